@@ -247,8 +247,8 @@ int main(int argc,char* argv[])
         }
       }
       std::vector<double> aDist;
-      VoxelGeodesic(aDist,
-                    aIdvoxDist, sampler_box.edgeLen(), grid);
+      VoxelGeodesic_FastMarching(aDist,
+                                 aIdvoxDist, sampler_box.edgeLen(), grid);
       const int nx = grid.ndivx;
       const int ny = grid.ndivy;
       const int nz = grid.ndivz;
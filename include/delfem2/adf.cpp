@@ -9,7 +9,10 @@
 #include <assert.h>
 #include <math.h>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
 #include "delfem2/adf.h"
+#include "delfem2/thread/th.h"
 
 namespace dfm2 = delfem2;
 
@@ -342,6 +345,73 @@ DFM2_INLINE void VertexInterp
   pIntp[2] = p0[2]*r0 + p1[2]*r1;
 }
 
+/**
+ * @brief trilinear interpolation of the distance and its gradient in a cell
+ * @param rx,ry,rz normalized coordinate in the cell (-1 to +1)
+ * @param n normal outward (negative gradient)
+ */
+DFM2_INLINE double TrilinearDistNormal
+ (double n[3],
+  double rx, double ry, double rz,
+  const double dists_[8])
+{
+  const double dist =
+  ( (1-rx)*(1-ry)*(1-rz)*dists_[0]
+   +(1+rx)*(1-ry)*(1-rz)*dists_[1]
+   +(1+rx)*(1+ry)*(1-rz)*dists_[2]
+   +(1-rx)*(1+ry)*(1-rz)*dists_[3]
+   +(1-rx)*(1-ry)*(1+rz)*dists_[4]
+   +(1+rx)*(1-ry)*(1+rz)*dists_[5]
+   +(1+rx)*(1+ry)*(1+rz)*dists_[6]
+   +(1-rx)*(1+ry)*(1+rz)*dists_[7] )*0.125;
+  ////
+  n[0] =
+  (-(1-ry)*(1-rz)*dists_[0]
+   +(1-ry)*(1-rz)*dists_[1]
+   +(1+ry)*(1-rz)*dists_[2]
+   -(1+ry)*(1-rz)*dists_[3]
+   -(1-ry)*(1+rz)*dists_[4]
+   +(1-ry)*(1+rz)*dists_[5]
+   +(1+ry)*(1+rz)*dists_[6]
+   -(1+ry)*(1+rz)*dists_[7] );
+  ////
+  n[1] =
+  (-(1-rx)*(1-rz)*dists_[0]
+   -(1+rx)*(1-rz)*dists_[1]
+   +(1+rx)*(1-rz)*dists_[2]
+   +(1-rx)*(1-rz)*dists_[3]
+   -(1-rx)*(1+rz)*dists_[4]
+   -(1+rx)*(1+rz)*dists_[5]
+   +(1+rx)*(1+rz)*dists_[6]
+   +(1-rx)*(1+rz)*dists_[7] );
+  ////
+  n[2] =
+  (-(1-rx)*(1-ry)*dists_[0]
+   -(1+rx)*(1-ry)*dists_[1]
+   -(1+rx)*(1+ry)*dists_[2]
+   -(1-rx)*(1+ry)*dists_[3]
+   +(1-rx)*(1-ry)*dists_[4]
+   +(1+rx)*(1-ry)*dists_[5]
+   +(1+rx)*(1+ry)*dists_[6]
+   +(1-rx)*(1+ry)*dists_[7] );
+  ////
+  const double invlen = 1.0/sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+  n[0] *= -invlen;
+  n[1] *= -invlen;
+  n[2] *= -invlen;
+  return dist;
+}
+
+/**
+ * @brief index of the child (or the corner) in the octant "ix,iy,iz" (0:minus side, 1:plus side)
+ */
+DFM2_INLINE unsigned int IndexOctant
+ (unsigned int ix, unsigned int iy, unsigned int iz)
+{
+  static const unsigned int aInd[4] = { 0, 1, 3, 2 }; // (iy*2+ix) -> index in the xy-plane
+  return aInd[iy*2+ix] + iz*4;
+}
+
 }
 }
 
@@ -367,35 +437,168 @@ void dfm2::CADF3::SetUp
 (const CInput_ADF3& ct,
  double bb[6])
 {
-  aNode.reserve(1024*64);
-  aNode.resize(1);
-  CNode no;
+  this->SetUp(ct, bb, 6, 1, -1.0, 1);
+}
+
+DFM2_INLINE void dfm2::CADF3::SetUp(
+    const CInput_ADF3& ct,
+    const double bb[6],
+    unsigned int depth_max,
+    unsigned int depth_min,
+    double tol,
+    unsigned int nthread)
+{
+  namespace lcl = ::delfem2::adf;
+  assert( depth_max <= 20 ); // lattice coordinates of the samples are packed in 64bit
+  double hw0 = (bb[1]-bb[0]) > (bb[3]-bb[2]) ? (bb[1]-bb[0])*0.5 : (bb[3]-bb[2])*0.5;
+  hw0 = hw0 > (bb[5]-bb[4])*0.5 ? hw0 : (bb[5]-bb[4])*0.5;
+  hw0 *= 1.1234;
+  const double org[3] = { // corner of the root cell
+    (bb[0]+bb[1])*0.5-hw0,
+    (bb[2]+bb[3])*0.5-hw0,
+    (bb[4]+bb[5])*0.5-hw0 };
+  const double min_hw = ldexp(hw0, -static_cast<int>(depth_max))*0.99;
+  if( tol < 0 ){ tol = min_hw*0.8; }
+  aNode.assign(1, CNode());
   {
-    no.cent_[0] = (bb[0]+bb[1])*0.5;
-    no.cent_[1] = (bb[2]+bb[3])*0.5;
-    no.cent_[2] = (bb[4]+bb[5])*0.5;
-    no.hw_ = (bb[1]-bb[0]) > (bb[3]-bb[2]) ? (bb[1]-bb[0])*0.5 : (bb[3]-bb[2])*0.5;
-    no.hw_ = no.hw_ > (bb[5]-bb[4])*0.5 ? no.hw_ : (bb[5]-bb[4])*0.5;
-    no.hw_ *= 1.1234;
-    no.SetCornerDist(ct);
-    no.MakeChildTree(ct,aNode,no.hw_*(0.99/64.0),no.hw_*(1.01/4.0));
-    //		no.MakeChildTree(ct,aNode,no.hw_*(0.99/128.0),no.hw_*(1.01/4.0));
-    //		no.MakeChildTree(ct,aNode,no.hw_*(0.99/32.0),no.hw_*(1.01/4.0));
+    CNode& no = aNode[0];
+    double aXYZ[24];
+    for(int idim=0;idim<3;++idim){ no.cent_[idim] = org[idim]+hw0; }
+    no.hw_ = hw0;
+    for(unsigned int i=0;i<8;++i){
+      for(int idim=0;idim<3;++idim){ aXYZ[i*3+idim] = org[idim]+hw0*(1+lcl::phexflg[i][idim]); }
+    }
+    ct.sdf_batch(no.dists_, aXYZ, 8);
+  }
+  // position of 27 lattice points of a cell (0:minus, 1:center, 2:plus). The points with "1" are sampled
+  unsigned int aIndCorner[8]; // 8 corners among 27
+  for(unsigned int ic=0;ic<8;++ic){
+    aIndCorner[ic] = (lcl::phexflg[ic][0] > 0 ? 18 : 0) + (lcl::phexflg[ic][1] > 0 ? 6 : 0) + (lcl::phexflg[ic][2] > 0 ? 2 : 0);
+  }
+  std::vector<unsigned int> aIndSmpl; // 19 sampled points among 27
+  for(unsigned int i=0;i<27;++i){
+    if( i/9 == 1 || (i/3)%3 == 1 || i%3 == 1 ){ aIndSmpl.push_back(i); }
+  }
+  assert( aIndSmpl.size() == 19 );
+  std::vector<unsigned int> aFront(1, 0); // nodes at the current depth
+  std::vector<unsigned int> aCell(3, 0); // integer coordinates of the cells at the current depth
+  for(unsigned int idepth=0;idepth<depth_max && !aFront.empty();++idepth){
+    const auto nfront = static_cast<unsigned int>(aFront.size());
+    const double hw = ldexp(hw0, -static_cast<int>(idepth));
+    const std::uint64_t nlat = (std::uint64_t(2) << idepth)+1; // number of lattice points with the interval "hw"
+    // sort the samples by the lattice coordinate to find the samples shared by the neighboring cells
+    std::vector<std::pair<std::uint64_t,unsigned int> > aKey(nfront*19);
+    thread::parallel_for(nfront, [&](unsigned int ifront){
+      for(unsigned int ismpl=0;ismpl<19;++ismpl){
+        const unsigned int i27 = aIndSmpl[ismpl];
+        const std::uint64_t ix = 2*aCell[ifront*3+0]+i27/9;
+        const std::uint64_t iy = 2*aCell[ifront*3+1]+(i27/3)%3;
+        const std::uint64_t iz = 2*aCell[ifront*3+2]+i27%3;
+        aKey[ifront*19+ismpl] = std::make_pair((ix*nlat+iy)*nlat+iz, ifront*19+ismpl);
+      }
+    }, nthread);
+    std::sort(aKey.begin(), aKey.end());
+    std::vector<unsigned int> aSmpl(nfront*19); // index of the unique sample
+    std::vector<double> aXYZ;
+    for(unsigned int ik=0;ik<aKey.size();++ik){
+      const std::uint64_t key = aKey[ik].first;
+      if( ik == 0 || key != aKey[ik-1].first ){
+        aXYZ.push_back(org[0]+static_cast<double>(key/(nlat*nlat))*hw);
+        aXYZ.push_back(org[1]+static_cast<double>((key/nlat)%nlat)*hw);
+        aXYZ.push_back(org[2]+static_cast<double>(key%nlat)*hw);
+      }
+      aSmpl[aKey[ik].second] = static_cast<unsigned int>(aXYZ.size()/3-1);
+    }
+    const auto nsmpl = static_cast<unsigned int>(aXYZ.size()/3);
+    std::vector<double> aVal(nsmpl);
+    thread::parallel_for_range(nsmpl, [&](unsigned int, unsigned int is, unsigned int ie){
+      ct.sdf_batch(aVal.data()+is, aXYZ.data()+is*3, ie-is);
+    }, std::min(nsmpl, thread::num_threads(nthread)));
+    // distances at 27 lattice points of a cell
+    auto lattice_values = [&](double v[27], unsigned int ifront){
+      const CNode& no = aNode[aFront[ifront]];
+      for(unsigned int ic=0;ic<8;++ic){ v[aIndCorner[ic]] = no.dists_[ic]; }
+      for(unsigned int ismpl=0;ismpl<19;++ismpl){ v[aIndSmpl[ismpl]] = aVal[aSmpl[ifront*19+ismpl]]; }
+    };
+    // decide subdivision
+    std::vector<unsigned int> aIsSubdiv(nfront, 0);
+    thread::parallel_for(nfront, [&](unsigned int ifront){
+      if( idepth < depth_min ){ aIsSubdiv[ifront] = 1; return; }
+      double v[27];
+      lattice_values(v, ifront);
+      double min_dist = fabs(v[aIndSmpl[0]]);
+      for(unsigned int ismpl=1;ismpl<19;++ismpl){ min_dist = std::min(min_dist, fabs(v[aIndSmpl[ismpl]])); }
+      if( min_dist > hw*1.8 ){ return; } // there is no surface inside
+      if( min_dist < min_hw ){ aIsSubdiv[ifront] = 1; return; }
+      for(unsigned int ismpl=0;ismpl<19;++ismpl){
+        const unsigned int i27 = aIndSmpl[ismpl];
+        const unsigned int id[3] = { i27/9, (i27/3)%3, i27%3 };
+        double interp = 0.0;
+        for(unsigned int ic=0;ic<8;++ic){
+          double w = 1.0;
+          for(int idim=0;idim<3;++idim){
+            if( id[idim] == 1 ){ w *= 0.5; }
+            else if( (id[idim] == 2) != (lcl::phexflg[ic][idim] > 0) ){ w = 0.0; }
+          }
+          interp += w*v[aIndCorner[ic]];
+        }
+        if( fabs(v[i27]-interp) > tol ){ aIsSubdiv[ifront] = 1; return; }
+      }
+    }, nthread);
+    // make the children. The children of a node are contiguous
+    std::vector<unsigned int> aIndChild0(nfront);
+    unsigned int nchild = 0;
+    for(unsigned int ifront=0;ifront<nfront;++ifront){
+      if( aIsSubdiv[ifront] == 0 ){ continue; }
+      aIndChild0[ifront] = static_cast<unsigned int>(aNode.size())+nchild;
+      nchild += 8;
+    }
+    const auto nnode0 = static_cast<unsigned int>(aNode.size());
+    aNode.resize(nnode0+nchild);
+    std::vector<unsigned int> aFrontNext(nchild), aCellNext(nchild*3);
+    const double hwc = hw*0.5;
+    thread::parallel_for(nfront, [&](unsigned int ifront){
+      if( aIsSubdiv[ifront] == 0 ){ return; }
+      double v[27];
+      lattice_values(v, ifront);
+      CNode& no = aNode[aFront[ifront]];
+      for(unsigned int ichild=0;ichild<8;++ichild){
+        const unsigned int ino = aIndChild0[ifront]+ichild;
+        no.ichilds_[ichild] = static_cast<int>(ino);
+        const int oct[3] = { // octant of the child
+          lcl::phexflg[ichild][0] > 0 ? 1 : 0,
+          lcl::phexflg[ichild][1] > 0 ? 1 : 0,
+          lcl::phexflg[ichild][2] > 0 ? 1 : 0 };
+        CNode& nc = aNode[ino];
+        nc.hw_ = hwc;
+        for(int idim=0;idim<3;++idim){
+          const unsigned int icell = 2*aCell[ifront*3+idim]+oct[idim];
+          nc.cent_[idim] = org[idim]+static_cast<double>(2*icell+1)*hwc;
+          aCellNext[(ino-nnode0)*3+idim] = icell;
+        }
+        for(unsigned int ic=0;ic<8;++ic){ nc.dists_[ic] = v[aIndCorner[ic]/2+oct[0]*9+oct[1]*3+oct[2]]; }
+        aFrontNext[ino-nnode0] = ino;
+      }
+    }, nthread);
+    aFront.swap(aFrontNext);
+    aCell.swap(aCellNext);
+  }
+  // compact layout for the query
+  const auto nnode = static_cast<unsigned int>(aNode.size());
+  aIndChild.resize(nnode);
+  aDistCorner.resize(nnode*8);
+  for(unsigned int ino=0;ino<nnode;ino++){
+    aIndChild[ino] = aNode[ino].ichilds_[0];
+    for(unsigned int i=0;i<8;i++){ aDistCorner[ino*8+i] = aNode[ino].dists_[i]; }
   }
-  aNode[0] = no;
-  std::cout << "ADF Oct-tree Node Size : " << aNode.size() << std::endl;
   ////
-  dist_min = no.dists_[0];
+  dist_min = aNode[0].dists_[0];
   dist_max = dist_min;
-  for(unsigned int ino=0;ino<aNode.size();ino++){
-    for(unsigned int i=0;i<8;i++){
-      const double dist = aNode[ino].dists_[i];
-      dist_min = ( dist < dist_min ) ? dist : dist_min;
-      dist_max = ( dist > dist_max ) ? dist : dist_max;
-    }
+  for(double dist : aDistCorner){
+    dist_min = ( dist < dist_min ) ? dist : dist_min;
+    dist_max = ( dist > dist_max ) ? dist : dist_max;
   }
-  std::cout << "dist min max" << dist_min << " " << dist_max << std::endl;
-  if( aIsoTri_ != 0 ){ delete aIsoTri_; aIsoTri_ = 0; }
+  if( aIsoTri_ != 0 ){ delete[] aIsoTri_; aIsoTri_ = 0; }
   nIsoTri_ = 0;
 }
 
@@ -404,16 +607,47 @@ double dfm2::CADF3::Projection
 (double px, double py, double pz,
  double n[3]) const // normal outward
 {
+  namespace lcl = ::delfem2::adf;
   const CNode& no = aNode[0];
   if( fabs(px-no.cent_[0]) > no.hw_ || fabs(py-no.cent_[1]) > no.hw_ || fabs(pz-no.cent_[2]) > no.hw_ ){
     n[0] = no.cent_[0]-px;
     n[1] = no.cent_[1]-py;
     n[2] = no.cent_[2]-pz;
     const double invlen = 1.0/sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
-    for(unsigned int i=0;i<3;i++){ n[0] *= invlen; }
+    for(unsigned int i=0;i<3;i++){ n[i] *= invlen; }
     return -no.hw_;
   }
-  return no.FindDistNormal(px,py,pz, n, aNode);
+  if( aIndChild.size() != aNode.size() ){ // the compact layout is not built
+    return no.FindDistNormal(px,py,pz, n, aNode);
+  }
+  // descend the tree only with the child indices
+  double cx = no.cent_[0], cy = no.cent_[1], cz = no.cent_[2], hw = no.hw_;
+  unsigned int ino = 0;
+  while( aIndChild[ino] != -1 ){
+    hw *= 0.5;
+    const unsigned int ix = (px < cx) ? 0 : 1;
+    const unsigned int iy = (py < cy) ? 0 : 1;
+    const unsigned int iz = (pz < cz) ? 0 : 1;
+    cx += ix ? hw : -hw;
+    cy += iy ? hw : -hw;
+    cz += iz ? hw : -hw;
+    ino = aIndChild[ino]+lcl::IndexOctant(ix,iy,iz);
+  }
+  return lcl::TrilinearDistNormal(n,
+      (px-cx)/hw, (py-cy)/hw, (pz-cz)/hw,
+      aDistCorner.data()+ino*8);
+}
+
+DFM2_INLINE void dfm2::CADF3::Projection_Batch(
+    double* aDist,
+    double* aNorm,
+    const double* aXYZ,
+    unsigned int np,
+    unsigned int nthread) const
+{
+  thread::parallel_for(np, [&](unsigned int ip){
+    aDist[ip] = this->Projection(aXYZ[ip*3+0], aXYZ[ip*3+1], aXYZ[ip*3+2], aNorm+ip*3);
+  }, nthread);
 }
 
 void dfm2::CADF3::BuildIsoSurface_MarchingCube()
@@ -696,54 +930,9 @@ double dfm2::CADF3::CNode::FindDistNormal
     //    return dist;
   }
   if( ichilds_[0] == -1 ){
-    const double rx = (px-cent_[0])/hw_;
-    const double ry = (py-cent_[1])/hw_;
-    const double rz = (pz-cent_[2])/hw_;
-    double dist =
-    ( (1-rx)*(1-ry)*(1-rz)*dists_[0]
-     +(1+rx)*(1-ry)*(1-rz)*dists_[1]
-     +(1+rx)*(1+ry)*(1-rz)*dists_[2]
-     +(1-rx)*(1+ry)*(1-rz)*dists_[3]
-     +(1-rx)*(1-ry)*(1+rz)*dists_[4]
-     +(1+rx)*(1-ry)*(1+rz)*dists_[5]
-     +(1+rx)*(1+ry)*(1+rz)*dists_[6]
-     +(1-rx)*(1+ry)*(1+rz)*dists_[7] )*0.125;
-    ////
-    n[0] =
-    (-(1-ry)*(1-rz)*dists_[0]
-     +(1-ry)*(1-rz)*dists_[1]
-     +(1+ry)*(1-rz)*dists_[2]
-     -(1+ry)*(1-rz)*dists_[3]
-     -(1-ry)*(1+rz)*dists_[4]
-     +(1-ry)*(1+rz)*dists_[5]
-     +(1+ry)*(1+rz)*dists_[6]
-     -(1+ry)*(1+rz)*dists_[7] );
-    ////
-    n[1] =
-    (-(1-rx)*(1-rz)*dists_[0]
-     -(1+rx)*(1-rz)*dists_[1]
-     +(1+rx)*(1-rz)*dists_[2]
-     +(1-rx)*(1-rz)*dists_[3]
-     -(1-rx)*(1+rz)*dists_[4]
-     -(1+rx)*(1+rz)*dists_[5]
-     +(1+rx)*(1+rz)*dists_[6]
-     +(1-rx)*(1+rz)*dists_[7] );
-    ////
-    n[2] =
-    (-(1-rx)*(1-ry)*dists_[0]
-     -(1+rx)*(1-ry)*dists_[1]
-     -(1+rx)*(1+ry)*dists_[2]
-     -(1-rx)*(1+ry)*dists_[3]
-     +(1-rx)*(1-ry)*dists_[4]
-     +(1+rx)*(1-ry)*dists_[5]
-     +(1+rx)*(1+ry)*dists_[6]
-     +(1-rx)*(1+ry)*dists_[7] );
-    ////
-    const double invlen = 1.0/sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
-    n[0] *= -invlen;
-    n[1] *= -invlen;
-    n[2] *= -invlen;
-    return dist;
+    return adf::TrilinearDistNormal(n,
+        (px-cent_[0])/hw_, (py-cent_[1])/hw_, (pz-cent_[2])/hw_,
+        dists_);
   }
   if( px<cent_[0] ){
     if( py<cent_[1] ){
@@ -20,6 +20,14 @@ class CInput_ADF3
 {
 public:
   virtual double sdf(double px, double py, double pz) const = 0;
+  /**
+   * @brief signed distances of "np" points at once. Override this if evaluating the points together is faster
+   * @param aXYZ coordinates of the points (3 values per point)
+   * @details "CADF3::SetUp" calls this from multiple threads simultaneously if "nthread" is not 1
+   */
+  virtual void sdf_batch(double* aDist, const double* aXYZ, unsigned int np) const {
+    for(unsigned int ip=0;ip<np;++ip){ aDist[ip] = this->sdf(aXYZ[ip*3+0], aXYZ[ip*3+1], aXYZ[ip*3+2]); }
+  }
 };
 
 /**
@@ -30,11 +38,40 @@ class CADF3
 public:
   CADF3();
   ~CADF3();
+  /**
+   * @brief build the tree with the depth up to 6 using a single thread
+   */
   void SetUp(const CInput_ADF3& ct, double bb[6]);
+  /**
+   * @brief build the tree level by level. The samples shared by the neighboring cells are evaluated only once with "sdf_batch"
+   * @param depth_max the cells at this depth are not subdivided (up to 20)
+   * @param depth_min the cells shallower than this are always subdivided
+   * @param tol the cell is subdivided if the trilinear interpolation error at the edge, face or center points exceeds this.
+   * negative value sets 80% of the half-width of the smallest cell
+   * @param nthread number of threads. hardware concurrency is used if 0
+   * @details the resulting tree does not depend on the number of threads
+   */
+  void SetUp(
+      const CInput_ADF3& ct,
+      const double bb[6],
+      unsigned int depth_max,
+      unsigned int depth_min,
+      double tol,
+      unsigned int nthread = 0);
   void SetFaceColor(double r, double g, double b){ color_[0] = r; color_[1] = g; color_[2] = b; }
   virtual double Projection
   (double px, double py, double pz,
    double n[3]) const;
+  /**
+   * @brief "Projection" of many points in parallel
+   * @param aNorm outward normals (3 values per point)
+   */
+  void Projection_Batch(
+      double* aDist,
+      double* aNorm,
+      const double* aXYZ,
+      unsigned int np,
+      unsigned int nthread = 0) const;
   virtual bool IntersectionPoint
   (double p[3],
    const double org[3], const double dir[3]) const { return false; }
@@ -66,6 +103,9 @@ public:
   };
 public:
   std::vector<CNode> aNode;
+  // compact layout of "aNode" for the query. The 8 children of a node are stored contiguously
+  std::vector<int> aIndChild; // index of the first child of each node. -1 for the leaf
+  std::vector<double> aDistCorner; // distances at the 8 corners of each node
   double dist_min, dist_max;
   unsigned int nIsoTri_;
   double* aIsoTri_;
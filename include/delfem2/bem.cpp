@@ -5,8 +5,14 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cmath>
+#include <climits>
+#include <limits>
+#include <algorithm>
 #include "delfem2/bem.h"
 #include "delfem2/geo3_v23m34q.h"
+#include "delfem2/srchbvh.h"
+#include "delfem2/thread/th.h"
 
 #ifndef M_PI
 #  define M_PI 3.141592653589793
@@ -393,6 +399,58 @@ delfem2::CVec3d delfem2::evaluateField_PotentialFlow_Order1st(
 }
 
 
+namespace delfem2 {
+namespace bem {
+
+/**
+ * @brief integral of the Green's function and its normal derivative over a triangle seen from a point
+ * @param ny (out) unit normal of the triangle pointing outward to the domain
+ */
+DFM2_INLINE void PotentialFlow_Order0th_Coeff(
+    double& dGdn_int,
+    double& G_int,
+    CVec3d& ny,
+    const CVec3d& pm,
+    const CVec3d& q0,
+    const CVec3d& q1,
+    const CVec3d& q2,
+    int ngauss)
+{
+  ny = Normal(q0, q1, q2);
+  const double area = ny.Length()*0.5; // area
+  ny.SetNormalizedVector(); // unit normal
+  ny *= -1; // it is pointing outward to the domain
+  dGdn_int = 0;
+  G_int = 0;
+  const int nint = NIntTriGauss[ngauss]; // number of integral points
+  for (int iint = 0; iint<nint; iint++){
+    double r0 = TriGauss[ngauss][iint][0];
+    double r1 = TriGauss[ngauss][iint][1];
+    double r2 = 1.0-r0-r1;
+    double wb = TriGauss[ngauss][iint][2];
+    CVec3d yb = r0*q0+r1*q1+r2*q2;
+    CVec3d r = (pm-yb);
+    double len = r.Length();
+    double G = 1.0/(4*M_PI*len);
+    double dGdn = (r*ny)/(4*M_PI*len*len*len);
+    dGdn_int += wb*area*dGdn;  // should be plus
+    G_int += wb*area*G;
+  }
+}
+
+DFM2_INLINE CVec3d TriPoint(
+    unsigned int itri,
+    unsigned int inode,
+    const std::vector<unsigned int> &aTri,
+    const std::vector<double>& aXYZ)
+{
+  const unsigned int ip = aTri[itri*3+inode];
+  return CVec3d(aXYZ[ip*3+0], aXYZ[ip*3+1], aXYZ[ip*3+2]);
+}
+
+}
+}
+
 void delfem2::makeLinearSystem_PotentialFlow_Order0th(
     std::vector<double>& A,
     std::vector<double>& f,
@@ -409,60 +467,445 @@ void delfem2::makeLinearSystem_PotentialFlow_Order0th(
     const CVec3d pm = MidPoint(it, aTri, aXYZ);
     for (std::size_t jt = 0; jt<nt; ++jt){
       if (it==jt) continue;
-      const unsigned int jq0 = aTri[jt*3+0];
-      const unsigned int jq1 = aTri[jt*3+1];
-      const unsigned int jq2 = aTri[jt*3+2];
-      const CVec3d q0(aXYZ[jq0*3+0], aXYZ[jq0*3+1], aXYZ[jq0*3+2]);
-      const CVec3d q1(aXYZ[jq1*3+0], aXYZ[jq1*3+1], aXYZ[jq1*3+2]);
-      const CVec3d q2(aXYZ[jq2*3+0], aXYZ[jq2*3+1], aXYZ[jq2*3+2]);
-      CVec3d ny = Normal(q0, q1, q2);
-      const double area = ny.Length()*0.5; // area
-      ny.SetNormalizedVector(); // unit normal
-      ny *= -1; // it is pointing outward to the domain
-      double aC = 0;
-      double df = 0;
-      const int nint = NIntTriGauss[ngauss]; // number of integral points
-      for (int iint = 0; iint<nint; iint++){
-        double r0 = TriGauss[ngauss][iint][0];
-        double r1 = TriGauss[ngauss][iint][1];
-        double r2 = 1.0-r0-r1;
-        double wb = TriGauss[ngauss][iint][2];
-        CVec3d yb = r0*q0+r1*q1+r2*q2;
-        CVec3d r = (pm-yb);
-        double len = r.Length();
-        double G = 1.0/(4*M_PI*len);
-        double dGdn = (r*ny)/(4*M_PI*len*len*len);
-        {
-          double wav = wb*area*dGdn;
-          aC += wav;  // should be plus
-        }
-        {
-          double vnyb = -ny*velo_inf;
-          double val = vnyb*G;
-          df += wb*area*val;  // should be plus
-        }
-      }
+      double aC, G_int;
+      CVec3d ny;
+      bem::PotentialFlow_Order0th_Coeff(
+          aC, G_int, ny,
+          pm,
+          bem::TriPoint(jt,0,aTri,aXYZ), bem::TriPoint(jt,1,aTri,aXYZ), bem::TriPoint(jt,2,aTri,aXYZ),
+          ngauss);
+      const double vnyb = -ny*velo_inf;
       A[it*nt+jt] = aC;
-      f[it] += df;
+      f[it] += vnyb*G_int;  // should be plus
     }
     A[it*nt+it] += 0.5; 
   }
-  /*
+}
+
+// ---------------------------------------
+// H-matrix
+
+namespace delfem2 {
+namespace bem {
+
+/**
+ * @tparam CLUSTER class with "ibegin", "iend", "ichild[2]", "bbmin[3]" and "bbmax[3]"
+ */
+template <class CLUSTER>
+unsigned int MakeCluster_Morton(
+    std::vector<CLUSTER>& aCluster,
+    unsigned int ibegin,
+    unsigned int iend,
+    const std::vector<unsigned int>& aSortedMc,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aPerm,
+    unsigned int nleaf)
+{
+  const unsigned int icluster = static_cast<unsigned int>(aCluster.size());
+  aCluster.resize(aCluster.size()+1);
   {
-    double sum = 0;
-    for (int jt = 0; jt<nt; ++jt){
-      double row = 0;
-      for (int it = 0; it<nt; ++it){
-        row += A[it*nt+jt];
+    CLUSTER& c = aCluster[icluster];
+    c.ibegin = ibegin;
+    c.iend = iend;
+    c.ichild[0] = c.ichild[1] = UINT_MAX;
+    for(int idim=0;idim<3;++idim){
+      c.bbmin[idim] = +std::numeric_limits<double>::max();
+      c.bbmax[idim] = -std::numeric_limits<double>::max();
+    }
+    for(unsigned int ii=ibegin;ii<iend;++ii){
+      const double* p = aXYZ.data()+aPerm[ii]*3;
+      for(int idim=0;idim<3;++idim){
+        c.bbmin[idim] = std::min(c.bbmin[idim], p[idim]);
+        c.bbmax[idim] = std::max(c.bbmax[idim], p[idim]);
       }
-      sum += row;
-      std::cout<<"hoge"<<jt<<" "<<row<<std::endl;
     }
-    std::cout<<"sum: "<<sum<<std::endl;
   }
-  */
+  if( iend-ibegin <= nleaf ){ return icluster; }
+  unsigned int isplit = (ibegin+iend)/2; // for the duplicated Morton codes
+  if( aSortedMc[ibegin] != aSortedMc[iend-1] ){
+    isplit = MortonCode_FindSplit(aSortedMc.data(), ibegin, iend-1)+1;
+  }
+  const unsigned int ic0 = MakeCluster_Morton(aCluster, ibegin, isplit, aSortedMc, aXYZ, aPerm, nleaf);
+  const unsigned int ic1 = MakeCluster_Morton(aCluster, isplit, iend, aSortedMc, aXYZ, aPerm, nleaf);
+  aCluster[icluster].ichild[0] = ic0;
+  aCluster[icluster].ichild[1] = ic1;
+  return icluster;
+}
+
+/**
+ * @brief cluster tree of the points along the Morton code
+ * @param aPerm (out) index of the point for the i-th position of cluster order
+ */
+template <class CLUSTER>
+void MakeClusterTree_Morton(
+    std::vector<CLUSTER>& aCluster,
+    std::vector<unsigned int>& aPerm,
+    const std::vector<double>& aXYZ,
+    unsigned int nleaf)
+{
+  const unsigned int n = static_cast<unsigned int>(aXYZ.size()/3);
+  aCluster.clear();
+  aPerm.clear();
+  if( n == 0 ){ return; }
+  double bbmin[3], bbmax[3];
+  for(int idim=0;idim<3;++idim){
+    bbmin[idim] = +std::numeric_limits<double>::max();
+    bbmax[idim] = -std::numeric_limits<double>::max();
+  }
+  for(unsigned int i=0;i<n;++i){
+    for(int idim=0;idim<3;++idim){
+      bbmin[idim] = std::min(bbmin[idim], aXYZ[i*3+idim]);
+      bbmax[idim] = std::max(bbmax[idim], aXYZ[i*3+idim]);
+    }
+  }
+  double len = std::max(bbmax[0]-bbmin[0], std::max(bbmax[1]-bbmin[1], bbmax[2]-bbmin[2]));
+  if( len <= 0.0 ){ len = 1.0; }
+  for(int idim=0;idim<3;++idim){ // avoid zero division for the flat geometry
+    bbmin[idim] -= len*1.0e-3;
+    bbmax[idim] += len*1.0e-3;
+  }
+  std::vector<unsigned int> aSortedMc;
+  SortedMortenCode_Points3(aPerm, aSortedMc, aXYZ, bbmin, bbmax);
+  MakeCluster_Morton(aCluster, 0, n, aSortedMc, aXYZ, aPerm, nleaf);
+}
+
+template <class CLUSTER>
+double Diameter_Cluster(const CLUSTER& c)
+{
+  const double d[3] = { c.bbmax[0]-c.bbmin[0], c.bbmax[1]-c.bbmin[1], c.bbmax[2]-c.bbmin[2] };
+  return sqrt(d[0]*d[0]+d[1]*d[1]+d[2]*d[2]);
+}
+
+DFM2_INLINE double Distance_Cluster(
+    const CHMatrixACA::CCluster& c0,
+    const CHMatrixACA::CCluster& c1)
+{
+  double sqd = 0.0;
+  for(int idim=0;idim<3;++idim){
+    const double d = std::max(0.0, std::max(c0.bbmin[idim]-c1.bbmax[idim], c1.bbmin[idim]-c0.bbmax[idim]));
+    sqd += d*d;
+  }
+  return sqrt(sqd);
+}
+
+DFM2_INLINE void MakeBlock_Admissible(
+    std::vector<std::pair<unsigned int,unsigned int> >& aPairLowRank,
+    std::vector<std::pair<unsigned int,unsigned int> >& aPairDense,
+    unsigned int ic0,
+    unsigned int ic1,
+    const std::vector<CHMatrixACA::CCluster>& aCluster,
+    double eta)
+{
+  const CHMatrixACA::CCluster& c0 = aCluster[ic0];
+  const CHMatrixACA::CCluster& c1 = aCluster[ic1];
+  if( std::min(Diameter_Cluster(c0), Diameter_Cluster(c1)) < eta*Distance_Cluster(c0, c1) ){
+    aPairLowRank.emplace_back(ic0, ic1);
+    return;
+  }
+  const bool is_leaf0 = (c0.ichild[0] == UINT_MAX);
+  const bool is_leaf1 = (c1.ichild[0] == UINT_MAX);
+  if( is_leaf0 && is_leaf1 ){
+    aPairDense.emplace_back(ic0, ic1);
+    return;
+  }
+  if( is_leaf0 ){
+    for(unsigned int jc : c1.ichild){ MakeBlock_Admissible(aPairLowRank, aPairDense, ic0, jc, aCluster, eta); }
+    return;
+  }
+  if( is_leaf1 ){
+    for(unsigned int ic : c0.ichild){ MakeBlock_Admissible(aPairLowRank, aPairDense, ic, ic1, aCluster, eta); }
+    return;
+  }
+  for(unsigned int ic : c0.ichild){
+    for(unsigned int jc : c1.ichild){ MakeBlock_Admissible(aPairLowRank, aPairDense, ic, jc, aCluster, eta); }
+  }
+}
+
+/**
+ * @brief adaptive cross approximation with the partial pivoting
+ * @param row (in) function sets the components of a row of the block "v[jcol]=A(irow,jcol)"
+ * @param col (in) function sets the components of a column of the block "u[irow]=A(irow,jcol)"
+ * @return false if the rank becomes too large to be efficient
+ */
+DFM2_INLINE bool ACA_PartialPivot(
+    std::vector<double>& aU,
+    std::vector<double>& aV,
+    unsigned int& rank,
+    const std::function<void(double* v, unsigned int irow)>& row,
+    const std::function<void(double* u, unsigned int jcol)>& col,
+    unsigned int nrow,
+    unsigned int ncol,
+    double eps)
+{
+  const unsigned int rank_max = (nrow*ncol)/(nrow+ncol); // storage is smaller than the dense block
+  aU.clear();
+  aV.clear();
+  rank = 0;
+  std::vector<int> aIsUsedRow(nrow, 0);
+  std::vector<double> u(nrow), v(ncol);
+  double sqnorm = 0.0; // squared Frobenius norm of the approximation
+  unsigned int irow = 0;
+  for(unsigned int itr=0;itr<nrow;++itr){
+    aIsUsedRow[irow] = 1;
+    row(v.data(), irow);
+    for(unsigned int k=0;k<rank;++k){
+      const double uk = aU[k*nrow+irow];
+      for(unsigned int jcol=0;jcol<ncol;++jcol){ v[jcol] -= uk*aV[k*ncol+jcol]; }
+    }
+    unsigned int jpivot = 0;
+    for(unsigned int jcol=1;jcol<ncol;++jcol){
+      if( fabs(v[jcol]) > fabs(v[jpivot]) ){ jpivot = jcol; }
+    }
+    if( fabs(v[jpivot]) < 1.0e-300 ){ // this row is already approximated. try next row
+      irow = UINT_MAX;
+      for(unsigned int i=0;i<nrow;++i){ if( aIsUsedRow[i] == 0 ){ irow = i; break; } }
+      if( irow == UINT_MAX ){ return true; }
+      continue;
+    }
+    const double invpivot = 1.0/v[jpivot];
+    for(unsigned int jcol=0;jcol<ncol;++jcol){ v[jcol] *= invpivot; }
+    col(u.data(), jpivot);
+    for(unsigned int k=0;k<rank;++k){
+      const double vk = aV[k*ncol+jpivot];
+      for(unsigned int i=0;i<nrow;++i){ u[i] -= aU[k*nrow+i]*vk; }
+    }
+    double sqnu = 0, sqnv = 0;
+    for(unsigned int i=0;i<nrow;++i){ sqnu += u[i]*u[i]; }
+    for(unsigned int j=0;j<ncol;++j){ sqnv += v[j]*v[j]; }
+    for(unsigned int k=0;k<rank;++k){
+      double du = 0, dv = 0;
+      for(unsigned int i=0;i<nrow;++i){ du += u[i]*aU[k*nrow+i]; }
+      for(unsigned int j=0;j<ncol;++j){ dv += v[j]*aV[k*ncol+j]; }
+      sqnorm += 2*du*dv;
+    }
+    sqnorm += sqnu*sqnv;
+    aU.insert(aU.end(), u.begin(), u.end());
+    aV.insert(aV.end(), v.begin(), v.end());
+    rank++;
+    if( sqnu*sqnv <= eps*eps*sqnorm ){ return true; }
+    if( rank >= rank_max ){ return false; }
+    irow = UINT_MAX;
+    for(unsigned int i=0;i<nrow;++i){
+      if( aIsUsedRow[i] != 0 ){ continue; }
+      if( irow == UINT_MAX || fabs(u[i]) > fabs(u[irow]) ){ irow = i; }
+    }
+    if( irow == UINT_MAX ){ return true; }
+  }
+  return true;
+}
+
+/**
+ * @brief approximate the matrices sharing the rows, the columns and the cluster tree at once
+ * @param entry (in) function computes the (irow,icol) components of all the matrices "val[0],...,val[nmat-1]"
+ * @details the rows and the columns computed for the cross approximation of a matrix are kept in the block and
+ * reused for the other matrices, and the entries of the dense blocks are computed once for all the matrices.
+ */
+DFM2_INLINE void Initialize_HMatrixACA(
+    CHMatrixACA** aMat,
+    unsigned int nmat,
+    const std::function<void(double* val, unsigned int irow, unsigned int icol)>& entry,
+    const std::vector<double>& aXYZ,
+    double eps,
+    double eta,
+    unsigned int nleaf,
+    unsigned int nthread)
+{
+  CHMatrixACA& A0 = *aMat[0];
+  MakeClusterTree_Morton(A0.aCluster, A0.aPerm, aXYZ, nleaf);
+  std::vector<std::pair<unsigned int,unsigned int> > aPairLowRank, aPairDense;
+  if( !A0.aCluster.empty() ){
+    MakeBlock_Admissible(aPairLowRank, aPairDense, 0, 0, A0.aCluster, eta);
+  }
+  const unsigned int nlowrank = static_cast<unsigned int>(aPairLowRank.size());
+  for(unsigned int imat=0;imat<nmat;++imat){
+    CHMatrixACA& A = *aMat[imat];
+    A.nthread = nthread;
+    A.aCluster = A0.aCluster;
+    A.aPerm = A0.aPerm;
+    A.aBlock.clear();
+    A.aBlock.resize(aPairLowRank.size()+aPairDense.size());
+  }
+  const std::vector<unsigned int>& aPerm = A0.aPerm;
+  thread::parallel_for(
+      static_cast<unsigned int>(A0.aBlock.size()),
+      [&](unsigned int iblock){
+        const std::pair<unsigned int,unsigned int> ic01 = (iblock < nlowrank) ? aPairLowRank[iblock] : aPairDense[iblock-nlowrank];
+        const CHMatrixACA::CCluster& cr = A0.aCluster[ic01.first];
+        const CHMatrixACA::CCluster& cc = A0.aCluster[ic01.second];
+        const unsigned int nrow = cr.iend-cr.ibegin;
+        const unsigned int ncol = cc.iend-cc.ibegin;
+        // rows and columns computed for the cross approximation of a matrix are reused for the other matrices
+        std::vector<unsigned int> aRowSlot(nrow, UINT_MAX), aColSlot(ncol, UINT_MAX);
+        std::vector<double> aRowCache, aColCache; // values of all the matrices for the cached rows and columns
+        std::vector<double> aDense; // values of all the matrices for the dense block
+        for(unsigned int imat=0;imat<nmat;++imat){
+          CHMatrixACA::CBlock& b = aMat[imat]->aBlock[iblock];
+          b.icluster_row = ic01.first;
+          b.icluster_col = ic01.second;
+          if( iblock < nlowrank &&
+              ACA_PartialPivot(
+                  b.aU, b.aV, b.rank,
+                  [&](double* v, unsigned int i){
+                    if( aRowSlot[i] == UINT_MAX ){
+                      aRowSlot[i] = static_cast<unsigned int>(aRowCache.size()/(ncol*nmat));
+                      aRowCache.resize(aRowCache.size()+ncol*nmat);
+                      double* val = aRowCache.data()+static_cast<size_t>(aRowSlot[i])*ncol*nmat;
+                      for(unsigned int j=0;j<ncol;++j){ entry(val+j*nmat, aPerm[cr.ibegin+i], aPerm[cc.ibegin+j]); }
+                    }
+                    const double* val = aRowCache.data()+static_cast<size_t>(aRowSlot[i])*ncol*nmat;
+                    for(unsigned int j=0;j<ncol;++j){ v[j] = val[j*nmat+imat]; }
+                  },
+                  [&](double* u, unsigned int j){
+                    if( aColSlot[j] == UINT_MAX ){
+                      aColSlot[j] = static_cast<unsigned int>(aColCache.size()/(nrow*nmat));
+                      aColCache.resize(aColCache.size()+nrow*nmat);
+                      double* val = aColCache.data()+static_cast<size_t>(aColSlot[j])*nrow*nmat;
+                      for(unsigned int i=0;i<nrow;++i){ entry(val+i*nmat, aPerm[cr.ibegin+i], aPerm[cc.ibegin+j]); }
+                    }
+                    const double* val = aColCache.data()+static_cast<size_t>(aColSlot[j])*nrow*nmat;
+                    for(unsigned int i=0;i<nrow;++i){ u[i] = val[i*nmat+imat]; }
+                  },
+                  nrow, ncol, eps) ){
+            continue;
+          }
+          if( aDense.empty() ){ // all the matrices are computed at once
+            aDense.resize(static_cast<size_t>(nrow)*ncol*nmat);
+            for(unsigned int i=0;i<nrow;++i){
+              for(unsigned int j=0;j<ncol;++j){
+                entry(aDense.data()+(static_cast<size_t>(i)*ncol+j)*nmat, aPerm[cr.ibegin+i], aPerm[cc.ibegin+j]);
+              }
+            }
+          }
+          b.rank = UINT_MAX;
+          b.aV.clear();
+          b.aU.resize(static_cast<size_t>(nrow)*ncol);
+          for(size_t k=0;k<b.aU.size();++k){ b.aU[k] = aDense[k*nmat+imat]; }
+        }
+      },
+      nthread);
+  for(unsigned int imat=0;imat<nmat;++imat){
+    CHMatrixACA& A = *aMat[imat];
+    std::stable_sort(
+        A.aBlock.begin(), A.aBlock.end(),
+        [](const CHMatrixACA::CBlock& b0, const CHMatrixACA::CBlock& b1){ return b0.icluster_row < b1.icluster_row; });
+    A.aBlockInd.assign(1,0);
+    for(unsigned int iblock=0;iblock<A.aBlock.size();++iblock){
+      if( iblock+1 == A.aBlock.size() || A.aBlock[iblock+1].icluster_row != A.aBlock[iblock].icluster_row ){
+        A.aBlockInd.push_back(iblock+1);
+      }
+    }
+  }
+}
+
+}
+}
+
+DFM2_INLINE void delfem2::CHMatrixACA::Initialize(
+    const std::function<double(unsigned int, unsigned int)>& entry,
+    const std::vector<double>& aXYZ,
+    double eps,
+    double eta,
+    unsigned int nleaf,
+    unsigned int nthread_)
+{
+  CHMatrixACA* aMat[1] = { this };
+  bem::Initialize_HMatrixACA(
+      aMat, 1,
+      [&](double* val, unsigned int irow, unsigned int icol){ val[0] = entry(irow, icol); },
+      aXYZ, eps, eta, nleaf, nthread_);
+}
+
+DFM2_INLINE void delfem2::CHMatrixACA::MatVec(
+    double* y,
+    double alpha, const double* x,
+    double beta) const
+{
+  const unsigned int n = static_cast<unsigned int>(aPerm.size());
+  std::vector<double> xp(n), yp(n, 0.0);
+  for(unsigned int i=0;i<n;++i){ xp[i] = x[aPerm[i]]; }
+  const unsigned int ngroup = static_cast<unsigned int>(aBlockInd.size()-1);
+  std::vector<std::vector<double> > aYGroup(ngroup); // product for each row cluster
+  thread::parallel_for(
+      ngroup,
+      [&](unsigned int igroup){
+        const CCluster& cr = aCluster[aBlock[aBlockInd[igroup]].icluster_row];
+        const unsigned int nrow = cr.iend-cr.ibegin;
+        std::vector<double>& yg = aYGroup[igroup];
+        yg.assign(nrow, 0.0);
+        for(unsigned int iblock=aBlockInd[igroup];iblock<aBlockInd[igroup+1];++iblock){
+          const CBlock& b = aBlock[iblock];
+          const CCluster& cc = aCluster[b.icluster_col];
+          const unsigned int ncol = cc.iend-cc.ibegin;
+          const double* xb = xp.data()+cc.ibegin;
+          if( b.rank == UINT_MAX ){
+            for(unsigned int i=0;i<nrow;++i){
+              double s = 0;
+              for(unsigned int j=0;j<ncol;++j){ s += b.aU[i*ncol+j]*xb[j]; }
+              yg[i] += s;
+            }
+            continue;
+          }
+          for(unsigned int k=0;k<b.rank;++k){
+            double s = 0;
+            for(unsigned int j=0;j<ncol;++j){ s += b.aV[k*ncol+j]*xb[j]; }
+            for(unsigned int i=0;i<nrow;++i){ yg[i] += b.aU[k*nrow+i]*s; }
+          }
+        }
+      },
+      nthread);
+  for(unsigned int igroup=0;igroup<ngroup;++igroup){
+    const CCluster& cr = aCluster[aBlock[aBlockInd[igroup]].icluster_row];
+    for(unsigned int i=cr.ibegin;i<cr.iend;++i){ yp[i] += aYGroup[igroup][i-cr.ibegin]; }
+  }
+  for(unsigned int i=0;i<n;++i){ y[aPerm[i]] = alpha*yp[i] + beta*y[aPerm[i]]; }
 }
 
+DFM2_INLINE size_t delfem2::CHMatrixACA::NumStoredValues() const
+{
+  size_t n = 0;
+  for(const auto& b : aBlock){ n += b.aU.size() + b.aV.size(); }
+  return n;
+}
+
+DFM2_INLINE void delfem2::makeHMatrix_PotentialFlow_Order0th(
+    CHMatrixACA& A,
+    std::vector<double>& f,
+    //
+    const CVec3d& velo_inf,
+    int ngauss,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int> &aTri,
+    double eps,
+    unsigned int nthread)
+{
+  const unsigned int nt = static_cast<unsigned int>(aTri.size()/3);
+  std::vector<double> aCenter(nt*3), aVnyb(nt);
+  for(unsigned int it=0;it<nt;++it){
+    const CVec3d pm = MidPoint(it, aTri, aXYZ);
+    aCenter[it*3+0] = pm.x();
+    aCenter[it*3+1] = pm.y();
+    aCenter[it*3+2] = pm.z();
+    CVec3d ny = Normal(bem::TriPoint(it,0,aTri,aXYZ), bem::TriPoint(it,1,aTri,aXYZ), bem::TriPoint(it,2,aTri,aXYZ));
+    ny.SetNormalizedVector();
+    aVnyb[it] = ny*velo_inf; // (-ny)*velo_inf with the outward normal
+  }
+  CHMatrixACA S; // single-layer potential
+  CHMatrixACA* aMat[2] = { &A, &S };
+  bem::Initialize_HMatrixACA( // both kernels come from one quadrature
+      aMat, 2,
+      [&](double* val, unsigned int it, unsigned int jt){
+        if( it == jt ){ val[0] = 0.5; val[1] = 0.0; return; }
+        CVec3d ny;
+        bem::PotentialFlow_Order0th_Coeff(
+            val[0], val[1], ny,
+            CVec3d(aCenter.data()+it*3),
+            bem::TriPoint(jt,0,aTri,aXYZ), bem::TriPoint(jt,1,aTri,aXYZ), bem::TriPoint(jt,2,aTri,aXYZ),
+            ngauss);
+      },
+      aCenter, eps, 1.0, 32, nthread);
+  f.assign(nt, 0.0);
+  S.MatVec(f.data(), 1.0, aVnyb.data(), 0.0);
+}
 
 void delfem2::evaluateField_PotentialFlow_Order0th(
     double& phi_pos,
@@ -745,20 +1188,26 @@ int ivp_self)
   return m_res;
 }
 
-void delfem2::setGradVeloVortexParticles
-(std::vector<CVortexParticle>& aVortexParticle)
+DFM2_INLINE void delfem2::setGradVeloVortexParticles
+(std::vector<CVortexParticle>& aVortexParticle,
+ unsigned int nthread)
 {
   for (unsigned int ivp = 0; ivp<aVortexParticle.size(); ++ivp){
     CVortexParticle& vp = aVortexParticle[ivp];
     vp.velo_pre = vp.velo;
     vp.gradvelo_pre = vp.gradvelo;
   }
+  std::vector<CVec3d> aVelo(aVortexParticle.size());
+  std::vector<CMat3d> aGradVelo(aVortexParticle.size());
+  thread::parallel_for(
+      static_cast<unsigned int>(aVortexParticle.size()),
+      [&](unsigned int ivp){
+        aGradVelo[ivp] = gradveloVortexParticles(aVelo[ivp], aVortexParticle[ivp].pos, aVortexParticle, ivp);
+      },
+      nthread);
   for (unsigned int ivp = 0; ivp<aVortexParticle.size(); ++ivp){
-//    CVector3 velo = veloVortexParticles(aVortexParticle[ivp].pos, aVortexParticle, ivp);
-    CVec3d velo;
-    CMat3d grad_velo = gradveloVortexParticles(velo, aVortexParticle[ivp].pos, aVortexParticle, ivp);
-    aVortexParticle[ivp].velo = velo;
-    aVortexParticle[ivp].gradvelo = grad_velo;
+    aVortexParticle[ivp].velo = aVelo[ivp];
+    aVortexParticle[ivp].gradvelo = aGradVelo[ivp];
     /*
     aVortexParticle[ivp].gradvelo = grad_velo;
     CMatrix3 D = (grad_velo+grad_velo.Trans())*0.5;
@@ -769,6 +1218,152 @@ void delfem2::setGradVeloVortexParticles
   }
 }
 
+// ---------------------------------------
+// tree code for the vortex particles
+
+DFM2_INLINE void delfem2::CVortexParticleTree::Initialize(
+    const std::vector<CVortexParticle> &aVortexParticle,
+    unsigned int nleaf,
+    unsigned int nthread)
+{
+  const unsigned int np = static_cast<unsigned int>(aVortexParticle.size());
+  std::vector<double> aXYZ(np*3);
+  for(unsigned int ip=0;ip<np;++ip){
+    aXYZ[ip*3+0] = aVortexParticle[ip].pos.x();
+    aXYZ[ip*3+1] = aVortexParticle[ip].pos.y();
+    aXYZ[ip*3+2] = aVortexParticle[ip].pos.z();
+  }
+  bem::MakeClusterTree_Morton(aNode, aPerm, aXYZ, nleaf);
+  thread::parallel_for(
+      static_cast<unsigned int>(aNode.size()),
+      [&](unsigned int inode){ // moments are computed from the particles directly. O(n log n) in total
+        CNode& node = aNode[inode];
+        double c[3];
+        for(int i=0;i<3;++i){ c[i] = (node.bbmin[i]+node.bbmax[i])*0.5; }
+        node.rad_max = 0.0;
+        for(double& v : node.m0){ v = 0.0; }
+        for(double& v : node.m1){ v = 0.0; }
+        for(unsigned int jj=node.ibegin;jj<node.iend;++jj){
+          const CVortexParticle& vp = aVortexParticle[aPerm[jj]];
+          node.rad_max = std::max(node.rad_max, vp.rad);
+          const double d[3] = { vp.pos.x()-c[0], vp.pos.y()-c[1], vp.pos.z()-c[2] };
+          for(int k=0;k<3;++k){
+            node.m0[k] += vp.circ[k];
+            for(int m=0;m<3;++m){ node.m1[k*3+m] += vp.circ[k]*d[m]; }
+          }
+        }
+      },
+      nthread);
+}
+
+DFM2_INLINE void delfem2::CVortexParticleTree::VeloGradVelo(
+    CVec3d& velo,
+    CMat3d& gradvelo,
+    const CVec3d& p0,
+    const std::vector<CVortexParticle> &aVortexParticle,
+    int ivp_self) const
+{
+  velo = CVec3d(0,0,0);
+  gradvelo.SetZero();
+  if( aNode.empty() ){ return; }
+  const double coeff = 1.0/(4*M_PI);
+  std::vector<unsigned int> aStack(1,0);
+  while( !aStack.empty() ){
+    const CNode& node = aNode[aStack.back()];
+    aStack.pop_back();
+    double R[3];
+    for(int i=0;i<3;++i){ R[i] = p0[i]-(node.bbmin[i]+node.bbmax[i])*0.5; }
+    const double lenR = sqrt(R[0]*R[0]+R[1]*R[1]+R[2]*R[2]);
+    const double diam = bem::Diameter_Cluster(node);
+    // exp(-27) of the regularization is negligible if all the particles are farther than 3*radius
+    if( diam < theta*lenR && lenR-0.5*diam > 3*node.rad_max ){
+      const double invR = 1.0/lenR;
+      const double invR3 = invR*invR*invR;
+      const double invR5 = invR3*invR*invR;
+      const double invR7 = invR5*invR*invR;
+      double H[3], D[3][3], T[3][3][3]; // derivatives of the kernel r/(4*pi*|r|^3)
+      for(int l=0;l<3;++l){
+        H[l] = coeff*R[l]*invR3;
+        for(int m=0;m<3;++m){
+          D[l][m] = coeff*((l==m ? invR3 : 0.0) - 3*R[l]*R[m]*invR5);
+          for(int n=0;n<3;++n){
+            T[l][m][n] = -3*coeff*(
+                ((l==m ? R[n] : 0.0) + (l==n ? R[m] : 0.0) + (m==n ? R[l] : 0.0))*invR5
+                - 5*R[l]*R[m]*R[n]*invR7);
+          }
+        }
+      }
+      double B[3][3], C[3][3][3]; // velo_i = eps_ikl B_kl, d(velo_i)/d(x_n) = eps_ikl C_kln
+      for(int k=0;k<3;++k){
+        for(int l=0;l<3;++l){
+          B[k][l] = node.m0[k]*H[l];
+          for(int m=0;m<3;++m){ B[k][l] -= node.m1[k*3+m]*D[l][m]; }
+          for(int n=0;n<3;++n){
+            C[k][l][n] = node.m0[k]*D[l][n];
+            for(int m=0;m<3;++m){ C[k][l][n] -= node.m1[k*3+m]*T[l][m][n]; }
+          }
+        }
+      }
+      velo += CVec3d(B[1][2]-B[2][1], B[2][0]-B[0][2], B[0][1]-B[1][0]);
+      for(int n=0;n<3;++n){
+        gradvelo(0,n) += C[1][2][n]-C[2][1][n];
+        gradvelo(1,n) += C[2][0][n]-C[0][2][n];
+        gradvelo(2,n) += C[0][1][n]-C[1][0][n];
+      }
+      continue;
+    }
+    if( node.ichild[0] != UINT_MAX ){
+      aStack.push_back(node.ichild[0]);
+      aStack.push_back(node.ichild[1]);
+      continue;
+    }
+    for(unsigned int jj=node.ibegin;jj<node.iend;++jj){ // leaf
+      const unsigned int ivp = aPerm[jj];
+      if( (int)ivp == ivp_self ){ continue; }
+      const CVortexParticle& vp = aVortexParticle[ivp];
+      CVec3d dv;
+      gradvelo += gradveloVortexParticle(dv, p0, vp.pos, vp.circ, vp.rad);
+      velo += dv;
+    }
+  }
+}
+
+DFM2_INLINE delfem2::CVec3d delfem2::CVortexParticleTree::Velo(
+    const CVec3d& p0,
+    const std::vector<CVortexParticle> &aVortexParticle,
+    int ivp_self) const
+{
+  CVec3d velo;
+  CMat3d gradvelo;
+  this->VeloGradVelo(velo, gradvelo, p0, aVortexParticle, ivp_self);
+  return velo;
+}
+
+DFM2_INLINE void delfem2::setGradVeloVortexParticles_TreeCode(
+    std::vector<CVortexParticle>& aVortexParticle,
+    double theta,
+    unsigned int nthread)
+{
+  CVortexParticleTree tree;
+  tree.theta = theta;
+  tree.Initialize(aVortexParticle, 16, nthread);
+  std::vector<CVec3d> aVelo(aVortexParticle.size());
+  std::vector<CMat3d> aGradVelo(aVortexParticle.size());
+  thread::parallel_for(
+      static_cast<unsigned int>(aVortexParticle.size()),
+      [&](unsigned int ivp){
+        tree.VeloGradVelo(aVelo[ivp], aGradVelo[ivp], aVortexParticle[ivp].pos, aVortexParticle, ivp);
+      },
+      nthread);
+  for (unsigned int ivp = 0; ivp<aVortexParticle.size(); ++ivp){
+    CVortexParticle& vp = aVortexParticle[ivp];
+    vp.velo_pre = vp.velo;
+    vp.gradvelo_pre = vp.gradvelo;
+    vp.velo = aVelo[ivp];
+    vp.gradvelo = aGradVelo[ivp];
+  }
+}
+
 /*
 void CGrid_Vortex::drawBoundingBox() const
 {
@@ -1018,6 +1613,222 @@ int ngauss)
   return c1;
 }
 
+// ---------------------------------------
+
+DFM2_INLINE void delfem2::CBEM_Helmholtz_Order1st::Initialize(
+    const std::vector<double>& aXYZ_,
+    const std::vector<unsigned int>& aTri_,
+    int ngauss,
+    bool is_inverted_norm)
+{
+  assert(ngauss>=0&&ngauss<3);
+  aXYZ = aXYZ_;
+  aTri = aTri_;
+  nint = NIntTriGauss[ngauss];
+  const size_t ntri = aTri.size()/3;
+  aNormal.resize(ntri*3);
+  aQuadPos.resize(ntri*nint*3);
+  aQuadWeight.resize(ntri*nint*3);
+  for(unsigned int itri=0;itri<ntri;++itri){
+    const CVec3d q0 = bem::TriPoint(itri,0,aTri,aXYZ);
+    const CVec3d q1 = bem::TriPoint(itri,1,aTri,aXYZ);
+    const CVec3d q2 = bem::TriPoint(itri,2,aTri,aXYZ);
+    CVec3d n = Normal(q0, q1, q2);
+    const double a = n.Length()*0.5; // area
+    n.SetNormalizedVector(); // unit normal
+    if( is_inverted_norm ){ n *= -1; }
+    n.CopyTo(aNormal.data()+itri*3);
+    for(unsigned int iint=0;iint<nint;++iint){
+      const double r0 = TriGauss[ngauss][iint][0];
+      const double r1 = TriGauss[ngauss][iint][1];
+      const double r2 = 1.0-r0-r1;
+      const double w = TriGauss[ngauss][iint][2];
+      (r0*q0+r1*q1+r2*q2).CopyTo(aQuadPos.data()+(itri*nint+iint)*3);
+      double* pw = aQuadWeight.data()+(itri*nint+iint)*3;
+      pw[0] = w*a*r0;
+      pw[1] = w*a*r1;
+      pw[2] = w*a*r2;
+    }
+  }
+}
+
+DFM2_INLINE void delfem2::CBEM_Helmholtz_Order1st::TransferPntTri(
+    std::complex<double> aC[3],
+    const double p[3],
+    unsigned int itri,
+    double k,
+    double beta) const
+{
+  using COMPLEX = std::complex<double>;
+  const COMPLEX IMG(0.0, 1.0);
+  const double* n = aNormal.data()+itri*3;
+  aC[0] = aC[1] = aC[2] = COMPLEX(0, 0);
+  for(unsigned int iint=0;iint<nint;++iint){
+    const double* q = aQuadPos.data()+(itri*nint+iint)*3;
+    const double v[3] = { p[0]-q[0], p[1]-q[1], p[2]-q[2] };
+    const double d = sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]);
+    const double vn = v[0]*n[0]+v[1]*n[1]+v[2]*n[2];
+    const COMPLEX G = exp(COMPLEX(0, k*d))/(4.0*M_PI*d);
+    const COMPLEX val = G*(-IMG*k*beta+vn/(d*d)*COMPLEX(1.0, -k*d));
+    const double* pw = aQuadWeight.data()+(itri*nint+iint)*3;
+    aC[0] += pw[0]*val;
+    aC[1] += pw[1]*val;
+    aC[2] += pw[2]*val;
+  }
+}
+
+DFM2_INLINE void delfem2::CBEM_Helmholtz_Order1st::MakeMatrix(
+    std::vector<std::complex<double>>& A,
+    double k,
+    double beta,
+    const std::vector<double>& aSolidAngle,
+    unsigned int nthread) const
+{
+  using COMPLEX = std::complex<double>;
+  const unsigned int nno = static_cast<unsigned int>(aXYZ.size()/3);
+  const unsigned int ntri = static_cast<unsigned int>(aTri.size()/3);
+  assert(aSolidAngle.size() == nno);
+  A.assign(static_cast<size_t>(nno)*nno, COMPLEX(0,0));
+  thread::parallel_for(
+      nno,
+      [&](unsigned int ino){
+        COMPLEX* row = A.data()+static_cast<size_t>(ino)*nno;
+        const double* p = aXYZ.data()+ino*3;
+        for(unsigned int jtri=0;jtri<ntri;++jtri){
+          const unsigned int* jn = aTri.data()+jtri*3;
+          if( jn[0] == ino || jn[1] == ino || jn[2] == ino ){ continue; } // singular
+          COMPLEX aC[3];
+          this->TransferPntTri(aC, p, jtri, k, beta);
+          row[jn[0]] += aC[0];
+          row[jn[1]] += aC[1];
+          row[jn[2]] += aC[2];
+        }
+        row[ino] += aSolidAngle[ino]/(4*M_PI);
+      },
+      nthread);
+}
+
+DFM2_INLINE void delfem2::CBEM_Helmholtz_Order1st::MakeRhs_PointSource(
+    std::vector<std::complex<double>>& f,
+    const CVec3d& pos_source,
+    double k) const
+{
+  using COMPLEX = std::complex<double>;
+  const unsigned int nno = static_cast<unsigned int>(aXYZ.size()/3);
+  f.resize(nno);
+  for(unsigned int ino=0;ino<nno;++ino){
+    const double rs = (CVec3d(aXYZ.data()+ino*3)-pos_source).Length();
+    f[ino] = exp(COMPLEX(0, rs*k))/(4*M_PI*rs);
+  }
+}
+
+DFM2_INLINE void delfem2::CBEM_Helmholtz_Order1st::EvaluateField(
+    std::vector<std::complex<double>>& aVal,
+    const std::vector<double>& aXYZ_recv,
+    const std::vector<std::complex<double>>& aSol,
+    const CVec3d& pos_source,
+    double k,
+    double beta,
+    unsigned int nthread) const
+{
+  using COMPLEX = std::complex<double>;
+  const unsigned int nrecv = static_cast<unsigned int>(aXYZ_recv.size()/3);
+  const unsigned int ntri = static_cast<unsigned int>(aTri.size()/3);
+  aVal.resize(nrecv);
+  thread::parallel_for(
+      nrecv,
+      [&](unsigned int irecv){
+        const double* p = aXYZ_recv.data()+irecv*3;
+        const double rs = (CVec3d(p)-pos_source).Length();
+        COMPLEX c1 = exp(COMPLEX(0, rs*k))/(4*M_PI*rs);
+        for(unsigned int jtri=0;jtri<ntri;++jtri){
+          const unsigned int* jn = aTri.data()+jtri*3;
+          COMPLEX aC[3];
+          this->TransferPntTri(aC, p, jtri, k, beta);
+          c1 -= aC[0]*aSol[jn[0]]+aC[1]*aSol[jn[1]]+aC[2]*aSol[jn[2]];
+        }
+        aVal[irecv] = c1;
+      },
+      nthread);
+}
+
+// ---------------------------------------
+
+template <typename T>
+bool delfem2::LUDecomp_Dense(
+    std::vector<T>& A,
+    std::vector<unsigned int>& aPiv,
+    unsigned int n,
+    unsigned int nthread)
+{
+  assert(A.size() == static_cast<size_t>(n)*n);
+  const unsigned int nb = 64; // size of the panel
+  aPiv.resize(n);
+  for(unsigned int kb=0;kb<n;kb+=nb){
+    const unsigned int kbe = std::min(kb+nb, n);
+    for(unsigned int k=kb;k<kbe;++k){ // factorize the panel (columns of [kb,kbe))
+      unsigned int ip = k;
+      for(unsigned int i=k+1;i<n;++i){
+        if( std::abs(A[i*n+k]) > std::abs(A[ip*n+k]) ){ ip = i; }
+      }
+      if( std::abs(A[ip*n+k]) == 0.0 ){ return false; }
+      aPiv[k] = ip;
+      if( ip != k ){
+        std::swap_ranges(A.begin()+k*n, A.begin()+k*n+n, A.begin()+ip*n);
+      }
+      const T inv = T(1)/A[k*n+k];
+      for(unsigned int i=k+1;i<n;++i){
+        T& l = A[i*n+k];
+        l *= inv;
+        for(unsigned int j=k+1;j<kbe;++j){ A[i*n+j] -= l*A[k*n+j]; }
+      }
+    }
+    for(unsigned int k=kb;k<kbe;++k){ // upper part of the panel rows
+      for(unsigned int i=k+1;i<kbe;++i){
+        const T l = A[i*n+k];
+        for(unsigned int j=kbe;j<n;++j){ A[i*n+j] -= l*A[k*n+j]; }
+      }
+    }
+    thread::parallel_for( // update the trailing matrix
+        n-kbe,
+        [&](unsigned int ii){
+          const unsigned int i = kbe+ii;
+          for(unsigned int k=kb;k<kbe;++k){
+            const T l = A[i*n+k];
+            for(unsigned int j=kbe;j<n;++j){ A[i*n+j] -= l*A[k*n+j]; }
+          }
+        },
+        nthread);
+  }
+  return true;
+}
+#ifndef DFM2_HEADER_ONLY
+template bool delfem2::LUDecomp_Dense(std::vector<double>&, std::vector<unsigned int>&, unsigned int, unsigned int);
+template bool delfem2::LUDecomp_Dense(std::vector<std::complex<double>>&, std::vector<unsigned int>&, unsigned int, unsigned int);
+#endif
+
+template <typename T>
+void delfem2::LUSolve_Dense(
+    std::vector<T>& b,
+    const std::vector<T>& A,
+    const std::vector<unsigned int>& aPiv,
+    unsigned int n)
+{
+  assert(b.size() == n);
+  for(unsigned int k=0;k<n;++k){ std::swap(b[k], b[aPiv[k]]); }
+  for(unsigned int i=0;i<n;++i){
+    for(unsigned int j=0;j<i;++j){ b[i] -= A[i*n+j]*b[j]; }
+  }
+  for(unsigned int i=n;i-->0;){
+    for(unsigned int j=i+1;j<n;++j){ b[i] -= A[i*n+j]*b[j]; }
+    b[i] /= A[i*n+i];
+  }
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::LUSolve_Dense(std::vector<double>&, const std::vector<double>&, const std::vector<unsigned int>&, unsigned int);
+template void delfem2::LUSolve_Dense(std::vector<std::complex<double>>&, const std::vector<std::complex<double>>&, const std::vector<unsigned int>&, unsigned int);
+#endif
+
 /*
 void MakeMatrix_Helmholtz_Order1st
 (Eigen::PartialPivLU<Eigen::MatrixXcd>& solver,
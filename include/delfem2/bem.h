@@ -6,6 +6,7 @@
 #include "delfem2/mat3.h"
 #include <complex>
 #include <vector>
+#include <functional>
 
 namespace delfem2 {
 
@@ -51,6 +52,79 @@ void makeLinearSystem_PotentialFlow_Order0th(std::vector<double> &A,
                                              const std::vector<double> &aXYZ,
                                              const std::vector<unsigned int> &aTri);
 
+/**
+ * @brief hierarchical matrix (H-matrix) approximation of a dense matrix with the adaptive cross approximation (ACA)
+ * @details The rows and the columns are ordered along the Morton code of their positions and
+ * split recursively to make the cluster tree ("MortonCode_FindSplit" in "srchbvh.h").
+ * The blocks of the well-separated clusters are approximated by the low-rank matrices computed with ACA
+ * from a few rows and columns of the matrix. The other blocks are stored densely.
+ * The memory and the cost of "MatVec" are O(n log n) for the smooth kernels of BEM.
+ * "MatVec" has the interface of the iterative solvers (e.g., "Solve_BiCGStab" in "vecxitrsol.h").
+ */
+class CHMatrixACA {
+public:
+  /**
+   * @param entry (in) function returns the (irow,icol) component of the matrix
+   * @param aXYZ (in) position for each row (and column) (e.g., center of the triangle)
+   * @param eps (in) relative accuracy of the low-rank blocks
+   * @param eta (in) admissibility. Blocks with "min(diameter) < eta*distance" are approximated
+   * @param nleaf (in) maximum number of the rows in a leaf cluster
+   * @param nthread (in) number of threads. hardware concurrency is used if 0
+   */
+  void Initialize(
+      const std::function<double(unsigned int, unsigned int)>& entry,
+      const std::vector<double>& aXYZ,
+      double eps = 1.0e-5,
+      double eta = 1.0,
+      unsigned int nleaf = 32,
+      unsigned int nthread = 0);
+  /**
+   * @brief {y} = alpha*[A]{x} + beta*{y}
+   */
+  void MatVec(
+      double* y,
+      double alpha, const double* x,
+      double beta) const;
+  /**
+   * @brief number of values stored in the blocks (n*n for the dense matrix)
+   */
+  size_t NumStoredValues() const;
+public:
+  class CCluster {
+  public:
+    unsigned int ibegin, iend; // range in "aPerm"
+    unsigned int ichild[2]; // UINT_MAX for leaf
+    double bbmin[3], bbmax[3];
+  };
+  class CBlock {
+  public:
+    unsigned int icluster_row, icluster_col;
+    unsigned int rank; // UINT_MAX for dense block
+    std::vector<double> aU; // dense: nrow*ncol (row-major), low-rank: rank*nrow
+    std::vector<double> aV; // low-rank: rank*ncol. The block is sum_k U[k]*V[k]^T
+  };
+  unsigned int nthread = 0;
+  std::vector<unsigned int> aPerm; // index of the row for the i-th position of cluster order
+  std::vector<CCluster> aCluster; // aCluster[0] is the root
+  std::vector<CBlock> aBlock; // sorted by the row cluster
+  std::vector<unsigned int> aBlockInd; // blocks of the same row cluster: aBlock[aBlockInd[i]] ... aBlock[aBlockInd[i+1]-1]
+};
+
+/**
+ * @brief compressed version of "makeLinearSystem_PotentialFlow_Order0th"
+ * @details the right hand side is also computed with the H-matrix of the single-layer potential.
+ */
+void makeHMatrix_PotentialFlow_Order0th(
+    CHMatrixACA& A,
+    std::vector<double>& f,
+    //
+    const delfem2::CVec3d &velo_inf,
+    int ngauss,
+    const std::vector<double> &aXYZ,
+    const std::vector<unsigned int> &aTri,
+    double eps = 1.0e-5,
+    unsigned int nthread = 0);
+
 /**
  * @brief evaluate BEM solution where the value is constant over a triangle
  */
@@ -153,7 +227,67 @@ CMat3d gradveloVortexParticle
      const CVec3d& circ_vp,
      double rad_vp);
 
-void setGradVeloVortexParticles(std::vector<CVortexParticle> &aVortexParticle);
+/**
+ * @brief set velocity and its gradient of the particles by the direct summation O(n^2)
+ * @param nthread number of threads. hardware concurrency is used if 0
+ */
+void setGradVeloVortexParticles(
+    std::vector<CVortexParticle> &aVortexParticle,
+    unsigned int nthread = 0);
+
+/**
+ * @brief tree code (Barnes-Hut) for the velocity of the vortex particles
+ * @details the particles are sorted along the Morton code and split recursively into a binary tree.
+ * The circulations of a node is approximated by the monopole and the dipole moments around the center of the node.
+ * The moments are used instead of the particles when the node is far enough:
+ * "diameter < theta*distance" and the regularization of the kernel is negligible.
+ * The cost of the evaluation is O(log n) per point.
+ */
+class CVortexParticleTree {
+public:
+  /**
+   * @param nleaf maximum number of the particles in a leaf node
+   */
+  void Initialize(
+      const std::vector<CVortexParticle> &aVortexParticle,
+      unsigned int nleaf = 16,
+      unsigned int nthread = 0);
+  /**
+   * @brief velocity and its gradient (gradvelo(i,j) = d(velo_i)/d(x_j)) at the point
+   * @param ivp_self index of the particle excluded from the sum. -1 if none
+   */
+  void VeloGradVelo(
+      CVec3d& velo,
+      CMat3d& gradvelo,
+      const CVec3d& p0,
+      const std::vector<CVortexParticle> &aVortexParticle,
+      int ivp_self) const;
+  CVec3d Velo(
+      const CVec3d& p0,
+      const std::vector<CVortexParticle> &aVortexParticle,
+      int ivp_self) const;
+public:
+  class CNode {
+  public:
+    unsigned int ibegin, iend; // range in "aPerm"
+    unsigned int ichild[2]; // UINT_MAX for leaf
+    double bbmin[3], bbmax[3];
+    double rad_max; // largest radius of the particles
+    double m0[3]; // sum of circulation
+    double m1[9]; // sum of circulation (x) (position - center)
+  };
+  double theta = 0.5;
+  std::vector<unsigned int> aPerm;
+  std::vector<CNode> aNode; // aNode[0] is the root
+};
+
+/**
+ * @brief "setGradVeloVortexParticles" using the tree code. The evaluation is parallelized over the particles.
+ */
+void setGradVeloVortexParticles_TreeCode(
+    std::vector<CVortexParticle> &aVortexParticle,
+    double theta = 0.5,
+    unsigned int nthread = 0);
 
 class CGrid_Vortex {
 public:
@@ -209,6 +343,91 @@ std::complex<double> evaluateField_Helmholtz_Order1st(
     bool is_inverted_norm,
     int ngauss);
 
+/**
+ * @brief Helmholtz BEM with the linear elements (collocation at the nodes) for the frequency sweep
+ * @details the quadrature points, weights and normals that do not depend on the wave number are precomputed.
+ * The assembly of the dense complex matrix and the evaluation of the field are parallelized over the rows and the receivers.
+ * The singular integrals over the triangles around the collocation point are neglected
+ * as in "evaluateField_Helmholtz_Order1st".
+ */
+class CBEM_Helmholtz_Order1st {
+public:
+  void Initialize(
+      const std::vector<double>& aXYZ,
+      const std::vector<unsigned int>& aTri,
+      int ngauss,
+      bool is_inverted_norm = false);
+  /**
+   * @brief make dense matrix (row-major) for the nodal values
+   * @param aSolidAngle solid angle at the nodes (e.g., "makeSolidAngle" in "mshmisc.h")
+   */
+  void MakeMatrix(
+      std::vector<std::complex<double>>& A,
+      double k,
+      double beta,
+      const std::vector<double>& aSolidAngle,
+      unsigned int nthread = 0) const;
+  /**
+   * @brief incident wave from the point source at the nodes (right hand side of the system)
+   */
+  void MakeRhs_PointSource(
+      std::vector<std::complex<double>>& f,
+      const CVec3d& pos_source,
+      double k) const;
+  /**
+   * @brief evaluate the field at many receivers. Same as "evaluateField_Helmholtz_Order1st" for each receiver
+   * @param aXYZ_recv (in) coordinates of the receivers
+   */
+  void EvaluateField(
+      std::vector<std::complex<double>>& aVal,
+      const std::vector<double>& aXYZ_recv,
+      const std::vector<std::complex<double>>& aSol,
+      const CVec3d& pos_source,
+      double k,
+      double beta,
+      unsigned int nthread = 0) const;
+  /**
+   * @brief coefficients of the nodal values for the field at a point
+   */
+  void TransferPntTri(
+      std::complex<double> aC[3],
+      const double p[3],
+      unsigned int itri,
+      double k,
+      double beta) const;
+public:
+  unsigned int nint = 0; // number of the quadrature points per triangle
+  std::vector<double> aXYZ; // nodes
+  std::vector<unsigned int> aTri;
+  std::vector<double> aNormal; // unit normal of the triangles
+  std::vector<double> aQuadPos; // position of the quadrature points (nint*3 values per triangle)
+  std::vector<double> aQuadWeight; // weight times area times barycentric coordinates (nint*3 values per triangle)
+};
+
+/**
+ * @brief LU factorization of the dense matrix (row-major) with the partial pivoting.
+ * @details blocked right-looking algorithm. The update of the trailing matrix is parallelized.
+ * defined for "double" and "std::complex<double>"
+ * @param aPiv (out) row exchanged with the i-th row at the i-th step
+ * @return false if the matrix is singular
+ */
+template <typename T>
+bool LUDecomp_Dense(
+    std::vector<T>& A,
+    std::vector<unsigned int>& aPiv,
+    unsigned int n,
+    unsigned int nthread = 0);
+
+/**
+ * @brief solve the system with the factorized matrix by "LUDecomp_Dense". "b" is overwritten by the solution.
+ */
+template <typename T>
+void LUSolve_Dense(
+    std::vector<T>& b,
+    const std::vector<T>& A,
+    const std::vector<unsigned int>& aPiv,
+    unsigned int n);
+
 CVec3d evaluateField_PotentialFlow
     (const std::vector<double>& aSol,
      const CVec3d& p,
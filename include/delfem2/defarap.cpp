@@ -14,6 +14,7 @@
 #include "delfem2/vecxitrsol.h"
 #include "delfem2/lsitrsol.h"
 #include "delfem2/jagarray.h"
+#include "delfem2/thread/th.h"
 
 namespace delfem2 {
 namespace deflap {
@@ -460,7 +461,18 @@ void delfem2::CDef_Arap::Init(
   if( is_preconditioner ){
     this->Prec.Initialize_ILU0(Mat);
   }
-  
+
+  // graph Laplacian for the global step of local/global iteration
+  MatLap.Initialize(np, 1, true);
+  MatLap.SetPattern(psup_ind.data(), psup_ind.size(),
+                    psup.data(), psup.size());
+  for(unsigned int ip=0;ip<np;++ip){
+    MatLap.valDia[ip] = psup_ind[ip+1]-psup_ind[ip];
+    for(unsigned int ipsup=psup_ind[ip];ipsup<psup_ind[ip+1];++ipsup){
+      MatLap.valCrs[ipsup] = -1.0;
+    }
+  }
+  aBCFlagPrefactor.clear();
 }
 
 void delfem2::CDef_Arap::Deform(
@@ -543,3 +555,79 @@ void delfem2::CDef_Arap::UpdateQuats_SVD(
         ip, aXYZ0, aXYZ1, psup_ind, psup);
   }
 }
+
+DFM2_INLINE bool delfem2::CDef_Arap::Prefactorize(
+    const std::vector<int>& aBCFlag)
+{
+  const unsigned int np = static_cast<unsigned int>(psup_ind.size()-1);
+  assert( aBCFlag.size() == np*3 );
+  aBCFlagPrefactor = aBCFlag;
+  for(unsigned int idim=0;idim<3;++idim){
+    aIndLDLT[idim] = idim;
+    for(unsigned int jdim=0;jdim<idim;++jdim){
+      bool is_same = true;
+      for(unsigned int ip=0;ip<np;++ip){
+        if( (aBCFlag[ip*3+idim]!=0) != (aBCFlag[ip*3+jdim]!=0) ){ is_same = false; break; }
+      }
+      if( is_same ){ aIndLDLT[idim] = aIndLDLT[jdim]; break; }
+    }
+    if( aIndLDLT[idim] != idim ){ aLDLT[idim].Clear(); continue; }
+    CMatrixSparse<double> A;
+    A = MatLap;
+    std::vector<int> aFlg(np);
+    for(unsigned int ip=0;ip<np;++ip){ aFlg[ip] = aBCFlag[ip*3+idim]; }
+    A.SetFixedBC(aFlg.data());
+    aLDLT[idim].Initialize(A);
+    if( !aLDLT[idim].Factorize(A) ){ return false; }
+  }
+  return true;
+}
+
+DFM2_INLINE void delfem2::CDef_Arap::DeformPrefactored(
+    std::vector<double>& aXYZ1,
+    std::vector<double>& aQuat1,
+    const std::vector<double>& aXYZ0,
+    unsigned int nitr,
+    unsigned int nthread)
+{
+  const unsigned int np = static_cast<unsigned int>(psup_ind.size()-1);
+  assert( aBCFlagPrefactor.size() == np*3 );
+  std::vector<double> aR(np*9);
+  std::vector<double> aRhs(np*3), aX(np*3);
+  for(unsigned int itr=0;itr<nitr;++itr){
+    // local step
+    UpdateRotationsByMatchingCluster_Polar(
+        aQuat1,
+        aXYZ0, aXYZ1, psup_ind, psup, nthread);
+    thread::parallel_for(np, [&](unsigned int ip){
+      Mat3_Quat(aR.data()+ip*9, aQuat1.data()+ip*4);
+    }, nthread);
+    // global step: L p = sum_j 0.5*(Ri+Rj)(Pi-Pj)
+    thread::parallel_for(np, [&](unsigned int ip){
+      double b[3] = {0,0,0};
+      const double* Ri = aR.data()+ip*9;
+      for(unsigned int ipsup=psup_ind[ip];ipsup<psup_ind[ip+1];++ipsup){
+        const unsigned int jp = psup[ipsup];
+        const double* Rj = aR.data()+jp*9;
+        const double d[3] = {aXYZ0[ip*3+0]-aXYZ0[jp*3+0], aXYZ0[ip*3+1]-aXYZ0[jp*3+1], aXYZ0[ip*3+2]-aXYZ0[jp*3+2]};
+        for(int i=0;i<3;++i){
+          for(int j=0;j<3;++j){ b[i] += 0.5*(Ri[i*3+j]+Rj[i*3+j])*d[j]; }
+        }
+      }
+      for(int i=0;i<3;++i){ aRhs[ip*3+i] = b[i]; }
+    }, nthread);
+    thread::parallel_for(3, [&](unsigned int idim){
+      std::vector<double> r(np), x(np), t(np,0.0);
+      for(unsigned int ip=0;ip<np;++ip){
+        x[ip] = (aBCFlagPrefactor[ip*3+idim]!=0) ? aXYZ1[ip*3+idim] : 0.0;
+      }
+      MatLap.MatVec(t.data(), 1.0, x.data(), 0.0); // move the fixed values to right hand side
+      for(unsigned int ip=0;ip<np;++ip){
+        r[ip] = (aBCFlagPrefactor[ip*3+idim]!=0) ? aXYZ1[ip*3+idim] : aRhs[ip*3+idim]-t[ip];
+      }
+      aLDLT[aIndLDLT[idim]].Solve(r.data());
+      for(unsigned int ip=0;ip<np;++ip){ aX[ip*3+idim] = r[ip]; }
+    }, 3);
+    aXYZ1 = aX;
+  }
+}
@@ -11,6 +11,7 @@
 
 #include "delfem2/dfm2_inline.h"
 #include "delfem2/lsilu_mats.h"
+#include "delfem2/lsldlt_mats.h"
 
 // ---------------------------
 
@@ -119,6 +120,28 @@ public:
       std::vector<double>& aXYZ1,
       std::vector<double>& aQuat1,
       const std::vector<double>& aXYZ0) const;
+  /**
+   * @brief factorize the matrix of the global step of the local/global ARAP for the boundary condition
+   * @details the matrix is the graph Laplacian that does not depend on the deformation.
+   * Call this function only when the boundary condition changes.
+   * @param aBCFlag (in) fixed dof if aBCFlag[ip*3+idim] != 0
+   * @return false if the factorization fails
+   */
+  bool Prefactorize(
+      const std::vector<int>& aBCFlag);
+  /**
+   * @brief local/global ARAP iterations (O. Sorkine and M. Alexa 2007) with the prefactored global matrix
+   * @param aXYZ1 (in&out) the values at the fixed dofs are used as the boundary condition
+   * @param aQuat1 (in&out) rotation of each point. The local step is computed in parallel
+   * @param nitr number of local/global iterations
+   * @param nthread number of threads. hardware concurrency is used if 0
+   */
+  void DeformPrefactored(
+      std::vector<double>& aXYZ1,
+      std::vector<double>& aQuat1,
+      const std::vector<double>& aXYZ0,
+      unsigned int nitr,
+      unsigned int nthread = 0);
 public:
   mutable std::vector<double> aConvHist;
   std::vector<unsigned int> psup_ind, psup;
@@ -128,6 +151,11 @@ private:
   CMatrixSparse<double> Mat;
   std::vector<double> aRes1, aUpd1;
   CPreconditionerILU<double> Prec;
+  // for prefactored local/global mode
+  CMatrixSparse<double> MatLap; // graph Laplacian
+  std::vector<int> aBCFlagPrefactor;
+  CSparseLDLT<double> aLDLT[3]; // factor for each dimension
+  unsigned int aIndLDLT[3] = {0, 1, 2}; // dimensions with the same BC share the factor
 };
 
 } // namespace delfem2
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2019 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "delfem2/dijkstra.h"
+#include "delfem2/thread/th.h"
+
+namespace delfem2 {
+namespace dijkstra {
+
+/**
+ * relax the nodes from the sources in the heap
+ * @param aLabel label propagated from the sources. can be nullptr
+ * @param aVisit (out) the nodes popped from the heap (i.e., whose distances are updated) are appended. can be nullptr
+ * @details the distance is updated only if it becomes smaller than the current value in "aDist" (negative is infinite),
+ * so the previous distance field works as the bound.
+ */
+DFM2_INLINE void Propagate(
+    double* aDist,
+    unsigned int* aLabel,
+    CIndexedHeap<double>& heap,
+    const std::vector<unsigned int>& aInd,
+    const std::vector<unsigned int>& aAdj,
+    const std::vector<double>& aWeight,
+    std::vector<unsigned int>* aVisit = nullptr)
+{
+  while(!heap.empty()){
+    const CNode<double> node = heap.Pop();
+    const unsigned int i0 = node.ind;
+    if( aVisit != nullptr ){ aVisit->push_back(i0); }
+    for(unsigned int iadj=aInd[i0];iadj<aInd[i0+1];++iadj){
+      const unsigned int i1 = aAdj[iadj];
+      const double d1 = node.dist + aWeight[iadj];
+      if( aDist[i1] >= 0.0 && aDist[i1] <= d1 ){ continue; }
+      aDist[i1] = d1;
+      if( aLabel != nullptr ){ aLabel[i1] = aLabel[i0]; }
+      heap.Update(i1, d1);
+    }
+  }
+}
+
+}
+}
+
+// ----------------------------------------
+
+DFM2_INLINE double delfem2::dijkstra::Distance3(
+    const double p0[3], const double p1[3])
+{
+  return sqrt( (p1[0]-p0[0])*(p1[0]-p0[0]) + (p1[1]-p0[1])*(p1[1]-p0[1]) + (p1[2]-p0[2])*(p1[2]-p0[2]) );
+}
+
+DFM2_INLINE void delfem2::DijkstraElem_MeshElemTopo(
+    std::vector<unsigned int> &aDist,
+    std::vector<unsigned int>& aOrder,
+    //
+    unsigned int ielm_ker,
+    const std::vector<unsigned int> &aElSuEl,
+    unsigned int nelem)
+{
+  aOrder.assign(nelem,UINT_MAX);
+  aDist.assign(nelem, UINT_MAX);
+  aDist[ielm_ker] = 0;
+  const unsigned int nedge = aElSuEl.size() / nelem;
+  std::priority_queue<dijkstra::CNode<unsigned int>> que;
+  que.push(dijkstra::CNode<unsigned int>(ielm_ker, 0));
+  unsigned int icnt = 0;
+  while (!que.empty()) {
+    const unsigned int ielm0 = que.top().ind;
+    const unsigned int idist0 = que.top().dist;
+    que.pop();
+    if( aOrder[ielm0] != UINT_MAX ){ continue; } // already fixed so this is not the shortest path
+    aOrder[ielm0] = icnt; // found shortest path
+    icnt++;
+    for (unsigned int iedge = 0; iedge < nedge; ++iedge) {
+      const unsigned int ielm1 = aElSuEl[ielm0 * nedge + iedge];
+      if (ielm1 == UINT_MAX) { continue; }
+      const unsigned int idist1 = idist0+1;
+      if (idist1 >= aDist[ielm1]) { continue; }
+      aDist[ielm1] = idist1; // Found the shortest path so far
+      que.push(dijkstra::CNode<unsigned int>(ielm1, idist1)); // candidate of shortest path
+    }
+  }
+  assert(icnt==nelem);
+}
+
+DFM2_INLINE void delfem2::Center_Elem3(
+    double p[3],
+    unsigned int ielm1,
+    const std::vector<unsigned int> &aTri,
+    unsigned int nnoel,
+    const std::vector<double> &aXYZ)
+{
+  p[0] = 0.;
+  p[1] = 0.;
+  p[2] = 0.;
+  for(unsigned int inoel=0;inoel<nnoel;++inoel){
+    const unsigned int ip0 = aTri[ielm1*nnoel+inoel];
+    p[0] += aXYZ[ ip0*3+0 ];
+    p[1] += aXYZ[ ip0*3+1 ];
+    p[2] += aXYZ[ ip0*3+2 ];
+  }
+  p[0] /= nnoel;
+  p[1] /= nnoel;
+  p[2] /= nnoel;
+}
+
+DFM2_INLINE void delfem2::MeshClustering(
+    std::vector<unsigned int> &aFlgElm,
+    //
+    unsigned int ncluster,
+    const std::vector<unsigned int> &aTriSuTri,
+    unsigned int ntri)
+{
+  std::random_device rd;
+  std::mt19937 rdeng(rd());
+  std::uniform_int_distribution<unsigned int> dist0(0, ntri - 1);
+  const unsigned int itri_ker = dist0(rdeng);
+  assert(itri_ker < ntri);
+  // graph with the unit weights for the topological distance
+  const unsigned int nedge = aTriSuTri.size() / ntri;
+  std::vector<unsigned int> aInd(ntri+1, 0), aAdj;
+  for (unsigned int it = 0; it < ntri; ++it) {
+    for (unsigned int iedge = 0; iedge < nedge; ++iedge) {
+      const unsigned int jt = aTriSuTri[it * nedge + iedge];
+      if (jt == UINT_MAX) { continue; }
+      aAdj.push_back(jt);
+    }
+    aInd[it + 1] = aAdj.size();
+  }
+  const std::vector<double> aWeight(aAdj.size(), 1.0);
+  std::vector<double> aDist;
+  std::vector<unsigned int> aSeed;
+  Clustering_Graph(
+      aFlgElm, aDist, aSeed,
+      std::max(ncluster, 1u), itri_ker, aInd, aAdj, aWeight);
+  for(unsigned int& iflg : aFlgElm){ // elements not connected to the seeds
+    if( iflg == UINT_MAX ){ iflg = 0; }
+  }
+}
+
+// ----------------------------------------
+
+DFM2_INLINE void delfem2::ElemGraph_MeshElemGeo3(
+    std::vector<unsigned int>& aInd,
+    std::vector<unsigned int>& aAdj,
+    std::vector<double>& aWeight,
+    //
+    const std::vector<unsigned int>& aElem,
+    unsigned int nnoel,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aElSuEl,
+    unsigned int nthread)
+{
+  const unsigned int nelem = static_cast<unsigned int>(aElem.size()/nnoel);
+  const unsigned int nedge = (nelem==0) ? 0 : static_cast<unsigned int>(aElSuEl.size()/nelem);
+  std::vector<double> aCenter(nelem*3);
+  thread::parallel_for(
+      nelem,
+      [&](unsigned int ie){ Center_Elem3(aCenter.data()+ie*3, ie, aElem, nnoel, aXYZ); },
+      nthread);
+  aInd.assign(nelem+1, 0);
+  for(unsigned int ie=0;ie<nelem;++ie){
+    aInd[ie+1] = aInd[ie];
+    for(unsigned int iedge=0;iedge<nedge;++iedge){
+      if( aElSuEl[ie*nedge+iedge] != UINT_MAX ){ aInd[ie+1]++; }
+    }
+  }
+  aAdj.resize(aInd[nelem]);
+  aWeight.resize(aInd[nelem]);
+  thread::parallel_for(
+      nelem,
+      [&](unsigned int ie0){
+        unsigned int iadj = aInd[ie0];
+        for(unsigned int iedge=0;iedge<nedge;++iedge){
+          const unsigned int ie1 = aElSuEl[ie0*nedge+iedge];
+          if( ie1 == UINT_MAX ){ continue; }
+          aAdj[iadj] = ie1;
+          aWeight[iadj] = dijkstra::Distance3(aCenter.data()+ie0*3, aCenter.data()+ie1*3);
+          iadj++;
+        }
+      },
+      nthread);
+}
+
+DFM2_INLINE void delfem2::Dijkstra_Graph(
+    std::vector<double>& aDist,
+    std::vector<unsigned int>& aLabel,
+    //
+    const std::vector< std::pair<unsigned int, double> >& aSrcDist,
+    const std::vector<unsigned int>& aInd,
+    const std::vector<unsigned int>& aAdj,
+    const std::vector<double>& aWeight)
+{
+  const unsigned int nnode = static_cast<unsigned int>(aInd.size()-1);
+  aDist.assign(nnode, -1.0);
+  aLabel.assign(nnode, UINT_MAX);
+  dijkstra::CIndexedHeap<double> heap;
+  heap.Initialize(nnode);
+  for(unsigned int isrc=0;isrc<aSrcDist.size();++isrc){
+    const unsigned int i0 = aSrcDist[isrc].first;
+    const double d0 = aSrcDist[isrc].second;
+    assert( i0 < nnode );
+    if( aDist[i0] >= 0.0 && aDist[i0] <= d0 ){ continue; }
+    aDist[i0] = d0;
+    aLabel[i0] = isrc;
+    heap.Update(i0, d0);
+  }
+  dijkstra::Propagate(
+      aDist.data(), aLabel.data(), heap,
+      aInd, aAdj, aWeight);
+}
+
+DFM2_INLINE void delfem2::DijkstraSources_Graph(
+    std::vector<double>& aDist,
+    //
+    const std::vector<unsigned int>& aSrc,
+    const std::vector<unsigned int>& aInd,
+    const std::vector<unsigned int>& aAdj,
+    const std::vector<double>& aWeight,
+    unsigned int nthread)
+{
+  const unsigned int nnode = static_cast<unsigned int>(aInd.size()-1);
+  const unsigned int nsrc = static_cast<unsigned int>(aSrc.size());
+  aDist.assign(static_cast<size_t>(nsrc)*nnode, -1.0);
+  thread::parallel_for_range(
+      nsrc,
+      [&](unsigned int, unsigned int isrc0, unsigned int isrc1){
+        dijkstra::CIndexedHeap<double> heap; // heap for each thread
+        heap.Initialize(nnode);
+        for(unsigned int isrc=isrc0;isrc<isrc1;++isrc){
+          double* dist = aDist.data()+static_cast<size_t>(isrc)*nnode;
+          dist[aSrc[isrc]] = 0.0;
+          heap.Update(aSrc[isrc], 0.0);
+          dijkstra::Propagate(
+              dist, nullptr, heap,
+              aInd, aAdj, aWeight);
+        }
+      },
+      std::min(nsrc, thread::num_threads(nthread)));
+}
+
+DFM2_INLINE void delfem2::Clustering_Graph(
+    std::vector<unsigned int>& aLabel,
+    std::vector<double>& aDist,
+    std::vector<unsigned int>& aSeed,
+    //
+    unsigned int ncluster,
+    unsigned int iseed0,
+    const std::vector<unsigned int>& aInd,
+    const std::vector<unsigned int>& aAdj,
+    const std::vector<double>& aWeight)
+{
+  const unsigned int nnode = static_cast<unsigned int>(aInd.size()-1);
+  aLabel.assign(nnode, UINT_MAX);
+  aDist.assign(nnode, -1.0);
+  aSeed.clear();
+  if( ncluster == 0 || nnode == 0 ){ return; }
+  dijkstra::CIndexedHeap<double> heap;
+  heap.Initialize(nnode);
+  // max heap of the distances. the smaller index comes first for the same distance
+  auto cmp = [](const std::pair<double,unsigned int>& a, const std::pair<double,unsigned int>& b){
+    return a.first < b.first || (a.first == b.first && a.second > b.second);
+  };
+  std::priority_queue<
+      std::pair<double,unsigned int>,
+      std::vector<std::pair<double,unsigned int> >,
+      decltype(cmp)> heap_far(cmp);
+  std::vector<unsigned int> aVisit;
+  unsigned int inode_unreached = 0; // the nodes before this index are reached
+  unsigned int iseed = iseed0;
+  for(unsigned int icluster=0;icluster<ncluster;++icluster){
+    aSeed.push_back(iseed);
+    aDist[iseed] = 0.0;
+    aLabel[iseed] = icluster;
+    heap.Update(iseed, 0.0);
+    aVisit.clear();
+    dijkstra::Propagate( // only the nodes closer to the new seed are visited
+        aDist.data(), aLabel.data(), heap,
+        aInd, aAdj, aWeight, &aVisit);
+    for(unsigned int inode : aVisit){ heap_far.emplace(aDist[inode], inode); }
+    // find the farthest node. the nodes not reached are the farthest
+    while( inode_unreached < nnode && aDist[inode_unreached] >= 0.0 ){ ++inode_unreached; }
+    if( inode_unreached < nnode ){ iseed = inode_unreached; continue; }
+    while( !heap_far.empty() && heap_far.top().first != aDist[heap_far.top().second] ){ heap_far.pop(); } // outdated
+    if( heap_far.empty() || heap_far.top().first <= 0.0 ){ break; } // all the nodes are seeds
+    iseed = heap_far.top().second;
+  }
+}
@@ -7,6 +7,8 @@
 
 /**
  * @file geodesic & clustering on mesh using dijkstra method
+ * @details For the large meshes, build the weighted graph of the elements once with "ElemGraph_MeshElemGeo3"
+ * and use the functions with the suffix "_Graph". The graph is in the CSR format and the weights are cached.
  */
 
 #ifndef DFM2_DIJKSTRA_H
@@ -14,18 +16,17 @@
 
 #include "delfem2/dfm2_inline.h"
 #include <queue>
+#include <vector>
 #include <climits>
+#include <cassert>
 #include <random>
 
 namespace delfem2 {
 
 namespace dijkstra {
 
-double Distance3(
-    const double p0[3], const double p1[3])
-{
-  return sqrt( (p1[0]-p0[0])*(p1[0]-p0[0]) + (p1[1]-p0[1])*(p1[1]-p0[1]) + (p1[2]-p0[2])*(p1[2]-p0[2]) );
-}
+DFM2_INLINE double Distance3(
+    const double p0[3], const double p1[3]);
 
 template <typename DISTANCE>
 class CNode
@@ -41,63 +42,96 @@ public:
   DISTANCE dist;
 };
 
-}
+/**
+ * @brief binary heap of the nodes where the distance of the node in the heap can be decreased.
+ * @details the node with the smaller index is popped first if the distances are the same.
+ */
+template <typename DISTANCE>
+class CIndexedHeap
+{
+public:
+  void Initialize(unsigned int nnode){
+    aNode.clear();
+    aPos.assign(nnode, UINT_MAX);
+  }
+  bool empty() const { return aNode.empty(); }
+  /**
+   * @brief insert the node or decrease its distance. Nothing happens if the distance is not smaller.
+   */
+  void Update(unsigned int ind, DISTANCE dist){
+    unsigned int ipos = aPos[ind];
+    if( ipos == UINT_MAX ){
+      ipos = static_cast<unsigned int>(aNode.size());
+      aNode.push_back(CNode<DISTANCE>(ind,dist));
+      aPos[ind] = ipos;
+    }
+    else{
+      if( !(dist < aNode[ipos].dist) ){ return; }
+      aNode[ipos].dist = dist;
+    }
+    SiftUp(ipos);
+  }
+  CNode<DISTANCE> Pop(){
+    assert( !aNode.empty() );
+    const CNode<DISTANCE> top = aNode[0];
+    aPos[top.ind] = UINT_MAX;
+    aNode[0] = aNode.back();
+    aNode.pop_back();
+    if( !aNode.empty() ){
+      aPos[aNode[0].ind] = 0;
+      SiftDown(0);
+    }
+    return top;
+  }
+private:
+  bool IsBefore(const CNode<DISTANCE>& a, const CNode<DISTANCE>& b) const {
+    return a.dist < b.dist || ( !(b.dist < a.dist) && a.ind < b.ind );
+  }
+  void Swap(unsigned int i, unsigned int j){
+    std::swap(aNode[i], aNode[j]);
+    aPos[aNode[i].ind] = i;
+    aPos[aNode[j].ind] = j;
+  }
+  void SiftUp(unsigned int i){
+    while( i > 0 ){
+      const unsigned int ip = (i-1)/2;
+      if( !IsBefore(aNode[i],aNode[ip]) ){ break; }
+      Swap(i,ip);
+      i = ip;
+    }
+  }
+  void SiftDown(unsigned int i){
+    const unsigned int n = static_cast<unsigned int>(aNode.size());
+    for(;;){
+      unsigned int imin = i;
+      if( 2*i+1 < n && IsBefore(aNode[2*i+1],aNode[imin]) ){ imin = 2*i+1; }
+      if( 2*i+2 < n && IsBefore(aNode[2*i+2],aNode[imin]) ){ imin = 2*i+2; }
+      if( imin == i ){ break; }
+      Swap(i,imin);
+      i = imin;
+    }
+  }
+public:
+  std::vector< CNode<DISTANCE> > aNode;
+  std::vector<unsigned int> aPos; // position of the node in the heap. UINT_MAX if not in the heap
+};
 
+}
 
-void DijkstraElem_MeshElemTopo(
+DFM2_INLINE void DijkstraElem_MeshElemTopo(
     std::vector<unsigned int> &aDist,
     std::vector<unsigned int>& aOrder,
     //
     unsigned int ielm_ker,
     const std::vector<unsigned int> &aElSuEl,
-    unsigned int nelem)
-{
-  aOrder.assign(nelem,UINT_MAX);
-  aDist.assign(nelem, UINT_MAX);
-  aDist[ielm_ker] = 0;
-  const unsigned int nedge = aElSuEl.size() / nelem;
-  std::priority_queue<dijkstra::CNode<unsigned int>> que;
-  que.push(dijkstra::CNode<unsigned int>(ielm_ker, 0));
-  unsigned int icnt = 0;
-  while (!que.empty()) {
-    const unsigned int ielm0 = que.top().ind;
-    const unsigned int idist0 = que.top().dist;
-    que.pop();
-    if( aOrder[ielm0] != UINT_MAX ){ continue; } // already fixed so this is not the shortest path
-    aOrder[ielm0] = icnt; // found shortest path
-    icnt++;
-    for (unsigned int iedge = 0; iedge < nedge; ++iedge) {
-      const unsigned int ielm1 = aElSuEl[ielm0 * nedge + iedge];
-      if (ielm1 == UINT_MAX) { continue; }
-      const unsigned int idist1 = idist0+1;
-      if (idist1 >= aDist[ielm1]) { continue; }
-      aDist[ielm1] = idist1; // Found the shortest path so far
-      que.push(dijkstra::CNode<unsigned int>(ielm1, idist1)); // candidate of shortest path
-    }
-  }
-  assert(icnt==nelem);
-}
+    unsigned int nelem);
 
-void Center_Elem3(
+DFM2_INLINE void Center_Elem3(
     double p[3],
     unsigned int ielm1,
     const std::vector<unsigned int> &aTri,
     unsigned int nnoel,
-    const std::vector<double> &aXYZ)
-{
-  p[0] = 0.;
-  p[1] = 0.;
-  p[2] = 0.;
-  for(unsigned int inoel=0;inoel<nnoel;++inoel){
-    const unsigned int ip0 = aTri[ielm1*nnoel+inoel];
-    p[0] += aXYZ[ ip0*3+0 ];
-    p[1] += aXYZ[ ip0*3+1 ];
-    p[2] += aXYZ[ ip0*3+2 ];
-  }
-  p[0] /= nnoel;
-  p[1] /= nnoel;
-  p[2] /= nnoel;
-}
+    const std::vector<double> &aXYZ);
 
 template <typename PROC>
 void DijkstraElem_MeshElemGeo3(
@@ -122,9 +156,9 @@ void DijkstraElem_MeshElemGeo3(
   while (!que.empty()) {
     const unsigned int ielm0 = que.top().ind;
     const double idist0 = que.top().dist;
-    double p0[3]; Center_Elem3(p0, ielm0,aTri,nnoel,aXYZ);
     que.pop();
     if( aOrder[ielm0] != UINT_MAX ){ continue; } // already fixed so this is not the shortest path
+    double p0[3]; Center_Elem3(p0, ielm0,aTri,nnoel,aXYZ);
     aOrder[ielm0] = icnt; // found shortest path
     proc.AddElem(ielm0,aOrder);
     icnt++;
@@ -144,46 +178,16 @@ void DijkstraElem_MeshElemGeo3(
 //  assert(icnt==nelem);
 }
 
-void MeshClustering(
+/**
+ * @brief clustering of the elements with the farthest point sampling on the topological distance
+ * @param aFlgElm (out) index of the cluster for each element. The elements not connected to the seeds are in the cluster 0
+ */
+DFM2_INLINE void MeshClustering(
     std::vector<unsigned int> &aFlgElm,
     //
     unsigned int ncluster,
     const std::vector<unsigned int> &aTriSuTri,
-    unsigned int ntri)
-{
-  std::vector<unsigned int> aDist0(ntri, UINT_MAX);
-  std::random_device rd;
-  std::mt19937 rdeng(rd());
-  std::uniform_int_distribution<unsigned int> dist0(0, ntri - 1);
-  const unsigned int itri_ker = dist0(rdeng);
-  assert(itri_ker < ntri);
-  aFlgElm.assign(ntri, 0);
-  std::vector<unsigned int> aOrder;
-  DijkstraElem_MeshElemTopo(
-      aDist0,aOrder,
-      itri_ker, aTriSuTri,ntri);
-  for (unsigned int icluster = 1; icluster < ncluster; ++icluster) {
-    unsigned int itri_maxdist;
-    { // find triangle with maximum distance
-      double idist_max = 0;
-      for (unsigned int it = 0; it < ntri; ++it) {
-        if (aDist0[it] <= idist_max) { continue; }
-        idist_max = aDist0[it];
-        itri_maxdist = it;
-      }
-    }
-    std::vector<unsigned int> aDist1(ntri, UINT_MAX);
-    DijkstraElem_MeshElemTopo(
-        aDist1,aOrder,
-        itri_maxdist, aTriSuTri,ntri);
-    for (unsigned int it = 0; it < ntri; ++it) {
-      if (aDist1[it] < aDist0[it]) {
-        aDist0[it] = aDist1[it];
-        aFlgElm[it] = icluster;
-      }
-    }
-  }
-}
+    unsigned int ntri);
 
 template<typename PROC>
 void Dijkstra_FillFromBoundary(
@@ -277,7 +281,78 @@ void DijkstraPoint_MeshTri3D(
   assert(icnt==np);
 }
 
+// ----------------------------------------
+// shortest path on the weighted graph in the CSR format
+
+/**
+ * @brief weighted graph of the elements adjacent through the edges/faces.
+ * @details the weight is the distance between the centers of the elements.
+ * The neighbors of the element "ie" are "aAdj[aInd[ie]] ... aAdj[aInd[ie+1]-1]"
+ * @param aElSuEl (in) adjacent elements (UINT_MAX for the boundary). See "ElSuEl_MeshElem"
+ */
+DFM2_INLINE void ElemGraph_MeshElemGeo3(
+    std::vector<unsigned int>& aInd,
+    std::vector<unsigned int>& aAdj,
+    std::vector<double>& aWeight,
+    //
+    const std::vector<unsigned int>& aElem,
+    unsigned int nnoel,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aElSuEl,
+    unsigned int nthread = 0);
+
+/**
+ * @brief shortest distance from the multiple sources
+ * @param aDist (out) distance. -1 for the nodes not reached
+ * @param aLabel (out) index of the nearest source in "aSrcDist". UINT_MAX for the nodes not reached
+ * @param aSrcDist (in) source nodes and their initial distances
+ */
+DFM2_INLINE void Dijkstra_Graph(
+    std::vector<double>& aDist,
+    std::vector<unsigned int>& aLabel,
+    //
+    const std::vector< std::pair<unsigned int, double> >& aSrcDist,
+    const std::vector<unsigned int>& aInd,
+    const std::vector<unsigned int>& aAdj,
+    const std::vector<double>& aWeight);
+
+/**
+ * @brief shortest distance from each of the sources independently. The sources are processed in parallel
+ * @param aDist (out) the distance from "aSrc[isrc]" to the node "inode" is "aDist[isrc*nnode+inode]"
+ */
+DFM2_INLINE void DijkstraSources_Graph(
+    std::vector<double>& aDist,
+    //
+    const std::vector<unsigned int>& aSrc,
+    const std::vector<unsigned int>& aInd,
+    const std::vector<unsigned int>& aAdj,
+    const std::vector<double>& aWeight,
+    unsigned int nthread = 0);
+
+/**
+ * @brief clustering with the farthest point sampling
+ * @details the distance field is updated only in the region closer to the new seed, and the farthest node is
+ * taken from a heap of the updated distances, so adding a seed costs about the size of its cluster times log(n).
+ * @param aLabel (out) index of the cluster
+ * @param aDist (out) distance to the seed of the cluster
+ * @param aSeed (out) seeds of the clusters. The size can be smaller than "ncluster" if the nodes are not enough
+ * @param iseed0 (in) the first seed
+ */
+DFM2_INLINE void Clustering_Graph(
+    std::vector<unsigned int>& aLabel,
+    std::vector<double>& aDist,
+    std::vector<unsigned int>& aSeed,
+    //
+    unsigned int ncluster,
+    unsigned int iseed0,
+    const std::vector<unsigned int>& aInd,
+    const std::vector<unsigned int>& aAdj,
+    const std::vector<double>& aWeight);
 
 }
 
+#ifdef DFM2_HEADER_ONLY
+#  include "delfem2/dijkstra.cpp"
+#endif
+
 #endif
@@ -0,0 +1,439 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+#include <climits>
+#include <algorithm>
+#include "delfem2/dtri3_qem.h"
+#include "delfem2/thread/th.h"
+
+namespace delfem2 {
+namespace qem {
+
+/**
+ * points around the point in the counter-clockwise order
+ * @return false if the point is on the boundary or isolated
+ */
+DFM2_INLINE bool RingPoint(
+    std::vector<unsigned int>& aIP,
+    unsigned int ip0,
+    const std::vector<CDynPntSur>& aDP,
+    const std::vector<CDynTri>& aDTri)
+{
+  aIP.clear();
+  if( aDP[ip0].e == UINT_MAX ){ return false; }
+  unsigned int itri = aDP[ip0].e;
+  unsigned int ino = aDP[ip0].d;
+  for(;;){
+    assert( aDTri[itri].v[ino] == ip0 );
+    aIP.push_back( aDTri[itri].v[(ino+2)%3] );
+    if( !MoveCCW(itri, ino, UINT_MAX, aDTri) ){ return false; }
+    if( itri == aDP[ip0].e ){ return true; }
+  }
+}
+
+/**
+ * @return number of the neighbors. 0 if the point is on the boundary or isolated
+ */
+DFM2_INLINE unsigned int Valence(
+    unsigned int ip0,
+    const std::vector<CDynPntSur>& aDP,
+    const std::vector<CDynTri>& aDTri)
+{
+  if( aDP[ip0].e == UINT_MAX ){ return 0; }
+  unsigned int itri = aDP[ip0].e;
+  unsigned int ino = aDP[ip0].d;
+  for(unsigned int nval=1;;++nval){
+    if( !MoveCCW(itri, ino, UINT_MAX, aDTri) ){ return 0; }
+    if( itri == aDP[ip0].e ){ return nval; }
+  }
+}
+
+/**
+ * link condition where the ring of the first point "aIP0" is already computed
+ * @param aIP1 buffer for the ring of the point ip1
+ */
+DFM2_INLINE bool IsCollapsible_Ring(
+    const std::vector<unsigned int>& aIP0,
+    unsigned int ip1,
+    std::vector<unsigned int>& aIP1,
+    const std::vector<CDynPntSur>& aDP,
+    const std::vector<CDynTri>& aDTri)
+{
+  if( !RingPoint(aIP1, ip1, aDP, aDTri) ){ return false; }
+  unsigned int ncommon = 0;
+  for(unsigned int jp : aIP0){
+    if( std::find(aIP1.begin(), aIP1.end(), jp) == aIP1.end() ){ continue; }
+    ncommon++;
+    if( Valence(jp, aDP, aDTri) <= 3 ){ return false; } // the point will have only two neighbors (or on the boundary)
+  }
+  return ncommon == 2;
+}
+
+/**
+ * the triangles around ip0 and ip1 except for the ones sharing the edge do not flip when
+ * ip0 and ip1 are moved to "pos"
+ */
+DFM2_INLINE bool IsNotFlip(
+    unsigned int ip0,
+    unsigned int ip1,
+    const CVec3d& pos,
+    const std::vector<CDynPntSur>& aDP,
+    const std::vector<CDynTri>& aDTri,
+    const std::vector<CVec3d>& aVec3)
+{
+  for(unsigned int ip : {ip0, ip1}){
+    const unsigned int jp = ip0+ip1-ip; // the other point of the edge
+    unsigned int itri = aDP[ip].e;
+    unsigned int ino = aDP[ip].d;
+    for(;;){
+      const CDynTri& tri = aDTri[itri];
+      if( tri.v[0] != jp && tri.v[1] != jp && tri.v[2] != jp ){ // the triangles sharing the edge are deleted
+        CVec3d q[3] = { aVec3[tri.v[0]], aVec3[tri.v[1]], aVec3[tri.v[2]] };
+        const CVec3d n0 = (q[1]-q[0])^(q[2]-q[0]);
+        q[ino] = pos;
+        const CVec3d n1 = (q[1]-q[0])^(q[2]-q[0]);
+        if( n0*n1 <= 0.0 ){ return false; }
+      }
+      if( !MoveCCW(itri, ino, UINT_MAX, aDTri) ){ break; }
+      if( itri == aDP[ip].e ){ break; }
+    }
+  }
+  return true;
+}
+
+class CCollapse {
+public:
+  unsigned int ip1; // the other point of the edge. UINT_MAX if there is no edge to collapse
+  CVec3d pos;
+  double err;
+};
+
+/**
+ * find the edge around ip0 with the smallest error that can be collapsed
+ */
+DFM2_INLINE void Evaluate(
+    CCollapse& cl,
+    unsigned int ip0,
+    const std::vector<double>& aQ,
+    const std::vector<CDynPntSur>& aDP,
+    const std::vector<CDynTri>& aDTri,
+    const std::vector<CVec3d>& aVec3)
+{
+  cl.ip1 = UINT_MAX;
+  std::vector<unsigned int> aIP;
+  if( !RingPoint(aIP, ip0, aDP, aDTri) ){ return; }
+  std::vector<CCollapse> aCand;
+  for(unsigned int ip1 : aIP){
+    double Q[10];
+    for(int i=0;i<10;++i){ Q[i] = aQ[ip0*10+i] + aQ[ip1*10+i]; }
+    CCollapse c;
+    c.ip1 = ip1;
+    c.err = Minimize_Quadric(c.pos.p, Q, aVec3[ip0].p, aVec3[ip1].p);
+    aCand.push_back(c);
+  }
+  std::sort(aCand.begin(), aCand.end(),
+            [](const CCollapse& a, const CCollapse& b){ return a.err < b.err || (a.err == b.err && a.ip1 < b.ip1); });
+  std::vector<unsigned int> aIP1;
+  for(const CCollapse& c : aCand){ // check the topology and the geometry only for the best candidates
+    if( !IsCollapsible_Ring(aIP, c.ip1, aIP1, aDP, aDTri) ){ continue; }
+    if( !IsNotFlip(ip0, c.ip1, c.pos, aDP, aDTri, aVec3) ){ continue; }
+    cl = c;
+    return;
+  }
+}
+
+/**
+ * collapse ip1 into ip0 and move ip0 to "pos"
+ */
+DFM2_INLINE bool Collapse(
+    unsigned int ip0,
+    unsigned int ip1,
+    const CVec3d& pos,
+    std::vector<CDynPntSur>& aDP,
+    std::vector<CDynTri>& aDTri,
+    std::vector<CVec3d>& aVec3,
+    std::vector<double>& aQ,
+    std::vector<double>& aAttr,
+    unsigned int nattr)
+{
+  unsigned int itri0, ino0, ino1;
+  if( !FindEdge_LookAroundPoint(itri0, ino0, ino1, ip0, ip1, aDP, aDTri) ){ return false; }
+  const unsigned int ied0 = 3-ino0-ino1; // aDTri[itri0].v[(ied0+1)%3] == ip0 stays
+  assert( aDTri[itri0].v[(ied0+1)%3] == ip0 && aDTri[itri0].v[(ied0+2)%3] == ip1 );
+  if( !CollapseEdge_MeshDTri(itri0, ied0, aDP, aDTri) ){ return false; }
+  assert( aDP[ip1].e == UINT_MAX );
+  { // attributes at the projection of the position on the edge
+    const CVec3d d = aVec3[ip1]-aVec3[ip0];
+    const double len2 = d*d;
+    double t = (len2 > 0) ? ((pos-aVec3[ip0])*d)/len2 : 0.5;
+    t = std::max(0.0, std::min(1.0, t));
+    for(unsigned int iattr=0;iattr<nattr;++iattr){
+      aAttr[ip0*nattr+iattr] = (1-t)*aAttr[ip0*nattr+iattr] + t*aAttr[ip1*nattr+iattr];
+    }
+  }
+  aVec3[ip0] = pos;
+  for(int i=0;i<10;++i){ aQ[ip0*10+i] += aQ[ip1*10+i]; }
+  return true;
+}
+
+/**
+ * binary min-heap of the points keyed by their errors. The key of a point in the heap can be changed
+ */
+class CHeap {
+public:
+  void Initialize(unsigned int np){
+    aHeap.clear();
+    aPos.assign(np, UINT_MAX);
+    aKey.assign(np, 0.0);
+  }
+  bool empty() const { return aHeap.empty(); }
+  unsigned int Top() const { return aHeap[0]; }
+  void Update(unsigned int ip, double key){
+    aKey[ip] = key;
+    if( aPos[ip] == UINT_MAX ){
+      aPos[ip] = static_cast<unsigned int>(aHeap.size());
+      aHeap.push_back(ip);
+    }
+    SiftUp(aPos[ip]);
+    SiftDown(aPos[ip]);
+  }
+  void Remove(unsigned int ip){
+    const unsigned int i = aPos[ip];
+    if( i == UINT_MAX ){ return; }
+    aPos[ip] = UINT_MAX;
+    const unsigned int ilast = aHeap.back();
+    aHeap.pop_back();
+    if( i == aHeap.size() ){ return; }
+    aHeap[i] = ilast;
+    aPos[ilast] = i;
+    SiftUp(i);
+    SiftDown(aPos[ilast]);
+  }
+private:
+  bool IsBefore(unsigned int i, unsigned int j) const {
+    const unsigned int ip = aHeap[i], jp = aHeap[j];
+    return aKey[ip] < aKey[jp] || (aKey[ip] == aKey[jp] && ip < jp);
+  }
+  void Swap(unsigned int i, unsigned int j){
+    std::swap(aHeap[i], aHeap[j]);
+    aPos[aHeap[i]] = i;
+    aPos[aHeap[j]] = j;
+  }
+  void SiftUp(unsigned int i){
+    while( i > 0 && IsBefore(i,(i-1)/2) ){
+      Swap(i,(i-1)/2);
+      i = (i-1)/2;
+    }
+  }
+  void SiftDown(unsigned int i){
+    const unsigned int n = static_cast<unsigned int>(aHeap.size());
+    for(;;){
+      unsigned int imin = i;
+      if( 2*i+1 < n && IsBefore(2*i+1,imin) ){ imin = 2*i+1; }
+      if( 2*i+2 < n && IsBefore(2*i+2,imin) ){ imin = 2*i+2; }
+      if( imin == i ){ return; }
+      Swap(i,imin);
+      i = imin;
+    }
+  }
+public:
+  std::vector<unsigned int> aHeap;
+  std::vector<unsigned int> aPos; // position in the heap. UINT_MAX if not in the heap
+  std::vector<double> aKey;
+};
+
+}
+}
+
+// ----------------------------------------
+
+DFM2_INLINE double delfem2::qem::Error_Quadric(
+    const double Q[10],
+    const double p[3])
+{
+  return Q[0]*p[0]*p[0] + Q[4]*p[1]*p[1] + Q[7]*p[2]*p[2]
+      + 2*(Q[1]*p[0]*p[1] + Q[2]*p[0]*p[2] + Q[5]*p[1]*p[2])
+      + 2*(Q[3]*p[0] + Q[6]*p[1] + Q[8]*p[2])
+      + Q[9];
+}
+
+DFM2_INLINE double delfem2::qem::Minimize_Quadric(
+    double pos[3],
+    const double Q[10],
+    const double p0[3],
+    const double p1[3])
+{
+  // cofactors of the symmetric matrix A = [Q0 Q1 Q2; Q1 Q4 Q5; Q2 Q5 Q7]
+  const double c00 = Q[4]*Q[7]-Q[5]*Q[5];
+  const double c01 = Q[2]*Q[5]-Q[1]*Q[7];
+  const double c02 = Q[1]*Q[5]-Q[2]*Q[4];
+  const double c11 = Q[0]*Q[7]-Q[2]*Q[2];
+  const double c12 = Q[1]*Q[2]-Q[0]*Q[5];
+  const double c22 = Q[0]*Q[4]-Q[1]*Q[1];
+  const double det = Q[0]*c00 + Q[1]*c01 + Q[2]*c02;
+  const double tr = Q[0]+Q[4]+Q[7];
+  if( fabs(det) > 1.0e-6*tr*tr*tr ){ // well conditioned
+    pos[0] = -(c00*Q[3] + c01*Q[6] + c02*Q[8])/det;
+    pos[1] = -(c01*Q[3] + c11*Q[6] + c12*Q[8])/det;
+    pos[2] = -(c02*Q[3] + c12*Q[6] + c22*Q[8])/det;
+    return Error_Quadric(Q,pos);
+  }
+  const double pm[3] = { (p0[0]+p1[0])*0.5, (p0[1]+p1[1])*0.5, (p0[2]+p1[2])*0.5 };
+  const double* aP[3] = { pm, p0, p1 };
+  double err_min = -1;
+  for(const double* p : aP){
+    const double err = Error_Quadric(Q,p);
+    if( err_min >= 0 && err >= err_min ){ continue; }
+    err_min = err;
+    pos[0] = p[0];
+    pos[1] = p[1];
+    pos[2] = p[2];
+  }
+  return err_min;
+}
+
+DFM2_INLINE bool delfem2::qem::IsCollapsible_LinkCondition(
+    unsigned int ip0,
+    unsigned int ip1,
+    const std::vector<CDynPntSur>& aDP,
+    const std::vector<CDynTri>& aDTri)
+{
+  std::vector<unsigned int> aIP0, aIP1;
+  if( !RingPoint(aIP0, ip0, aDP, aDTri) ){ return false; }
+  return qem::IsCollapsible_Ring(aIP0, ip1, aIP1, aDP, aDTri);
+}
+
+DFM2_INLINE void delfem2::QuadErrorMetric_MeshDTri3(
+    std::vector<double>& aSymMat4,
+    //
+    const std::vector<CDynPntSur>& aDP,
+    const std::vector<CDynTri>& aDTri,
+    const std::vector<CVec3d>& aVec3)
+{
+  aSymMat4.assign(aDP.size()*10, 0.0);
+  for(const CDynTri& tri : aDTri){
+    const CVec3d n = (aVec3[tri.v[1]]-aVec3[tri.v[0]])^(aVec3[tri.v[2]]-aVec3[tri.v[0]]);
+    const double len = n.Length();
+    if( len == 0.0 ){ continue; }
+    const double area = len*0.5;
+    const double a = n.x()/len, b = n.y()/len, c = n.z()/len;
+    const double d = -(a*aVec3[tri.v[0]].x() + b*aVec3[tri.v[0]].y() + c*aVec3[tri.v[0]].z());
+    const double Q[10] = { a*a, a*b, a*c, a*d, b*b, b*c, b*d, c*c, c*d, d*d };
+    for(unsigned int ip : tri.v){
+      for(int i=0;i<10;++i){ aSymMat4[ip*10+i] += area*Q[i]; }
+    }
+  }
+}
+
+DFM2_INLINE void delfem2::Simplify_QEM_MeshDTri3(
+    std::vector<CDynPntSur>& aDP,
+    std::vector<CDynTri>& aDTri,
+    std::vector<CVec3d>& aVec3,
+    std::vector<double>& aAttr,
+    unsigned int nattr,
+    size_t ntri_target,
+    unsigned int nthread)
+{
+  const unsigned int np = static_cast<unsigned int>(aDP.size());
+  assert( aAttr.size() == np*nattr );
+  std::vector<double> aQ;
+  QuadErrorMetric_MeshDTri3(aQ, aDP, aDTri, aVec3);
+  std::vector<qem::CCollapse> aCollapse(np);
+  if( nthread == 1 ){ // greedy with the indexed heap
+    qem::CHeap heap;
+    heap.Initialize(np);
+    auto update = [&](unsigned int ip){
+      qem::Evaluate(aCollapse[ip], ip, aQ, aDP, aDTri, aVec3);
+      if( aCollapse[ip].ip1 == UINT_MAX ){ heap.Remove(ip); }
+      else{ heap.Update(ip, aCollapse[ip].err); }
+    };
+    for(unsigned int ip=0;ip<np;++ip){ update(ip); }
+    std::vector<unsigned int> aIP;
+    while( aDTri.size() > ntri_target && !heap.empty() ){
+      const unsigned int ip0 = heap.Top();
+      const qem::CCollapse cl = aCollapse[ip0];
+      // the neighborhood might have changed after the evaluation
+      if( !qem::IsCollapsible_LinkCondition(ip0, cl.ip1, aDP, aDTri) ||
+          !qem::IsNotFlip(ip0, cl.ip1, cl.pos, aDP, aDTri, aVec3) ){
+        update(ip0);
+        continue;
+      }
+      if( !qem::Collapse(ip0, cl.ip1, cl.pos, aDP, aDTri, aVec3, aQ, aAttr, nattr) ){
+        heap.Remove(ip0);
+        continue;
+      }
+      heap.Remove(cl.ip1);
+      update(ip0);
+      if( !qem::RingPoint(aIP, ip0, aDP, aDTri) ){ continue; }
+      for(unsigned int jp : aIP){ update(jp); }
+    }
+    return;
+  }
+  // parallel passes
+  std::vector<unsigned char> aLock(np);
+  std::vector<unsigned char> aDirty(np, 1); // the error needs to be updated
+  std::vector<unsigned int> aIP0, aIP1;
+  bool is_stuck = false; // no collapse in the previous pass
+  while( aDTri.size() > ntri_target ){
+    std::vector<unsigned int> aPEval;
+    for(unsigned int ip=0;ip<np;++ip){
+      if( aDP[ip].e != UINT_MAX && aDirty[ip] ){ aPEval.push_back(ip); }
+    }
+    if( aPEval.empty() ){ break; }
+    thread::parallel_for(
+        static_cast<unsigned int>(aPEval.size()),
+        [&](unsigned int iip){
+          const unsigned int ip = aPEval[iip];
+          qem::Evaluate(aCollapse[ip], ip, aQ, aDP, aDTri, aVec3);
+        },
+        nthread);
+    std::fill(aDirty.begin(), aDirty.end(), 0);
+    std::vector< std::pair<double,unsigned int> > aErrP;
+    for(unsigned int ip=0;ip<np;++ip){
+      if( aDP[ip].e == UINT_MAX || aCollapse[ip].ip1 == UINT_MAX ){ continue; }
+      aErrP.emplace_back(aCollapse[ip].err, ip);
+    }
+    std::sort(aErrP.begin(), aErrP.end());
+    // collapse the edges whose neighborhoods do not overlap, starting from the smallest error.
+    // only the better half of the edges is considered to keep the order close to the greedy one.
+    const size_t ncollapse_max = (aDTri.size()-ntri_target+1)/2;
+    size_t ncollapse = 0;
+    std::fill(aLock.begin(), aLock.end(), 0);
+    for(size_t ierr=0;ierr<(aErrP.size()+1)/2 && ncollapse<ncollapse_max;++ierr){
+      const unsigned int ip0 = aErrP[ierr].second;
+      const qem::CCollapse& cl = aCollapse[ip0];
+      if( aLock[ip0] || aLock[cl.ip1] ){ continue; }
+      qem::RingPoint(aIP0, ip0, aDP, aDTri);
+      bool is_locked = false;
+      for(unsigned int jp : aIP0){ if( aLock[jp] ){ is_locked = true; break; } }
+      if( is_locked ){ continue; }
+      // as in the sequential mode, the validity of the collapse is checked lazily
+      if( !qem::IsCollapsible_Ring(aIP0, cl.ip1, aIP1, aDP, aDTri) ||
+          !qem::IsNotFlip(ip0, cl.ip1, cl.pos, aDP, aDTri, aVec3) ){
+        aDirty[ip0] = 1;
+        continue;
+      }
+      for(unsigned int jp : aIP1){ if( aLock[jp] ){ is_locked = true; break; } }
+      if( is_locked ){ continue; }
+      if( !qem::Collapse(ip0, cl.ip1, cl.pos, aDP, aDTri, aVec3, aQ, aAttr, nattr) ){
+        aDirty[ip0] = 1;
+        continue;
+      }
+      aLock[ip0] = aLock[cl.ip1] = 1;
+      for(unsigned int jp : aIP0){ aLock[jp] = 1; }
+      for(unsigned int jp : aIP1){ aLock[jp] = 1; }
+      // the errors change only around the remaining point
+      aDirty[ip0] = 1;
+      qem::RingPoint(aIP0, ip0, aDP, aDTri);
+      for(unsigned int jp : aIP0){ aDirty[jp] = 1; }
+      ncollapse++;
+    }
+    if( ncollapse == 0 && is_stuck ){ break; } // nothing happened even after the errors are updated
+    is_stuck = (ncollapse == 0);
+  }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file simplification of the triangle mesh with the quadric error metric (QEM) on the dynamic triangle mesh
+ * @details M. Garland and P. Heckbert "Surface Simplification Using Quadric Error Metrics" SIGGRAPH 1997.
+ * The quadric of a point is a symmetric 4x4 matrix stored as the 10 values of the upper triangle
+ * (a^2, ab, ac, ad, b^2, bc, bd, c^2, cd, d^2) of the planes ax+by+cz+d=0.
+ * The points on the boundary are not collapsed.
+ */
+
+#ifndef DFM2_DTRI3_QEM_H
+#define DFM2_DTRI3_QEM_H
+
+#include "delfem2/dfm2_inline.h"
+#include "delfem2/vec3.h"
+#include "delfem2/dtri.h"
+#include <vector>
+
+namespace delfem2 {
+
+namespace qem {
+
+/**
+ * @brief position that minimizes the quadric error
+ * @details if the quadric is (nearly) singular, the best one among p0, p1 and their midpoint is chosen
+ * @return quadric error at the position
+ */
+DFM2_INLINE double Minimize_Quadric(
+    double pos[3],
+    const double Q[10],
+    const double p0[3],
+    const double p1[3]);
+
+DFM2_INLINE double Error_Quadric(
+    const double Q[10],
+    const double p[3]);
+
+/**
+ * @brief link condition of the edge (ip0,ip1) on the closed manifold
+ * @details the common neighbors of the two points need to be the two points opposite to the edge and
+ * they need to have more than three neighbors. False if the points are on the boundary.
+ */
+DFM2_INLINE bool IsCollapsible_LinkCondition(
+    unsigned int ip0,
+    unsigned int ip1,
+    const std::vector<CDynPntSur>& aDP,
+    const std::vector<CDynTri>& aDTri);
+
+}
+
+/**
+ * @brief quadric of the planes of the triangles around each point weighted by the area of the triangle
+ * @param aSymMat4 (out) 10 values per point
+ */
+DFM2_INLINE void QuadErrorMetric_MeshDTri3(
+    std::vector<double>& aSymMat4,
+    //
+    const std::vector<CDynPntSur>& aDP,
+    const std::vector<CDynTri>& aDTri,
+    const std::vector<CVec3d>& aVec3);
+
+/**
+ * @brief simplify the mesh by collapsing the edges with the smallest quadric error until the number of the triangles
+ * becomes "ntri_target" or no edge can be collapsed.
+ * @details the collapse is rejected if it violates the link condition or flips a triangle.
+ * The collapsed points remain in the arrays with "aDP[ip].e == UINT_MAX".
+ * If "nthread" is 1, the edges are collapsed one by one in the order of the error using the indexed heap of the points.
+ * Otherwise, the errors of all the points are evaluated in parallel and the edges that do not share their neighborhoods are
+ * collapsed together in each pass. The parallel mode is much faster for the large meshes but the order of the collapse
+ * is approximately greedy.
+ * @param aAttr (in,out) attributes of the points ("nattr" values per point, e.g., texture coordinates).
+ * The attribute of the remaining point is linearly interpolated along the collapsed edge. Can be empty if nattr is 0.
+ * @param nthread number of threads. 0 for the number of the hardware threads
+ */
+DFM2_INLINE void Simplify_QEM_MeshDTri3(
+    std::vector<CDynPntSur>& aDP,
+    std::vector<CDynTri>& aDTri,
+    std::vector<CVec3d>& aVec3,
+    std::vector<double>& aAttr,
+    unsigned int nattr,
+    size_t ntri_target,
+    unsigned int nthread = 1);
+
+}
+
+#ifdef DFM2_HEADER_ONLY
+#  include "delfem2/dtri3_qem.cpp"
+#endif
+
+#endif /* DFM2_DTRI3_QEM_H */
@@ -10,7 +10,9 @@
 
 #include "delfem2/dfm2_inline.h"
 #include "delfem2/femutil.h"
+#include "delfem2/thread/th.h"
 #include <vector>
+#include <climits>
 
 namespace delfem2 {
 
@@ -132,6 +134,119 @@ double MergeLinSys_Cloth(
   return W;
 }
 
+/**
+ * @brief parallel version of "MergeLinSys_Cloth"
+ * @details For each color, the energy and its derivatives of the elements are computed in parallel first,
+ * then the element matrices are merged in parallel. The elements in the same color do not share a point,
+ * so the merge is race free. The total energy is summed in the order of elements,
+ * so the result does not depend on the number of threads.
+ * The coloring is computed once by "JArray_ColorElem_MeshElem" for the fixed mesh.
+ * @param aTriColor_ind (in) index of jagged array of the triangle coloring
+ * @param aTriColor (in) triangles sorted by color
+ * @param aQuadColor_ind (in) index of jagged array of the quad coloring
+ * @param aQuadColor (in) quads sorted by color
+ * @param nthread number of threads. hardware concurrency is used if 0
+ */
+template <class MAT>
+double MergeLinSys_Cloth_Parallel(
+    MAT& ddW, // (out) second derivative of energy
+    double* dW, // (out) first derivative of energy
+    //
+    double lambda, // (in) Lame's 1st parameter
+    double myu,  // (in) Lame's 2nd parameter
+    double stiff_bend, // (in) bending stiffness
+    const double* aPosIni,
+    unsigned int np,
+    unsigned int ndim,
+    const unsigned int* aTri,
+    unsigned int nTri, // (in) triangle index
+    const std::vector<unsigned int>& aTriColor_ind,
+    const std::vector<unsigned int>& aTriColor,
+    const unsigned int* aQuad,
+    unsigned int nQuad, // (in) index of 4 vertices required for bending
+    const std::vector<unsigned int>& aQuadColor_ind,
+    const std::vector<unsigned int>& aQuadColor,
+    const double* aXYZ,
+    unsigned int nthread = 0)
+{
+  assert( ndim == 2 || ndim == 3 );
+  assert( aTriColor.size() == nTri && aQuadColor.size() == nQuad );
+  nthread = thread::num_threads(nthread);
+  std::vector<double> aW(nTri+nQuad,0.0); // energy of each element
+  std::vector< std::vector<unsigned int> > aBuffer(nthread, std::vector<unsigned int>(np,UINT_MAX)); // merge buffer for each thread
+  std::vector<double> aDW, aDDW; // element derivatives in a color
+  // marge element in-plane strain energy
+  for(unsigned int icolor=0;icolor+1<aTriColor_ind.size();++icolor){
+    const unsigned int* aIE = aTriColor.data()+aTriColor_ind[icolor];
+    const unsigned int ne = aTriColor_ind[icolor+1]-aTriColor_ind[icolor];
+    aDW.resize(ne*9);
+    aDDW.resize(ne*81);
+    thread::parallel_for(ne, [&](unsigned int iie){
+      const unsigned int itri = aIE[iie];
+      double C[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
+      double c[3][3];
+      for(int ino=0;ino<3;ino++){
+        const unsigned int ip = aTri[itri*3+ino];
+        for(unsigned int i=0;i<ndim;i++){ C[ino][i] = aPosIni[ip*ndim+i]; }
+        for(int i=0;i<3;i++){ c[ino][i] = aXYZ[ip*3+i]; }
+      }
+      WdWddW_CST(
+          aW[itri],
+          reinterpret_cast<double(*)[3]>(aDW.data()+iie*9),
+          reinterpret_cast<double(*)[3][3][3]>(aDDW.data()+iie*81),
+          C,c, lambda,myu );
+    }, nthread);
+    thread::parallel_for_range(ne, [&](unsigned int ithread, unsigned int iie0, unsigned int iie1){
+      for(unsigned int iie=iie0;iie<iie1;++iie){
+        const unsigned int* aIP = aTri+aIE[iie]*3;
+        for(int ino=0;ino<3;ino++){
+          for(int i =0;i<3;i++){ dW[aIP[ino]*3+i] += aDW[iie*9+ino*3+i]; }
+        }
+        Merge<3,3,3,3,double>(ddW,aIP,aIP,
+            reinterpret_cast<const double(*)[3][3][3]>(aDDW.data()+iie*81),
+            aBuffer[ithread]);
+      }
+    }, nthread);
+  }
+  // marge element bending energy
+  for(unsigned int icolor=0;icolor+1<aQuadColor_ind.size();++icolor){
+    const unsigned int* aIE = aQuadColor.data()+aQuadColor_ind[icolor];
+    const unsigned int ne = aQuadColor_ind[icolor+1]-aQuadColor_ind[icolor];
+    aDW.resize(ne*12);
+    aDDW.resize(ne*144);
+    thread::parallel_for(ne, [&](unsigned int iie){
+      const unsigned int iq = aIE[iie];
+      double C[4][3] = {{0,0,0},{0,0,0},{0,0,0},{0,0,0}};
+      double c[4][3];
+      for(int ino=0;ino<4;ino++){
+        const unsigned int ip = aQuad[iq*4+ino];
+        for(unsigned int i=0;i<ndim;i++){ C[ino][i] = aPosIni[ip*ndim+i]; }
+        for(int i=0;i<3;i++){ c[ino][i] = aXYZ[ip*3+i]; }
+      }
+      WdWddW_Bend(
+          aW[nTri+iq],
+          reinterpret_cast<double(*)[3]>(aDW.data()+iie*12),
+          reinterpret_cast<double(*)[4][3][3]>(aDDW.data()+iie*144),
+          C,c, stiff_bend );
+    }, nthread);
+    thread::parallel_for_range(ne, [&](unsigned int ithread, unsigned int iie0, unsigned int iie1){
+      for(unsigned int iie=iie0;iie<iie1;++iie){
+        const unsigned int* aIP = aQuad+aIE[iie]*4;
+        for(int ino=0;ino<4;ino++){
+          for(int i =0;i<3;i++){ dW[aIP[ino]*3+i] += aDW[iie*12+ino*3+i]; }
+        }
+        Merge<4,4,3,3,double>(ddW,aIP,aIP,
+            reinterpret_cast<const double(*)[4][3][3]>(aDDW.data()+iie*144),
+            aBuffer[ithread]);
+      }
+    }, nthread);
+  }
+  // deterministic reduction of the energy
+  double W = 0;
+  for(double e : aW){ W += e; }
+  return W;
+}
+
 template <class MAT>
 double MergeLinSys_Contact(
     MAT& ddW,
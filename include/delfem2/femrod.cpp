@@ -14,6 +14,7 @@
 #include "delfem2/vecxitrsol.h"
 #include "delfem2/mshuni.h"
 #include "delfem2/jagarray.h"
+#include "delfem2/thread/th.h"
 
 namespace delfem2 {
 namespace femrod{
@@ -795,22 +796,28 @@ DFM2_INLINE void delfem2::MakeDirectorOrthogonal_RodHair(
   */
 }
 
-double delfem2::MergeLinSys_Hair(
+namespace delfem2 {
+namespace femrod {
+
+/**
+ * @brief merge the linear system of a hair (vertices from "ips" to "ipe")
+ */
+DFM2_INLINE double MergeLinSys_HairOne(
     std::vector<double>& vec_r,
     CMatrixSparse<double>& mats,
+    std::vector<unsigned int>& tmp_buffer,
     const double stiff_stretch,
     const double stiff_bendtwist[3],
-    const std::vector<unsigned int>& aIP_HairRoot,
+    unsigned int ips,
+    unsigned int ipe,
     const std::vector<CVec3d>& aP,
     const std::vector<CVec3d>& aS,
     const std::vector<CVec3d>& aP0,
     const std::vector<CVec3d>& aS0)
 {
-  std::vector<unsigned int> tmp_buffer;
   double W = 0;
-  for(unsigned int ihair=0;ihair<aIP_HairRoot.size()-1;++ihair){
-    unsigned int ips = aIP_HairRoot[ihair];
-    unsigned int ns = aIP_HairRoot[ihair+1] - aIP_HairRoot[ihair] -1;
+  {
+    const unsigned int ns = ipe - ips - 1;
     for(unsigned int is=0;is<ns;++is){
       const unsigned int ip0 = ips+is+0;
       const unsigned int ip1 = ips+is+1;
@@ -841,9 +848,8 @@ double delfem2::MergeLinSys_Hair(
     }
   }
   // --------------------------
-  for(unsigned int ihair=0;ihair<aIP_HairRoot.size()-1;++ihair){
-    const unsigned int ips = aIP_HairRoot[ihair];
-    const unsigned int nr = aIP_HairRoot[ihair+1] - aIP_HairRoot[ihair] - 2;
+  {
+    const unsigned int nr = ipe - ips - 2;
     for(unsigned int ir=0;ir<nr;++ir){
       const unsigned int ip0 = ips+ir+0;
       const unsigned int ip1 = ips+ir+1;
@@ -905,6 +911,43 @@ double delfem2::MergeLinSys_Hair(
   return W;
 }
 
+}
+}
+
+DFM2_INLINE double delfem2::MergeLinSys_Hair(
+    std::vector<double>& vec_r,
+    CMatrixSparse<double>& mats,
+    const double stiff_stretch,
+    const double stiff_bendtwist[3],
+    const std::vector<unsigned int>& aIP_HairRoot,
+    const std::vector<CVec3d>& aP,
+    const std::vector<CVec3d>& aS,
+    const std::vector<CVec3d>& aP0,
+    const std::vector<CVec3d>& aS0,
+    unsigned int nthread)
+{
+  // the hairs do not share the vertices, so they can be merged in parallel
+  const unsigned int nhair = static_cast<unsigned int>(aIP_HairRoot.size()-1);
+  nthread = std::min(thread::num_threads(nthread), std::max(nhair, 1u));
+  std::vector<double> aW(nthread, 0.0);
+  thread::parallel_for_range(
+      nhair,
+      [&](unsigned int ithread, unsigned int ihair0, unsigned int ihair1){
+        std::vector<unsigned int> tmp_buffer;
+        for(unsigned int ihair=ihair0;ihair<ihair1;++ihair){
+          aW[ithread] += femrod::MergeLinSys_HairOne(
+              vec_r, mats, tmp_buffer,
+              stiff_stretch, stiff_bendtwist,
+              aIP_HairRoot[ihair], aIP_HairRoot[ihair+1],
+              aP, aS, aP0, aS0);
+        }
+      },
+      nthread);
+  double W = 0;
+  for(double w : aW){ W += w; }
+  return W;
+}
+
 DFM2_INLINE void delfem2::UpdateSolutionHair(
     std::vector<CVec3d>& aP,
     std::vector<CVec3d>& aS,
@@ -937,6 +980,102 @@ DFM2_INLINE void delfem2::UpdateSolutionHair(
   }
 }
 
+// ---------------------------------------
+
+DFM2_INLINE void delfem2::CRodHairBandLDLT::Initialize(
+    const std::vector<unsigned int>& aIP_HairRoot_,
+    unsigned int nthread_)
+{
+  assert( !aIP_HairRoot_.empty() && aIP_HairRoot_[0] == 0 );
+  this->aIP_HairRoot = aIP_HairRoot_;
+  this->nthread = nthread_;
+  const unsigned int np = aIP_HairRoot[aIP_HairRoot.size()-1];
+  aBand.resize(np*4*(nbw+1));
+}
+
+DFM2_INLINE bool delfem2::CRodHairBandLDLT::SetValueFactorize(
+    const CMatrixSparse<double>& mats)
+{
+  assert( mats.nrowdim == 4 && mats.ncoldim == 4 );
+  const unsigned int nhair = static_cast<unsigned int>(aIP_HairRoot.size()-1);
+  const unsigned int nrow = nbw+1; // length of a row in the band storage
+  std::vector<char> aFlgOK(nhair, 1);
+  thread::parallel_for(
+      nhair,
+      [&](unsigned int ihair){
+        const unsigned int ips = aIP_HairRoot[ihair];
+        const unsigned int ipe = aIP_HairRoot[ihair+1];
+        const unsigned int n = (ipe-ips)*4;
+        double* band = aBand.data() + ips*4*nrow; // band[i*nrow+nbw-(i-j)] is the entry (i,j)
+        std::fill(band, band+n*nrow, 0.0);
+        for(unsigned int ip=ips;ip<ipe;++ip){ // copy the lower triangle of the hair's matrix
+          const unsigned int i0 = (ip-ips)*4;
+          for(unsigned int idim=0;idim<4;++idim){
+            for(unsigned int jdim=0;jdim<=idim;++jdim){
+              band[(i0+idim)*nrow+nbw-(idim-jdim)] = mats.valDia[ip*16+idim*4+jdim];
+            }
+          }
+          for(unsigned int icrs=mats.colInd[ip];icrs<mats.colInd[ip+1];++icrs){
+            const unsigned int jp = mats.rowPtr[icrs];
+            if( jp < ips || jp >= ip ){ continue; }
+            const unsigned int j0 = (jp-ips)*4;
+            assert( i0 - j0 <= 8 );
+            for(unsigned int idim=0;idim<4;++idim){
+              for(unsigned int jdim=0;jdim<4;++jdim){
+                band[(i0+idim)*nrow+nbw-(i0+idim-j0-jdim)] = mats.valCrs[icrs*16+idim*4+jdim];
+              }
+            }
+          }
+        }
+        for(unsigned int i=0;i<n;++i){ // LDL^T factorization in place
+          double* bi = band + i*nrow + nbw - i; // bi[j] is the entry (i,j)
+          const unsigned int j0 = (i > nbw) ? i-nbw : 0;
+          for(unsigned int j=j0;j<i;++j){
+            const double* bj = band + j*nrow + nbw - j;
+            double v = bi[j];
+            for(unsigned int k=j0;k<j;++k){ v -= bi[k]*bj[k]*band[k*nrow+nbw]; }
+            bi[j] = v/bj[j];
+          }
+          double d = bi[i];
+          for(unsigned int k=j0;k<i;++k){ d -= bi[k]*bi[k]*band[k*nrow+nbw]; }
+          if( fabs(d) < 1.0e-30 ){ aFlgOK[ihair] = 0; d = 1.0; }
+          bi[i] = d;
+        }
+      },
+      nthread);
+  for(char flg : aFlgOK){ if( flg == 0 ){ return false; } }
+  return true;
+}
+
+DFM2_INLINE void delfem2::CRodHairBandLDLT::Solve(
+    double* vec) const
+{
+  const unsigned int nhair = static_cast<unsigned int>(aIP_HairRoot.size()-1);
+  const unsigned int nrow = nbw+1;
+  thread::parallel_for(
+      nhair,
+      [&](unsigned int ihair){
+        const unsigned int ips = aIP_HairRoot[ihair];
+        const unsigned int n = (aIP_HairRoot[ihair+1]-ips)*4;
+        const double* band = aBand.data() + ips*4*nrow;
+        double* x = vec + ips*4;
+        for(unsigned int i=0;i<n;++i){ // forward substitution
+          const double* bi = band + i*nrow + nbw - i;
+          const unsigned int j0 = (i > nbw) ? i-nbw : 0;
+          double v = x[i];
+          for(unsigned int j=j0;j<i;++j){ v -= bi[j]*x[j]; }
+          x[i] = v;
+        }
+        for(unsigned int i=0;i<n;++i){ x[i] /= band[i*nrow+nbw]; }
+        for(unsigned int i=n;i-->0;){ // backward substitution
+          const double* bi = band + i*nrow + nbw - i;
+          const unsigned int j0 = (i > nbw) ? i-nbw : 0;
+          for(unsigned int j=j0;j<i;++j){ x[j] -= bi[j]*x[i]; }
+        }
+      },
+      nthread);
+}
+
 DFM2_INLINE void delfem2::Solve_RodHair(
     std::vector<CVec3d>& aP,
     std::vector<CVec3d>& aS,
@@ -947,7 +1086,8 @@ DFM2_INLINE void delfem2::Solve_RodHair(
     const std::vector<CVec3d>& aP0,
     const std::vector<CVec3d>& aS0,
     const std::vector<int>& aBCFlag,
-    const std::vector<unsigned int>& aIP_HairRoot)
+    const std::vector<unsigned int>& aIP_HairRoot,
+    unsigned int nthread)
 {
   assert( mats.nrowdim == 4 );
   assert( mats.ncoldim == 4 );
@@ -962,7 +1102,8 @@ DFM2_INLINE void delfem2::Solve_RodHair(
   double W = MergeLinSys_Hair(
       vec_r,mats,
       stiff_stretch,stiff_bendtwist,
-      aIP_HairRoot,aP,aS,aP0,aS0);
+      aIP_HairRoot,aP,aS,aP0,aS0,
+      nthread);
   for(unsigned int ip=0;ip<aP.size();++ip){
     mats.valDia[ip*16+0*4+0] += mdtt;
     mats.valDia[ip*16+1*4+1] += mdtt;
@@ -973,22 +1114,13 @@ DFM2_INLINE void delfem2::Solve_RodHair(
   assert( aBCFlag.size() == np*4 );
   mats.SetFixedBC(aBCFlag.data());
   setRHS_Zero(vec_r, aBCFlag,0);
-  std::vector<double> vec_x;
-  vec_x.assign(np*4, 0.0);
-  {
-    const std::size_t n = vec_r.size();
-    std::vector<double> tmp0(n), tmp1(n);
-    auto vr = CVecXd(vec_r);
-    auto vu = CVecXd(vec_x);
-    auto vs = CVecXd(tmp0);
-    auto vt = CVecXd(tmp1);
-    auto aConvHist = Solve_CG(
-        vr,vu,vs,vt,
-        1.0e-4, 300, mats);
-    if( aConvHist.size() > 0 ){
-      std::cout << "            conv: " << aConvHist.size() << " " << aConvHist[0] << " " << aConvHist[aConvHist.size()-1] << std::endl;
-    }
+  CRodHairBandLDLT ldlt;
+  ldlt.Initialize(aIP_HairRoot, nthread);
+  if( !ldlt.SetValueFactorize(mats) ){
+    std::cout << "            zero pivot in the factorization" << std::endl;
   }
+  std::vector<double> vec_x = vec_r;
+  ldlt.Solve(vec_x.data());
   UpdateSolutionHair(aP,aS,
       vec_x,aIP_HairRoot,aBCFlag);
 }
@@ -1052,7 +1184,8 @@ DFM2_INLINE void delfem2::Solve_RodHairContact(
     const std::vector<unsigned int>& aIP_HairRoot,
     const double clearance,
     const double stiff_contact,
-    const std::vector<CContactHair>& aContact)
+    const std::vector<CContactHair>& aContact,
+    unsigned int nthread)
 {
   assert( mats.nrowdim == 4 );
   assert( mats.ncoldim == 4 );
@@ -1067,7 +1200,8 @@ DFM2_INLINE void delfem2::Solve_RodHairContact(
   double W = MergeLinSys_Hair(
       vec_r,mats,
       stiff_stretch,stiff_bendtwist,
-      aIP_HairRoot,aP,aS,aP0,aS0);
+      aIP_HairRoot,aP,aS,aP0,aS0,
+      nthread);
   for(unsigned int ip=0;ip<aP.size();++ip){
     mats.valDia[ip*16+0*4+0] += mdtt;
     mats.valDia[ip*16+1*4+1] += mdtt;
@@ -1102,6 +1236,11 @@ DFM2_INLINE void delfem2::Solve_RodHairContact(
   vec_x.assign(np*4, 0.0);
   setRHS_Zero(vec_r, aBCFlag,0);
   femrod::CMatContact mc(mats,aContact,stiff_contact);
+  CRodHairBandLDLT ldlt; // the factorization of each hair without the contact is the preconditioner
+  ldlt.Initialize(aIP_HairRoot, nthread);
+  if( !ldlt.SetValueFactorize(mats) ){
+    std::cout << "            zero pivot in the factorization" << std::endl;
+  }
   {
     const std::size_t n = vec_r.size();
     std::vector<double> tmp0(n), tmp1(n);
@@ -1109,9 +1248,9 @@ DFM2_INLINE void delfem2::Solve_RodHairContact(
     auto vu = CVecXd(vec_x);
     auto vs = CVecXd(tmp0);
     auto vt = CVecXd(tmp1);
-    auto aConvHist = Solve_CG(
+    auto aConvHist = Solve_PCG(
         vr, vu, vs, vt,
-        1.0e-6, 3000, mc);
+        1.0e-6, 3000, mc, ldlt);
     /*
     if( aConvHist.size() > 0 ){
       std::cout << "            conv: " << aConvHist.size() << " " << aConvHist[0] << " " << aConvHist[aConvHist.size()-1] << std::endl;
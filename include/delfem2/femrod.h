@@ -129,6 +129,9 @@ DFM2_INLINE void MakeDirectorOrthogonal_RodHair(
     const std::vector<CVec3d>& aP);
 
 
+/**
+ * @param nthread the hairs are merged in parallel. hardware concurrency is used if 0
+ */
 DFM2_INLINE double MergeLinSys_Hair(
     std::vector<double>& vec_r,
     CMatrixSparse<double>& mats,
@@ -138,7 +141,8 @@ DFM2_INLINE double MergeLinSys_Hair(
     const std::vector<CVec3d>& aP,
     const std::vector<CVec3d>& aS,
     const std::vector<CVec3d>& aP0,
-    const std::vector<CVec3d>& aS0);
+    const std::vector<CVec3d>& aS0,
+    unsigned int nthread = 0);
 
 DFM2_INLINE void UpdateSolutionHair(
     std::vector<CVec3d>& aP,
@@ -147,6 +151,38 @@ DFM2_INLINE void UpdateSolutionHair(
     const std::vector<unsigned int>& aIP_HairRoot,
     const std::vector<int>& aBCFlag);
 
+/**
+ * @brief direct solver for the linear system of the rod hairs
+ * @details a vertex interacts only with the two neighbors on each side in the hair,
+ * so the matrix of each hair is banded and it is factorized (LDL^T) in O(n).
+ * The hairs are independent and processed in parallel.
+ * The coupling between the hairs (e.g., contact) is ignored so it can be used as the preconditioner in such case.
+ */
+class CRodHairBandLDLT {
+public:
+  /**
+   * @param nthread number of threads. hardware concurrency is used if 0
+   */
+  void Initialize(
+      const std::vector<unsigned int>& aIP_HairRoot,
+      unsigned int nthread = 0);
+  /**
+   * @brief factorize the matrix whose pattern is made by "MakeSparseMatrix_RodHair"
+   * @return false if there is zero pivot
+   */
+  bool SetValueFactorize(const CMatrixSparse<double>& mats);
+  /**
+   * @brief solve the linear system. "vec" is overwritten by the solution
+   */
+  void Solve(double* vec) const;
+  void SolvePrecond(double* vec) const { this->Solve(vec); }
+public:
+  static const unsigned int nbw = 11; // half bandwidth (4 dofs times 2 vertices + 3)
+  unsigned int nthread = 0;
+  std::vector<unsigned int> aIP_HairRoot;
+  std::vector<double> aBand; // "nbw" values at the left of the diagonal, and the diagonal for each row
+};
+
 /**
  * @brief static minimization of the deformation energy
  * @param aP (in&out) position of the vertices of the rods
@@ -157,6 +193,8 @@ DFM2_INLINE void UpdateSolutionHair(
  * @param aS0 (in) initial darboux vectors
  * @param aBCFlag (in) boundary condition flag. Non zero value means fixed value
  * @param aIP_HairRoot (in) indeces of the root points
+ * @param nthread (in) number of threads. hardware concurrency is used if 0
+ * @details the linear system is solved directly for each hair with "CRodHairBandLDLT"
  */
 DFM2_INLINE void Solve_RodHair(
     std::vector<CVec3d>& aP,
@@ -168,7 +206,8 @@ DFM2_INLINE void Solve_RodHair(
     const std::vector<CVec3d>& aP0,
     const std::vector<CVec3d>& aS0,
     const std::vector<int>& aBCFlag,
-    const std::vector<unsigned int>& aIP_HairRoot);
+    const std::vector<unsigned int>& aIP_HairRoot,
+    unsigned int nthread = 0);
 
 
 class CContactHair{
@@ -185,6 +224,10 @@ public:
 };
 
 
+/**
+ * @details the hairs coupled by the contacts are solved with the preconditioned CG method
+ * where the factorization of each hair ("CRodHairBandLDLT") is used as the preconditioner
+ */
 DFM2_INLINE void Solve_RodHairContact(
     std::vector<CVec3d>& aP,
     std::vector<CVec3d>& aS,
@@ -199,7 +242,8 @@ DFM2_INLINE void Solve_RodHairContact(
     const std::vector<unsigned int>& aIP_HairRoot,
     const double clearance,
     const double stiff_contact,
-    const std::vector<CContactHair>& aContact);
+    const std::vector<CContactHair>& aContact,
+    unsigned int nthread = 0);
 
 
 
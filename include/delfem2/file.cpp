@@ -14,6 +14,14 @@
 
 #include "delfem2/file.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define DFM2_FILE_MMAP
+#endif
+
 namespace delfem2{
 namespace file{
 
@@ -130,4 +138,50 @@ DFM2_INLINE bool delfem2::GetFileContents(
 error:
   if (fp) fclose(fp);
   return false;
-}
\ No newline at end of file
+}
+
+// ----------------------------------------------
+
+DFM2_INLINE bool delfem2::CMappedFile::Open(
+    const std::string& fpath)
+{
+  this->Close();
+#ifdef DFM2_FILE_MMAP
+  const int fd = ::open(fpath.c_str(), O_RDONLY);
+  if( fd < 0 ){ return false; }
+  struct stat st;
+  if( ::fstat(fd, &st) != 0 ){ ::close(fd); return false; }
+  nbyte = static_cast<size_t>(st.st_size);
+  if( nbyte == 0 ){ ::close(fd); return true; }
+  void* p = ::mmap(nullptr, nbyte, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if( p != MAP_FAILED ){
+    ::madvise(p, nbyte, MADV_SEQUENTIAL);
+    ptr = static_cast<const char*>(p);
+    is_mapped = true;
+    return true;
+  }
+  nbyte = 0;
+#endif
+  std::ifstream fin(fpath.c_str(), std::ios::binary | std::ios::ate);
+  if( fin.fail() ){ return false; }
+  const std::streamoff n = fin.tellg();
+  if( n < 0 ){ return false; }
+  aBuff.resize(static_cast<size_t>(n));
+  fin.seekg(0);
+  fin.read(aBuff.data(), n);
+  ptr = aBuff.data();
+  nbyte = aBuff.size();
+  return true;
+}
+
+DFM2_INLINE void delfem2::CMappedFile::Close()
+{
+#ifdef DFM2_FILE_MMAP
+  if( is_mapped ){ ::munmap(const_cast<char*>(ptr), nbyte); }
+#endif
+  ptr = nullptr;
+  nbyte = 0;
+  is_mapped = false;
+  aBuff.clear();
+}
@@ -55,6 +55,30 @@ DFM2_INLINE bool WriteParam(
 DFM2_INLINE std::string LoadFile(
     const std::string& fname);
 
+/**
+ * @brief read-only view of the whole content of a file.
+ * @details the file is memory-mapped on the POSIX systems. On the other systems the content is read into a buffer.
+ */
+class CMappedFile {
+public:
+  CMappedFile() = default;
+  CMappedFile(const CMappedFile&) = delete;
+  CMappedFile& operator=(const CMappedFile&) = delete;
+  ~CMappedFile(){ this->Close(); }
+  /**
+   * @return false if the file cannot be opened
+   */
+  bool Open(const std::string& fpath);
+  void Close();
+  const char* data() const { return ptr; }
+  size_t size() const { return nbyte; }
+private:
+  const char* ptr = nullptr;
+  size_t nbyte = 0;
+  bool is_mapped = false;
+  std::vector<char> aBuff; // used when the file is not mapped
+};
+
 //DFM2_INLINE std::map<std::string, std::string> ReadDictionary(
 //    const std::string& path);
 
@@ -10,61 +10,217 @@
 #include <cassert>
 #include <cstdio>
 #include <cstring>
+#include <cstdint>
 #include <algorithm>
 #include "delfem2/str.h"
 #include "delfem2/filenpy_str.h"
 
+#ifdef USE_ZLIB
+#  include <zlib.h>
+#endif
+
 namespace delfem2{
-namespace funcs{
+namespace filenpy{
 
-// 10bytes header
-struct NPY
+DFM2_INLINE void SwapBytes(
+    char* p,
+    size_t n,
+    unsigned int nbyte_unit)
 {
-  char magic_string[6] = {'X','X','X','X','X','X'}; // 6 bytes (0x93NUMPY)
-  unsigned char major_version = 0; // 1 byte
-  unsigned char minor_version = 0; // 1 byte
-  unsigned short header_len = 0; // 2 bytes
-};
+  for(size_t i=0;i<n;++i){
+    std::reverse(p+i*nbyte_unit, p+(i+1)*nbyte_unit);
+  }
+}
 
-DFM2_INLINE bool LoadNumpy(
-    int& ndim0,
-    int& ndim1,
-    std::ifstream& fp)
-{
-  NPY npy;
-//  size_t n0 = fread(&npy, sizeof(npy), 1, fp);
-//  if( n0 != 1 ){ return false; }
-  fp.read((char*)&npy, sizeof(npy));
-  if( fp.fail() ){ return false; }
-
-  { // check magic string
-    unsigned char sMagic[7] = {0x93,'N','U','M','P','Y'};
-    if( memcmp(npy.magic_string, sMagic, 6 ) != 0 ){ return false; }
-  }
-
-  ndim0 = 0;
-  ndim1 = 0;
-  { // format
-    char buff[256];
-//    size_t n1 = fread(buff, 1, npy.header_len, fp);
-//    if( n1 != npy.header_len ){ return false; }
-    fp.read(buff,npy.header_len);
-    if( fp.fail() ){ return false; }
-    std::map<std::string, std::string> map0 = ReadDictionary_Python(std::string(buff));
-    std::string str_shape = map0["'shape'"];
-    str_shape = Get_Parentheses(str_shape,"()");
-    std::vector<std::string> aToken = Split(str_shape,',');
-    if( aToken.size() != 2 ){ return false; }
-    ndim0 = myStoi(aToken[0]);
-    ndim1 = myStoi(aToken[1]);
+template <typename T, typename S>
+void ConvertValues(
+    T* aOut,
+    const char* pIn,
+    size_t n,
+    bool is_swap)
+{
+  for(size_t i=0;i<n;++i){
+    S v;
+    std::memcpy(&v, pIn+i*sizeof(S), sizeof(S));
+    if( is_swap ){ SwapBytes(reinterpret_cast<char*>(&v), 1, sizeof(S)); }
+    aOut[i] = static_cast<T>(v);
   }
-  return true;
 }
 
+/**
+ * @brief convert "n" values in the file to "T"
+ */
+template <typename T>
+bool ConvertNumpyValues(
+    T* aOut,
+    const char* pIn,
+    size_t n,
+    const CNumpyHeader& head)
+{
+  const bool is_swap = head.nbyte_value > 1 && head.is_big_endian != IsBigEndian_Native();
+  if( head.kind == NumpyType<T>::kind && head.nbyte_value == sizeof(T) ){
+    std::memcpy(static_cast<void*>(aOut), pIn, n*sizeof(T));
+    if( is_swap ){ // complex value is swapped for each component
+      const unsigned int nbyte_unit = (head.kind == 'c') ? head.nbyte_value/2 : head.nbyte_value;
+      SwapBytes(reinterpret_cast<char*>(aOut), n*sizeof(T)/nbyte_unit, nbyte_unit);
+    }
+    return true;
+  }
+  const unsigned int nb = head.nbyte_value;
+  if( head.kind == 'f' && nb == 4 ){ ConvertValues<T,float>(aOut, pIn, n, is_swap); return true; }
+  if( head.kind == 'f' && nb == 8 ){ ConvertValues<T,double>(aOut, pIn, n, is_swap); return true; }
+  if( head.kind == 'i' && nb == 1 ){ ConvertValues<T,std::int8_t>(aOut, pIn, n, is_swap); return true; }
+  if( head.kind == 'i' && nb == 2 ){ ConvertValues<T,std::int16_t>(aOut, pIn, n, is_swap); return true; }
+  if( head.kind == 'i' && nb == 4 ){ ConvertValues<T,std::int32_t>(aOut, pIn, n, is_swap); return true; }
+  if( head.kind == 'i' && nb == 8 ){ ConvertValues<T,std::int64_t>(aOut, pIn, n, is_swap); return true; }
+  if( (head.kind == 'u' || head.kind == 'b') && nb == 1 ){ ConvertValues<T,std::uint8_t>(aOut, pIn, n, is_swap); return true; }
+  if( head.kind == 'u' && nb == 2 ){ ConvertValues<T,std::uint16_t>(aOut, pIn, n, is_swap); return true; }
+  if( head.kind == 'u' && nb == 4 ){ ConvertValues<T,std::uint32_t>(aOut, pIn, n, is_swap); return true; }
+  if( head.kind == 'u' && nb == 8 ){ ConvertValues<T,std::uint64_t>(aOut, pIn, n, is_swap); return true; }
+  return false; // complex to the other type, or the other size
+}
 
+/**
+ * @brief find the value of the key in the python dictionary
+ * @return position just after ":". std::string::npos if not found
+ */
+DFM2_INLINE size_t FindValuePythonDict(
+    const std::string& dict,
+    const std::string& key)
+{
+  for(const char q : {'\'', '"'}){
+    const size_t i0 = dict.find(q+key+q);
+    if( i0 == std::string::npos ){ continue; }
+    const size_t i1 = dict.find(':', i0+key.size()+2);
+    if( i1 == std::string::npos ){ return std::string::npos; }
+    return i1+1;
+  }
+  return std::string::npos;
 }
+
+// zip archive
+
+constexpr std::uint32_t kZipLocalHeader = 0x04034b50;
+constexpr std::uint32_t kZipCentralHeader = 0x02014b50;
+constexpr std::uint32_t kZipEnd = 0x06054b50;
+constexpr std::uint32_t kZip64End = 0x06064b50;
+constexpr std::uint32_t kZip64Locator = 0x07064b50;
+
+DFM2_INLINE std::uint32_t Crc32(
+    const char* p,
+    size_t n,
+    std::uint32_t crc = 0)
+{
+  static const std::vector<std::uint32_t> aTable = [](){
+    std::vector<std::uint32_t> a(256);
+    for(std::uint32_t i=0;i<256;++i){
+      std::uint32_t c = i;
+      for(int k=0;k<8;++k){ c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1); }
+      a[i] = c;
+    }
+    return a;
+  }();
+  crc = ~crc;
+  for(size_t i=0;i<n;++i){
+    crc = aTable[(crc ^ static_cast<unsigned char>(p[i])) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+/**
+ * @brief append the value in the little endian
+ */
+template <typename T>
+void AppendLE(
+    std::string& s,
+    T v)
+{
+  for(unsigned int i=0;i<sizeof(T);++i){ s.push_back(static_cast<char>((v >> (8*i)) & 0xFF)); }
 }
 
+template <typename T>
+T ReadLE(const char* p)
+{
+  T v = 0;
+  for(unsigned int i=0;i<sizeof(T);++i){ v |= static_cast<T>(static_cast<unsigned char>(p[i])) << (8*i); }
+  return v;
+}
+
+#ifdef USE_ZLIB
+
+constexpr size_t kZlibChunk = size_t(1) << 30; // the sizes in "z_stream" are "uInt"
+
+/**
+ * @brief raw deflate (no zlib header) of the data fed to zlib in chunks
+ */
+DFM2_INLINE bool Deflate(
+    std::string& out,
+    const char* p,
+    size_t n)
+{
+  out.clear();
+  z_stream zs;
+  std::memset(&zs, 0, sizeof(zs));
+  if( deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK ){ return false; }
+  size_t iin = 0;
+  int res = Z_OK;
+  while( res == Z_OK ){
+    if( zs.avail_in == 0 && iin < n ){
+      const size_t nin = std::min(n-iin, kZlibChunk);
+      zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(p+iin));
+      zs.avail_in = static_cast<uInt>(nin);
+      iin += nin;
+    }
+    const size_t nout = std::min(std::max(n/2, size_t(1) << 16), kZlibChunk);
+    const size_t iout = out.size();
+    out.resize(iout+nout);
+    zs.next_out = reinterpret_cast<Bytef*>(&out[iout]);
+    zs.avail_out = static_cast<uInt>(nout);
+    res = deflate(&zs, (iin == n) ? Z_FINISH : Z_NO_FLUSH);
+    out.resize(out.size()-zs.avail_out);
+  }
+  deflateEnd(&zs);
+  return res == Z_STREAM_END;
+}
+
+/**
+ * @brief raw inflate of the data whose size after decompression "nout" is known
+ */
+DFM2_INLINE bool Inflate(
+    char* out,
+    size_t nout,
+    const char* p,
+    size_t n)
+{
+  z_stream zs;
+  std::memset(&zs, 0, sizeof(zs));
+  if( inflateInit2(&zs, -15) != Z_OK ){ return false; }
+  size_t iin = 0, iout = 0;
+  int res = Z_OK;
+  while( res == Z_OK ){
+    if( zs.avail_in == 0 && iin < n ){
+      const size_t nin = std::min(n-iin, kZlibChunk);
+      zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(p+iin));
+      zs.avail_in = static_cast<uInt>(nin);
+      iin += nin;
+    }
+    if( zs.avail_out == 0 && iout < nout ){
+      const size_t nout1 = std::min(nout-iout, kZlibChunk);
+      zs.next_out = reinterpret_cast<Bytef*>(out+iout);
+      zs.avail_out = static_cast<uInt>(nout1);
+      iout += nout1;
+    }
+    res = inflate(&zs, Z_NO_FLUSH);
+  }
+  const bool is_complete = (res == Z_STREAM_END && iout == nout && zs.avail_out == 0);
+  inflateEnd(&zs);
+  return is_complete;
+}
+
+#endif
+
+}
+}
 
 // ------------------------------
 // -----------------------------
@@ -119,6 +275,7 @@ DFM2_INLINE delfem2::ReadDictionary_Python(
   return map0;
 }
 
+
 //bool isNaN(double x) { return x!=x; }
 
 template <typename REAL>
@@ -128,16 +285,12 @@ DFM2_INLINE bool delfem2::LoadNumpy_2Dim(
     std::vector<REAL>& aData,
     const std::string& path)
 {
-//  FILE* fp = fopen(path.c_str(),"rb");
-  std::ifstream fin(path,std::ios::in | std::ios::binary);
-  if( fin.fail() ) { return false; }
-  funcs::LoadNumpy(ndim0, ndim1, fin);
-  int size = ndim0*ndim1;
-  aData.resize(size);
-//  size_t n0 = fread(&aData[0], sizeof(float), size, fp);
-//  return (int) n0 == size;
-  fin.read( (char*)&aData[0], sizeof(REAL)*size );
-  return !fin.fail();
+  std::vector<size_t> aShape;
+  if( !LoadNumpy(aShape, aData, path) ){ return false; }
+  if( aShape.size() != 2 ){ return false; }
+  ndim0 = static_cast<int>(aShape[0]);
+  ndim1 = static_cast<int>(aShape[1]);
+  return true;
 }
 #ifndef DFM2_HEADER_ONLY
 template bool delfem2::LoadNumpy_2Dim(
@@ -153,53 +306,540 @@ DFM2_INLINE bool delfem2::LoadNumpy_1DimF(
     std::vector<float>& aData,
     const std::string& path)
 {
-//  FILE* fp = fopen(path.c_str(),"r");
-//  if( fp == nullptr ) { return false; }
+  std::vector<size_t> aShape;
+  if( !LoadNumpy(aShape, aData, path) ){ return false; }
+  if( aShape.size() != 1 ){ return false; }
+  ndim0 = static_cast<int>(aShape[0]);
+  return true;
+}
+
+// ------------------------------------------
+// N-dimensional array
+
+DFM2_INLINE size_t delfem2::CNumpyHeader::NumValues() const
+{
+  size_t n = 1;
+  for(size_t s : shape){ n *= s; }
+  return n;
+}
+
+DFM2_INLINE size_t delfem2::CNumpyHeader::NumValuesPerRow() const
+{
+  size_t n = 1;
+  for(unsigned int i=1;i<shape.size();++i){ n *= shape[i]; }
+  return n;
+}
+
+DFM2_INLINE bool delfem2::ParseNumpyHeader(
+    CNumpyHeader& head,
+    const char* p,
+    size_t n)
+{
+  namespace lcl = ::delfem2::filenpy;
+  if( n < 10 ){ return false; }
+  {
+    const unsigned char sMagic[6] = {0x93,'N','U','M','P','Y'};
+    if( std::memcmp(p, sMagic, 6) != 0 ){ return false; }
+  }
+  const unsigned int major_version = static_cast<unsigned char>(p[6]);
+  size_t nbyte_dict, ipos;
+  if( major_version == 1 ){
+    nbyte_dict = lcl::ReadLE<std::uint16_t>(p+8);
+    ipos = 10;
+  }
+  else if( major_version == 2 || major_version == 3 ){
+    if( n < 12 ){ return false; }
+    nbyte_dict = lcl::ReadLE<std::uint32_t>(p+8);
+    ipos = 12;
+  }
+  else{ return false; }
+  if( ipos + nbyte_dict > n ){ return false; }
+  const std::string dict(p+ipos, nbyte_dict);
+  head.nbyte_header = ipos + nbyte_dict;
+  { // descr (e.g., '<f8')
+    const size_t i0 = lcl::FindValuePythonDict(dict, "descr");
+    if( i0 == std::string::npos ){ return false; }
+    const size_t i1 = dict.find_first_of("'\"[", i0);
+    if( i1 == std::string::npos || dict[i1] == '[' ){ return false; } // structured array
+    const size_t i2 = dict.find(dict[i1], i1+1);
+    if( i2 == std::string::npos || i2 - i1 < 4 ){ return false; }
+    const std::string descr = dict.substr(i1+1, i2-i1-1);
+    if( descr[0] == '<' ){ head.is_big_endian = false; }
+    else if( descr[0] == '>' ){ head.is_big_endian = true; }
+    else if( descr[0] == '|' || descr[0] == '=' ){ head.is_big_endian = IsBigEndian_Native(); }
+    else{ return false; }
+    head.kind = descr[1];
+    if( std::string("fiubc").find(head.kind) == std::string::npos ){ return false; }
+    const int nbyte_value = myStoi(descr.substr(2));
+    if( nbyte_value <= 0 ){ return false; }
+    head.nbyte_value = static_cast<unsigned int>(nbyte_value);
+  }
+  { // fortran_order
+    const size_t i0 = lcl::FindValuePythonDict(dict, "fortran_order");
+    if( i0 == std::string::npos ){ return false; }
+    const size_t i1 = dict.find_first_not_of(' ', i0);
+    head.fortran_order = ( dict.compare(i1, 4, "True") == 0 );
+  }
+  { // shape (e.g., (3, 4) or (3,) or ())
+    const size_t i0 = lcl::FindValuePythonDict(dict, "shape");
+    if( i0 == std::string::npos ){ return false; }
+    const size_t i1 = dict.find('(', i0);
+    const size_t i2 = dict.find(')', i0);
+    if( i1 == std::string::npos || i2 == std::string::npos || i2 < i1 ){ return false; }
+    head.shape.clear();
+    const std::vector<std::string> aToken = Split(dict.substr(i1+1, i2-i1-1), ',');
+    for(const std::string& token : aToken){
+      const std::string t = RemoveSpace(token);
+      if( t.empty() ){ continue; }
+      size_t v = 0;
+      for(char c : t){
+        if( c < '0' || c > '9' ){ return false; }
+        if( v > (SIZE_MAX-9)/10 ){ return false; } // overflow
+        v = v*10 + static_cast<size_t>(c-'0');
+      }
+      head.shape.push_back(v);
+    }
+  }
+  return true;
+}
+
+DFM2_INLINE std::string delfem2::MakeNumpyHeader(
+    const CNumpyHeader& head,
+    size_t nbyte_min)
+{
+  std::string dict = "{'descr': '";
+  dict += (head.nbyte_value == 1) ? '|' : (head.is_big_endian ? '>' : '<');
+  dict += head.kind + std::to_string(head.nbyte_value);
+  dict += "', 'fortran_order': ";
+  dict += head.fortran_order ? "True" : "False";
+  dict += ", 'shape': (";
+  for(size_t s : head.shape){ dict += std::to_string(s) + ", "; }
+  if( head.shape.size() > 1 ){ dict.resize(dict.size()-2); }
+  else if( head.shape.size() == 1 ){ dict.resize(dict.size()-1); } // (n,)
+  dict += "), }";
+  const bool is_v1 = dict.size() + 11 + 64 < 65536;
+  const size_t nbyte_prefix = is_v1 ? 10 : 12;
+  size_t nbyte = std::max(nbyte_prefix + dict.size() + 1, nbyte_min);
+  nbyte = (nbyte + 63)/64*64;
+  dict.resize(nbyte - nbyte_prefix - 1, ' ');
+  dict += '\n';
+  std::string out = {'\x93','N','U','M','P','Y'};
+  out += is_v1 ? '\x01' : '\x02';
+  out += '\x00';
+  if( is_v1 ){ ::delfem2::filenpy::AppendLE<std::uint16_t>(out, static_cast<std::uint16_t>(dict.size())); }
+  else{ ::delfem2::filenpy::AppendLE<std::uint32_t>(out, static_cast<std::uint32_t>(dict.size())); }
+  return out + dict;
+}
+
+template <typename T>
+bool delfem2::GetNumpyArray(
+    std::vector<T>& aData,
+    const CNumpyHeader& head,
+    const char* pData)
+{
+  const size_t nval = head.NumValues();
+  aData.resize(nval);
+  if( nval == 0 ){ return true; }
+  const unsigned int ndim = static_cast<unsigned int>(head.shape.size());
+  if( !head.fortran_order || ndim <= 1 ){
+    return filenpy::ConvertNumpyValues(aData.data(), pData, nval, head);
+  }
+  std::vector<T> aTmp(nval);
+  if( !filenpy::ConvertNumpyValues(aTmp.data(), pData, nval, head) ){ return false; }
+  // Fortran order to C order. The last index runs fastest in the output
+  std::vector<size_t> aStride(ndim); // stride of the index in the Fortran order
+  aStride[0] = 1;
+  for(unsigned int idim=1;idim<ndim;++idim){ aStride[idim] = aStride[idim-1]*head.shape[idim-1]; }
+  std::vector<size_t> aIndex(ndim, 0);
+  size_t iin = 0;
+  for(size_t iout=0;iout<nval;++iout){
+    aData[iout] = aTmp[iin];
+    for(int idim=static_cast<int>(ndim)-1;idim>=0;--idim){
+      aIndex[idim] += 1;
+      iin += aStride[idim];
+      if( aIndex[idim] < head.shape[idim] ){ break; }
+      iin -= aIndex[idim]*aStride[idim];
+      aIndex[idim] = 0;
+    }
+  }
+  return true;
+}
+#ifndef DFM2_HEADER_ONLY
+template bool delfem2::GetNumpyArray(std::vector<float>&, const CNumpyHeader&, const char*);
+template bool delfem2::GetNumpyArray(std::vector<double>&, const CNumpyHeader&, const char*);
+template bool delfem2::GetNumpyArray(std::vector<int>&, const CNumpyHeader&, const char*);
+template bool delfem2::GetNumpyArray(std::vector<unsigned int>&, const CNumpyHeader&, const char*);
+template bool delfem2::GetNumpyArray(std::vector<unsigned char>&, const CNumpyHeader&, const char*);
+template bool delfem2::GetNumpyArray(std::vector<std::complex<double>>&, const CNumpyHeader&, const char*);
+#endif
+
+template <typename T>
+bool delfem2::LoadNumpy(
+    std::vector<size_t>& aShape,
+    std::vector<T>& aData,
+    const std::string& path)
+{
+  CMappedFile file;
+  if( !file.Open(path) ){ return false; }
+  CNumpyHeader head;
+  if( !ParseNumpyHeader(head, file.data(), file.size()) ){ return false; }
+  if( head.nbyte_header + head.NumValues()*head.nbyte_value > file.size() ){ return false; }
+  aShape = head.shape;
+  return GetNumpyArray(aData, head, file.data()+head.nbyte_header);
+}
+#ifndef DFM2_HEADER_ONLY
+template bool delfem2::LoadNumpy(std::vector<size_t>&, std::vector<float>&, const std::string&);
+template bool delfem2::LoadNumpy(std::vector<size_t>&, std::vector<double>&, const std::string&);
+template bool delfem2::LoadNumpy(std::vector<size_t>&, std::vector<int>&, const std::string&);
+template bool delfem2::LoadNumpy(std::vector<size_t>&, std::vector<unsigned int>&, const std::string&);
+template bool delfem2::LoadNumpy(std::vector<size_t>&, std::vector<unsigned char>&, const std::string&);
+template bool delfem2::LoadNumpy(std::vector<size_t>&, std::vector<std::complex<double>>&, const std::string&);
+#endif
+
+template <typename T>
+bool delfem2::SaveNumpy(
+    const std::string& path,
+    const std::vector<size_t>& aShape,
+    const T* aData)
+{
+  CNumpyHeader head;
+  head.SetType<T>();
+  head.shape = aShape;
+  std::ofstream fout(path, std::ios::binary);
+  if( fout.fail() ){ return false; }
+  const std::string str_head = MakeNumpyHeader(head);
+  fout.write(str_head.data(), static_cast<std::streamsize>(str_head.size()));
+  fout.write(reinterpret_cast<const char*>(aData), static_cast<std::streamsize>(head.NumValues()*sizeof(T)));
+  return !fout.fail();
+}
+#ifndef DFM2_HEADER_ONLY
+template bool delfem2::SaveNumpy(const std::string&, const std::vector<size_t>&, const float*);
+template bool delfem2::SaveNumpy(const std::string&, const std::vector<size_t>&, const double*);
+template bool delfem2::SaveNumpy(const std::string&, const std::vector<size_t>&, const int*);
+template bool delfem2::SaveNumpy(const std::string&, const std::vector<size_t>&, const unsigned int*);
+template bool delfem2::SaveNumpy(const std::string&, const std::vector<size_t>&, const unsigned char*);
+template bool delfem2::SaveNumpy(const std::string&, const std::vector<size_t>&, const std::complex<double>*);
+#endif
+
+// ------------------------------------------
 
-  std::ifstream fin(path,std::ios::in | std::ios::binary);
-  if( fin.fail() ) { return false; }
-  
-  funcs::NPY npy;
-//  size_t n0 = fread(&npy, sizeof(npy), 1, fp);
-//  if( n0 != 1 ){ return false; }
-  fin.read((char*)&npy,sizeof(npy));
+DFM2_INLINE bool delfem2::CNumpyMappedArray::Open(
+    const std::string& path)
+{
+  if( !file.Open(path) ){ return false; }
+  if( !ParseNumpyHeader(head, file.data(), file.size()) ){ return false; }
+  return head.nbyte_header + head.NumValues()*head.nbyte_value <= file.size();
+}
+
+// ------------------------------------------
+
+DFM2_INLINE bool delfem2::CNumpyRowReader::Open(
+    const std::string& path)
+{
+  irow = 0;
+  fin.close();
+  fin.open(path, std::ios::in | std::ios::binary);
   if( fin.fail() ){ return false; }
-  
-  { // check magic string
-    unsigned char sMagic[7] = {0x93,'N','U','M','P','Y'};
-    if( memcmp(npy.magic_string, sMagic, 6 ) != 0 ){ return false; }
-  }
-  
-  //    std::cout << npy.major_version << std::endl;
-  //    std::cout << npy.minor_version << std::endl;
-  //    std::cout << npy.header_len << std::endl;
-  
-  ndim0 = 0;
-  { // format
-    char buff[256];
-//    size_t n1 = fread(buff, 1, npy.header_len, fp);
-//    if( n1 != npy.header_len ){ return false; }
-    fin.read(buff,npy.header_len);
-    if(fin.fail()){ return false; }
-    //    std::cout << buff << "###" << strlen(buff) << std::endl;
-    std::map<std::string, std::string> map0 = ReadDictionary_Python(std::string(buff));
-    //    for(std::map<std::string, std::string>::iterator itr=map0.begin();itr!=map0.end();++itr){
-    //      std::cout << itr->first << " --> " << itr->second << std::endl;
-    //    }
-    std::string str_shape = map0["'shape'"];
-    str_shape = Get_Parentheses(str_shape,"()");
-    std::vector<std::string> aToken = Split(str_shape,',');
-    if( aToken.size() != 1 ){ return false; }
-    ndim0 = myStoi(aToken[0]);
-  }
-  //    std::cout << ndim0 << " " << ndim1 << std::endl;
-  
-  //////
-  unsigned int size = ndim0;
-  aData.resize(size);
-  //  double* aRes = (double*)malloc( sizeof(double)*size );
-//  size_t n2 = fread(&aData[0], sizeof(float), size, fp);
-//  return n2 == size;
-  fin.read( (char*)&aData[0], sizeof(float)*size );
+  std::vector<char> aHead(10);
+  fin.read(aHead.data(), 10);
+  if( fin.fail() ){ return false; }
+  size_t nbyte_prefix = 10; // the size of the length of the dictionary depends on the version
+  if( aHead[6] != 1 ){
+    aHead.resize(12);
+    fin.read(aHead.data()+10, 2);
+    if( fin.fail() ){ return false; }
+    nbyte_prefix = 12;
+  }
+  const size_t nbyte_dict = (nbyte_prefix == 10) ?
+      filenpy::ReadLE<std::uint16_t>(aHead.data()+8) :
+      filenpy::ReadLE<std::uint32_t>(aHead.data()+8);
+  aHead.resize(nbyte_prefix+nbyte_dict);
+  fin.read(aHead.data()+nbyte_prefix, static_cast<std::streamsize>(nbyte_dict));
+  if( fin.fail() ){ return false; }
+  if( !ParseNumpyHeader(head, aHead.data(), aHead.size()) ){ return false; }
+  if( head.fortran_order && head.shape.size() > 1 ){ return false; }
+  fin.seekg(static_cast<std::streamoff>(head.nbyte_header));
   return !fin.fail();
 }
+
+template <typename T>
+size_t delfem2::CNumpyRowReader::ReadRows(
+    std::vector<T>& aVal,
+    size_t nrow_max)
+{
+  const size_t nrow = std::min(nrow_max, this->NumRowsRemaining());
+  if( nrow == 0 ){ aVal.clear(); return 0; }
+  const size_t nval = nrow*head.NumValuesPerRow();
+  aBuff.resize(nval*head.nbyte_value);
+  fin.read(aBuff.data(), static_cast<std::streamsize>(aBuff.size()));
+  if( fin.fail() ){ aVal.clear(); return 0; }
+  aVal.resize(nval);
+  if( !filenpy::ConvertNumpyValues(aVal.data(), aBuff.data(), nval, head) ){ aVal.clear(); return 0; }
+  irow += nrow;
+  return nrow;
+}
+#ifndef DFM2_HEADER_ONLY
+template size_t delfem2::CNumpyRowReader::ReadRows(std::vector<float>&, size_t);
+template size_t delfem2::CNumpyRowReader::ReadRows(std::vector<double>&, size_t);
+template size_t delfem2::CNumpyRowReader::ReadRows(std::vector<int>&, size_t);
+template size_t delfem2::CNumpyRowReader::ReadRows(std::vector<unsigned int>&, size_t);
+template size_t delfem2::CNumpyRowReader::ReadRows(std::vector<unsigned char>&, size_t);
+template size_t delfem2::CNumpyRowReader::ReadRows(std::vector<std::complex<double>>&, size_t);
+#endif
+
+// ------------------------------------------
+
+DFM2_INLINE bool delfem2::CNumpyRowWriter::OpenHeader(
+    const std::string& path,
+    const CNumpyHeader& h)
+{
+  this->Close();
+  head = h;
+  // reserve the space so that any number of rows can be written later
+  head.shape[0] = SIZE_MAX;
+  head.nbyte_header = MakeNumpyHeader(head).size();
+  head.shape[0] = 0;
+  fout.open(path, std::ios::binary);
+  if( fout.fail() ){ return false; }
+  const std::string str_head = MakeNumpyHeader(head, head.nbyte_header);
+  fout.write(str_head.data(), static_cast<std::streamsize>(str_head.size()));
+  return !fout.fail();
+}
+
+DFM2_INLINE bool delfem2::CNumpyRowWriter::WriteBytes(
+    const char* p,
+    size_t nrow)
+{
+  if( !fout.is_open() ){ return false; }
+  fout.write(p, static_cast<std::streamsize>(nrow*head.NumValuesPerRow()*head.nbyte_value));
+  head.shape[0] += nrow;
+  return !fout.fail();
+}
+
+DFM2_INLINE bool delfem2::CNumpyRowWriter::Close()
+{
+  if( !fout.is_open() ){ return true; }
+  const std::string str_head = MakeNumpyHeader(head, head.nbyte_header);
+  assert( str_head.size() == head.nbyte_header );
+  fout.seekp(0);
+  fout.write(str_head.data(), static_cast<std::streamsize>(str_head.size()));
+  const bool res = !fout.fail();
+  fout.close();
+  return res;
+}
+
+// ------------------------------------------
+
+DFM2_INLINE bool delfem2::CNumpyZipWriter::Open(
+    const std::string& path,
+    bool is_compress_)
+{
+  this->Close();
+  aEntry.clear();
+  pos = 0;
+#ifdef USE_ZLIB
+  this->is_compress = is_compress_;
+#else
+  (void)is_compress_;
+  this->is_compress = false;
+#endif
+  fout.open(path, std::ios::binary);
+  return !fout.fail();
+}
+
+DFM2_INLINE bool delfem2::CNumpyZipWriter::AddArray(
+    const std::string& name,
+    const CNumpyHeader& h,
+    const char* p)
+{
+  namespace lcl = ::delfem2::filenpy;
+  if( !fout.is_open() ){ return false; }
+  std::string data = MakeNumpyHeader(h);
+  data.append(p, h.NumValues()*h.nbyte_value);
+  CEntry e;
+  e.name = name + ".npy";
+  e.method = 0;
+  e.crc = lcl::Crc32(data.data(), data.size());
+  if( data.size() >= 0xFFFFFFFF || pos >= 0xFFFFFFFF ){ return false; }
+  e.nbyte = static_cast<std::uint32_t>(data.size());
+  e.offset = static_cast<std::uint32_t>(pos);
+#ifdef USE_ZLIB
+  if( is_compress ){
+    std::string comp;
+    if( !lcl::Deflate(comp, data.data(), data.size()) ){ return false; }
+    data.swap(comp);
+    e.method = 8;
+  }
+#endif
+  if( data.size() >= 0xFFFFFFFF ){ return false; } // zip64 is not supported for writing
+  e.nbyte_compressed = static_cast<std::uint32_t>(data.size());
+  std::string lh;
+  lcl::AppendLE<std::uint32_t>(lh, lcl::kZipLocalHeader);
+  lcl::AppendLE<std::uint16_t>(lh, 20); // version needed to extract
+  lcl::AppendLE<std::uint16_t>(lh, 0); // flag
+  lcl::AppendLE<std::uint16_t>(lh, e.method);
+  lcl::AppendLE<std::uint16_t>(lh, 0); // time
+  lcl::AppendLE<std::uint16_t>(lh, 0x21); // date (1980/1/1)
+  lcl::AppendLE<std::uint32_t>(lh, e.crc);
+  lcl::AppendLE<std::uint32_t>(lh, e.nbyte_compressed);
+  lcl::AppendLE<std::uint32_t>(lh, e.nbyte);
+  lcl::AppendLE<std::uint16_t>(lh, static_cast<std::uint16_t>(e.name.size()));
+  lcl::AppendLE<std::uint16_t>(lh, 0); // extra field
+  lh += e.name;
+  fout.write(lh.data(), static_cast<std::streamsize>(lh.size()));
+  fout.write(data.data(), static_cast<std::streamsize>(data.size()));
+  pos += lh.size() + data.size();
+  aEntry.push_back(e);
+  return !fout.fail();
+}
+
+DFM2_INLINE bool delfem2::CNumpyZipWriter::Close()
+{
+  namespace lcl = ::delfem2::filenpy;
+  if( !fout.is_open() ){ return true; }
+  std::string cd;
+  for(const CEntry& e : aEntry){
+    lcl::AppendLE<std::uint32_t>(cd, lcl::kZipCentralHeader);
+    lcl::AppendLE<std::uint16_t>(cd, 20); // version made by
+    lcl::AppendLE<std::uint16_t>(cd, 20); // version needed to extract
+    lcl::AppendLE<std::uint16_t>(cd, 0); // flag
+    lcl::AppendLE<std::uint16_t>(cd, e.method);
+    lcl::AppendLE<std::uint16_t>(cd, 0); // time
+    lcl::AppendLE<std::uint16_t>(cd, 0x21); // date
+    lcl::AppendLE<std::uint32_t>(cd, e.crc);
+    lcl::AppendLE<std::uint32_t>(cd, e.nbyte_compressed);
+    lcl::AppendLE<std::uint32_t>(cd, e.nbyte);
+    lcl::AppendLE<std::uint16_t>(cd, static_cast<std::uint16_t>(e.name.size()));
+    lcl::AppendLE<std::uint16_t>(cd, 0); // extra field
+    lcl::AppendLE<std::uint16_t>(cd, 0); // comment
+    lcl::AppendLE<std::uint16_t>(cd, 0); // disk number
+    lcl::AppendLE<std::uint16_t>(cd, 0); // internal attribute
+    lcl::AppendLE<std::uint32_t>(cd, 0); // external attribute
+    lcl::AppendLE<std::uint32_t>(cd, e.offset);
+    cd += e.name;
+  }
+  const std::uint32_t nbyte_cd = static_cast<std::uint32_t>(cd.size());
+  lcl::AppendLE<std::uint32_t>(cd, lcl::kZipEnd);
+  lcl::AppendLE<std::uint16_t>(cd, 0); // disk number
+  lcl::AppendLE<std::uint16_t>(cd, 0); // disk with the central directory
+  lcl::AppendLE<std::uint16_t>(cd, static_cast<std::uint16_t>(aEntry.size()));
+  lcl::AppendLE<std::uint16_t>(cd, static_cast<std::uint16_t>(aEntry.size()));
+  lcl::AppendLE<std::uint32_t>(cd, nbyte_cd);
+  lcl::AppendLE<std::uint32_t>(cd, static_cast<std::uint32_t>(pos));
+  lcl::AppendLE<std::uint16_t>(cd, 0); // comment
+  fout.write(cd.data(), static_cast<std::streamsize>(cd.size()));
+  const bool res = !fout.fail();
+  fout.close();
+  return res;
+}
+
+// ------------------------------------------
+
+DFM2_INLINE bool delfem2::CNumpyZipReader::Open(
+    const std::string& path)
+{
+  namespace lcl = ::delfem2::filenpy;
+  mapEntry.clear();
+  if( !file.Open(path) ){ return false; }
+  const char* p0 = file.data();
+  const size_t nbyte_file = file.size();
+  if( nbyte_file < 22 ){ return false; }
+  // end of central directory record. search from the end because of the comment
+  size_t iend = nbyte_file - 22;
+  for(;;){
+    if( lcl::ReadLE<std::uint32_t>(p0+iend) == lcl::kZipEnd ){ break; }
+    if( iend == 0 || nbyte_file - iend > 22 + 0xFFFF ){ return false; }
+    --iend;
+  }
+  std::uint64_t nentry = lcl::ReadLE<std::uint16_t>(p0+iend+10);
+  std::uint64_t offset_cd = lcl::ReadLE<std::uint32_t>(p0+iend+16);
+  if( iend >= 20 && lcl::ReadLE<std::uint32_t>(p0+iend-20) == lcl::kZip64Locator ){ // zip64
+    const std::uint64_t iend64 = lcl::ReadLE<std::uint64_t>(p0+iend-20+8);
+    if( iend64 + 56 > nbyte_file || lcl::ReadLE<std::uint32_t>(p0+iend64) != lcl::kZip64End ){ return false; }
+    nentry = lcl::ReadLE<std::uint64_t>(p0+iend64+32);
+    offset_cd = lcl::ReadLE<std::uint64_t>(p0+iend64+48);
+  }
+  size_t ipos = offset_cd;
+  for(std::uint64_t ie=0;ie<nentry;++ie){
+    if( ipos + 46 > nbyte_file || lcl::ReadLE<std::uint32_t>(p0+ipos) != lcl::kZipCentralHeader ){ return false; }
+    const char* p = p0+ipos;
+    CEntry e;
+    e.method = lcl::ReadLE<std::uint16_t>(p+10);
+    e.nbyte_compressed = lcl::ReadLE<std::uint32_t>(p+20);
+    e.nbyte = lcl::ReadLE<std::uint32_t>(p+24);
+    const unsigned int nname = lcl::ReadLE<std::uint16_t>(p+28);
+    const unsigned int nextra = lcl::ReadLE<std::uint16_t>(p+30);
+    const unsigned int ncomment = lcl::ReadLE<std::uint16_t>(p+32);
+    std::uint64_t offset_local = lcl::ReadLE<std::uint32_t>(p+42);
+    if( ipos + 46 + nname + nextra > nbyte_file ){ return false; }
+    std::string name(p+46, nname);
+    { // zip64 extended information
+      const char* q = p+46+nname;
+      const char* qe = q+nextra;
+      while( q + 4 <= qe ){
+        const unsigned int id = lcl::ReadLE<std::uint16_t>(q);
+        const unsigned int nq = lcl::ReadLE<std::uint16_t>(q+2);
+        if( id == 0x0001 ){
+          const char* r = q+4;
+          if( e.nbyte == 0xFFFFFFFF && r+8 <= qe ){ e.nbyte = lcl::ReadLE<std::uint64_t>(r); r += 8; }
+          if( e.nbyte_compressed == 0xFFFFFFFF && r+8 <= qe ){ e.nbyte_compressed = lcl::ReadLE<std::uint64_t>(r); r += 8; }
+          if( offset_local == 0xFFFFFFFF && r+8 <= qe ){ offset_local = lcl::ReadLE<std::uint64_t>(r); }
+        }
+        q += 4+nq;
+      }
+    }
+    ipos += 46 + nname + nextra + ncomment;
+    // the length of the extra field in the local header can be different from the central directory
+    if( offset_local + 30 > nbyte_file ){ return false; }
+    const char* pl = p0+offset_local;
+    if( lcl::ReadLE<std::uint32_t>(pl) != lcl::kZipLocalHeader ){ return false; }
+    e.offset = offset_local + 30 + lcl::ReadLE<std::uint16_t>(pl+26) + lcl::ReadLE<std::uint16_t>(pl+28);
+    if( e.offset + e.nbyte_compressed > nbyte_file ){ return false; }
+    if( name.size() > 4 && name.compare(name.size()-4, 4, ".npy") == 0 ){ name.resize(name.size()-4); }
+    mapEntry[name] = e;
+  }
+  return true;
+}
+
+DFM2_INLINE std::vector<std::string> delfem2::CNumpyZipReader::Names() const
+{
+  std::vector<std::string> aName;
+  for(const auto& itr : mapEntry){ aName.push_back(itr.first); }
+  return aName;
+}
+
+template <typename T>
+bool delfem2::CNumpyZipReader::Get(
+    std::vector<size_t>& aShape,
+    std::vector<T>& aData,
+    const std::string& name) const
+{
+  auto itr = mapEntry.find(name);
+  if( itr == mapEntry.end() ){ return false; }
+  const CEntry& e = itr->second;
+  const char* p = file.data() + e.offset;
+  std::vector<char> aBuff;
+  if( e.method == 8 ){
+#ifdef USE_ZLIB
+    aBuff.resize(e.nbyte);
+    if( !filenpy::Inflate(aBuff.data(), aBuff.size(), p, e.nbyte_compressed) ){ return false; }
+    p = aBuff.data();
+#else
+    return false;
+#endif
+  }
+  else if( e.method != 0 ){ return false; }
+  CNumpyHeader head;
+  if( !ParseNumpyHeader(head, p, e.nbyte) ){ return false; }
+  if( head.nbyte_header + head.NumValues()*head.nbyte_value > e.nbyte ){ return false; }
+  aShape = head.shape;
+  return GetNumpyArray(aData, head, p+head.nbyte_header);
+}
+#ifndef DFM2_HEADER_ONLY
+template bool delfem2::CNumpyZipReader::Get(std::vector<size_t>&, std::vector<float>&, const std::string&) const;
+template bool delfem2::CNumpyZipReader::Get(std::vector<size_t>&, std::vector<double>&, const std::string&) const;
+template bool delfem2::CNumpyZipReader::Get(std::vector<size_t>&, std::vector<int>&, const std::string&) const;
+template bool delfem2::CNumpyZipReader::Get(std::vector<size_t>&, std::vector<unsigned int>&, const std::string&) const;
+template bool delfem2::CNumpyZipReader::Get(std::vector<size_t>&, std::vector<unsigned char>&, const std::string&) const;
+template bool delfem2::CNumpyZipReader::Get(std::vector<size_t>&, std::vector<std::complex<double>>&, const std::string&) const;
+#endif
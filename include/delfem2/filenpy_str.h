@@ -6,14 +6,24 @@
  */
 
 
+/**
+ * @file reader and writer of the NumPy array files (".npy" and ".npz")
+ * @details N-dimensional arrays of the boolean, integer, floating point and complex values are supported.
+ * The values are converted to the requested type when it is different from the one in the file.
+ * The ".npz" archive is written without compression unless compiled with "USE_ZLIB" defined (link zlib).
+ */
+
 #ifndef DFM2_FILENPY_STR_H
 #define DFM2_FILENPY_STR_H
 
 #include "delfem2/dfm2_inline.h"
+#include "delfem2/file.h" // CMappedFile
 #include <fstream>
 #include <map>
 #include <vector>
 #include <string>
+#include <complex>
+#include <cstdint>
 
 namespace delfem2 {
 
@@ -33,6 +43,293 @@ DFM2_INLINE bool LoadNumpy_1DimF(
     std::vector<float>& aData,
     const std::string& path);
 
+// ------------------------------------------
+// N-dimensional array
+
+/**
+ * @brief kind of the value in the numpy's type string ("descr").
+ * 'f':floating point, 'i':signed integer, 'u':unsigned integer, 'b':boolean, 'c':complex
+ */
+template <typename T> struct NumpyType;
+template <> struct NumpyType<float> { static const char kind = 'f'; };
+template <> struct NumpyType<double> { static const char kind = 'f'; };
+template <> struct NumpyType<std::int8_t> { static const char kind = 'i'; };
+template <> struct NumpyType<std::int16_t> { static const char kind = 'i'; };
+template <> struct NumpyType<std::int32_t> { static const char kind = 'i'; };
+template <> struct NumpyType<std::int64_t> { static const char kind = 'i'; };
+template <> struct NumpyType<std::uint8_t> { static const char kind = 'u'; };
+template <> struct NumpyType<std::uint16_t> { static const char kind = 'u'; };
+template <> struct NumpyType<std::uint32_t> { static const char kind = 'u'; };
+template <> struct NumpyType<std::uint64_t> { static const char kind = 'u'; };
+template <> struct NumpyType<bool> { static const char kind = 'b'; };
+template <> struct NumpyType<std::complex<float>> { static const char kind = 'c'; };
+template <> struct NumpyType<std::complex<double>> { static const char kind = 'c'; };
+
+inline bool IsBigEndian_Native(){
+  const std::uint16_t v = 1;
+  return *reinterpret_cast<const unsigned char*>(&v) == 0;
+}
+
+/**
+ * @brief header of the ".npy" file
+ */
+class CNumpyHeader {
+public:
+  template <typename T>
+  void SetType(){
+    kind = NumpyType<T>::kind;
+    nbyte_value = sizeof(T);
+    is_big_endian = IsBigEndian_Native();
+  }
+  /**
+   * @return true if the values can be used as "T" without conversion
+   */
+  template <typename T>
+  bool IsType() const {
+    if( kind != NumpyType<T>::kind || nbyte_value != sizeof(T) ){ return false; }
+    return nbyte_value == 1 || is_big_endian == IsBigEndian_Native();
+  }
+  size_t NumValues() const;
+  /**
+   * @brief number of values in the first dimension (row)
+   */
+  size_t NumValuesPerRow() const;
+public:
+  char kind = 'f';
+  unsigned int nbyte_value = 4;
+  bool is_big_endian = false;
+  bool fortran_order = false;
+  std::vector<size_t> shape;
+  size_t nbyte_header = 0; // offset of the values from the top of the file
+};
+
+/**
+ * @brief parse the header of the ".npy" file (format version 1.0, 2.0 and 3.0)
+ * @param n number of bytes available at "p"
+ * @return false if it is not a ".npy" file or the type is not supported (e.g., structured array)
+ */
+DFM2_INLINE bool ParseNumpyHeader(
+    CNumpyHeader& head,
+    const char* p,
+    size_t n);
+
+/**
+ * @brief make the header of the ".npy" file
+ * @param nbyte_min the header is padded with spaces to have at least this length
+ * @return header including the magic string. The length is multiple of 64 so that the values are aligned
+ */
+DFM2_INLINE std::string MakeNumpyHeader(
+    const CNumpyHeader& head,
+    size_t nbyte_min = 0);
+
+/**
+ * @brief convert the values to "T" and arrange them in the C (row-major) order
+ * @param pData values just after the header
+ * @details defined for "float", "double", "int", "unsigned int", "unsigned char" and "std::complex<double>"
+ * @return false if the values cannot be converted (e.g., complex to real)
+ */
+template <typename T>
+bool GetNumpyArray(
+    std::vector<T>& aData,
+    const CNumpyHeader& head,
+    const char* pData);
+
+/**
+ * @brief load N-dimensional array from the ".npy" file
+ * @param aShape shape of the array. The values are stored in the C order even if the file is in the Fortran order
+ */
+template <typename T>
+bool LoadNumpy(
+    std::vector<size_t>& aShape,
+    std::vector<T>& aData,
+    const std::string& path);
+
+/**
+ * @brief save N-dimensional array in the C order to the ".npy" file
+ */
+template <typename T>
+bool SaveNumpy(
+    const std::string& path,
+    const std::vector<size_t>& aShape,
+    const T* aData);
+
+/**
+ * @brief memory-mapped ".npy" file to access the values without copy
+ */
+class CNumpyMappedArray {
+public:
+  bool Open(const std::string& path);
+  const CNumpyHeader& Header() const { return head; }
+  /**
+   * @return pointer to the values. nullptr if the type is different from "T" (see "CNumpyHeader::IsType")
+   * @details the order of the values (C or Fortran) is not changed
+   */
+  template <typename T>
+  const T* Data() const {
+    if( !head.IsType<T>() ){ return nullptr; }
+    const char* p = file.data() + head.nbyte_header;
+    if( reinterpret_cast<std::uintptr_t>(p) % alignof(T) != 0 ){ return nullptr; }
+    return reinterpret_cast<const T*>(p);
+  }
+private:
+  CMappedFile file;
+  CNumpyHeader head;
+};
+
+/**
+ * @brief read the ".npy" file row by row (a row is the slice in the first dimension).
+ * @details arrays larger than the memory can be processed. Fortran order is not supported except for 1D
+ */
+class CNumpyRowReader {
+public:
+  bool Open(const std::string& path);
+  const CNumpyHeader& Header() const { return head; }
+  size_t NumRows() const { return head.shape.empty() ? 1 : head.shape[0]; }
+  size_t NumRowsRemaining() const { return this->NumRows() - irow; }
+  /**
+   * @brief read at most "nrow_max" rows. The values are converted to "T".
+   * @return number of rows read. 0 at the end of file or if it fails.
+   * @details defined for "float", "double", "int", "unsigned int", "unsigned char" and "std::complex<double>"
+   */
+  template <typename T>
+  size_t ReadRows(
+      std::vector<T>& aVal,
+      size_t nrow_max);
+private:
+  std::ifstream fin;
+  CNumpyHeader head;
+  size_t irow = 0;
+  std::vector<char> aBuff;
+};
+
+/**
+ * @brief write the ".npy" file row by row. The number of rows is written to the header when closed.
+ */
+class CNumpyRowWriter {
+public:
+  CNumpyRowWriter() = default;
+  CNumpyRowWriter(const CNumpyRowWriter&) = delete;
+  CNumpyRowWriter& operator=(const CNumpyRowWriter&) = delete;
+  ~CNumpyRowWriter(){ this->Close(); }
+  /**
+   * @param aShapeRow shape of a row (i.e., the shape of the array except the first dimension)
+   */
+  template <typename T>
+  bool Open(
+      const std::string& path,
+      const std::vector<size_t>& aShapeRow)
+  {
+    CNumpyHeader h;
+    h.SetType<T>();
+    h.shape.push_back(0);
+    h.shape.insert(h.shape.end(), aShapeRow.begin(), aShapeRow.end());
+    return this->OpenHeader(path, h);
+  }
+  /**
+   * @return false if "T" is different from the one given in "Open"
+   */
+  template <typename T>
+  bool WriteRows(
+      const T* p,
+      size_t nrow)
+  {
+    if( !head.IsType<T>() ){ return false; }
+    return this->WriteBytes(reinterpret_cast<const char*>(p), nrow);
+  }
+  bool Close();
+  size_t NumRows() const { return head.shape.empty() ? 0 : head.shape[0]; }
+private:
+  bool OpenHeader(const std::string& path, const CNumpyHeader& h);
+  bool WriteBytes(const char* p, size_t nrow);
+private:
+  std::ofstream fout;
+  CNumpyHeader head;
+};
+
+/**
+ * @brief write ".npz" archive (zip file of ".npy" files) that can be loaded with "numpy.load"
+ * @details the size of the archive is limited to 4GB (zip64 is not written)
+ */
+class CNumpyZipWriter {
+public:
+  CNumpyZipWriter() = default;
+  CNumpyZipWriter(const CNumpyZipWriter&) = delete;
+  CNumpyZipWriter& operator=(const CNumpyZipWriter&) = delete;
+  ~CNumpyZipWriter(){ this->Close(); }
+  /**
+   * @param is_compress compress the arrays with deflate. Ignored if compiled without "USE_ZLIB"
+   */
+  bool Open(
+      const std::string& path,
+      bool is_compress = false);
+  /**
+   * @param name name of the array. The entry is named as "<name>.npy"
+   */
+  template <typename T>
+  bool Add(
+      const std::string& name,
+      const std::vector<size_t>& aShape,
+      const T* aData)
+  {
+    CNumpyHeader h;
+    h.SetType<T>();
+    h.shape = aShape;
+    return this->AddArray(name, h, reinterpret_cast<const char*>(aData));
+  }
+  /**
+   * @brief write the directory of the archive
+   */
+  bool Close();
+private:
+  bool AddArray(const std::string& name, const CNumpyHeader& h, const char* p);
+private:
+  class CEntry {
+  public:
+    std::string name;
+    std::uint16_t method;
+    std::uint32_t crc;
+    std::uint32_t nbyte_compressed;
+    std::uint32_t nbyte;
+    std::uint32_t offset;
+  };
+  std::ofstream fout;
+  bool is_compress = false;
+  std::uint64_t pos = 0;
+  std::vector<CEntry> aEntry;
+};
+
+/**
+ * @brief read ".npz" archive. The archive is memory-mapped and only the requested array is decoded.
+ * @details the compressed arrays (numpy.savez_compressed) can be read only when compiled with "USE_ZLIB"
+ */
+class CNumpyZipReader {
+public:
+  bool Open(const std::string& path);
+  /**
+   * @brief names of the arrays without the extension ".npy"
+   */
+  std::vector<std::string> Names() const;
+  bool IsIncluded(const std::string& name) const { return mapEntry.find(name) != mapEntry.end(); }
+  /**
+   * @details defined for "float", "double", "int", "unsigned int", "unsigned char" and "std::complex<double>"
+   */
+  template <typename T>
+  bool Get(
+      std::vector<size_t>& aShape,
+      std::vector<T>& aData,
+      const std::string& name) const;
+private:
+  class CEntry {
+  public:
+    std::uint16_t method;
+    std::uint64_t nbyte_compressed;
+    std::uint64_t nbyte;
+    std::uint64_t offset; // offset of the data
+  };
+  CMappedFile file;
+  std::map<std::string, CEntry> mapEntry;
+};
+
 }
 
 #ifdef DFM2_HEADER_ONLY
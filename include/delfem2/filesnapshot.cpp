@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <complex>
+#include <fstream>
+#include "delfem2/filesnapshot.h"
+
+namespace delfem2 {
+namespace filesnapshot {
+
+constexpr char kMagic[8] = {'D','F','M','2','S','N','P','\0'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kByteOrder = 0x01020304;
+constexpr std::uint64_t kAlign = 64;
+
+/**
+ * header of the file. 64 bytes
+ */
+class CHeader {
+public:
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint64_t narray;
+  std::uint64_t offset_directory;
+  std::uint64_t nbyte_file;
+  std::uint64_t reserved[3];
+};
+
+inline std::uint64_t AlignUp(std::uint64_t n){
+  return (n + kAlign - 1)/kAlign*kAlign;
+}
+
+template <typename T>
+void AppendValue(std::vector<char>& aBuff, T v){
+  const char* p = reinterpret_cast<const char*>(&v);
+  aBuff.insert(aBuff.end(), p, p+sizeof(T));
+}
+
+}
+}
+
+// ----------------------------------
+
+DFM2_INLINE bool delfem2::CSnapshotWriter::Write(
+    const std::string& fpath) const
+{
+  namespace lcl = ::delfem2::filesnapshot;
+  static_assert( sizeof(lcl::CHeader) == 64, "header size" );
+  // directory
+  std::vector<std::uint64_t> aOffset(aEntry.size());
+  std::uint64_t offset = sizeof(lcl::CHeader);
+  for(unsigned int ie=0;ie<aEntry.size();++ie){
+    aOffset[ie] = offset;
+    offset = lcl::AlignUp(offset + aEntry[ie].nvalue*aEntry[ie].nbyte_value);
+  }
+  const std::uint64_t offset_dir = offset;
+  std::vector<char> aDir;
+  for(unsigned int ie=0;ie<aEntry.size();++ie){
+    const CEntry& e = aEntry[ie];
+    lcl::AppendValue<std::uint64_t>(aDir, e.name.size());
+    aDir.insert(aDir.end(), e.name.begin(), e.name.end());
+    aDir.resize((aDir.size()+7)/8*8, 0);
+    lcl::AppendValue<std::uint32_t>(aDir, e.itype);
+    lcl::AppendValue<std::uint32_t>(aDir, e.nbyte_value);
+    lcl::AppendValue<std::uint64_t>(aDir, e.nvalue);
+    lcl::AppendValue<std::uint64_t>(aDir, aOffset[ie]);
+  }
+  lcl::CHeader head;
+  std::memset(&head, 0, sizeof(head));
+  std::memcpy(head.magic, lcl::kMagic, 8);
+  head.version = lcl::kVersion;
+  head.byte_order = lcl::kByteOrder;
+  head.narray = aEntry.size();
+  head.offset_directory = offset_dir;
+  head.nbyte_file = offset_dir + aDir.size();
+  // write
+  std::ofstream fout(fpath.c_str(), std::ios::binary);
+  if( fout.fail() ){ return false; }
+  fout.write(reinterpret_cast<const char*>(&head), sizeof(head));
+  const char zeros[lcl::kAlign] = {0};
+  std::uint64_t pos = sizeof(head);
+  for(unsigned int ie=0;ie<aEntry.size();++ie){
+    const CEntry& e = aEntry[ie];
+    const std::uint64_t nbyte = e.nvalue*e.nbyte_value;
+    fout.write(e.ptr, static_cast<std::streamsize>(nbyte));
+    pos += nbyte;
+    const std::uint64_t pos1 = lcl::AlignUp(pos);
+    fout.write(zeros, static_cast<std::streamsize>(pos1-pos));
+    pos = pos1;
+  }
+  fout.write(aDir.data(), static_cast<std::streamsize>(aDir.size()));
+  return !fout.fail();
+}
+
+// ----------------------------------
+
+DFM2_INLINE bool delfem2::CSnapshotReader::Open(
+    const std::string& fpath)
+{
+  namespace lcl = ::delfem2::filesnapshot;
+  mapEntry.clear();
+  if( !file.Open(fpath) ){ return false; }
+  const size_t nbyte = file.size();
+  if( nbyte < sizeof(lcl::CHeader) ){ return false; }
+  lcl::CHeader head;
+  std::memcpy(&head, file.data(), sizeof(head));
+  if( std::memcmp(head.magic, lcl::kMagic, 8) != 0 ){ return false; }
+  if( head.byte_order != lcl::kByteOrder ){ return false; }
+  if( head.version > lcl::kVersion ){ return false; }
+  if( head.nbyte_file != nbyte || head.offset_directory > nbyte ){ return false; }
+  const char* p = file.data() + head.offset_directory;
+  const char* pe = file.data() + nbyte;
+  for(unsigned int ie=0;ie<head.narray;++ie){
+    std::uint64_t nname;
+    if( p+8 > pe ){ return false; }
+    std::memcpy(&nname, p, 8); p += 8;
+    const std::uint64_t nname_pad = (nname+7)/8*8;
+    if( p+nname_pad+24 > pe ){ return false; }
+    const std::string name(p, nname); p += nname_pad;
+    std::uint32_t itype, nbyte_value;
+    std::uint64_t nvalue, offset;
+    std::memcpy(&itype, p, 4); p += 4;
+    std::memcpy(&nbyte_value, p, 4); p += 4;
+    std::memcpy(&nvalue, p, 8); p += 8;
+    std::memcpy(&offset, p, 8); p += 8;
+    if( offset + nvalue*nbyte_value > head.offset_directory ){ return false; }
+    mapEntry[name] = CEntry{itype, nbyte_value, nvalue, offset};
+  }
+  return true;
+}
+
+DFM2_INLINE std::vector<std::string> delfem2::CSnapshotReader::Names() const
+{
+  std::vector<std::string> aName;
+  for(const auto& itr : mapEntry){ aName.push_back(itr.first); }
+  return aName;
+}
+
+// ----------------------------------
+
+template <typename T>
+void delfem2::AddToSnapshot(
+    CSnapshotWriter& writer,
+    const std::string& name,
+    const CMatrixSparse<T>& mat)
+{
+  // the writer only keeps the pointers, so the sizes are referenced from the matrix itself
+  writer.Add(name+".nrowblk", &mat.nrowblk, 1);
+  writer.Add(name+".ncolblk", &mat.ncolblk, 1);
+  writer.Add(name+".nrowdim", &mat.nrowdim, 1);
+  writer.Add(name+".ncoldim", &mat.ncoldim, 1);
+  writer.Add(name+".colInd", mat.colInd);
+  writer.Add(name+".rowPtr", mat.rowPtr);
+  writer.Add(name+".valCrs", mat.valCrs);
+  writer.Add(name+".valDia", mat.valDia);
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::AddToSnapshot(CSnapshotWriter&, const std::string&, const CMatrixSparse<float>&);
+template void delfem2::AddToSnapshot(CSnapshotWriter&, const std::string&, const CMatrixSparse<double>&);
+template void delfem2::AddToSnapshot(CSnapshotWriter&, const std::string&, const CMatrixSparse<std::complex<double>>&);
+#endif
+
+template <typename T>
+bool delfem2::GetFromSnapshot(
+    CMatrixSparse<T>& mat,
+    const CSnapshotReader& reader,
+    const std::string& name)
+{
+  const CArrayView<unsigned int> nrowblk = reader.View<unsigned int>(name+".nrowblk");
+  const CArrayView<unsigned int> ncolblk = reader.View<unsigned int>(name+".ncolblk");
+  const CArrayView<unsigned int> nrowdim = reader.View<unsigned int>(name+".nrowdim");
+  const CArrayView<unsigned int> ncoldim = reader.View<unsigned int>(name+".ncoldim");
+  if( nrowblk.size() != 1 || ncolblk.size() != 1 || nrowdim.size() != 1 || ncoldim.size() != 1 ){ return false; }
+  mat.nrowblk = nrowblk[0];
+  mat.ncolblk = ncolblk[0];
+  mat.nrowdim = nrowdim[0];
+  mat.ncoldim = ncoldim[0];
+  if( !reader.Get(mat.colInd, name+".colInd") ){ return false; }
+  if( !reader.Get(mat.rowPtr, name+".rowPtr") ){ return false; }
+  if( !reader.Get(mat.valCrs, name+".valCrs") ){ return false; }
+  if( !reader.Get(mat.valDia, name+".valDia") ){ return false; }
+  return mat.colInd.size() == mat.nrowblk+1;
+}
+#ifndef DFM2_HEADER_ONLY
+template bool delfem2::GetFromSnapshot(CMatrixSparse<float>&, const CSnapshotReader&, const std::string&);
+template bool delfem2::GetFromSnapshot(CMatrixSparse<double>&, const CSnapshotReader&, const std::string&);
+template bool delfem2::GetFromSnapshot(CMatrixSparse<std::complex<double>>&, const CSnapshotReader&, const std::string&);
+#endif
+
+template <typename T>
+void delfem2::AddToSnapshot(
+    CSnapshotWriter& writer,
+    const std::string& name,
+    const CPreconditionerILU<T>& ilu)
+{
+  AddToSnapshot(writer, name+".mat", ilu.mat);
+  writer.Add(name+".diaInd", ilu.m_diaInd);
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::AddToSnapshot(CSnapshotWriter&, const std::string&, const CPreconditionerILU<double>&);
+template void delfem2::AddToSnapshot(CSnapshotWriter&, const std::string&, const CPreconditionerILU<std::complex<double>>&);
+#endif
+
+template <typename T>
+bool delfem2::GetFromSnapshot(
+    CPreconditionerILU<T>& ilu,
+    const CSnapshotReader& reader,
+    const std::string& name)
+{
+  if( !GetFromSnapshot(ilu.mat, reader, name+".mat") ){ return false; }
+  if( !reader.Get(ilu.m_diaInd, name+".diaInd") ){ return false; }
+  return ilu.m_diaInd.size() == ilu.mat.nrowblk;
+}
+#ifndef DFM2_HEADER_ONLY
+template bool delfem2::GetFromSnapshot(CPreconditionerILU<double>&, const CSnapshotReader&, const std::string&);
+template bool delfem2::GetFromSnapshot(CPreconditionerILU<std::complex<double>>&, const CSnapshotReader&, const std::string&);
+#endif
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file binary container of named arrays (snapshot) to save and restore the precomputed data quickly.
+ * @details The file starts with a header, followed by the arrays aligned to 64 bytes and the directory of the arrays.
+ * The values are stored in the native byte order of the machine that wrote the file.
+ * The reader memory-maps the file and the arrays can be accessed without copy.
+ */
+
+#ifndef DFM2_FILESNAPSHOT_H
+#define DFM2_FILESNAPSHOT_H
+
+#include "delfem2/dfm2_inline.h"
+#include "delfem2/file.h" // CMappedFile
+#include "delfem2/lsmats.h"
+#include "delfem2/lsilu_mats.h"
+#include "delfem2/srchbvh.h"
+#include <vector>
+#include <string>
+#include <map>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+
+namespace delfem2 {
+
+/**
+ * @brief type id of the value stored in the snapshot. 0 is for the other plain data (e.g., CNodeBVH2)
+ */
+template <typename T> struct SnapshotType { static const unsigned int value = 0; };
+template <> struct SnapshotType<std::uint8_t> { static const unsigned int value = 1; };
+template <> struct SnapshotType<std::int32_t> { static const unsigned int value = 2; };
+template <> struct SnapshotType<std::uint32_t> { static const unsigned int value = 3; };
+template <> struct SnapshotType<std::int64_t> { static const unsigned int value = 4; };
+template <> struct SnapshotType<std::uint64_t> { static const unsigned int value = 5; };
+template <> struct SnapshotType<float> { static const unsigned int value = 6; };
+template <> struct SnapshotType<double> { static const unsigned int value = 7; };
+template <> struct SnapshotType<std::complex<float>> { static const unsigned int value = 8; };
+template <> struct SnapshotType<std::complex<double>> { static const unsigned int value = 9; };
+
+/**
+ * @brief read-only view of an array
+ */
+template <typename T>
+class CArrayView {
+public:
+  CArrayView() : p(nullptr), n(0) {}
+  CArrayView(const T* p_, size_t n_) : p(p_), n(n_) {}
+  const T* data() const { return p; }
+  size_t size() const { return n; }
+  bool empty() const { return n == 0; }
+  const T& operator[](size_t i) const { return p[i]; }
+  const T* begin() const { return p; }
+  const T* end() const { return p+n; }
+private:
+  const T* p;
+  size_t n;
+};
+
+/**
+ * @brief writer of the snapshot
+ * @details the arrays are not copied when they are added. Keep them alive until "Write" is called.
+ * The value type need to be the plain data that can be copied with "memcpy".
+ */
+class CSnapshotWriter {
+public:
+  template <typename T>
+  void Add(const std::string& name, const T* p, size_t n){
+    aEntry.push_back(CEntry{name, SnapshotType<T>::value, static_cast<unsigned int>(sizeof(T)),
+                            n, reinterpret_cast<const char*>(p)});
+  }
+  template <typename T>
+  void Add(const std::string& name, const std::vector<T>& a){
+    this->Add(name, a.data(), a.size());
+  }
+  /**
+   * @return false if the file cannot be opened
+   */
+  bool Write(const std::string& fpath) const;
+public:
+  class CEntry {
+  public:
+    std::string name;
+    unsigned int itype;
+    unsigned int nbyte_value;
+    size_t nvalue;
+    const char* ptr;
+  };
+  std::vector<CEntry> aEntry;
+};
+
+/**
+ * @brief reader of the snapshot
+ */
+class CSnapshotReader {
+public:
+  /**
+   * @return false if the file cannot be opened, it is not a snapshot, or it is written on the machine with different byte order
+   */
+  bool Open(const std::string& fpath);
+  bool IsIncluded(const std::string& name) const { return mapEntry.find(name) != mapEntry.end(); }
+  std::vector<std::string> Names() const;
+  /**
+   * @brief access the array without copy. The view is valid while this reader is alive.
+   * @return empty view if the array is not found or the type is different
+   */
+  template <typename T>
+  CArrayView<T> View(const std::string& name) const {
+    auto itr = mapEntry.find(name);
+    if( itr == mapEntry.end() ){ return CArrayView<T>(); }
+    const CEntry& e = itr->second;
+    if( e.itype != SnapshotType<T>::value || e.nbyte_value != sizeof(T) ){ return CArrayView<T>(); }
+    return CArrayView<T>(reinterpret_cast<const T*>(file.data()+e.offset), e.nvalue);
+  }
+  /**
+   * @brief copy the array
+   * @return false if the array is not found or the type is different
+   */
+  template <typename T>
+  bool Get(std::vector<T>& a, const std::string& name) const {
+    auto itr = mapEntry.find(name);
+    if( itr == mapEntry.end() ){ return false; }
+    const CEntry& e = itr->second;
+    if( e.itype != SnapshotType<T>::value || e.nbyte_value != sizeof(T) ){ return false; }
+    a.resize(e.nvalue);
+    if( e.nvalue > 0 ){ std::memcpy(static_cast<void*>(a.data()), file.data()+e.offset, e.nvalue*sizeof(T)); }
+    return true;
+  }
+private:
+  class CEntry {
+  public:
+    unsigned int itype;
+    unsigned int nbyte_value;
+    size_t nvalue;
+    size_t offset;
+  };
+  CMappedFile file;
+  std::map<std::string, CEntry> mapEntry;
+};
+
+// ------------------------------
+// helpers for the core classes
+
+/**
+ * @brief add the pattern and the values of sparse matrix. The arrays are named "<name>.colInd" etc.
+ * @details defined for "float", "double" and "std::complex<double>"
+ */
+template <typename T>
+void AddToSnapshot(
+    CSnapshotWriter& writer,
+    const std::string& name,
+    const CMatrixSparse<T>& mat);
+
+template <typename T>
+bool GetFromSnapshot(
+    CMatrixSparse<T>& mat,
+    const CSnapshotReader& reader,
+    const std::string& name);
+
+/**
+ * @brief add the factorized ILU preconditioner so that "SolvePrecond" can be called without re-factorization
+ * @details defined for "double" and "std::complex<double>"
+ */
+template <typename T>
+void AddToSnapshot(
+    CSnapshotWriter& writer,
+    const std::string& name,
+    const CPreconditionerILU<T>& ilu);
+
+template <typename T>
+bool GetFromSnapshot(
+    CPreconditionerILU<T>& ilu,
+    const CSnapshotReader& reader,
+    const std::string& name);
+
+/**
+ * @brief add the topology and the bounding volumes of BVH
+ * @tparam BV bounding volume class (e.g., CBV3_AABB, CBV3_Sphere)
+ */
+template <typename BV>
+void AddToSnapshot(
+    CSnapshotWriter& writer,
+    const std::string& name,
+    const std::vector<CNodeBVH2>& aNodeBVH,
+    const std::vector<BV>& aBB)
+{
+  writer.Add(name+".node", aNodeBVH);
+  writer.Add(name+".bb", aBB);
+}
+
+template <typename BV>
+bool GetFromSnapshot(
+    std::vector<CNodeBVH2>& aNodeBVH,
+    std::vector<BV>& aBB,
+    const CSnapshotReader& reader,
+    const std::string& name)
+{
+  if( !reader.Get(aNodeBVH, name+".node") ){ return false; }
+  if( !reader.Get(aBB, name+".bb") ){ return false; }
+  return aNodeBVH.size() == aBB.size();
+}
+
+} // end namespace delfem2
+
+#ifdef DFM2_HEADER_ONLY
+#  include "delfem2/filesnapshot.cpp"
+#endif
+
+#endif /* DFM2_FILESNAPSHOT_H */
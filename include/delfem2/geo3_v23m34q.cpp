@@ -11,6 +11,7 @@
 #include "delfem2/mat3.h"
 #include "delfem2/mat4.h"
 #include "delfem2/quat.h"
+#include "delfem2/thread/th.h"
 //
 #include "delfem2/geo3_v23m34q.h"
 
@@ -435,6 +436,62 @@ DFM2_INLINE void delfem2::UpdateRotationsByMatchingCluster_SVD(
 }
 
 
+DFM2_INLINE void delfem2::Quat_RotationalPart(
+    double q[4],
+    const double A[9],
+    unsigned int nitr)
+{
+  for(unsigned int itr=0;itr<nitr;++itr){
+    const CMat3d R = CMat3d::Quat(q);
+    double omega[3] = {0,0,0};
+    double dot = 0.0;
+    for(int i=0;i<3;++i){ // sum of cross product of i-th columns of R and A
+      const double r[3] = {R.mat[0*3+i], R.mat[1*3+i], R.mat[2*3+i]};
+      const double a[3] = {A[0*3+i], A[1*3+i], A[2*3+i]};
+      omega[0] += r[1]*a[2]-r[2]*a[1];
+      omega[1] += r[2]*a[0]-r[0]*a[2];
+      omega[2] += r[0]*a[1]-r[1]*a[0];
+      dot += r[0]*a[0]+r[1]*a[1]+r[2]*a[2];
+    }
+    const double invden = 1.0/(fabs(dot)+1.0e-9);
+    omega[0] *= invden;
+    omega[1] *= invden;
+    omega[2] *= invden;
+    const double w = sqrt(omega[0]*omega[0]+omega[1]*omega[1]+omega[2]*omega[2]);
+    if( w < 1.0e-9 ){ break; }
+    double dq[4]; Quat_CartesianAngle(dq, omega);
+    double q1[4]; QuatQuat(q1, dq, q);
+    Normalize_Quat(q1);
+    Copy_Quat(q, q1);
+  }
+}
+
+DFM2_INLINE void delfem2::UpdateRotationsByMatchingCluster_Polar(
+    std::vector<double>& aQuat1,
+    const std::vector<double>& aXYZ0,
+    const std::vector<double>& aXYZ1,
+    const std::vector<unsigned int>& psup_ind,
+    const std::vector<unsigned int>& psup,
+    unsigned int nthread)
+{
+  const unsigned int np = static_cast<unsigned int>(psup_ind.size()-1);
+  auto func = [&](unsigned int ip){
+    const double* Pi = aXYZ0.data()+ip*3;
+    const double* pi = aXYZ1.data()+ip*3;
+    double A[9] = {0,0,0, 0,0,0, 0,0,0};
+    for(unsigned int ipsup=psup_ind[ip];ipsup<psup_ind[ip+1];++ipsup){
+      const unsigned int jp = psup[ipsup];
+      const double dq[3] = {aXYZ0[jp*3+0]-Pi[0], aXYZ0[jp*3+1]-Pi[1], aXYZ0[jp*3+2]-Pi[2]};
+      const double dp[3] = {aXYZ1[jp*3+0]-pi[0], aXYZ1[jp*3+1]-pi[1], aXYZ1[jp*3+2]-pi[2]};
+      for(int i=0;i<3;++i){
+        for(int j=0;j<3;++j){ A[i*3+j] += dp[i]*dq[j]; }
+      }
+    }
+    Quat_RotationalPart(aQuat1.data()+ip*4, A, 20);
+  };
+  thread::parallel_for(np, func, nthread);
+}
+
 bool delfem2::Distortion_MappingTriangleFrom2To3Dim(
     double thresA,
     double thresE,
@@ -182,6 +182,30 @@ DFM2_INLINE void UpdateRotationsByMatchingCluster_SVD(
     const std::vector<unsigned int>& psup_ind,
     const std::vector<unsigned int>& psup);
 
+/**
+ * @brief rotational part of 3x3 matrix A (i.e., rotation R maximizing tr(R^T A)) as the quaternion
+ * @param q (in&out) initial guess of rotation as input and the result as output. The initial guess accelerates convergence
+ * @param A (in) 3x3 row-major matrix
+ * @details fast alternative to the polar decomposition with SVD. The algorithm is from
+ * M. Muller et al. "A Robust Method to Extract the Rotational Part of Deformations" MIG 2016
+ */
+DFM2_INLINE void Quat_RotationalPart(
+    double q[4],
+    const double A[9],
+    unsigned int nitr);
+
+/**
+ * @brief update rotation of the points by matching rest and deformed one-ring clusters with "Quat_RotationalPart".
+ * @details the points are processed in parallel. The current rotation is used as the initial guess.
+ */
+DFM2_INLINE void UpdateRotationsByMatchingCluster_Polar(
+    std::vector<double>& aQuat1,
+    const std::vector<double>& aXYZ0,
+    const std::vector<double>& aXYZ1,
+    const std::vector<unsigned int>& psup_ind,
+    const std::vector<unsigned int>& psup,
+    unsigned int nthread = 0);
+
 DFM2_INLINE bool Distortion_MappingTriangleFrom2To3Dim(
     double thresA,
     double thresE,
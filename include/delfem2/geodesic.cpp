@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+#include <climits>
+#include <algorithm>
+#include "delfem2/geodesic.h"
+#include "delfem2/mshuni.h"
+#include "delfem2/jagarray.h"
+
+// ----------------------------------------------
+
+DFM2_INLINE double delfem2::geodesic::Distance3(
+    const double p0[3], const double p1[3])
+{
+  return sqrt( (p1[0]-p0[0])*(p1[0]-p0[0]) + (p1[1]-p0[1])*(p1[1]-p0[1]) + (p1[2]-p0[2])*(p1[2]-p0[2]) );
+}
+
+DFM2_INLINE double delfem2::geodesic::Update_FastMarchingTri3(
+    const double p0[3], double d0,
+    const double p1[3], double d1,
+    const double p2[3])
+{
+  const double l02 = Distance3(p0,p2);
+  const double l12 = Distance3(p1,p2);
+  const double dist_edge = std::min(d0+l02, d1+l12);
+  const double e = Distance3(p0,p1);
+  if( e == 0.0 ){ return dist_edge; }
+  // unfold the triangle to 2D. p0 is the origin and p1 is on the x-axis
+  const double u[3] = { (p1[0]-p0[0])/e, (p1[1]-p0[1])/e, (p1[2]-p0[2])/e };
+  const double cx = (p2[0]-p0[0])*u[0] + (p2[1]-p0[1])*u[1] + (p2[2]-p0[2])*u[2];
+  const double cy = sqrt(std::max(l02*l02-cx*cx, 0.0));
+  // virtual source on the other side of the edge
+  const double sx = (d0*d0-d1*d1+e*e)/(2*e);
+  const double sy2 = d0*d0-sx*sx;
+  if( sy2 < 0.0 ){ return dist_edge; }
+  const double sy = -sqrt(sy2);
+  const double x = sx + (cx-sx)*(-sy)/(cy-sy); // the path crosses the x-axis here
+  if( x < 0.0 || x > e ){ return dist_edge; }
+  return std::min(dist_edge, sqrt((cx-sx)*(cx-sx)+(cy-sy)*(cy-sy)));
+}
+
+DFM2_INLINE void delfem2::FastMarching_MeshTri3D(
+    std::vector<double>& aDist,
+    //
+    const std::vector< std::pair<unsigned int, double> >& aIpDist,
+    double dist_max,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri)
+{
+  std::vector<unsigned int> elsup_ind, elsup;
+  JArray_ElSuP_MeshElem(
+      elsup_ind, elsup,
+      aTri.data(), aTri.size()/3, 3, aXYZ.size()/3);
+  std::vector<unsigned int> aOrder;
+  geodesic::CProc_Nothing proc;
+  FastMarchingPoint_MeshTri3D(
+      aDist, aOrder, proc,
+      aIpDist, dist_max, aXYZ, aTri, elsup_ind, elsup);
+}
+
+// ----------------------------------------------
+
+DFM2_INLINE void delfem2::CGeodesic_HeatMethod::Initialize(
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri_,
+    double t)
+{
+  aTri = aTri_;
+  const unsigned int np = static_cast<unsigned int>(aXYZ.size()/3);
+  const unsigned int ntri = static_cast<unsigned int>(aTri.size()/3);
+  aArea.resize(ntri);
+  aGradBasis.resize(ntri*9);
+  double len_sum = 0.0;
+  for(unsigned int it=0;it<ntri;++it){
+    const double* p[3] = {
+        aXYZ.data()+aTri[it*3+0]*3,
+        aXYZ.data()+aTri[it*3+1]*3,
+        aXYZ.data()+aTri[it*3+2]*3 };
+    const double e1[3] = { p[1][0]-p[0][0], p[1][1]-p[0][1], p[1][2]-p[0][2] };
+    const double e2[3] = { p[2][0]-p[0][0], p[2][1]-p[0][1], p[2][2]-p[0][2] };
+    double n[3] = { // twice the area times the unit normal
+        e1[1]*e2[2]-e1[2]*e2[1],
+        e1[2]*e2[0]-e1[0]*e2[2],
+        e1[0]*e2[1]-e1[1]*e2[0] };
+    const double a2 = sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+    aArea[it] = a2*0.5;
+    for(int i=0;i<3;++i){ n[i] /= a2; }
+    for(unsigned int ino=0;ino<3;++ino){
+      const double* q0 = p[(ino+1)%3];
+      const double* q1 = p[(ino+2)%3];
+      const double e[3] = { q1[0]-q0[0], q1[1]-q0[1], q1[2]-q0[2] }; // edge opposite to the point
+      double* g = aGradBasis.data()+it*9+ino*3;
+      g[0] = (n[1]*e[2]-n[2]*e[1])/a2;
+      g[1] = (n[2]*e[0]-n[0]*e[2])/a2;
+      g[2] = (n[0]*e[1]-n[1]*e[0])/a2;
+      len_sum += geodesic::Distance3(q0,q1);
+    }
+  }
+  if( t < 0.0 ){
+    const double len_ave = len_sum/(ntri*3);
+    t = len_ave*len_ave;
+  }
+  std::vector<unsigned int> psup_ind, psup;
+  JArray_PSuP_MeshElem(
+      psup_ind, psup,
+      aTri.data(), ntri, 3, np);
+  JArray_Sort(psup_ind, psup);
+  CMatrixSparse<double> mat_heat, mat_poisson;
+  for(CMatrixSparse<double>* m : {&mat_heat, &mat_poisson}){
+    m->Initialize(np, 1, true);
+    m->SetPattern(psup_ind.data(), psup_ind.size(), psup.data(), psup.size());
+    m->setZero();
+  }
+  std::vector<unsigned int> merge_buffer(np, UINT_MAX);
+  for(unsigned int it=0;it<ntri;++it){
+    const double* g = aGradBasis.data()+it*9;
+    double eL[3][3], eH[3][3];
+    for(int i=0;i<3;++i){
+      for(int j=0;j<3;++j){
+        eL[i][j] = aArea[it]*(g[i*3+0]*g[j*3+0]+g[i*3+1]*g[j*3+1]+g[i*3+2]*g[j*3+2]);
+        eH[i][j] = t*eL[i][j] + ((i==j) ? aArea[it]/3.0 : 0.0); // lumped mass
+      }
+    }
+    Mearge(mat_poisson, 3, aTri.data()+it*3, 3, aTri.data()+it*3, 1, &eL[0][0], merge_buffer);
+    Mearge(mat_heat, 3, aTri.data()+it*3, 3, aTri.data()+it*3, 1, &eH[0][0], merge_buffer);
+  }
+  {  // fix the point 0 to remove the constant mode
+    std::vector<int> aBCFlag(np, 0);
+    aBCFlag[0] = 1;
+    mat_poisson.SetFixedBC(aBCFlag.data());
+  }
+  ldlt_heat.Initialize(mat_heat);
+  ldlt_heat.Factorize(mat_heat);
+  ldlt_poisson.Initialize(mat_poisson);
+  ldlt_poisson.Factorize(mat_poisson);
+}
+
+DFM2_INLINE void delfem2::CGeodesic_HeatMethod::Compute(
+    std::vector<double>& aDist,
+    const std::vector<unsigned int>& aIpSrc) const
+{
+  const unsigned int np = ldlt_heat.n;
+  const unsigned int ntri = static_cast<unsigned int>(aTri.size()/3);
+  if( aIpSrc.empty() ){ aDist.assign(np, 0.0); return; } // no source
+  // heat flow
+  std::vector<double> u(np, 0.0);
+  for(unsigned int ip : aIpSrc){ u[ip] = 1.0; }
+  ldlt_heat.Solve(u.data());
+  // divergence of the normalized gradient
+  aDist.assign(np, 0.0);
+  for(unsigned int it=0;it<ntri;++it){
+    const unsigned int* aIp = aTri.data()+it*3;
+    const double* g = aGradBasis.data()+it*9;
+    double X[3] = {0,0,0};
+    for(int ino=0;ino<3;++ino){
+      for(int i=0;i<3;++i){ X[i] -= u[aIp[ino]]*g[ino*3+i]; }
+    }
+    const double len = sqrt(X[0]*X[0]+X[1]*X[1]+X[2]*X[2]);
+    if( len == 0.0 ){ continue; }
+    for(int ino=0;ino<3;++ino){
+      aDist[aIp[ino]] += aArea[it]*(X[0]*g[ino*3+0]+X[1]*g[ino*3+1]+X[2]*g[ino*3+2])/len;
+    }
+  }
+  // distance whose gradient is closest to the normalized gradient
+  aDist[0] = 0.0;
+  ldlt_poisson.Solve(aDist.data());
+  double dist_src = aDist[aIpSrc[0]];
+  for(unsigned int ip : aIpSrc){ dist_src = std::min(dist_src, aDist[ip]); }
+  for(double& d : aDist){ d -= dist_src; }
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file geodesic distance on triangle mesh with the fast marching method and the heat method
+ * @details use "dijkstra.h" for the distance along the edges.
+ * See "VoxelGeodesic_FastMarching" in "gridvoxel.h" for the voxel grid.
+ */
+
+#ifndef DFM2_GEODESIC_H
+#define DFM2_GEODESIC_H
+
+#include "delfem2/dfm2_inline.h"
+#include "delfem2/lsmats.h"
+#include "delfem2/lsldlt_mats.h"
+#include <vector>
+#include <queue>
+#include <climits>
+#include <cassert>
+
+namespace delfem2 {
+
+namespace geodesic {
+
+/**
+ * @brief tentative distance at "p2" from the distances at "p0" and "p1" in the triangle (p0,p1,p2)
+ * @details the triangle is unfolded with the virtual source. If the path from the virtual source
+ * does not pass through the edge (p0,p1), the distance along the edges is returned.
+ */
+DFM2_INLINE double Update_FastMarchingTri3(
+    const double p0[3], double d0,
+    const double p1[3], double d1,
+    const double p2[3]);
+
+DFM2_INLINE double Distance3(
+    const double p0[3], const double p1[3]);
+
+/**
+ * @brief do nothing when the distance of a point is fixed
+ */
+class CProc_Nothing {
+public:
+  void AddPoint(unsigned int, std::vector<unsigned int>&){}
+};
+
+template <typename DISTANCE>
+class CNode
+{
+public:
+  CNode(unsigned int ino, DISTANCE dist_)
+  : ind(ino), dist(dist_){}
+  bool operator < (const CNode& lhs) const {
+    return this->dist > lhs.dist;
+  }
+public:
+  unsigned int ind;
+  DISTANCE dist;
+};
+
+}
+
+/**
+ * @brief geodesic distance from the points with the fast marching method
+ * @details the interface is the same as "DijkstraPoint_MeshTri3D" in "dijkstra.h",
+ * so the processor (e.g., "CExpMap_DijkstraPoint") is called with "proc.AddPoint(ip,aOrder)" in the order of the distance.
+ * @param aDist (out) distance. -1 for the points not reached
+ * @param aOrder (out) the order the distance is fixed. UINT_MAX for the points not reached
+ * @param aIpDist (in) source points and their initial distances
+ * @param dist_max (in) the marching stops at this distance. negative value for no limit
+ * @param elsup_ind,elsup (in) triangles surrounding point (see "JArray_ElSuP_MeshElem")
+ */
+template <typename PROC>
+void FastMarchingPoint_MeshTri3D(
+    std::vector<double>& aDist,
+    std::vector<unsigned int>& aOrder,
+    PROC& proc,
+    //
+    const std::vector< std::pair<unsigned int, double> >& aIpDist,
+    double dist_max,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri,
+    const std::vector<unsigned int>& elsup_ind,
+    const std::vector<unsigned int>& elsup)
+{
+  const unsigned int np = static_cast<unsigned int>(aXYZ.size()/3);
+  aOrder.assign(np, UINT_MAX);
+  aDist.assign(np, -1.0);
+  std::priority_queue< geodesic::CNode<double> > que;
+  for(const auto& ipdist : aIpDist){
+    const unsigned int ip0 = ipdist.first; assert(ip0<np);
+    if( aDist[ip0] >= 0.0 && aDist[ip0] <= ipdist.second ){ continue; }
+    aDist[ip0] = ipdist.second;
+    que.push(geodesic::CNode<double>(ip0, ipdist.second));
+  }
+  auto update = [&](unsigned int ip, double dist){
+    if( aDist[ip] >= 0.0 && aDist[ip] <= dist ){ return; }
+    aDist[ip] = dist;
+    que.push(geodesic::CNode<double>(ip, dist));
+  };
+  unsigned int icnt = 0;
+  while(!que.empty()){
+    const unsigned int ip0 = que.top().ind;
+    const double dist0 = que.top().dist;
+    que.pop();
+    if( aOrder[ip0] != UINT_MAX ){ continue; } // already fixed
+    if( dist0 > aDist[ip0] ){ continue; } // updated after pushed
+    if( dist_max >= 0.0 && dist0 > dist_max ){ break; }
+    aOrder[ip0] = icnt;
+    proc.AddPoint(ip0, aOrder);
+    icnt++;
+    const double* p0 = aXYZ.data()+ip0*3;
+    for(unsigned int ielsup=elsup_ind[ip0];ielsup<elsup_ind[ip0+1];++ielsup){
+      const unsigned int it = elsup[ielsup];
+      unsigned int inoel0 = 0;
+      for(;inoel0<3;++inoel0){ if( aTri[it*3+inoel0] == ip0 ){ break; } }
+      assert( inoel0 < 3 );
+      const unsigned int ip1 = aTri[it*3+(inoel0+1)%3];
+      const unsigned int ip2 = aTri[it*3+(inoel0+2)%3];
+      const double* p1 = aXYZ.data()+ip1*3;
+      const double* p2 = aXYZ.data()+ip2*3;
+      const bool is_fix1 = aOrder[ip1] != UINT_MAX;
+      const bool is_fix2 = aOrder[ip2] != UINT_MAX;
+      if( !is_fix1 ){
+        if( is_fix2 ){ update(ip1, geodesic::Update_FastMarchingTri3(p0,dist0, p2,aDist[ip2], p1)); }
+        else{ update(ip1, dist0+geodesic::Distance3(p0,p1)); }
+      }
+      if( !is_fix2 ){
+        if( is_fix1 ){ update(ip2, geodesic::Update_FastMarchingTri3(p0,dist0, p1,aDist[ip1], p2)); }
+        else{ update(ip2, dist0+geodesic::Distance3(p0,p2)); }
+      }
+    }
+  }
+  for(unsigned int ip=0;ip<np;++ip){
+    if( aOrder[ip] == UINT_MAX ){ aDist[ip] = -1.0; }
+  }
+}
+
+/**
+ * @brief geodesic distance from the points with the fast marching method
+ * @param aIpDist (in) source points and their initial distances
+ * @param dist_max (in) the marching stops at this distance. negative value for no limit
+ * @param aDist (out) distance. -1 for the points not reached
+ */
+DFM2_INLINE void FastMarching_MeshTri3D(
+    std::vector<double>& aDist,
+    //
+    const std::vector< std::pair<unsigned int, double> >& aIpDist,
+    double dist_max,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri);
+
+/**
+ * @brief geodesic distance with the heat method
+ * @details K. Crane, C. Weischedel and M. Wardetzky "Geodesics in Heat" ACM TOG 2013.
+ * The heat flow and the Poisson matrices are factorized once in "Initialize", and "Compute" only solves them.
+ * The mesh need to be connected.
+ */
+class CGeodesic_HeatMethod {
+public:
+  /**
+   * @param t time step of the heat flow. The square of the mean edge length is used if negative
+   */
+  void Initialize(
+      const std::vector<double>& aXYZ,
+      const std::vector<unsigned int>& aTri,
+      double t = -1.0);
+  /**
+   * @param aIpSrc source points. The distance is zero at these points. All the distances are zero if empty
+   * @details this function can be called from multiple threads at the same time
+   */
+  void Compute(
+      std::vector<double>& aDist,
+      const std::vector<unsigned int>& aIpSrc) const;
+public:
+  std::vector<unsigned int> aTri;
+  std::vector<double> aArea; // area of the triangles
+  std::vector<double> aGradBasis; // gradient of the linear basis functions (9 values per triangle)
+  CSparseLDLT<double> ldlt_heat; // factor of "M+t*L"
+  CSparseLDLT<double> ldlt_poisson; // factor of "L" where the point 0 is fixed
+};
+
+}
+
+#ifdef DFM2_HEADER_ONLY
+#  include "delfem2/geodesic.cpp"
+#endif
+
+#endif /* DFM2_GEODESIC_H */
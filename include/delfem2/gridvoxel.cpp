@@ -6,8 +6,14 @@
  */
 
 #include <queue>
+#include <cmath>
+#include <climits>
+#include <cassert>
+#include <algorithm>
 #include "delfem2/vec3.h"
 #include "delfem2/gridvoxel.h"
+#include "delfem2/geoproximity3_v3.h"
+#include "delfem2/thread/th.h"
 
 namespace dfm2 = delfem2;
 
@@ -424,6 +430,95 @@ void delfem2::VoxelGeodesic
 namespace delfem2 {
 namespace gridvoxel {
 
+/**
+ * solve the upwind discretization of |grad d|=1 with the smallest neighbor distances along the axes
+ * @param a distance of the neighbor along x,y,z. negative if no neighbor is fixed
+ */
+DFM2_INLINE double Update_FastMarchingVoxel(
+    const double a[3],
+    double h)
+{
+  double b[3];
+  unsigned int n = 0;
+  for(int i=0;i<3;++i){ if( a[i] >= 0.0 ){ b[n] = a[i]; n++; } }
+  assert( n > 0 );
+  std::sort(b, b+n);
+  double d = b[0]+h;
+  if( n == 1 || d <= b[1] ){ return d; }
+  d = 0.5*(b[0]+b[1]+sqrt(2*h*h-(b[0]-b[1])*(b[0]-b[1])));
+  if( n == 2 || d <= b[2] ){ return d; }
+  const double s1 = b[0]+b[1]+b[2];
+  const double s2 = b[0]*b[0]+b[1]*b[1]+b[2]*b[2];
+  return (s1+sqrt(std::max(s1*s1-3*(s2-h*h), 0.0)))/3.0;
+}
+
+}
+}
+
+DFM2_INLINE void delfem2::VoxelGeodesic_FastMarching(
+    std::vector<double>& aDist,
+    const std::vector< std::pair<unsigned int, double> >& aIdvoxDist,
+    double el,
+    const CGrid3<int>& grid,
+    double dist_max)
+{
+  const int nx = (int)grid.ndivx;
+  const int ny = (int)grid.ndivy;
+  const int nz = (int)grid.ndivz;
+  const int aNDiv[3] = {nx, ny, nz};
+  const int aStride[3] = {1, nx, nx*ny};
+  aDist.assign(grid.aVal.size(),-1.0);
+  std::vector<unsigned char> aIsFix(grid.aVal.size(), 0);
+  using distIdvox = std::pair<double,unsigned int>;
+  std::priority_queue<distIdvox, std::vector<distIdvox>, std::greater<distIdvox>> aNext;
+  for(const auto& idvox_dist: aIdvoxDist){
+    const unsigned int ivox0 = idvox_dist.first;
+    if( aDist[ivox0] >= 0 && aDist[ivox0] <= idvox_dist.second ){ continue; }
+    aDist[ivox0] = idvox_dist.second;
+    aNext.push( std::make_pair(idvox_dist.second,ivox0) );
+  }
+  while(!aNext.empty()){
+    const unsigned int ivox1 = aNext.top().second;
+    const double dist1 = aNext.top().first;
+    aNext.pop();
+    if( aIsFix[ivox1] ){ continue; }
+    if( dist1 > aDist[ivox1] ){ continue; } // updated after pushed
+    if( dist_max >= 0 && dist1 > dist_max ){ break; }
+    aIsFix[ivox1] = 1;
+    const int aI1[3] = { (int)ivox1%nx, ((int)ivox1/nx)%ny, (int)ivox1/(nx*ny) };
+    for(int ifc=0;ifc<6;++ifc){
+      const int idim = ifc/2;
+      const int i2 = aI1[idim] + ((ifc%2==0) ? -1 : +1);
+      if( i2 < 0 || i2 >= aNDiv[idim] ){ continue; }
+      const unsigned int ivox2 = ivox1 + ((ifc%2==0) ? -aStride[idim] : +aStride[idim]);
+      if( grid.aVal[ivox2] == 0 || aIsFix[ivox2] ){ continue; }
+      // smallest fixed distance of the neighbors along each axis
+      const int aI2[3] = { (int)ivox2%nx, ((int)ivox2/nx)%ny, (int)ivox2/(nx*ny) };
+      double a[3] = {-1,-1,-1};
+      for(int jdim=0;jdim<3;++jdim){
+        for(int isgn=-1;isgn<=1;isgn+=2){
+          const int i3 = aI2[jdim]+isgn;
+          if( i3 < 0 || i3 >= aNDiv[jdim] ){ continue; }
+          const unsigned int ivox3 = ivox2 + isgn*aStride[jdim];
+          if( !aIsFix[ivox3] ){ continue; }
+          if( a[jdim] < 0 || aDist[ivox3] < a[jdim] ){ a[jdim] = aDist[ivox3]; }
+        }
+      }
+      const double dist2 = gridvoxel::Update_FastMarchingVoxel(a,el);
+      if( aDist[ivox2] < 0 || aDist[ivox2] > dist2 ){
+        aDist[ivox2] = dist2;
+        aNext.push( std::make_pair(dist2,ivox2) );
+      }
+    }
+  }
+  for(unsigned int ivox=0;ivox<aIsFix.size();++ivox){
+    if( !aIsFix[ivox] ){ aDist[ivox] = -1.0; }
+  }
+}
+
+namespace delfem2 {
+namespace gridvoxel {
+
 int signum(double x) {
   return x > 0.0 ? 1 : x < 0.0 ? -1 : 0;
 }
@@ -508,3 +603,500 @@ void delfem2::Intersection_VoxelGrid_LinSeg
   }
    */
 }
+
+// ----------------------------------------
+// voxelization of triangle mesh
+
+namespace delfem2 {
+namespace gridvoxel {
+
+DFM2_INLINE void XYZ_GridCoordinate(
+    std::vector<double>& aXYZg,
+    const std::vector<double>& aXYZ,
+    const CMat4d& am)
+{
+  const CMat4d ami = am.Inverse();
+  aXYZg.resize(aXYZ.size());
+  for(unsigned int ip=0;ip<aXYZ.size()/3;++ip){
+    Vec3_Mat4Vec3_Affine(aXYZg.data()+ip*3, ami.mat, aXYZ.data()+ip*3);
+  }
+}
+
+/**
+ * @brief jagged array of the triangles overlapping the slab [iz-margin,iz+1+margin]
+ */
+DFM2_INLINE void SlabTriangle(
+    std::vector<unsigned int>& aSlabInd,
+    std::vector<unsigned int>& aSlabTri,
+    const std::vector<double>& aXYZg,
+    const std::vector<unsigned int>& aTri,
+    unsigned int nz,
+    double margin)
+{
+  const unsigned int ntri = static_cast<unsigned int>(aTri.size()/3);
+  std::vector<int> aRange(ntri*2);
+  for(unsigned int itri=0;itri<ntri;++itri){
+    const double z0 = aXYZg[aTri[itri*3+0]*3+2];
+    const double z1 = aXYZg[aTri[itri*3+1]*3+2];
+    const double z2 = aXYZg[aTri[itri*3+2]*3+2];
+    const double zmin = std::min(z0, std::min(z1, z2))-margin;
+    const double zmax = std::max(z0, std::max(z1, z2))+margin;
+    aRange[itri*2+0] = static_cast<int>(std::max(0.0, floor(zmin)));
+    aRange[itri*2+1] = static_cast<int>(std::min(double(nz)-1, floor(zmax)));
+  }
+  aSlabInd.assign(nz+1, 0);
+  for(unsigned int itri=0;itri<ntri;++itri){
+    for(int iz=aRange[itri*2+0];iz<=aRange[itri*2+1];++iz){ aSlabInd[iz+1] += 1; }
+  }
+  for(unsigned int iz=0;iz<nz;++iz){ aSlabInd[iz+1] += aSlabInd[iz]; }
+  aSlabTri.resize(aSlabInd[nz]);
+  for(unsigned int itri=0;itri<ntri;++itri){
+    for(int iz=aRange[itri*2+0];iz<=aRange[itri*2+1];++iz){ aSlabTri[aSlabInd[iz]++] = itri; }
+  }
+  for(unsigned int iz=nz;iz>0;--iz){ aSlabInd[iz] = aSlabInd[iz-1]; }
+  aSlabInd[0] = 0;
+}
+
+/**
+ * @brief separating axis test of the triangle and the cube [-h,h]^3
+ * @param v vertices of the triangle relative to the center of the cube
+ */
+DFM2_INLINE bool IsIntersect_TriCube(
+    const double v[3][3],
+    double h)
+{
+  for(int i=0;i<3;++i){ // axes of the cube
+    const double vmin = std::min(v[0][i], std::min(v[1][i], v[2][i]));
+    const double vmax = std::max(v[0][i], std::max(v[1][i], v[2][i]));
+    if( vmin > h || vmax < -h ){ return false; }
+  }
+  double e[3][3]; // edges
+  for(int i=0;i<3;++i){
+    for(int j=0;j<3;++j){ e[i][j] = v[(i+1)%3][j]-v[i][j]; }
+  }
+  { // normal of the triangle
+    const double n[3] = {
+        e[0][1]*e[1][2]-e[0][2]*e[1][1],
+        e[0][2]*e[1][0]-e[0][0]*e[1][2],
+        e[0][0]*e[1][1]-e[0][1]*e[1][0] };
+    const double d = n[0]*v[0][0]+n[1]*v[0][1]+n[2]*v[0][2];
+    if( fabs(d) > h*(fabs(n[0])+fabs(n[1])+fabs(n[2])) ){ return false; }
+  }
+  for(int i=0;i<3;++i){ // cross products of the axes of the cube and the edges
+    for(int j=0;j<3;++j){
+      double a[3] = {0,0,0};
+      a[(i+1)%3] = -e[j][(i+2)%3];
+      a[(i+2)%3] = +e[j][(i+1)%3];
+      const double p0 = a[0]*v[0][0]+a[1]*v[0][1]+a[2]*v[0][2];
+      const double p1 = a[0]*v[1][0]+a[1]*v[1][1]+a[2]*v[1][2];
+      const double p2 = a[0]*v[2][0]+a[1]*v[2][1]+a[2]*v[2][2];
+      const double r = h*(fabs(a[0])+fabs(a[1])+fabs(a[2]));
+      if( std::min(p0, std::min(p1, p2)) > r || std::max(p0, std::max(p1, p2)) < -r ){ return false; }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief set 1 to the voxels of the slab "iz" whose centers are inside the closed mesh
+ * @details the intersections of the rays along the x-axis are counted.
+ * The rays are shifted by tiny offset to avoid passing through the vertices and the edges of the mesh.
+ */
+DFM2_INLINE void FillSlab_Parity(
+    int* aValSlab,
+    unsigned int iz,
+    unsigned int nx,
+    unsigned int ny,
+    const unsigned int* aSlabTri,
+    unsigned int nSlabTri,
+    const std::vector<double>& aXYZg,
+    const std::vector<unsigned int>& aTri)
+{
+  const double oy = 1.234567e-7, oz = 2.345678e-7;
+  const double z = iz+0.5+oz;
+  std::vector< std::vector<double> > aX(ny); // intersections for each ray
+  for(unsigned int jj=0;jj<nSlabTri;++jj){
+    const unsigned int itri = aSlabTri[jj];
+    const double* p0 = aXYZg.data()+aTri[itri*3+0]*3;
+    const double* p1 = aXYZg.data()+aTri[itri*3+1]*3;
+    const double* p2 = aXYZg.data()+aTri[itri*3+2]*3;
+    if( z < std::min(p0[2], std::min(p1[2], p2[2])) || z > std::max(p0[2], std::max(p1[2], p2[2])) ){ continue; }
+    const double det = (p1[1]-p0[1])*(p2[2]-p0[2])-(p2[1]-p0[1])*(p1[2]-p0[2]);
+    if( det == 0.0 ){ continue; } // parallel to the ray
+    const double ymin = std::min(p0[1], std::min(p1[1], p2[1]));
+    const double ymax = std::max(p0[1], std::max(p1[1], p2[1]));
+    const int iy0 = std::max(0, static_cast<int>(ceil(ymin-0.5-oy)));
+    const int iy1 = std::min(static_cast<int>(ny)-1, static_cast<int>(floor(ymax-0.5-oy)));
+    for(int iy=iy0;iy<=iy1;++iy){
+      const double y = iy+0.5+oy;
+      const double r1 = ((y-p0[1])*(p2[2]-p0[2])-(p2[1]-p0[1])*(z-p0[2]))/det;
+      const double r2 = ((p1[1]-p0[1])*(z-p0[2])-(y-p0[1])*(p1[2]-p0[2]))/det;
+      if( r1 < 0 || r2 < 0 || r1+r2 > 1 ){ continue; }
+      aX[iy].push_back((1-r1-r2)*p0[0]+r1*p1[0]+r2*p2[0]);
+    }
+  }
+  for(unsigned int iy=0;iy<ny;++iy){
+    std::vector<double>& ax = aX[iy];
+    std::sort(ax.begin(), ax.end());
+    for(unsigned int i=0;i+1<ax.size();i+=2){
+      const int ix0 = std::max(0, static_cast<int>(ceil(ax[i]-0.5)));
+      const int ix1 = std::min(static_cast<int>(nx)-1, static_cast<int>(floor(ax[i+1]-0.5)));
+      for(int ix=ix0;ix<=ix1;++ix){ aValSlab[iy*nx+ix] = 1; }
+    }
+  }
+}
+
+/**
+ * @brief unsigned distance from the centers of the voxels in the slab "iz" to the triangles within the band
+ * @param aValSlab (in&out) the distance is updated if it is smaller than the current value
+ * @param aTriSlab (out) index of the nearest triangle. Not set if nullptr
+ * @param margin width of the band in the grid coordinate
+ */
+template <typename VAL>
+DFM2_INLINE void NarrowBand_Slab(
+    VAL* aValSlab,
+    unsigned int* aTriSlab,
+    unsigned int iz,
+    unsigned int nx,
+    unsigned int ny,
+    const unsigned int* aSlabTri,
+    unsigned int nSlabTri,
+    const double margin[3],
+    const std::vector<double>& aXYZg,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri,
+    const CMat4d& am)
+{
+  for(unsigned int jj=0;jj<nSlabTri;++jj){
+    const unsigned int itri = aSlabTri[jj];
+    const double* p[3] = {
+        aXYZg.data()+aTri[itri*3+0]*3,
+        aXYZg.data()+aTri[itri*3+1]*3,
+        aXYZg.data()+aTri[itri*3+2]*3 };
+    const double* q[3] = {
+        aXYZ.data()+aTri[itri*3+0]*3,
+        aXYZ.data()+aTri[itri*3+1]*3,
+        aXYZ.data()+aTri[itri*3+2]*3 };
+    int ir[2][2]; // range of the voxel centers in x and y
+    for(int i=0;i<2;++i){
+      const double vmin = std::min(p[0][i], std::min(p[1][i], p[2][i]))-margin[i];
+      const double vmax = std::max(p[0][i], std::max(p[1][i], p[2][i]))+margin[i];
+      const int n = static_cast<int>(i==0 ? nx : ny);
+      ir[i][0] = static_cast<int>(std::max(0.0, ceil(vmin-0.5)));
+      ir[i][1] = static_cast<int>(std::min(double(n)-1, floor(vmax-0.5)));
+    }
+    for(int iy=ir[1][0];iy<=ir[1][1];++iy){
+      for(int ix=ir[0][0];ix<=ir[0][1];++ix){
+        const double c[3] = {ix+0.5, iy+0.5, iz+0.5};
+        double pc[3]; Vec3_Mat4Vec3_Affine(pc, am.mat, c); // world coordinate
+        double pn[3], r0, r1;
+        GetNearest_TrianglePoint3D(pn, r0, r1, pc, q[0], q[1], q[2]);
+        const double d = sqrt((pn[0]-pc[0])*(pn[0]-pc[0])+(pn[1]-pc[1])*(pn[1]-pc[1])+(pn[2]-pc[2])*(pn[2]-pc[2]));
+        if( d >= aValSlab[iy*nx+ix] ){ continue; }
+        aValSlab[iy*nx+ix] = static_cast<VAL>(d);
+        if( aTriSlab ){ aTriSlab[iy*nx+ix] = itri; }
+      }
+    }
+  }
+}
+
+/**
+ * @brief width of the band in the grid coordinate for each axis
+ */
+DFM2_INLINE void Margin_GridCoordinate(
+    double margin[3],
+    double band,
+    const CMat4d& am)
+{
+  const CMat4d ami = am.Inverse();
+  for(int i=0;i<3;++i){
+    const double* r = ami.mat+i*4;
+    margin[i] = band*sqrt(r[0]*r[0]+r[1]*r[1]+r[2]*r[2]);
+  }
+}
+
+}
+}
+
+DFM2_INLINE void delfem2::Voxelize_MeshTri3(
+    CGrid3<int>& grid,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri,
+    bool is_solid,
+    unsigned int nthread)
+{
+  namespace lcl = ::delfem2::gridvoxel;
+  const unsigned int nx = grid.ndivx;
+  const unsigned int ny = grid.ndivy;
+  const unsigned int nz = grid.ndivz;
+  grid.aVal.assign(nx*ny*nz, 0);
+  std::vector<double> aXYZg;
+  lcl::XYZ_GridCoordinate(aXYZg, aXYZ, grid.am);
+  const double h = 0.5+1.0e-5; // slightly larger than the voxel to be conservative
+  std::vector<unsigned int> aSlabInd, aSlabTri;
+  lcl::SlabTriangle(aSlabInd, aSlabTri, aXYZg, aTri, nz, h-0.5);
+  thread::parallel_for(
+      nz,
+      [&](unsigned int iz){
+        int* aValSlab = grid.aVal.data()+iz*ny*nx;
+        for(unsigned int jj=aSlabInd[iz];jj<aSlabInd[iz+1];++jj){
+          const unsigned int itri = aSlabTri[jj];
+          const double* p[3] = {
+              aXYZg.data()+aTri[itri*3+0]*3,
+              aXYZg.data()+aTri[itri*3+1]*3,
+              aXYZg.data()+aTri[itri*3+2]*3 };
+          int ir[2][2]; // range of the voxels in x and y
+          for(int i=0;i<2;++i){
+            const double vmin = std::min(p[0][i], std::min(p[1][i], p[2][i]));
+            const double vmax = std::max(p[0][i], std::max(p[1][i], p[2][i]));
+            const int n = static_cast<int>(i==0 ? nx : ny);
+            ir[i][0] = static_cast<int>(std::max(0.0, floor(vmin-h+0.5)));
+            ir[i][1] = static_cast<int>(std::min(double(n)-1, floor(vmax+h-0.5)));
+          }
+          for(int iy=ir[1][0];iy<=ir[1][1];++iy){
+            for(int ix=ir[0][0];ix<=ir[0][1];++ix){
+              if( aValSlab[iy*nx+ix] != 0 ){ continue; }
+              const double c[3] = {ix+0.5, iy+0.5, iz+0.5};
+              double v[3][3];
+              for(int k=0;k<3;++k){
+                for(int i=0;i<3;++i){ v[k][i] = p[k][i]-c[i]; }
+              }
+              if( lcl::IsIntersect_TriCube(v, h) ){ aValSlab[iy*nx+ix] = 1; }
+            }
+          }
+        }
+        if( is_solid ){
+          lcl::FillSlab_Parity(
+              aValSlab, iz, nx, ny,
+              aSlabTri.data()+aSlabInd[iz], aSlabInd[iz+1]-aSlabInd[iz],
+              aXYZg, aTri);
+        }
+      },
+      nthread);
+}
+
+DFM2_INLINE void delfem2::SignedDistance_NarrowBand_MeshTri3(
+    CGrid3<double>& grid,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri,
+    double band,
+    unsigned int nthread)
+{
+  namespace lcl = ::delfem2::gridvoxel;
+  const unsigned int nx = grid.ndivx;
+  const unsigned int ny = grid.ndivy;
+  const unsigned int nz = grid.ndivz;
+  grid.aVal.assign(nx*ny*nz, band);
+  std::vector<double> aXYZg;
+  lcl::XYZ_GridCoordinate(aXYZg, aXYZ, grid.am);
+  double margin[3]; // width of the band in the grid coordinate
+  lcl::Margin_GridCoordinate(margin, band, grid.am);
+  std::vector<unsigned int> aSlabInd, aSlabTri;
+  lcl::SlabTriangle(aSlabInd, aSlabTri, aXYZg, aTri, nz, margin[2]);
+  thread::parallel_for(
+      nz,
+      [&](unsigned int iz){
+        double* aValSlab = grid.aVal.data()+iz*ny*nx;
+        lcl::NarrowBand_Slab(
+            aValSlab, nullptr, iz, nx, ny,
+            aSlabTri.data()+aSlabInd[iz], aSlabInd[iz+1]-aSlabInd[iz],
+            margin, aXYZg, aXYZ, aTri, grid.am);
+        std::vector<int> aIsIn(nx*ny, 0);
+        lcl::FillSlab_Parity(
+            aIsIn.data(), iz, nx, ny,
+            aSlabTri.data()+aSlabInd[iz], aSlabInd[iz+1]-aSlabInd[iz],
+            aXYZg, aTri);
+        for(unsigned int i=0;i<nx*ny;++i){
+          if( aIsIn[i] ){ aValSlab[i] = -aValSlab[i]; }
+        }
+      },
+      nthread);
+}
+
+DFM2_INLINE void delfem2::SignedDistanceField_MeshTri3(
+    CGrid3<float>& grid,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri,
+    double band,
+    unsigned int nthread)
+{
+  namespace lcl = ::delfem2::gridvoxel;
+  const unsigned int nx = grid.ndivx;
+  const unsigned int ny = grid.ndivy;
+  const unsigned int nz = grid.ndivz;
+  const unsigned int nvox = nx*ny*nz;
+  grid.aVal.assign(nvox, static_cast<float>(band));
+  std::vector<double> aXYZg;
+  lcl::XYZ_GridCoordinate(aXYZg, aXYZ, grid.am);
+  double margin[3];
+  lcl::Margin_GridCoordinate(margin, band, grid.am);
+  std::vector<unsigned int> aSlabInd, aSlabTri;
+  lcl::SlabTriangle(aSlabInd, aSlabTri, aXYZg, aTri, nz, margin[2]);
+  // exact distance in the band and the sign
+  std::vector<unsigned int> aTriNear(nvox, UINT_MAX); // nearest triangle of the voxels in the band
+  std::vector<int> aIsIn(nvox, 0);
+  thread::parallel_for(
+      nz,
+      [&](unsigned int iz){
+        lcl::NarrowBand_Slab(
+            grid.aVal.data()+iz*ny*nx, aTriNear.data()+iz*ny*nx, iz, nx, ny,
+            aSlabTri.data()+aSlabInd[iz], aSlabInd[iz+1]-aSlabInd[iz],
+            margin, aXYZg, aXYZ, aTri, grid.am);
+        lcl::FillSlab_Parity(
+            aIsIn.data()+iz*ny*nx, iz, nx, ny,
+            aSlabTri.data()+aSlabInd[iz], aSlabInd[iz+1]-aSlabInd[iz],
+            aXYZg, aTri);
+      },
+      nthread);
+  // the nearest points of the voxels in the band are the seeds of the jump flooding
+  std::vector<unsigned int> aSeed(nvox, UINT_MAX); // seed nearest to the voxel
+  std::vector<double> aPn; // nearest point of the seed
+  std::vector<unsigned int> aSeedTri; // nearest triangle of the seed
+  for(unsigned int ivox=0;ivox<nvox;++ivox){
+    const unsigned int itri = aTriNear[ivox];
+    if( itri == UINT_MAX ){ continue; }
+    const double c[3] = {ivox%nx+0.5, (ivox/nx)%ny+0.5, ivox/(nx*ny)+0.5};
+    double pc[3]; Vec3_Mat4Vec3_Affine(pc, grid.am.mat, c);
+    double pn[3], r0, r1;
+    GetNearest_TrianglePoint3D(pn, r0, r1, pc,
+        aXYZ.data()+aTri[itri*3+0]*3, aXYZ.data()+aTri[itri*3+1]*3, aXYZ.data()+aTri[itri*3+2]*3);
+    aSeed[ivox] = static_cast<unsigned int>(aSeedTri.size());
+    aSeedTri.push_back(itri);
+    aPn.insert(aPn.end(), pn, pn+3);
+  }
+  std::vector<unsigned int> aSeedNext(aSeed);
+  auto center = [&](double pc[3], unsigned int ix, unsigned int iy, unsigned int iz){
+    const double c[3] = {ix+0.5, iy+0.5, iz+0.5};
+    Vec3_Mat4Vec3_Affine(pc, grid.am.mat, c);
+  };
+  auto sqdist_seed = [&](const double pc[3], unsigned int iseed) -> double {
+    const double* pn = aPn.data()+iseed*3;
+    return (pn[0]-pc[0])*(pn[0]-pc[0])+(pn[1]-pc[1])*(pn[1]-pc[1])+(pn[2]-pc[2])*(pn[2]-pc[2]);
+  };
+  unsigned int kmax = 1;
+  while( kmax*2 < std::max(nx, std::max(ny, nz)) ){ kmax *= 2; }
+  std::vector<unsigned int> aStep;
+  for(unsigned int k=kmax;k>=1;k/=2){ aStep.push_back(k); }
+  aStep.push_back(1); // one more pass with the smallest step reduces the error of the jump flooding
+  for(unsigned int k : aStep){
+    thread::parallel_for(
+        nz,
+        [&](unsigned int iz){
+          for(unsigned int iy=0;iy<ny;++iy){
+            for(unsigned int ix=0;ix<nx;++ix){
+              const unsigned int ivox = iz*ny*nx+iy*nx+ix;
+              unsigned int iseed0 = aSeed[ivox];
+              if( aTriNear[ivox] != UINT_MAX ){ // the nearest point in the band is exact
+                aSeedNext[ivox] = iseed0;
+                continue;
+              }
+              // off the band, the nearest seed is approximated with the jump flooding
+              double pc[3]; center(pc, ix, iy, iz);
+              double d0 = (iseed0 == UINT_MAX) ? -1.0 : sqdist_seed(pc, iseed0);
+              for(int dz=-1;dz<=1;++dz){
+                const int jz = static_cast<int>(iz)+dz*static_cast<int>(k);
+                if( jz < 0 || jz >= static_cast<int>(nz) ){ continue; }
+                for(int dy=-1;dy<=1;++dy){
+                  const int jy = static_cast<int>(iy)+dy*static_cast<int>(k);
+                  if( jy < 0 || jy >= static_cast<int>(ny) ){ continue; }
+                  for(int dx=-1;dx<=1;++dx){
+                    const int jx = static_cast<int>(ix)+dx*static_cast<int>(k);
+                    if( jx < 0 || jx >= static_cast<int>(nx) ){ continue; }
+                    const unsigned int iseed1 = aSeed[(jz*ny+jy)*nx+jx];
+                    if( iseed1 == UINT_MAX || iseed1 == iseed0 ){ continue; }
+                    const double d1 = sqdist_seed(pc, iseed1);
+                    if( d0 >= 0.0 && (d1 > d0 || (d1 == d0 && iseed1 > iseed0)) ){ continue; }
+                    iseed0 = iseed1;
+                    d0 = d1;
+                  }
+                }
+              }
+              aSeedNext[ivox] = iseed0;
+            }
+          }
+        },
+        nthread);
+    aSeed.swap(aSeedNext);
+  }
+  // distance to the triangle of the seed is closer than the distance to the seed point
+  thread::parallel_for(
+      nz,
+      [&](unsigned int iz){
+        for(unsigned int iy=0;iy<ny;++iy){
+          for(unsigned int ix=0;ix<nx;++ix){
+            const unsigned int ivox = iz*ny*nx+iy*nx+ix;
+            const unsigned int iseed = aSeed[ivox];
+            if( aTriNear[ivox] == UINT_MAX && iseed != UINT_MAX ){
+              const unsigned int itri = aSeedTri[iseed];
+              double pc[3]; center(pc, ix, iy, iz);
+              double pn[3], r0, r1;
+              GetNearest_TrianglePoint3D(pn, r0, r1, pc,
+                  aXYZ.data()+aTri[itri*3+0]*3, aXYZ.data()+aTri[itri*3+1]*3, aXYZ.data()+aTri[itri*3+2]*3);
+              grid.aVal[ivox] = static_cast<float>(
+                  sqrt((pn[0]-pc[0])*(pn[0]-pc[0])+(pn[1]-pc[1])*(pn[1]-pc[1])+(pn[2]-pc[2])*(pn[2]-pc[2])));
+            }
+            if( aIsIn[ivox] ){ grid.aVal[ivox] = -grid.aVal[ivox]; }
+          }
+        }
+      },
+      nthread);
+}
+
+template <typename VAL>
+double delfem2::ValueGradient_Grid3(
+    double grad[3],
+    const CGrid3<VAL>& grid,
+    const double p[3])
+{
+  const unsigned int nd[3] = {grid.ndivx, grid.ndivy, grid.ndivz};
+  unsigned int i0[3];
+  double r[3];
+  for(int idim=0;idim<3;++idim){
+    assert( nd[idim] >= 2 );
+    const double q = p[idim]-0.5; // the values are at the centers of the voxels
+    const double i = std::min(std::max(floor(q), 0.0), double(nd[idim]-2));
+    i0[idim] = static_cast<unsigned int>(i);
+    r[idim] = std::min(std::max(q-i, 0.0), 1.0);
+  }
+  const size_t nx = grid.ndivx, nxy = static_cast<size_t>(grid.ndivx)*grid.ndivy;
+  const VAL* v = grid.aVal.data()+i0[2]*nxy+i0[1]*nx+i0[0];
+  const double v000 = v[0], v100 = v[1], v010 = v[nx], v110 = v[nx+1];
+  const double v001 = v[nxy], v101 = v[nxy+1], v011 = v[nxy+nx], v111 = v[nxy+nx+1];
+  const double rx = r[0], ry = r[1], rz = r[2];
+  grad[0] =
+      (1-ry)*(1-rz)*(v100-v000) + ry*(1-rz)*(v110-v010) +
+      (1-ry)*rz*(v101-v001) + ry*rz*(v111-v011);
+  grad[1] =
+      (1-rx)*(1-rz)*(v010-v000) + rx*(1-rz)*(v110-v100) +
+      (1-rx)*rz*(v011-v001) + rx*rz*(v111-v101);
+  grad[2] =
+      (1-rx)*(1-ry)*(v001-v000) + rx*(1-ry)*(v101-v100) +
+      (1-rx)*ry*(v011-v010) + rx*ry*(v111-v110);
+  return
+      (1-rz)*((1-ry)*((1-rx)*v000+rx*v100) + ry*((1-rx)*v010+rx*v110)) +
+      rz*((1-ry)*((1-rx)*v001+rx*v101) + ry*((1-rx)*v011+rx*v111));
+}
+#ifndef DFM2_HEADER_ONLY
+template double delfem2::ValueGradient_Grid3(double grad[3], const CGrid3<float>& grid, const double p[3]);
+template double delfem2::ValueGradient_Grid3(double grad[3], const CGrid3<double>& grid, const double p[3]);
+#endif
+
+template <typename VAL>
+double delfem2::SignedDistance_Grid3(
+    double grad[3],
+    const CGrid3<VAL>& grid,
+    const CMat4d& ami,
+    const double p[3])
+{
+  double pg[3]; Vec3_Mat4Vec3_Affine(pg, ami.mat, p);
+  double gg[3];
+  const double d = ValueGradient_Grid3(gg, grid, pg);
+  for(int i=0;i<3;++i){ // transpose of the linear part of "ami"
+    grad[i] = ami.mat[0*4+i]*gg[0] + ami.mat[1*4+i]*gg[1] + ami.mat[2*4+i]*gg[2];
+  }
+  return d;
+}
+#ifndef DFM2_HEADER_ONLY
+template double delfem2::SignedDistance_Grid3(double grad[3], const CGrid3<float>& grid, const CMat4d& ami, const double p[3]);
+template double delfem2::SignedDistance_Grid3(double grad[3], const CGrid3<double>& grid, const CMat4d& ami, const double p[3]);
+#endif
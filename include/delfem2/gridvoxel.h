@@ -101,6 +101,24 @@ void VoxelGeodesic
   const double el,
   const CGrid3<int>& grid);
 
+/**
+ * @brief geodesic distance on the voxels with the fast marching method
+ * @details the first-order upwind discretization of the Eikonal equation |grad d|=1 is solved.
+ * The distance is much closer to the Euclidean distance than "VoxelGeodesic" which only follows the axis.
+ * The index of the voxel is "iz*ny*nx+iy*nx+ix" as in "VoxelGeodesic".
+ * @param aDist (out) geodesic distance at the center of the voxel. -1 for the voxels not reached
+ * @param aIdvoxDist (in) source voxels and their initial distances
+ * @param el (in) edge length of the voxel
+ * @param grid (in) the voxels where aVal is zero are outside
+ * @param dist_max (in) the marching stops at this distance. negative value for no limit
+ */
+void VoxelGeodesic_FastMarching(
+    std::vector<double>& aDist,
+    const std::vector< std::pair<unsigned int, double> >& aIdvoxDist,
+    double el,
+    const CGrid3<int>& grid,
+    double dist_max = -1.0);
+
 
 /**
  * @details this is the implementation of the following paper
@@ -113,6 +131,77 @@ void Intersection_VoxelGrid_LinSeg
   const CVec3d& ps,
   const CVec3d& pe);
 
+/**
+ * @brief voxelize triangle mesh on CPU (without OpenGL)
+ * @details the size of the grid and the affine matrix "grid.am" (grid coordinate to world coordinate) need to be set beforehand.
+ * The voxel (ix,iy,iz) occupies [ix,ix+1]x[iy,iy+1]x[iz,iz+1] in the grid coordinate and
+ * its value is "grid.aVal[iz*ndivy*ndivx+iy*ndivx+ix]" as in "Grid3Voxel_Dilation".
+ * The voxels touching the triangles are found conservatively with the separating axis test.
+ * If "is_solid" is true, the voxels whose centers are inside the mesh are also filled with the parity of the
+ * intersections along the x-axis (the mesh need to be closed).
+ * The voxels are processed in parallel for each slab of the same "iz".
+ * @param aXYZ (in) coordinates of the mesh in the world coordinate
+ * @param nthread (in) number of threads. hardware concurrency is used if 0
+ */
+void Voxelize_MeshTri3(
+    CGrid3<int>& grid,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri,
+    bool is_solid = true,
+    unsigned int nthread = 0);
+
+/**
+ * @brief narrow band signed distance (negative inside) of a closed triangle mesh at the center of the voxels
+ * @details the size of the grid and "grid.am" need to be set beforehand.
+ * The distance is exact if it is smaller than "band", otherwise "-band" or "+band" is set.
+ * @param band (in) width of the band in the world coordinate
+ */
+void SignedDistance_NarrowBand_MeshTri3(
+    CGrid3<double>& grid,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri,
+    double band,
+    unsigned int nthread = 0);
+
+/**
+ * @brief bake the signed distance (negative inside) of a closed triangle mesh at the center of the voxels
+ * @details the size of the grid and "grid.am" need to be set beforehand.
+ * The distance is exact within "band" from the mesh. The nearest points of the voxels in the band are
+ * propagated to the other voxels with the jump flooding, which is parallel for each slab of the same "iz",
+ * and the distance outside the band is measured to the triangle of the propagated point.
+ * The sign is given by the parity of the intersections along the x-axis.
+ * Use "SignedDistance_Grid3" to look up the distance and its gradient.
+ * @param band (in) width of the band in the world coordinate. One or two voxels are enough
+ */
+void SignedDistanceField_MeshTri3(
+    CGrid3<float>& grid,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri,
+    double band,
+    unsigned int nthread = 0);
+
+/**
+ * @brief trilinear interpolation of the values at the centers of the voxels and its gradient
+ * @param p (in) position in the grid coordinate. The values are extrapolated constantly outside the centers
+ * @param grad (out) gradient in the grid coordinate
+ * @details defined for "float" and "double"
+ */
+template <typename VAL>
+double ValueGradient_Grid3(
+    double grad[3],
+    const CGrid3<VAL>& grid,
+    const double p[3]);
+
+/**
+ * @brief signed distance and its gradient at the position "p" in the world coordinate
+ * @param ami (in) inverse of "grid.am". Compute it once for many queries
+ */
+template <typename VAL>
+double SignedDistance_Grid3(
+    double grad[3],
+    const CGrid3<VAL>& grid,
+    const CMat4d& ami,
+    const double p[3]);
 
 /*
 void Add(int ivx, int ivy, int ivz){
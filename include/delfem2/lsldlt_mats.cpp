@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cassert>
+#include <climits>
+#include <complex>
+#include <algorithm>
+#include "delfem2/lsldlt_mats.h"
+#include "delfem2/mshreorder.h"
+
+// ----------------------------------------------
+
+template <typename T>
+void delfem2::CSparseLDLT<T>::Initialize(
+    const CMatrixSparse<T>& m)
+{
+  assert( m.nrowblk == m.ncolblk && m.nrowdim == m.ncoldim );
+  const unsigned int nblk = m.nrowblk;
+  const unsigned int len = m.nrowdim;
+  const unsigned int blksize = len*len;
+  n = nblk*len;
+  { // ordering of the blocks then expand it to the scalar dofs
+    std::vector<unsigned int> aOld2NewBlk;
+    Permutation_ReverseCuthillMcKee(aOld2NewBlk, m.colInd, m.rowPtr);
+    aOld2New.resize(n);
+    for(unsigned int iblk=0;iblk<nblk;++iblk){
+      for(unsigned int idim=0;idim<len;++idim){
+        aOld2New[iblk*len+idim] = aOld2NewBlk[iblk]*len+idim;
+      }
+    }
+  }
+  // upper triangle (i<=j) of the reordered matrix stored column by column
+  const unsigned int ndia = static_cast<unsigned int>(m.valDia.size());
+  std::vector< std::pair<unsigned int,unsigned int> > aRowSrc; // (row, source)
+  std::vector<unsigned int> aCol;
+  for(unsigned int iblk=0;iblk<nblk;++iblk){
+    for(unsigned int idim=0;idim<len;++idim){
+      const unsigned int i1 = aOld2New[iblk*len+idim];
+      if( ndia != 0 ) {
+        for (unsigned int jdim = 0; jdim < len; ++jdim) {
+          const unsigned int j1 = aOld2New[iblk*len+jdim];
+          if( i1 > j1 ){ continue; }
+          aCol.push_back(j1);
+          aRowSrc.emplace_back(i1, iblk*blksize+idim*len+jdim);
+        }
+      }
+      for(unsigned int icrs=m.colInd[iblk];icrs<m.colInd[iblk+1];++icrs){
+        const unsigned int jblk = m.rowPtr[icrs];
+        for(unsigned int jdim=0;jdim<len;++jdim){
+          const unsigned int j1 = aOld2New[jblk*len+jdim];
+          if( i1 > j1 ){ continue; }
+          aCol.push_back(j1);
+          aRowSrc.emplace_back(i1, ndia+icrs*blksize+idim*len+jdim);
+        }
+      }
+    }
+  }
+  Ap.assign(n+1,0);
+  for(unsigned int j1 : aCol){ Ap[j1+1]++; }
+  for(unsigned int i=0;i<n;++i){ Ap[i+1] += Ap[i]; }
+  Ai.resize(aCol.size());
+  aSrc.resize(aCol.size());
+  {
+    std::vector<unsigned int> aPos(Ap.begin(),Ap.end()-1);
+    for(unsigned int iv=0;iv<aCol.size();++iv){
+      const unsigned int ipos = aPos[aCol[iv]]++;
+      Ai[ipos] = aRowSrc[iv].first;
+      aSrc[ipos] = aRowSrc[iv].second;
+    }
+  }
+  // symbolic factorization: elimination tree and the column counts
+  Parent.assign(n,UINT_MAX);
+  std::vector<unsigned int> Lnz(n,0), Flag(n);
+  for(unsigned int k=0;k<n;++k){
+    Flag[k] = k;
+    for(unsigned int p=Ap[k];p<Ap[k+1];++p){
+      unsigned int i = Ai[p];
+      if( i >= k ){ continue; }
+      for(;Flag[i]!=k;i=Parent[i]){
+        if( Parent[i] == UINT_MAX ){ Parent[i] = k; }
+        Lnz[i]++;
+        Flag[i] = k;
+      }
+    }
+  }
+  Lp.assign(n+1,0);
+  for(unsigned int k=0;k<n;++k){ Lp[k+1] = Lp[k]+Lnz[k]; }
+  Li.resize(Lp[n]);
+  Lx.resize(Lp[n]);
+  D.resize(n);
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::CSparseLDLT<double>::Initialize(const CMatrixSparse<double>& m);
+template void delfem2::CSparseLDLT<std::complex<double>>::Initialize(const CMatrixSparse<std::complex<double>>& m);
+#endif
+
+// ----------------------------------------------
+
+template <typename T>
+bool delfem2::CSparseLDLT<T>::Factorize(
+    const CMatrixSparse<T>& m)
+{
+  assert( n == m.nrowblk*m.nrowdim );
+  const unsigned int ndia = static_cast<unsigned int>(m.valDia.size());
+  std::vector<T> Y(n,0);
+  std::vector<unsigned int> Lnz(n,0), Flag(n), Pattern(n);
+  for(unsigned int k=0;k<n;++k){
+    // scatter k-th column of the upper triangle and compute the non-zero pattern of k-th row of L
+    unsigned int top = n;
+    Flag[k] = k;
+    for(unsigned int p=Ap[k];p<Ap[k+1];++p){
+      unsigned int i = Ai[p];
+      const unsigned int isrc = aSrc[p];
+      Y[i] += (isrc < ndia) ? m.valDia[isrc] : m.valCrs[isrc-ndia];
+      unsigned int len = 0;
+      for(;Flag[i]!=k;i=Parent[i]){
+        Pattern[len++] = i;
+        Flag[i] = k;
+      }
+      while( len > 0 ){ Pattern[--top] = Pattern[--len]; }
+    }
+    D[k] = Y[k];
+    Y[k] = 0;
+    for(;top<n;++top){
+      const unsigned int i = Pattern[top];
+      const T yi = Y[i];
+      Y[i] = 0;
+      const unsigned int p2 = Lp[i]+Lnz[i];
+      for(unsigned int p=Lp[i];p<p2;++p){ Y[Li[p]] -= Lx[p]*yi; }
+      const T l_ki = yi/D[i];
+      D[k] -= l_ki*yi;
+      Li[p2] = k;
+      Lx[p2] = l_ki;
+      Lnz[i]++;
+    }
+    if( D[k] == T(0) ){ return false; }
+  }
+  return true;
+}
+#ifndef DFM2_HEADER_ONLY
+template bool delfem2::CSparseLDLT<double>::Factorize(const CMatrixSparse<double>& m);
+template bool delfem2::CSparseLDLT<std::complex<double>>::Factorize(const CMatrixSparse<std::complex<double>>& m);
+#endif
+
+// ----------------------------------------------
+
+template <typename T>
+void delfem2::CSparseLDLT<T>::Solve(
+    T* vec) const
+{
+  std::vector<T> tmp(n); // local buffer so that the factor can be shared among threads
+  for(unsigned int i=0;i<n;++i){ tmp[aOld2New[i]] = vec[i]; }
+  for(unsigned int j=0;j<n;++j){ // L y = b
+    const T xj = tmp[j];
+    for(unsigned int p=Lp[j];p<Lp[j+1];++p){ tmp[Li[p]] -= Lx[p]*xj; }
+  }
+  for(unsigned int j=0;j<n;++j){ tmp[j] /= D[j]; }
+  for(unsigned int j=n;j-->0;){ // L^T x = y
+    T xj = tmp[j];
+    for(unsigned int p=Lp[j];p<Lp[j+1];++p){ xj -= Lx[p]*tmp[Li[p]]; }
+    tmp[j] = xj;
+  }
+  for(unsigned int i=0;i<n;++i){ vec[i] = tmp[aOld2New[i]]; }
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::CSparseLDLT<double>::Solve(double* vec) const;
+template void delfem2::CSparseLDLT<std::complex<double>>::Solve(std::complex<double>* vec) const;
+#endif
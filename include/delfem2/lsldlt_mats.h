@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef DFM2_LSLDLT_MATS_H
+#define DFM2_LSLDLT_MATS_H
+
+#include "delfem2/lsmats.h"
+#include "delfem2/dfm2_inline.h"
+#include <vector>
+
+namespace delfem2 {
+
+/**
+ * @brief sparse direct solver with LDL^T decomposition for symmetric matrix
+ * @details The matrix is reordered with reverse Cuthill-McKee to reduce the fill-in.
+ * The symbolic factorization (Initialize) is done once for the non-zero pattern,
+ * and the numeric factorization (Factorize) is done every time the values of the matrix change.
+ * The factorization can be reused for many right hand sides. The algorithm is from
+ * T. A. Davis "Algorithm 849: A concise sparse Cholesky factorization package" ACM TOMS 2005.
+ * The block matrix is treated as a scalar matrix.
+ * @tparam T double or std::complex<double> (complex symmetric, not Hermitian)
+ */
+template <typename T>
+class CSparseLDLT
+{
+public:
+  CSparseLDLT() noexcept : n(0) {}
+  void Clear(){
+    n = 0;
+    aOld2New.clear();
+    Ap.clear(); Ai.clear(); aSrc.clear();
+    Lp.clear(); Li.clear(); Lx.clear(); D.clear(); Parent.clear();
+  }
+  /**
+   * @brief ordering and symbolic factorization from the non-zero pattern of a square matrix
+   */
+  void Initialize(const CMatrixSparse<T>& m);
+  /**
+   * @brief numeric factorization.
+   * @return false if the zero pivot is found (e.g., the matrix is singular)
+   */
+  bool Factorize(const CMatrixSparse<T>& m);
+  /**
+   * @brief solve the linear system in place. The vec is the right hand side as input and the solution as output
+   * @details this function can be called from multiple threads at the same time
+   */
+  void Solve(T* vec) const;
+  /**
+   * @brief same as "Solve". The function name is for the preconditioner interface of the Krylov solvers.
+   */
+  void SolvePrecond(T* vec) const { this->Solve(vec); }
+  /**
+   * @brief number of non-zero entries in the factor L
+   */
+  size_t NumNonzeroFactor() const { return Li.size(); }
+public:
+  unsigned int n; // size of the scalar matrix
+  std::vector<unsigned int> aOld2New; // permutation of the scalar dofs
+  // upper triangle of the reordered matrix in compressed column
+  std::vector<unsigned int> Ap, Ai;
+  std::vector<unsigned int> aSrc; // source of the value. valDia if aSrc[i]<ndia else valCrs
+  // factor
+  std::vector<unsigned int> Lp, Li, Parent;
+  std::vector<T> Lx, D;
+};
+
+} // end namespace delfem2
+
+#ifdef DFM2_HEADER_ONLY
+#  include "delfem2/lsldlt_mats.cpp"
+#endif
+
+#endif /* DFM2_LSLDLT_MATS_H */
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file matrix-free linear operators for the iterative solvers
+ * @details The iterative solvers ("Solve_CG", "Solve_PCG" in "lsitrsol.h" and "Solve_BiCGStab" in "vecxitrsol.h")
+ * only require a class with the member function
+ *
+ *     void MatVec(T* y, T alpha, const T* x, T beta) const; // {y} = alpha*[A]{x} + beta*{y}
+ *
+ * The classes in this file satisfy this requirement without assembling "CMatrixSparse".
+ * - "CMatFree_Elem" : sum of the element operators (element-by-element FEM)
+ * - "CMatFree_GridStencil" : 7-point stencil of the Laplacian on the "CGrid3"
+ * - "CMatFree_Dense" : dense matrix (e.g., BEM) without copy
+ * All of them compute "MatVec" in parallel and the result does not depend on the number of threads.
+ */
+
+#ifndef DFM2_LSMATFREE_H
+#define DFM2_LSMATFREE_H
+
+#include "delfem2/dfm2_inline.h"
+#include "delfem2/mshuni.h"
+#include "delfem2/thread/th.h"
+#include <vector>
+#include <cassert>
+#include <algorithm>
+
+namespace delfem2 {
+
+/**
+ * @brief operator given as the sum of the element operators
+ * @tparam ELEMOP functor "void operator()(T* ye, const T* xe, unsigned int ielem) const" that adds
+ * the product of the element matrix and the element vector to "ye" (nnoel*ndim values).
+ * The element matrix can be computed on the fly.
+ * @details the elements are colored such that the elements in the same color can be processed in parallel.
+ */
+template <typename T, class ELEMOP>
+class CMatFree_Elem {
+public:
+  /**
+   * @param aElem_ element connectivity. The array need to be alive while this operator is used
+   * @param ndim_ number of degrees of freedom per point
+   */
+  CMatFree_Elem(
+      const unsigned int* aElem_,
+      size_t nelem_,
+      unsigned int nnoel_,
+      size_t np_,
+      unsigned int ndim_,
+      const ELEMOP& op_,
+      unsigned int nthread_ = 0)
+      : aElem(aElem_), nelem(nelem_), nnoel(nnoel_), np(np_), ndim(ndim_), op(op_), nthread(nthread_)
+  {
+    JArray_ColorElem_MeshElem(
+        aColorInd, aOrder,
+        aElem, nelem, nnoel, np);
+  }
+  void MatVec(
+      T* y,
+      T alpha, const T* x,
+      T beta) const
+  {
+    const unsigned int ndof = static_cast<unsigned int>(np*ndim);
+    thread::parallel_for(
+        ndof,
+        [&](unsigned int idof){ y[idof] = (beta == T(0)) ? T(0) : beta*y[idof]; },
+        nthread);
+    const unsigned int nvec = nnoel*ndim;
+    for(unsigned int icolor=0;icolor+1<aColorInd.size();++icolor){
+      const unsigned int je0 = aColorInd[icolor];
+      const unsigned int nec = aColorInd[icolor+1]-je0;
+      thread::parallel_for_range(
+          nec,
+          [&](unsigned int, unsigned int jes, unsigned int jee){
+            std::vector<T> xe(nvec), ye(nvec); // buffer for each thread
+            for(unsigned int je=jes;je<jee;++je){
+              const unsigned int ielem = aOrder[je0+je];
+              const unsigned int* aIP = aElem+ielem*nnoel;
+              for(unsigned int inoel=0;inoel<nnoel;++inoel){
+                for(unsigned int idim=0;idim<ndim;++idim){ xe[inoel*ndim+idim] = x[aIP[inoel]*ndim+idim]; }
+              }
+              std::fill(ye.begin(), ye.end(), T(0));
+              op(ye.data(), xe.data(), ielem);
+              for(unsigned int inoel=0;inoel<nnoel;++inoel){
+                for(unsigned int idim=0;idim<ndim;++idim){ y[aIP[inoel]*ndim+idim] += alpha*ye[inoel*ndim+idim]; }
+              }
+            }
+          },
+          std::min(nec, thread::num_threads(nthread)));
+    }
+  }
+public:
+  const unsigned int* aElem;
+  const size_t nelem;
+  const unsigned int nnoel;
+  const size_t np;
+  const unsigned int ndim;
+  const ELEMOP op;
+  unsigned int nthread;
+  std::vector<unsigned int> aColorInd, aOrder;
+};
+
+/**
+ * @brief element operator with the element matrices stored in an array (row-major, (nnoel*ndim)^2 values per element)
+ */
+template <typename T>
+class CElemOp_Stored {
+public:
+  void operator()(T* ye, const T* xe, unsigned int ielem) const {
+    const T* emat = aEMat+ielem*nvec*nvec;
+    for(unsigned int i=0;i<nvec;++i){
+      for(unsigned int j=0;j<nvec;++j){ ye[i] += emat[i*nvec+j]*xe[j]; }
+    }
+  }
+public:
+  const T* aEMat;
+  unsigned int nvec;
+};
+
+/**
+ * @brief stencil operator of "shift*u - coeff*\nabla^2 u" on the cells of "CGrid3" with the cell size "h"
+ * @details the cells where grid.aVal is zero are outside the domain.
+ * The value outside the domain is regarded as zero (Dirichlet boundary condition) and
+ * the rows of the cells outside are the identity.
+ * The cell index is "ivz*(ndivx*ndivy)+ivy*ndivx+ivx" (x is the fastest) as in the voxel functions in "gridvoxel.h"
+ * (e.g., "Voxelize_MeshTri3", "SignedDistanceField_MeshTri3" and "VoxelGeodesic_FastMarching").
+ */
+template <typename T>
+class CMatFree_GridStencil {
+public:
+  /**
+   * @tparam GRID "CGrid3" in "gridvoxel.h" or the class with the same members ("ndivx", "ndivy", "ndivz", "aVal")
+   */
+  template <class GRID>
+  CMatFree_GridStencil(
+      const GRID& grid,
+      double h,
+      double coeff_,
+      double shift_,
+      unsigned int nthread_ = 0)
+      : ndivx(grid.ndivx), ndivy(grid.ndivy), ndivz(grid.ndivz),
+        coeff(coeff_/(h*h)), shift(shift_), nthread(nthread_)
+  {
+    aIsIn.resize(grid.aVal.size());
+    for(unsigned int ic=0;ic<aIsIn.size();++ic){ aIsIn[ic] = (grid.aVal[ic] != 0) ? 1 : 0; }
+  }
+  void MatVec(
+      T* y,
+      T alpha, const T* x,
+      T beta) const
+  {
+    const unsigned int nxy = ndivx*ndivy;
+    thread::parallel_for(
+        ndivz,
+        [&](unsigned int ivz){
+          for(unsigned int ivy=0;ivy<ndivy;++ivy){
+            for(unsigned int ivx=0;ivx<ndivx;++ivx){
+              const unsigned int ic = ivz*nxy+ivy*ndivx+ivx;
+              if( aIsIn[ic] == 0 ){
+                y[ic] = (beta == T(0)) ? alpha*x[ic] : alpha*x[ic] + beta*y[ic];
+                continue;
+              }
+              T sum = (shift+6*coeff)*x[ic];
+              if( ivx > 0 && aIsIn[ic-1] ){ sum -= coeff*x[ic-1]; }
+              if( ivx+1 < ndivx && aIsIn[ic+1] ){ sum -= coeff*x[ic+1]; }
+              if( ivy > 0 && aIsIn[ic-ndivx] ){ sum -= coeff*x[ic-ndivx]; }
+              if( ivy+1 < ndivy && aIsIn[ic+ndivx] ){ sum -= coeff*x[ic+ndivx]; }
+              if( ivz > 0 && aIsIn[ic-nxy] ){ sum -= coeff*x[ic-nxy]; }
+              if( ivz+1 < ndivz && aIsIn[ic+nxy] ){ sum -= coeff*x[ic+nxy]; }
+              y[ic] = (beta == T(0)) ? alpha*sum : alpha*sum + beta*y[ic]; // "y" is not read if beta==0
+            }
+          }
+        },
+        nthread);
+  }
+  /**
+   * @brief diagonal of the operator (e.g., for the Jacobi preconditioner)
+   */
+  void Diagonal(T* d) const {
+    for(unsigned int ic=0;ic<aIsIn.size();++ic){ d[ic] = aIsIn[ic] ? T(shift+6*coeff) : T(1); }
+  }
+public:
+  const unsigned int ndivx, ndivy, ndivz;
+  const double coeff; // coefficient divided by h^2
+  const double shift;
+  unsigned int nthread;
+  std::vector<unsigned char> aIsIn;
+};
+
+/**
+ * @brief dense matrix (row-major) as the operator. The values are not copied.
+ * @details the rows are split into blocks processed in parallel
+ */
+template <typename T>
+class CMatFree_Dense {
+public:
+  CMatFree_Dense(
+      const T* A_,
+      unsigned int nrow_,
+      unsigned int ncol_,
+      unsigned int nthread_ = 0)
+      : A(A_), nrow(nrow_), ncol(ncol_), nthread(nthread_) {}
+  void MatVec(
+      T* y,
+      T alpha, const T* x,
+      T beta) const
+  {
+    const unsigned int nrowblk = 64;
+    thread::parallel_for(
+        (nrow+nrowblk-1)/nrowblk,
+        [&](unsigned int iblk){
+          const unsigned int irow1 = (iblk*nrowblk+nrowblk < nrow) ? iblk*nrowblk+nrowblk : nrow;
+          for(unsigned int irow=iblk*nrowblk;irow<irow1;++irow){
+            const T* a = A+static_cast<size_t>(irow)*ncol;
+            T sum = 0;
+            for(unsigned int icol=0;icol<ncol;++icol){ sum += a[icol]*x[icol]; }
+            y[irow] = (beta == T(0)) ? alpha*sum : alpha*sum + beta*y[irow]; // "y" is not read if beta==0
+          }
+        },
+        nthread);
+  }
+public:
+  const T* A;
+  const unsigned int nrow, ncol;
+  unsigned int nthread;
+};
+
+/**
+ * @brief diagonal (Jacobi) preconditioner. "SolvePrecond" divides the vector by the diagonal
+ */
+template <typename T>
+class CPreconditionerJacobi {
+public:
+  template <class MAT>
+  void SetValue(const MAT& mat, unsigned int n){
+    aInvDia.resize(n);
+    mat.Diagonal(aInvDia.data());
+    for(auto& d : aInvDia){ d = T(1)/d; }
+  }
+  void SolvePrecond(T* v) const {
+    for(unsigned int i=0;i<aInvDia.size();++i){ v[i] *= aInvDia[i]; }
+  }
+public:
+  std::vector<T> aInvDia;
+};
+
+} // delfem2
+
+#endif // DFM2_LSMATFREE_H
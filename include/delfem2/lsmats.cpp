@@ -9,6 +9,7 @@
 #include <vector>
 #include <climits>
 #include <complex>
+#include <algorithm>
 #include "delfem2/lsmats.h"
 
 namespace delfem2 {
@@ -430,6 +431,182 @@ template void delfem2::CMatrixSparse<std::complex<double>>::SetFixedBC_Col(const
 
 // -----------------------------------------------------------------
 
+DFM2_INLINE void delfem2::CSparseFixedBC::Initialize(
+    const unsigned int* colInd,
+    const unsigned int* rowPtr,
+    unsigned int nblk_,
+    unsigned int ndim_,
+    const int* pBCFlag)
+{
+  nblk = nblk_;
+  ndim = ndim_;
+  const unsigned int ndof = nblk*ndim;
+  aDofFix.clear();
+  aDofFree.clear();
+  std::vector<unsigned int> map_red(ndof, UINT_MAX);
+  for(unsigned int idof=0;idof<ndof;++idof){
+    if( pBCFlag[idof] != 0 ){ aDofFix.push_back(idof); continue; }
+    map_red[idof] = static_cast<unsigned int>(aDofFree.size());
+    aDofFree.push_back(idof);
+  }
+  const unsigned int ncrs = colInd[nblk];
+  aSlotCol.clear();
+  for(unsigned int icrs=0;icrs<ncrs;++icrs){
+    const unsigned int jblk = rowPtr[icrs];
+    for(unsigned int jdim=0;jdim<ndim;++jdim){
+      if( pBCFlag[jblk*ndim+jdim] == 0 ){ continue; }
+      aSlotCol.push_back(icrs*ndim+jdim);
+    }
+  }
+  // reduced system
+  const unsigned int blksize = ndim*ndim;
+  const unsigned int ndia = nblk*blksize;
+  const unsigned int nfree = static_cast<unsigned int>(aDofFree.size());
+  red_colInd.assign(1, 0);
+  red_rowPtr.clear();
+  red_srcCrs.clear();
+  red_srcDia.resize(nfree);
+  std::vector<std::pair<unsigned int,unsigned int> > aJSrc; // reduced column and the source of the value
+  for(unsigned int ired=0;ired<nfree;++ired){
+    const unsigned int iblk = aDofFree[ired]/ndim;
+    const unsigned int idim = aDofFree[ired]%ndim;
+    red_srcDia[ired] = iblk*blksize+idim*ndim+idim;
+    aJSrc.clear();
+    for(unsigned int jdim=0;jdim<ndim;++jdim){
+      const unsigned int jred = map_red[iblk*ndim+jdim];
+      if( jdim == idim || jred == UINT_MAX ){ continue; }
+      aJSrc.emplace_back(jred, iblk*blksize+idim*ndim+jdim);
+    }
+    for(unsigned int icrs=colInd[iblk];icrs<colInd[iblk+1];++icrs){
+      const unsigned int jblk = rowPtr[icrs];
+      for(unsigned int jdim=0;jdim<ndim;++jdim){
+        const unsigned int jred = map_red[jblk*ndim+jdim];
+        if( jred == UINT_MAX ){ continue; }
+        aJSrc.emplace_back(jred, ndia+icrs*blksize+idim*ndim+jdim);
+      }
+    }
+    std::sort(aJSrc.begin(), aJSrc.end());
+    for(const auto& js : aJSrc){
+      red_rowPtr.push_back(js.first);
+      red_srcCrs.push_back(js.second);
+    }
+    red_colInd.push_back(static_cast<unsigned int>(red_rowPtr.size()));
+  }
+}
+
+template <typename T>
+void delfem2::CSparseFixedBC::SetFixedBC(
+    CMatrixSparse<T>& mat,
+    T val_dia) const
+{
+  assert(mat.nrowblk == nblk && mat.nrowdim == ndim && !mat.valDia.empty());
+  const unsigned int blksize = ndim*ndim;
+  for(unsigned int idof : aDofFix){
+    const unsigned int iblk = idof/ndim;
+    const unsigned int idim = idof%ndim;
+    T* pdia = mat.valDia.data()+iblk*blksize;
+    for(unsigned int jdim=0;jdim<ndim;++jdim){
+      pdia[idim*ndim+jdim] = 0.0;
+      pdia[jdim*ndim+idim] = 0.0;
+    }
+    pdia[idim*ndim+idim] = val_dia;
+    for(unsigned int icrs=mat.colInd[iblk];icrs<mat.colInd[iblk+1];++icrs){
+      for(unsigned int jdim=0;jdim<ndim;++jdim){ mat.valCrs[icrs*blksize+idim*ndim+jdim] = 0.0; }
+    }
+  }
+  for(unsigned int islot : aSlotCol){
+    const unsigned int icrs = islot/ndim;
+    const unsigned int jdim = islot%ndim;
+    for(unsigned int idim=0;idim<ndim;++idim){ mat.valCrs[icrs*blksize+idim*ndim+jdim] = 0.0; }
+  }
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::CSparseFixedBC::SetFixedBC(CMatrixSparse<float>&, float) const;
+template void delfem2::CSparseFixedBC::SetFixedBC(CMatrixSparse<double>&, double) const;
+template void delfem2::CSparseFixedBC::SetFixedBC(CMatrixSparse<std::complex<double>>&, std::complex<double>) const;
+#endif
+
+template <typename T>
+void delfem2::CSparseFixedBC::SetZero(
+    T* vec) const
+{
+  for(unsigned int idof : aDofFix){ vec[idof] = 0.0; }
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::CSparseFixedBC::SetZero(float*) const;
+template void delfem2::CSparseFixedBC::SetZero(double*) const;
+template void delfem2::CSparseFixedBC::SetZero(std::complex<double>*) const;
+#endif
+
+template <typename T>
+void delfem2::CSparseFixedBC::InitializeReducedMatrix(
+    CMatrixSparse<T>& mat_r) const
+{
+  const unsigned int nfree = NumFree();
+  mat_r.Clear();
+  mat_r.Initialize(nfree, 1, true);
+  mat_r.SetPattern(
+      red_colInd.data(), red_colInd.size(),
+      red_rowPtr.data(), red_rowPtr.size());
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::CSparseFixedBC::InitializeReducedMatrix(CMatrixSparse<float>&) const;
+template void delfem2::CSparseFixedBC::InitializeReducedMatrix(CMatrixSparse<double>&) const;
+template void delfem2::CSparseFixedBC::InitializeReducedMatrix(CMatrixSparse<std::complex<double>>&) const;
+#endif
+
+template <typename T>
+void delfem2::CSparseFixedBC::SetValueReducedMatrix(
+    CMatrixSparse<T>& mat_r,
+    const CMatrixSparse<T>& mat) const
+{
+  assert(mat.nrowblk == nblk && mat.nrowdim == ndim);
+  assert(mat_r.valDia.size() == aDofFree.size() && mat_r.valCrs.size() == red_srcCrs.size());
+  const unsigned int ndia = nblk*ndim*ndim;
+  for(unsigned int ired=0;ired<red_srcDia.size();++ired){
+    mat_r.valDia[ired] = mat.valDia[red_srcDia[ired]];
+  }
+  for(unsigned int icrs=0;icrs<red_srcCrs.size();++icrs){
+    const unsigned int isrc = red_srcCrs[icrs];
+    mat_r.valCrs[icrs] = (isrc < ndia) ? mat.valDia[isrc] : mat.valCrs[isrc-ndia];
+  }
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::CSparseFixedBC::SetValueReducedMatrix(CMatrixSparse<float>&, const CMatrixSparse<float>&) const;
+template void delfem2::CSparseFixedBC::SetValueReducedMatrix(CMatrixSparse<double>&, const CMatrixSparse<double>&) const;
+template void delfem2::CSparseFixedBC::SetValueReducedMatrix(
+    CMatrixSparse<std::complex<double>>&, const CMatrixSparse<std::complex<double>>&) const;
+#endif
+
+template <typename T>
+void delfem2::CSparseFixedBC::ReduceVector(
+    T* vec_r,
+    const T* vec) const
+{
+  for(unsigned int ired=0;ired<aDofFree.size();++ired){ vec_r[ired] = vec[aDofFree[ired]]; }
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::CSparseFixedBC::ReduceVector(float*, const float*) const;
+template void delfem2::CSparseFixedBC::ReduceVector(double*, const double*) const;
+template void delfem2::CSparseFixedBC::ReduceVector(std::complex<double>*, const std::complex<double>*) const;
+#endif
+
+template <typename T>
+void delfem2::CSparseFixedBC::ExpandVector(
+    T* vec,
+    const T* vec_r) const
+{
+  for(unsigned int ired=0;ired<aDofFree.size();++ired){ vec[aDofFree[ired]] = vec_r[ired]; }
+  for(unsigned int idof : aDofFix){ vec[idof] = 0.0; }
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::CSparseFixedBC::ExpandVector(float*, const float*) const;
+template void delfem2::CSparseFixedBC::ExpandVector(double*, const double*) const;
+template void delfem2::CSparseFixedBC::ExpandVector(std::complex<double>*, const std::complex<double>*) const;
+#endif
+
+// -----------------------------------------------------------------
+
 DFM2_INLINE void delfem2::SetMasterSlave(
     delfem2::CMatrixSparse<double>& mat,
     const unsigned int* aMSFlag)
@@ -360,6 +360,95 @@ bool Merge(
   return true;
 }
 
+/**
+ * @brief precomputed index of the fixed degrees of freedom and the entries of the sparse matrix they affect
+ * @details build once for the pattern of the matrix and the boundary condition.
+ * Then the cost of applying the boundary condition is proportional to the number of the affected entries
+ * instead of the number of all the non-zero entries as in "CMatrixSparse::SetFixedBC".
+ * Optionally, the fixed degrees of freedom can be eliminated to make the reduced system with scalar blocks.
+ * The member templates are defined for "float", "double" and "std::complex<double>".
+ */
+class CSparseFixedBC {
+public:
+  /**
+   * @param pBCFlag fixed if pBCFlag[idof] != 0. The size is nblk*ndim.
+   */
+  void Initialize(
+      const unsigned int* colInd,
+      const unsigned int* rowPtr,
+      unsigned int nblk,
+      unsigned int ndim,
+      const int* pBCFlag);
+
+  template <typename T>
+  void Initialize(
+      const CMatrixSparse<T>& mat,
+      const int* pBCFlag)
+  {
+    assert(mat.nrowblk == mat.ncolblk && mat.nrowdim == mat.ncoldim);
+    this->Initialize(mat.colInd.data(), mat.rowPtr.data(), mat.nrowblk, mat.nrowdim, pBCFlag);
+  }
+
+  /**
+   * @brief same as "CMatrixSparse::SetFixedBC" but touches only the affected entries
+   */
+  template <typename T>
+  void SetFixedBC(
+      CMatrixSparse<T>& mat,
+      T val_dia = 1) const;
+
+  /**
+   * @brief set zero to the fixed degrees of freedom of a vector (e.g., right hand side)
+   */
+  template <typename T>
+  void SetZero(
+      T* vec) const;
+
+  unsigned int NumFixed() const { return static_cast<unsigned int>(aDofFix.size()); }
+  unsigned int NumFree() const { return static_cast<unsigned int>(aDofFree.size()); }
+
+  // ------------
+  // reduced system
+
+  /**
+   * @brief allocate the reduced matrix for the free degrees of freedom (scalar blocks)
+   */
+  template <typename T>
+  void InitializeReducedMatrix(
+      CMatrixSparse<T>& mat_r) const;
+
+  /**
+   * @brief copy the values of the free degrees of freedom to the reduced matrix.
+   * @details the matrix "mat" does not need the boundary condition applied
+   */
+  template <typename T>
+  void SetValueReducedMatrix(
+      CMatrixSparse<T>& mat_r,
+      const CMatrixSparse<T>& mat) const;
+
+  template <typename T>
+  void ReduceVector(
+      T* vec_r,
+      const T* vec) const;
+
+  /**
+   * @brief scatter the reduced vector to the full vector. The fixed degrees of freedom are set zero.
+   */
+  template <typename T>
+  void ExpandVector(
+      T* vec,
+      const T* vec_r) const;
+
+public:
+  unsigned int nblk = 0;
+  unsigned int ndim = 0;
+  std::vector<unsigned int> aDofFix; // fixed degrees of freedom in the ascending order
+  std::vector<unsigned int> aSlotCol; // icrs*ndim+jdim where the column "rowPtr[icrs]*ndim+jdim" is fixed
+  std::vector<unsigned int> aDofFree; // free degrees of freedom in the ascending order
+  // pattern of reduced matrix. the source of value is "valDia[isrc]" if isrc < nblk*ndim*ndim, otherwise "valCrs[isrc-nblk*ndim*ndim]"
+  std::vector<unsigned int> red_colInd, red_rowPtr, red_srcCrs, red_srcDia;
+};
+
 DFM2_INLINE double CheckSymmetry(
     const delfem2::CMatrixSparse<double> &mat);
 
@@ -0,0 +1,692 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <climits>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "delfem2/mshiofast.h"
+#include "delfem2/file.h" // CMappedFile
+#include "delfem2/thread/th.h"
+
+namespace delfem2 {
+namespace mshiofast {
+
+inline bool IsSpace(char c){
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* SkipSpace(const char* p, const char* e){
+  while( p < e && IsSpace(*p) ){ ++p; }
+  return p;
+}
+
+inline const char* SkipToken(const char* p, const char* e){
+  while( p < e && !IsSpace(*p) && *p != '\n' ){ ++p; }
+  return p;
+}
+
+inline const char* NextLine(const char* p, const char* e){
+  const void* q = memchr(p, '\n', e-p);
+  return (q == nullptr) ? e : static_cast<const char*>(q)+1;
+}
+
+inline bool IsLittleEndianHost(){
+  const std::uint16_t v = 1;
+  unsigned char c;
+  memcpy(&c, &v, 1);
+  return c == 1;
+}
+
+/**
+ * parse decimal integer and advance the pointer
+ * @return false if there is no digit
+ */
+DFM2_INLINE bool ParseInt(
+    long long& v,
+    const char*& p,
+    const char* e)
+{
+  bool is_neg = false;
+  if( p < e && (*p == '-' || *p == '+') ){ is_neg = (*p == '-'); ++p; }
+  if( p >= e || *p < '0' || *p > '9' ){ return false; }
+  long long a = 0;
+  for(;p<e && *p>='0' && *p<='9';++p){ a = a*10 + (*p-'0'); }
+  v = is_neg ? -a : a;
+  return true;
+}
+
+/**
+ * parse floating point number and advance the pointer
+ * @details the number that is exactly computed with one multiplication or division
+ * is converted directly (W. D. Clinger 1990). Otherwise "strtod" is called,
+ * so the result is always the same as "strtod".
+ * @return false if it is not a number
+ */
+DFM2_INLINE bool ParseDouble(
+    double& v,
+    const char*& p,
+    const char* e)
+{
+  static const double aPow10[23] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+  const char* q = p;
+  bool is_neg = false;
+  if( q < e && (*q == '-' || *q == '+') ){ is_neg = (*q == '-'); ++q; }
+  std::uint64_t w = 0;
+  int ndigit = 0; // number of significant digits
+  int exp10 = 0;
+  bool is_digit = false;
+  for(;q<e && *q>='0' && *q<='9';++q){
+    is_digit = true;
+    w = w*10 + (*q-'0');
+    if( w != 0 ){ ndigit++; }
+  }
+  if( q < e && *q == '.' ){
+    ++q;
+    for(;q<e && *q>='0' && *q<='9';++q){
+      is_digit = true;
+      w = w*10 + (*q-'0');
+      if( w != 0 ){ ndigit++; }
+      exp10--;
+    }
+  }
+  if( is_digit && q < e && (*q == 'e' || *q == 'E') ){
+    const char* r = q+1;
+    long long iexp;
+    if( ParseInt(iexp,r,e) ){
+      exp10 += static_cast<int>(std::max(-10000LL,std::min(iexp,10000LL)));
+      q = r;
+    }
+  }
+  if( is_digit && ndigit <= 19 && w <= (1ULL<<53) && exp10 >= -22 && exp10 <= 22 ){
+    double d = static_cast<double>(w);
+    if( exp10 < 0 ){ d /= aPow10[-exp10]; }
+    else{ d *= aPow10[exp10]; }
+    v = is_neg ? -d : d;
+    p = q;
+    return true;
+  }
+  // slow path. inf, nan and the long mantissa
+  const char* r = SkipToken(p,e);
+  if( r == p ){ return false; }
+  const std::string s(p,r);
+  char* end;
+  v = std::strtod(s.c_str(), &end);
+  if( end == s.c_str() ){ return false; }
+  p += (end-s.c_str());
+  return true;
+}
+
+/**
+ * split the buffer into "nchunk" parts at the beginning of lines
+ */
+DFM2_INLINE void SplitAtLines(
+    std::vector<const char*>& aPtr,
+    const char* b,
+    const char* e,
+    unsigned int nchunk)
+{
+  aPtr.resize(nchunk+1);
+  aPtr[0] = b;
+  for(unsigned int ichunk=1;ichunk<nchunk;++ichunk){
+    const char* p = b + (e-b)*ichunk/nchunk;
+    if( p < aPtr[ichunk-1] ){ p = aPtr[ichunk-1]; }
+    if( p > b && *(p-1) != '\n' ){ p = NextLine(p,e); }
+    aPtr[ichunk] = p;
+  }
+  aPtr[nchunk] = e;
+}
+
+// ---------------------------------
+// PLY
+
+enum PLY_TYPE { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_UNKNOWN };
+
+enum PLY_FORMAT { PLY_ASCII, PLY_BINARY_LE, PLY_BINARY_BE };
+
+class CPlyProperty {
+public:
+  std::string name;
+  PLY_TYPE type;
+  bool is_list;
+  PLY_TYPE type_count;
+};
+
+class CPlyElement {
+public:
+  std::string name;
+  size_t n;
+  std::vector<CPlyProperty> aProp;
+};
+
+DFM2_INLINE PLY_TYPE PlyType(const std::string& s){
+  if( s == "char" || s == "int8" ){ return PLY_INT8; }
+  if( s == "uchar" || s == "uint8" ){ return PLY_UINT8; }
+  if( s == "short" || s == "int16" ){ return PLY_INT16; }
+  if( s == "ushort" || s == "uint16" ){ return PLY_UINT16; }
+  if( s == "int" || s == "int32" ){ return PLY_INT32; }
+  if( s == "uint" || s == "uint32" ){ return PLY_UINT32; }
+  if( s == "float" || s == "float32" ){ return PLY_FLOAT32; }
+  if( s == "double" || s == "float64" ){ return PLY_FLOAT64; }
+  return PLY_UNKNOWN;
+}
+
+inline unsigned int PlyTypeSize(PLY_TYPE t){
+  static const unsigned int aSize[9] = {1,1,2,2,4,4,4,8,0};
+  return aSize[t];
+}
+
+inline double ReadBinaryPly(
+    const char* p,
+    PLY_TYPE t,
+    bool is_swap)
+{
+  unsigned char b[8];
+  const unsigned int n = PlyTypeSize(t);
+  memcpy(b,p,n);
+  if( is_swap ){ std::reverse(b,b+n); }
+  switch(t){
+    case PLY_INT8:    { std::int8_t v;   memcpy(&v,b,1); return v; }
+    case PLY_UINT8:   { std::uint8_t v;  memcpy(&v,b,1); return v; }
+    case PLY_INT16:   { std::int16_t v;  memcpy(&v,b,2); return v; }
+    case PLY_UINT16:  { std::uint16_t v; memcpy(&v,b,2); return v; }
+    case PLY_INT32:   { std::int32_t v;  memcpy(&v,b,4); return v; }
+    case PLY_UINT32:  { std::uint32_t v; memcpy(&v,b,4); return v; }
+    case PLY_FLOAT32: { float v;         memcpy(&v,b,4); return v; }
+    case PLY_FLOAT64: { double v;        memcpy(&v,b,8); return v; }
+    default: return 0;
+  }
+}
+
+/**
+ * visit all the values in a row of an element.
+ * "func(iprop, val)" is called for every scalar property and for every item of the list property.
+ * @return pointer to the next row. nullptr if the row is broken
+ */
+template <typename FUNC>
+const char* VisitRowPly(
+    const char* p,
+    const char* e,
+    const CPlyElement& elem,
+    PLY_FORMAT format,
+    FUNC func)
+{
+  if( format == PLY_ASCII ){
+    const char* pe = NextLine(p,e);
+    for(unsigned int iprop=0;iprop<elem.aProp.size();++iprop){
+      const CPlyProperty& prop = elem.aProp[iprop];
+      unsigned int nitem = 1;
+      if( prop.is_list ){
+        p = SkipSpace(p,pe);
+        long long n;
+        if( !ParseInt(n,p,pe) || n < 0 ){ return nullptr; }
+        nitem = static_cast<unsigned int>(n);
+      }
+      for(unsigned int iitem=0;iitem<nitem;++iitem){
+        p = SkipSpace(p,pe);
+        double v;
+        if( !ParseDouble(v,p,pe) ){ return nullptr; }
+        func(iprop,v);
+      }
+    }
+    return pe;
+  }
+  const bool is_swap = (format == PLY_BINARY_LE) != IsLittleEndianHost();
+  for(unsigned int iprop=0;iprop<elem.aProp.size();++iprop){
+    const CPlyProperty& prop = elem.aProp[iprop];
+    unsigned int nitem = 1;
+    if( prop.is_list ){
+      const unsigned int nbyte = PlyTypeSize(prop.type_count);
+      if( p+nbyte > e ){ return nullptr; }
+      nitem = static_cast<unsigned int>(ReadBinaryPly(p,prop.type_count,is_swap));
+      p += nbyte;
+    }
+    const unsigned int nbyte = PlyTypeSize(prop.type);
+    if( p+nbyte*nitem > e ){ return nullptr; }
+    for(unsigned int iitem=0;iitem<nitem;++iitem){
+      func(iprop, ReadBinaryPly(p,prop.type,is_swap));
+      p += nbyte;
+    }
+  }
+  return p;
+}
+
+/**
+ * find the beginning of the rows of an element that are split into "nchunk"
+ * @param aPtr (out) pointer to the first row of each chunk. aPtr[nchunk] is the end of the element
+ * @param aRow (out) index of the first row of each chunk.
+ */
+DFM2_INLINE bool SplitElementPly(
+    std::vector<const char*>& aPtr,
+    std::vector<size_t>& aRow,
+    const char* p,
+    const char* e,
+    const CPlyElement& elem,
+    PLY_FORMAT format,
+    unsigned int nchunk)
+{
+  aPtr.resize(nchunk+1);
+  aRow.resize(nchunk+1);
+  for(unsigned int ichunk=0;ichunk<nchunk+1;++ichunk){ aRow[ichunk] = elem.n*ichunk/nchunk; }
+  bool is_fixed_size = (format != PLY_ASCII);
+  size_t stride = 0;
+  for(const auto& prop : elem.aProp){
+    if( prop.is_list ){ is_fixed_size = false; }
+    stride += PlyTypeSize(prop.type);
+  }
+  if( is_fixed_size ){
+    if( p + stride*elem.n > e ){ return false; }
+    for(unsigned int ichunk=0;ichunk<nchunk+1;++ichunk){ aPtr[ichunk] = p + stride*aRow[ichunk]; }
+    return true;
+  }
+  unsigned int ichunk = 0;
+  for(size_t irow=0;irow<elem.n;++irow){
+    while( ichunk < nchunk && aRow[ichunk] == irow ){ aPtr[ichunk] = p; ichunk++; }
+    if( format == PLY_ASCII ){
+      if( p >= e ){ return false; }
+      p = NextLine(p,e);
+    }
+    else{
+      p = VisitRowPly(p,e,elem,format,[](unsigned int, double){});
+      if( p == nullptr ){ return false; }
+    }
+  }
+  for(;ichunk<nchunk+1;++ichunk){ aPtr[ichunk] = p; }
+  return true;
+}
+
+} // namespace mshiofast
+} // namespace delfem2
+
+// ----------------------------------------------
+
+DFM2_INLINE bool delfem2::Read_Obj_Fast(
+    const std::string& fname,
+    std::vector<double>& aXYZ,
+    std::vector<unsigned int>& aTri,
+    unsigned int nthread)
+{
+  namespace lcl = ::delfem2::mshiofast;
+  CMappedFile file;
+  if( !file.Open(fname) ){ return false; }
+  const char* b = file.data();
+  const char* e = b + file.size();
+  nthread = thread::num_threads(nthread);
+  const unsigned int nchunk = nthread;
+  std::vector<const char*> aPtr;
+  lcl::SplitAtLines(aPtr, b, e, nchunk);
+  // first pass: count vertices and triangles in each chunk
+  std::vector<size_t> aNVtx(nchunk+1,0), aNTri(nchunk+1,0);
+  thread::parallel_for(nchunk, [&](unsigned int ichunk){
+    size_t nvtx = 0, ntri = 0;
+    const char* pe = aPtr[ichunk+1];
+    for(const char* p=aPtr[ichunk];p<pe;){
+      const char* pl = lcl::NextLine(p,pe);
+      p = lcl::SkipSpace(p,pl);
+      if( p+1 < pl && p[0] == 'v' && lcl::IsSpace(p[1]) ){ nvtx++; }
+      else if( p+1 < pl && p[0] == 'f' && lcl::IsSpace(p[1]) ){
+        unsigned int nv = 0;
+        for(p=lcl::SkipSpace(p+1,pl);p<pl && *p!='\n';p=lcl::SkipSpace(p,pl)){
+          p = lcl::SkipToken(p,pl);
+          nv++;
+        }
+        if( nv >= 3 ){ ntri += nv-2; }
+      }
+      p = pl;
+    }
+    aNVtx[ichunk+1] = nvtx;
+    aNTri[ichunk+1] = ntri;
+  }, nthread);
+  for(unsigned int ichunk=0;ichunk<nchunk;++ichunk){
+    aNVtx[ichunk+1] += aNVtx[ichunk];
+    aNTri[ichunk+1] += aNTri[ichunk];
+  }
+  aXYZ.resize(aNVtx[nchunk]*3);
+  aTri.resize(aNTri[nchunk]*3);
+  // second pass: parse values
+  thread::parallel_for(nchunk, [&](unsigned int ichunk){
+    size_t ivtx = aNVtx[ichunk], itri = aNTri[ichunk];
+    const char* pe = aPtr[ichunk+1];
+    std::vector<unsigned int> aIP;
+    for(const char* p=aPtr[ichunk];p<pe;){
+      const char* pl = lcl::NextLine(p,pe);
+      p = lcl::SkipSpace(p,pl);
+      if( p+1 < pl && p[0] == 'v' && lcl::IsSpace(p[1]) ){
+        p++;
+        for(int idim=0;idim<3;++idim){
+          p = lcl::SkipSpace(p,pl);
+          double v = 0.0;
+          lcl::ParseDouble(v,p,pl);
+          aXYZ[ivtx*3+idim] = v;
+        }
+        ivtx++;
+      }
+      else if( p+1 < pl && p[0] == 'f' && lcl::IsSpace(p[1]) ){
+        aIP.clear();
+        for(p=lcl::SkipSpace(p+1,pl);p<pl && *p!='\n';p=lcl::SkipSpace(p,pl)){
+          long long i0 = 0;
+          lcl::ParseInt(i0,p,pl);
+          // 1-origin index, or the negative index relative to the current vertex
+          aIP.push_back( static_cast<unsigned int>((i0 > 0) ? i0-1 : static_cast<long long>(ivtx)+i0) );
+          p = lcl::SkipToken(p,pl); // skip texture and normal index
+        }
+        for(unsigned int iv=2;iv<aIP.size();++iv){
+          aTri[itri*3+0] = aIP[0];
+          aTri[itri*3+1] = aIP[iv-1];
+          aTri[itri*3+2] = aIP[iv];
+          itri++;
+        }
+      }
+      p = pl;
+    }
+  }, nthread);
+  return true;
+}
+
+// ----------------------------------------------
+
+DFM2_INLINE bool delfem2::Read_Ply_Fast(
+    const std::string& fname,
+    std::vector<double>& aXYZ,
+    std::vector<unsigned int>& aTri,
+    unsigned int nthread)
+{
+  namespace lcl = ::delfem2::mshiofast;
+  CMappedFile file;
+  if( !file.Open(fname) ){ return false; }
+  const char* b = file.data();
+  const char* e = b + file.size();
+  // parse header
+  lcl::PLY_FORMAT format = lcl::PLY_ASCII;
+  std::vector<lcl::CPlyElement> aElem;
+  const char* p = b;
+  {
+    if( file.size() < 4 || strncmp(b,"ply",3) != 0 ){ return false; }
+    bool is_end = false;
+    while( p < e ){
+      const char* pl = lcl::NextLine(p,e);
+      std::istringstream ss(std::string(p,pl));
+      p = pl;
+      std::string key;
+      ss >> key;
+      if( key == "format" ){
+        std::string sformat;
+        ss >> sformat;
+        if( sformat == "ascii" ){ format = lcl::PLY_ASCII; }
+        else if( sformat == "binary_little_endian" ){ format = lcl::PLY_BINARY_LE; }
+        else if( sformat == "binary_big_endian" ){ format = lcl::PLY_BINARY_BE; }
+        else { return false; }
+      }
+      else if( key == "element" ){
+        lcl::CPlyElement elem;
+        ss >> elem.name >> elem.n;
+        aElem.push_back(elem);
+      }
+      else if( key == "property" ){
+        if( aElem.empty() ){ return false; }
+        lcl::CPlyProperty prop;
+        std::string stype;
+        ss >> stype;
+        prop.is_list = (stype == "list");
+        if( prop.is_list ){
+          std::string stype_count;
+          ss >> stype_count >> stype;
+          prop.type_count = lcl::PlyType(stype_count);
+          if( prop.type_count == lcl::PLY_UNKNOWN ){ return false; }
+        }
+        else { prop.type_count = lcl::PLY_UNKNOWN; }
+        prop.type = lcl::PlyType(stype);
+        if( prop.type == lcl::PLY_UNKNOWN ){ return false; }
+        ss >> prop.name;
+        aElem.back().aProp.push_back(prop);
+      }
+      else if( key == "end_header" ){ is_end = true; break; }
+    }
+    if( !is_end ){ return false; }
+  }
+  nthread = thread::num_threads(nthread);
+  const unsigned int nchunk = nthread;
+  aXYZ.clear();
+  aTri.clear();
+  std::vector<const char*> aPtr;
+  std::vector<size_t> aRow;
+  for(const auto& elem : aElem){
+    if( !lcl::SplitElementPly(aPtr,aRow,p,e,elem,format,nchunk) ){ return false; }
+    p = aPtr[nchunk];
+    if( elem.name == "vertex" ){
+      unsigned int aIPropXYZ[3] = {UINT_MAX, UINT_MAX, UINT_MAX};
+      for(unsigned int iprop=0;iprop<elem.aProp.size();++iprop){
+        const std::string& name = elem.aProp[iprop].name;
+        if( name == "x" ){ aIPropXYZ[0] = iprop; }
+        if( name == "y" ){ aIPropXYZ[1] = iprop; }
+        if( name == "z" ){ aIPropXYZ[2] = iprop; }
+      }
+      aXYZ.assign(elem.n*3, 0.0);
+      thread::parallel_for(nchunk, [&](unsigned int ichunk){
+        const char* q = aPtr[ichunk];
+        for(size_t ip=aRow[ichunk];ip<aRow[ichunk+1] && q!=nullptr;++ip){
+          q = lcl::VisitRowPly(q,e,elem,format,[&](unsigned int iprop, double v){
+            for(int idim=0;idim<3;++idim){
+              if( iprop == aIPropXYZ[idim] ){ aXYZ[ip*3+idim] = v; }
+            }
+          });
+        }
+      }, nthread);
+    }
+    else if( elem.name == "face" ){
+      unsigned int iprop_vtx = UINT_MAX;
+      for(unsigned int iprop=0;iprop<elem.aProp.size();++iprop){
+        const std::string& name = elem.aProp[iprop].name;
+        if( name == "vertex_indices" || name == "vertex_index" ){ iprop_vtx = iprop; }
+      }
+      std::vector<size_t> aNTri(nchunk+1,0);
+      thread::parallel_for(nchunk, [&](unsigned int ichunk){
+        const char* q = aPtr[ichunk];
+        size_t ntri = 0;
+        for(size_t iface=aRow[ichunk];iface<aRow[ichunk+1] && q!=nullptr;++iface){
+          unsigned int nv = 0;
+          q = lcl::VisitRowPly(q,e,elem,format,[&](unsigned int iprop, double){
+            if( iprop == iprop_vtx ){ nv++; }
+          });
+          if( nv >= 3 ){ ntri += nv-2; }
+        }
+        aNTri[ichunk+1] = ntri;
+      }, nthread);
+      for(unsigned int ichunk=0;ichunk<nchunk;++ichunk){ aNTri[ichunk+1] += aNTri[ichunk]; }
+      aTri.resize(aNTri[nchunk]*3);
+      thread::parallel_for(nchunk, [&](unsigned int ichunk){
+        const char* q = aPtr[ichunk];
+        size_t itri = aNTri[ichunk];
+        std::vector<unsigned int> aIP;
+        for(size_t iface=aRow[ichunk];iface<aRow[ichunk+1] && q!=nullptr;++iface){
+          aIP.clear();
+          q = lcl::VisitRowPly(q,e,elem,format,[&](unsigned int iprop, double v){
+            if( iprop == iprop_vtx ){ aIP.push_back(static_cast<unsigned int>(v)); }
+          });
+          for(unsigned int iv=2;iv<aIP.size();++iv){
+            aTri[itri*3+0] = aIP[0];
+            aTri[itri*3+1] = aIP[iv-1];
+            aTri[itri*3+2] = aIP[iv];
+            itri++;
+          }
+        }
+      }, nthread);
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------
+
+DFM2_INLINE bool delfem2::Read_STL(
+    const std::string& fname,
+    std::vector<double>& aXYZ,
+    std::vector<unsigned int>& aTri,
+    bool is_merge_vertex)
+{
+  namespace lcl = ::delfem2::mshiofast;
+  CMappedFile file;
+  if( !file.Open(fname) ){ return false; }
+  const char* b = file.data();
+  const char* e = b + file.size();
+  aXYZ.clear();
+  std::uint32_t ntri = 0;
+  if( file.size() >= 84 ){
+    unsigned char c[4];
+    memcpy(c, b+80, 4);
+    ntri = c[0] | (c[1]<<8) | (c[2]<<16) | (static_cast<std::uint32_t>(c[3])<<24);
+  }
+  if( file.size() >= 84 && file.size() == 84 + 50*static_cast<size_t>(ntri) ){ // binary
+    const bool is_swap = !lcl::IsLittleEndianHost();
+    aXYZ.resize(static_cast<size_t>(ntri)*9);
+    for(size_t itri=0;itri<ntri;++itri){
+      const char* q = b + 84 + itri*50 + 12; // skip normal
+      for(int i=0;i<9;++i){
+        aXYZ[itri*9+i] = lcl::ReadBinaryPly(q+i*4, lcl::PLY_FLOAT32, is_swap);
+      }
+    }
+  }
+  else { // ascii
+    if( file.size() < 5 || strncmp(b,"solid",5) != 0 ){ return false; }
+    for(const char* p=b;p<e;){
+      const char* pl = lcl::NextLine(p,e);
+      p = lcl::SkipSpace(p,pl);
+      if( pl-p > 6 && strncmp(p,"vertex",6) == 0 ){
+        p += 6;
+        for(int idim=0;idim<3;++idim){
+          p = lcl::SkipSpace(p,pl);
+          double v = 0.0;
+          if( !lcl::ParseDouble(v,p,pl) ){ return false; }
+          aXYZ.push_back(v);
+        }
+      }
+      p = pl;
+    }
+    if( aXYZ.size() % 9 != 0 ){ return false; }
+  }
+  const unsigned int nv = static_cast<unsigned int>(aXYZ.size()/3);
+  aTri.resize(nv);
+  for(unsigned int iv=0;iv<nv;++iv){ aTri[iv] = iv; }
+  if( !is_merge_vertex ){ return true; }
+  // merge the vertices at the same position. The vertices are ordered in the order of appearance.
+  std::vector<unsigned int> aIdx(aTri);
+  std::stable_sort(aIdx.begin(), aIdx.end(), [&aXYZ](unsigned int i, unsigned int j){
+    if( aXYZ[i*3+0] != aXYZ[j*3+0] ){ return aXYZ[i*3+0] < aXYZ[j*3+0]; }
+    if( aXYZ[i*3+1] != aXYZ[j*3+1] ){ return aXYZ[i*3+1] < aXYZ[j*3+1]; }
+    return aXYZ[i*3+2] < aXYZ[j*3+2];
+  });
+  std::vector<unsigned int> aRep(nv); // the first vertex at the same position
+  for(unsigned int ii=0;ii<nv;++ii){
+    const unsigned int i = aIdx[ii];
+    if( ii == 0 ){ aRep[i] = i; continue; }
+    const unsigned int j = aIdx[ii-1];
+    const bool is_same = aXYZ[i*3+0] == aXYZ[j*3+0] && aXYZ[i*3+1] == aXYZ[j*3+1] && aXYZ[i*3+2] == aXYZ[j*3+2];
+    aRep[i] = is_same ? aRep[j] : i;
+  }
+  std::vector<unsigned int> aOld2New(nv,UINT_MAX);
+  unsigned int np = 0;
+  for(unsigned int iv=0;iv<nv;++iv){
+    if( aRep[iv] != iv ){ continue; }
+    aOld2New[iv] = np;
+    for(int idim=0;idim<3;++idim){ aXYZ[np*3+idim] = aXYZ[iv*3+idim]; }
+    np++;
+  }
+  aXYZ.resize(np*3);
+  for(unsigned int iv=0;iv<nv;++iv){ aTri[iv] = aOld2New[aRep[iv]]; }
+  return true;
+}
+
+// ----------------------------------------------
+
+DFM2_INLINE void delfem2::Write_STL_Binary(
+    const std::string& fname,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri)
+{
+  namespace lcl = ::delfem2::mshiofast;
+  const bool is_swap = !lcl::IsLittleEndianHost();
+  const std::uint32_t ntri = static_cast<std::uint32_t>(aTri.size()/3);
+  std::vector<char> aBuff(84+50*static_cast<size_t>(ntri), 0);
+  strncpy(aBuff.data(), "binary STL written by delfem2", 80);
+  auto put = [is_swap](char* q, const void* v, unsigned int n){
+    memcpy(q,v,n);
+    if( is_swap ){ std::reverse(q,q+n); }
+  };
+  put(aBuff.data()+80, &ntri, 4);
+  for(size_t itri=0;itri<ntri;++itri){
+    char* q = aBuff.data() + 84 + itri*50;
+    const double* p0 = aXYZ.data()+aTri[itri*3+0]*size_t(3);
+    const double* p1 = aXYZ.data()+aTri[itri*3+1]*size_t(3);
+    const double* p2 = aXYZ.data()+aTri[itri*3+2]*size_t(3);
+    double n[3] = {
+        (p1[1]-p0[1])*(p2[2]-p0[2]) - (p2[1]-p0[1])*(p1[2]-p0[2]),
+        (p1[2]-p0[2])*(p2[0]-p0[0]) - (p2[2]-p0[2])*(p1[0]-p0[0]),
+        (p1[0]-p0[0])*(p2[1]-p0[1]) - (p2[0]-p0[0])*(p1[1]-p0[1]) };
+    const double len = sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+    if( len > 0 ){ n[0] /= len; n[1] /= len; n[2] /= len; }
+    const double* aP[4] = {n, p0, p1, p2};
+    for(int i=0;i<4;++i){
+      for(int idim=0;idim<3;++idim){
+        const float v = static_cast<float>(aP[i][idim]);
+        put(q+i*12+idim*4, &v, 4);
+      }
+    }
+  }
+  std::ofstream fout(fname.c_str(), std::ios::binary);
+  fout.write(aBuff.data(), aBuff.size());
+}
+
+DFM2_INLINE void delfem2::Write_Ply_Binary(
+    const std::string& fname,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri)
+{
+  namespace lcl = ::delfem2::mshiofast;
+  const bool is_swap = !lcl::IsLittleEndianHost();
+  const size_t np = aXYZ.size()/3;
+  const size_t ntri = aTri.size()/3;
+  std::ostringstream ss;
+  ss << "ply\n";
+  ss << "format binary_little_endian 1.0\n";
+  ss << "element vertex " << np << "\n";
+  ss << "property float x\n";
+  ss << "property float y\n";
+  ss << "property float z\n";
+  ss << "element face " << ntri << "\n";
+  ss << "property list uchar int vertex_indices\n";
+  ss << "end_header\n";
+  const std::string header = ss.str();
+  std::vector<char> aBuff(header.size() + np*12 + ntri*13);
+  memcpy(aBuff.data(), header.data(), header.size());
+  auto put = [is_swap](char* q, const void* v, unsigned int n){
+    memcpy(q,v,n);
+    if( is_swap ){ std::reverse(q,q+n); }
+  };
+  char* q = aBuff.data() + header.size();
+  for(size_t ip=0;ip<np;++ip){
+    for(int idim=0;idim<3;++idim){
+      const float v = static_cast<float>(aXYZ[ip*3+idim]);
+      put(q, &v, 4); q += 4;
+    }
+  }
+  for(size_t itri=0;itri<ntri;++itri){
+    *q = 3; q += 1;
+    for(int inode=0;inode<3;++inode){
+      const std::int32_t v = static_cast<std::int32_t>(aTri[itri*3+inode]);
+      put(q, &v, 4); q += 4;
+    }
+  }
+  std::ofstream fout(fname.c_str(), std::ios::binary);
+  fout.write(aBuff.data(), aBuff.size());
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file readers of large mesh files (OBJ, PLY, STL).
+ * @details the whole file is memory mapped and the text is parsed in parallel by splitting it at line boundaries.
+ * The number of vertices and elements are counted in the first pass so the arrays are allocated only once.
+ * Use the functions in "mshio.h" for small files or the files with the groups and materials.
+ */
+
+#ifndef DFM2_MSHIOFAST_H
+#define DFM2_MSHIOFAST_H
+
+#include "delfem2/dfm2_inline.h"
+#include <vector>
+#include <string>
+
+namespace delfem2 {
+
+/**
+ * @brief read vertex positions and faces of the Wavefront OBJ file in parallel.
+ * @details polygons are triangulated as a fan. The texture and normal indices ("f 1/2/3") are ignored.
+ * The negative (relative) indices are supported.
+ * @param nthread number of threads. hardware concurrency is used if 0
+ * @return false if the file cannot be opened
+ */
+DFM2_INLINE bool Read_Obj_Fast(
+    const std::string& fname,
+    std::vector<double>& aXYZ,
+    std::vector<unsigned int>& aTri,
+    unsigned int nthread = 0);
+
+/**
+ * @brief read vertex positions and faces of the PLY file.
+ * @details "ascii", "binary_little_endian" and "binary_big_endian" formats are supported.
+ * The properties other than x, y, z and the vertex indices are skipped. Polygons are triangulated as a fan.
+ * @param nthread number of threads. hardware concurrency is used if 0
+ * @return false if the file cannot be opened or the header is not supported
+ */
+DFM2_INLINE bool Read_Ply_Fast(
+    const std::string& fname,
+    std::vector<double>& aXYZ,
+    std::vector<unsigned int>& aTri,
+    unsigned int nthread = 0);
+
+/**
+ * @brief read the STL file (both ascii and binary)
+ * @param is_merge_vertex the vertices at exactly the same position are merged into one. Otherwise three vertices per triangle
+ * @return false if the file cannot be opened or broken
+ */
+DFM2_INLINE bool Read_STL(
+    const std::string& fname,
+    std::vector<double>& aXYZ,
+    std::vector<unsigned int>& aTri,
+    bool is_merge_vertex = true);
+
+/**
+ * @brief write triangle mesh as binary STL file
+ */
+DFM2_INLINE void Write_STL_Binary(
+    const std::string& fname,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri);
+
+/**
+ * @brief write triangle mesh as binary little endian PLY file. The coordinates are stored as float
+ */
+DFM2_INLINE void Write_Ply_Binary(
+    const std::string& fname,
+    const std::vector<double>& aXYZ,
+    const std::vector<unsigned int>& aTri);
+
+} // end namespace delfem2
+
+#ifdef DFM2_HEADER_ONLY
+#  include "delfem2/mshiofast.cpp"
+#endif
+
+#endif /* DFM2_MSHIOFAST_H */
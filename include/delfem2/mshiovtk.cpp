@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <utility>
+#include "delfem2/mshiovtk.h"
+#include "delfem2/thread/th.h"
+
+#ifdef USE_ZLIB
+#  include <zlib.h>
+#endif
+
+namespace delfem2 {
+namespace mshiovtk {
+
+inline bool IsLittleEndianHost(){
+  const std::uint16_t v = 1;
+  unsigned char c;
+  memcpy(&c, &v, 1);
+  return c == 1;
+}
+
+/**
+ * append the value in the big endian
+ */
+template <typename T>
+void AppendBigEndian(
+    std::vector<char>& aBuff,
+    T v)
+{
+  char b[sizeof(T)];
+  memcpy(b, &v, sizeof(T));
+  if( IsLittleEndianHost() ){ std::reverse(b, b+sizeof(T)); }
+  aBuff.insert(aBuff.end(), b, b+sizeof(T));
+}
+
+/**
+ * append the array in the native endian
+ */
+template <typename T>
+void AppendNative(
+    std::vector<char>& aBuff,
+    const T* p,
+    size_t n)
+{
+  const char* b = reinterpret_cast<const char*>(p);
+  aBuff.insert(aBuff.end(), b, b+sizeof(T)*n);
+}
+
+DFM2_INLINE void AppendString(
+    std::vector<char>& aBuff,
+    const std::string& s)
+{
+  aBuff.insert(aBuff.end(), s.begin(), s.end());
+}
+
+DFM2_INLINE void AppendFieldLegacy(
+    std::vector<char>& aBuff,
+    const CVtkField& field)
+{
+  std::ostringstream ss;
+  if( field.ndim == 3 ){
+    ss << "VECTORS " << field.name << " double\n";
+  }
+  else{
+    ss << "SCALARS " << field.name << " double " << field.ndim << "\n";
+    ss << "LOOKUP_TABLE default\n";
+  }
+  AppendString(aBuff, ss.str());
+  for(double v : field.aVal){ AppendBigEndian(aBuff, v); }
+  aBuff.push_back('\n');
+}
+
+/**
+ * append a block of the appended data of VTU file.
+ * @param aData the raw data
+ */
+DFM2_INLINE void AppendBlockVTU(
+    std::vector<char>& aBuff,
+    const char* aData,
+    size_t nbyte,
+    bool is_compress,
+    unsigned int nthread)
+{
+#ifdef USE_ZLIB
+  if( is_compress ){
+    const size_t nbyte_block = 1 << 15;
+    const size_t nblock = (nbyte + nbyte_block - 1)/nbyte_block;
+    std::vector< std::vector<Bytef> > aComp(nblock);
+    thread::parallel_for(static_cast<unsigned int>(nblock), [&](unsigned int iblock){
+      const size_t ibyte0 = iblock*nbyte_block;
+      const size_t n = std::min(nbyte_block, nbyte-ibyte0);
+      uLongf ncomp = compressBound(static_cast<uLong>(n));
+      aComp[iblock].resize(ncomp);
+      compress2(aComp[iblock].data(), &ncomp,
+                reinterpret_cast<const Bytef*>(aData+ibyte0), static_cast<uLong>(n),
+                Z_DEFAULT_COMPRESSION);
+      aComp[iblock].resize(ncomp);
+    }, nthread);
+    std::vector<std::uint64_t> aHead(3+nblock);
+    aHead[0] = nblock;
+    aHead[1] = nbyte_block;
+    aHead[2] = nbyte % nbyte_block;
+    for(size_t iblock=0;iblock<nblock;++iblock){ aHead[3+iblock] = aComp[iblock].size(); }
+    AppendNative(aBuff, aHead.data(), aHead.size());
+    for(const auto& comp : aComp){ AppendNative(aBuff, comp.data(), comp.size()); }
+    return;
+  }
+#else
+  (void)is_compress;
+  (void)nthread;
+#endif
+  const std::uint64_t n = nbyte;
+  AppendNative(aBuff, &n, 1);
+  aBuff.insert(aBuff.end(), aData, aData+nbyte);
+}
+
+} // namespace mshiovtk
+} // namespace delfem2
+
+// ----------------------------------------------
+
+DFM2_INLINE void delfem2::CVtkUnstructuredGrid::SetPoints(
+    const std::vector<double>& aXYZ_,
+    unsigned int ndim)
+{
+  assert( ndim == 2 || ndim == 3 );
+  const size_t np = aXYZ_.size()/ndim;
+  aXYZ.assign(np*3, 0.0);
+  for(size_t ip=0;ip<np;++ip){
+    for(unsigned int idim=0;idim<ndim;++idim){ aXYZ[ip*3+idim] = aXYZ_[ip*ndim+idim]; }
+  }
+}
+
+DFM2_INLINE void delfem2::CVtkUnstructuredGrid::AddCells(
+    const std::vector<unsigned int>& aElem,
+    unsigned int nnoel,
+    unsigned int vtk_elem_type)
+{
+  const size_t nelem = aElem.size()/nnoel;
+  aConnectivity.insert(aConnectivity.end(), aElem.begin(), aElem.begin()+nelem*nnoel);
+  unsigned int ioffset = aOffset.empty() ? 0 : aOffset.back();
+  for(size_t ielem=0;ielem<nelem;++ielem){
+    ioffset += nnoel;
+    aOffset.push_back(ioffset);
+    aCellType.push_back(static_cast<unsigned char>(vtk_elem_type));
+  }
+}
+
+DFM2_INLINE void delfem2::CVtkUnstructuredGrid::AddPointData(
+    const std::string& name,
+    const std::vector<double>& aVal,
+    unsigned int ndim)
+{
+  assert( aVal.size() == NumPoints()*ndim );
+  aPointData.push_back(CVtkField{name, ndim, aVal});
+}
+
+DFM2_INLINE void delfem2::CVtkUnstructuredGrid::AddCellData(
+    const std::string& name,
+    const std::vector<double>& aVal,
+    unsigned int ndim)
+{
+  assert( aVal.size() == NumCells()*ndim );
+  aCellData.push_back(CVtkField{name, ndim, aVal});
+}
+
+// ----------------------------------------------
+
+DFM2_INLINE bool delfem2::WriteVTK_LegacyBinary(
+    const std::string& fpath,
+    const CVtkUnstructuredGrid& grid,
+    const std::string& name)
+{
+  namespace lcl = ::delfem2::mshiovtk;
+  const size_t np = grid.NumPoints();
+  const size_t nc = grid.NumCells();
+  std::vector<char> aBuff;
+  aBuff.reserve(128 + np*3*8 + (grid.aConnectivity.size()+nc*2)*4);
+  {
+    std::ostringstream ss;
+    ss << "# vtk DataFile Version 3.0\n";
+    ss << name << "\n";
+    ss << "BINARY\n";
+    ss << "DATASET UNSTRUCTURED_GRID\n";
+    ss << "POINTS " << np << " double\n";
+    lcl::AppendString(aBuff, ss.str());
+  }
+  for(double v : grid.aXYZ){ lcl::AppendBigEndian(aBuff, v); }
+  aBuff.push_back('\n');
+  lcl::AppendString(aBuff, "CELLS " + std::to_string(nc) + " " + std::to_string(grid.aConnectivity.size()+nc) + "\n");
+  for(size_t ic=0;ic<nc;++ic){
+    const unsigned int i0 = (ic==0) ? 0 : grid.aOffset[ic-1];
+    const unsigned int i1 = grid.aOffset[ic];
+    lcl::AppendBigEndian(aBuff, static_cast<std::int32_t>(i1-i0));
+    for(unsigned int i=i0;i<i1;++i){
+      lcl::AppendBigEndian(aBuff, static_cast<std::int32_t>(grid.aConnectivity[i]));
+    }
+  }
+  aBuff.push_back('\n');
+  lcl::AppendString(aBuff, "CELL_TYPES " + std::to_string(nc) + "\n");
+  for(unsigned char t : grid.aCellType){ lcl::AppendBigEndian(aBuff, static_cast<std::int32_t>(t)); }
+  aBuff.push_back('\n');
+  if( !grid.aPointData.empty() ){
+    lcl::AppendString(aBuff, "POINT_DATA " + std::to_string(np) + "\n");
+    for(const auto& field : grid.aPointData){ lcl::AppendFieldLegacy(aBuff, field); }
+  }
+  if( !grid.aCellData.empty() ){
+    lcl::AppendString(aBuff, "CELL_DATA " + std::to_string(nc) + "\n");
+    for(const auto& field : grid.aCellData){ lcl::AppendFieldLegacy(aBuff, field); }
+  }
+  std::ofstream fout(fpath.c_str(), std::ios::binary);
+  if( fout.fail() ){ return false; }
+  fout.write(aBuff.data(), aBuff.size());
+  return true;
+}
+
+// ----------------------------------------------
+
+DFM2_INLINE bool delfem2::WriteVTU(
+    const std::string& fpath,
+    const CVtkUnstructuredGrid& grid,
+    bool is_compress,
+    unsigned int nthread)
+{
+  namespace lcl = ::delfem2::mshiovtk;
+#ifndef USE_ZLIB
+  is_compress = false;
+#endif
+  std::vector<char> aData; // appended data
+  std::ostringstream ss;
+  auto data_array = [&](const std::string& type, const std::string& name, unsigned int ndim,
+      const void* p, size_t nbyte){
+    ss << "        <DataArray type=\"" << type << "\" Name=\"" << name << "\"";
+    ss << " NumberOfComponents=\"" << ndim << "\" format=\"appended\" offset=\"" << aData.size() << "\"/>\n";
+    lcl::AppendBlockVTU(aData, static_cast<const char*>(p), nbyte, is_compress, nthread);
+  };
+  const size_t np = grid.NumPoints();
+  const size_t nc = grid.NumCells();
+  ss << "<?xml version=\"1.0\"?>\n";
+  ss << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\"";
+  ss << " byte_order=\"" << (lcl::IsLittleEndianHost() ? "LittleEndian" : "BigEndian") << "\"";
+  ss << " header_type=\"UInt64\"";
+  if( is_compress ){ ss << " compressor=\"vtkZLibDataCompressor\""; }
+  ss << ">\n";
+  ss << "  <UnstructuredGrid>\n";
+  ss << "    <Piece NumberOfPoints=\"" << np << "\" NumberOfCells=\"" << nc << "\">\n";
+  ss << "      <Points>\n";
+  data_array("Float64", "Points", 3, grid.aXYZ.data(), grid.aXYZ.size()*sizeof(double));
+  ss << "      </Points>\n";
+  ss << "      <Cells>\n";
+  {
+    std::vector<std::int32_t> aConn(grid.aConnectivity.begin(), grid.aConnectivity.end());
+    std::vector<std::int32_t> aOffset(grid.aOffset.begin(), grid.aOffset.end());
+    data_array("Int32", "connectivity", 1, aConn.data(), aConn.size()*sizeof(std::int32_t));
+    data_array("Int32", "offsets", 1, aOffset.data(), aOffset.size()*sizeof(std::int32_t));
+    data_array("UInt8", "types", 1, grid.aCellType.data(), grid.aCellType.size());
+  }
+  ss << "      </Cells>\n";
+  ss << "      <PointData>\n";
+  for(const auto& field : grid.aPointData){
+    data_array("Float64", field.name, field.ndim, field.aVal.data(), field.aVal.size()*sizeof(double));
+  }
+  ss << "      </PointData>\n";
+  ss << "      <CellData>\n";
+  for(const auto& field : grid.aCellData){
+    data_array("Float64", field.name, field.ndim, field.aVal.data(), field.aVal.size()*sizeof(double));
+  }
+  ss << "      </CellData>\n";
+  ss << "    </Piece>\n";
+  ss << "  </UnstructuredGrid>\n";
+  ss << "  <AppendedData encoding=\"raw\">\n";
+  ss << "_";
+  const std::string sfoot = "\n  </AppendedData>\n</VTKFile>\n";
+  std::ofstream fout(fpath.c_str(), std::ios::binary);
+  if( fout.fail() ){ return false; }
+  const std::string shead = ss.str();
+  fout.write(shead.data(), shead.size());
+  fout.write(aData.data(), aData.size());
+  fout.write(sfoot.data(), sfoot.size());
+  return true;
+}
+
+DFM2_INLINE bool delfem2::WritePVD(
+    const std::string& fpath,
+    const std::vector<std::pair<double,std::string> >& aTimeFile)
+{
+  std::ostringstream ss;
+  ss << "<?xml version=\"1.0\"?>\n";
+  ss << "<VTKFile type=\"Collection\" version=\"0.1\">\n";
+  ss << "  <Collection>\n";
+  ss << std::setprecision(17);
+  for(const auto& tf : aTimeFile){
+    ss << "    <DataSet timestep=\"" << tf.first << "\" group=\"\" part=\"0\" file=\"" << tf.second << "\"/>\n";
+  }
+  ss << "  </Collection>\n";
+  ss << "</VTKFile>\n";
+  std::ofstream fout(fpath.c_str(), std::ios::binary);
+  if( fout.fail() ){ return false; }
+  const std::string s = ss.str();
+  fout.write(s.data(), s.size());
+  return true;
+}
+
+// ----------------------------------------------
+
+DFM2_INLINE delfem2::CVtkSeriesWriter::CVtkSeriesWriter(
+    std::string path_base_,
+    bool is_compress_,
+    bool is_async_,
+    unsigned int nqueue_max_) :
+    path_base(std::move(path_base_)),
+    is_compress(is_compress_),
+    is_async(is_async_),
+    nqueue_max(nqueue_max_==0 ? 1 : nqueue_max_)
+{
+  if( is_async ){
+    worker = std::thread(&CVtkSeriesWriter::Loop, this);
+  }
+}
+
+DFM2_INLINE void delfem2::CVtkSeriesWriter::Write(
+    double time,
+    CVtkUnstructuredGrid&& grid)
+{
+  const unsigned int iframe = nframe;
+  nframe++;
+  if( !is_async ){
+    this->WriteFrame(iframe, time, grid);
+    return;
+  }
+  if( !worker.joinable() ){ // restart after "Finish"
+    is_stop = false;
+    worker = std::thread(&CVtkSeriesWriter::Loop, this);
+  }
+  std::unique_lock<std::mutex> lk(mtx);
+  cv.wait(lk, [this]{ return queue.size() < nqueue_max; });
+  queue.push_back(CFrame{iframe, time, std::move(grid)});
+  cv.notify_all();
+}
+
+DFM2_INLINE void delfem2::CVtkSeriesWriter::Finish()
+{
+  if( !is_async || !worker.joinable() ){ return; }
+  {
+    std::unique_lock<std::mutex> lk(mtx);
+    cv.wait(lk, [this]{ return queue.empty() && !is_writing; });
+    is_stop = true;
+  }
+  cv.notify_all();
+  worker.join();
+}
+
+DFM2_INLINE void delfem2::CVtkSeriesWriter::Loop()
+{
+  for(;;){
+    CFrame frame;
+    {
+      std::unique_lock<std::mutex> lk(mtx);
+      cv.wait(lk, [this]{ return !queue.empty() || is_stop; });
+      if( queue.empty() ){ return; }
+      frame = std::move(queue.front());
+      queue.pop_front();
+      is_writing = true;
+    }
+    cv.notify_all(); // a space in the queue
+    this->WriteFrame(frame.iframe, frame.time, frame.grid);
+    {
+      std::lock_guard<std::mutex> lk(mtx);
+      is_writing = false;
+    }
+    cv.notify_all();
+  }
+}
+
+DFM2_INLINE void delfem2::CVtkSeriesWriter::WriteFrame(
+    unsigned int iframe,
+    double time,
+    const CVtkUnstructuredGrid& grid)
+{
+  std::ostringstream ss;
+  ss << path_base << "_" << std::setw(5) << std::setfill('0') << iframe << ".vtu";
+  const std::string path = ss.str();
+  WriteVTU(path, grid, is_compress);
+  const size_t ipos = path.find_last_of("/\\");
+  const std::string fname = (ipos == std::string::npos) ? path : path.substr(ipos+1);
+  aTimeFile.emplace_back(time, fname);
+  WritePVD(path_base+".pvd", aTimeFile);
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file binary VTK output (legacy binary ".vtk", XML ".vtu" and ".pvd" time series)
+ * @details The data is serialized into a buffer and written at once.
+ * The zlib compression of ".vtu" is available when compiled with "USE_ZLIB" defined (link zlib).
+ * Use "WriteVTK_*" in "mshio.h" for the small ASCII output.
+ */
+
+#ifndef DFM2_MSHIOVTK_H
+#define DFM2_MSHIOVTK_H
+
+#include "delfem2/dfm2_inline.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace delfem2 {
+
+/**
+ * @brief array of values on the points or on the cells
+ */
+class CVtkField {
+public:
+  std::string name;
+  unsigned int ndim; // number of components (1:scalar, 3:vector)
+  std::vector<double> aVal;
+};
+
+/**
+ * @brief unstructured grid for VTK output. Different types of cells can be mixed.
+ */
+class CVtkUnstructuredGrid {
+public:
+  /**
+   * @param ndim dimension of the coordinate (2 or 3). 2D points are stored with z=0
+   */
+  void SetPoints(
+      const std::vector<double>& aXYZ,
+      unsigned int ndim);
+  /**
+   * @param nnoel number of nodes per cell
+   * @param vtk_elem_type 5:VTK_TRIANGLE, 9:VTK_QUAD, 10:VTK_TETRA, 12:VTK_HEXAHEDRON, 13:VTK_WEDGE, 14:VTK_PYRAMID
+   */
+  void AddCells(
+      const std::vector<unsigned int>& aElem,
+      unsigned int nnoel,
+      unsigned int vtk_elem_type);
+  void AddPointData(
+      const std::string& name,
+      const std::vector<double>& aVal,
+      unsigned int ndim);
+  void AddCellData(
+      const std::string& name,
+      const std::vector<double>& aVal,
+      unsigned int ndim);
+  size_t NumPoints() const { return aXYZ.size()/3; }
+  size_t NumCells() const { return aCellType.size(); }
+public:
+  std::vector<double> aXYZ; // 3 values per point
+  std::vector<unsigned int> aConnectivity; // point index of the cells
+  std::vector<unsigned int> aOffset; // end of each cell in aConnectivity (same as the VTU's "offsets")
+  std::vector<unsigned char> aCellType;
+  std::vector<CVtkField> aPointData, aCellData;
+};
+
+/**
+ * @brief write legacy VTK file in the binary format (big endian, double precision)
+ * @return false if the file cannot be opened
+ */
+DFM2_INLINE bool WriteVTK_LegacyBinary(
+    const std::string& fpath,
+    const CVtkUnstructuredGrid& grid,
+    const std::string& name = "delfem2");
+
+/**
+ * @brief write XML VTK unstructured grid file (".vtu") with the appended raw binary data
+ * @param is_compress compress the data with zlib. Ignored if compiled without "USE_ZLIB"
+ * @param nthread number of threads used for the compression. hardware concurrency is used if 0
+ * @return false if the file cannot be opened
+ */
+DFM2_INLINE bool WriteVTU(
+    const std::string& fpath,
+    const CVtkUnstructuredGrid& grid,
+    bool is_compress = false,
+    unsigned int nthread = 0);
+
+/**
+ * @brief write ParaView data collection file (".pvd") for the time series
+ * @param aTimeFile pairs of time and path of the data file (relative to the ".pvd" file)
+ */
+DFM2_INLINE bool WritePVD(
+    const std::string& fpath,
+    const std::vector<std::pair<double,std::string> >& aTimeFile);
+
+/**
+ * @brief write time series of ".vtu" files and the ".pvd" file that bundles them.
+ * @details if "is_async" is true, the frames are written in a background thread
+ * and "Write" returns immediately unless the number of the waiting frames exceeds "nqueue_max".
+ * The ".pvd" file is updated for every frame so that the partial result can be visualized.
+ */
+class CVtkSeriesWriter {
+public:
+  /**
+   * @param path_base the files are written as "<path_base>_<frame>.vtu" and "<path_base>.pvd"
+   */
+  CVtkSeriesWriter(
+      std::string path_base,
+      bool is_compress = false,
+      bool is_async = true,
+      unsigned int nqueue_max = 2);
+  CVtkSeriesWriter(const CVtkSeriesWriter&) = delete;
+  CVtkSeriesWriter& operator=(const CVtkSeriesWriter&) = delete;
+  ~CVtkSeriesWriter(){ this->Finish(); }
+  /**
+   * @brief write a frame. The grid is moved to the writer so the caller can keep on updating its own arrays
+   */
+  void Write(
+      double time,
+      CVtkUnstructuredGrid&& grid);
+  /**
+   * @brief wait until all the frames are written and stop the background thread.
+   * @details the thread is started again if "Write" is called after this.
+   */
+  void Finish();
+  unsigned int NumFrames() const { return nframe; }
+private:
+  void WriteFrame(unsigned int iframe, double time, const CVtkUnstructuredGrid& grid);
+  void Loop();
+private:
+  const std::string path_base;
+  const bool is_compress;
+  const bool is_async;
+  const unsigned int nqueue_max;
+  unsigned int nframe = 0;
+  std::vector<std::pair<double,std::string> > aTimeFile;
+  // for asynchronous output
+  struct CFrame {
+    unsigned int iframe;
+    double time;
+    CVtkUnstructuredGrid grid;
+  };
+  std::deque<CFrame> queue;
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool is_stop = false;
+  bool is_writing = false;
+  std::thread worker;
+};
+
+} // end namespace delfem2
+
+#ifdef DFM2_HEADER_ONLY
+#  include "delfem2/mshiovtk.cpp"
+#endif
+
+#endif /* DFM2_MSHIOVTK_H */
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <climits>
+#include "delfem2/mshreorder.h"
+#include "delfem2/srchbvh.h"
+
+// ------------------------------------
+
+namespace delfem2 {
+namespace mshreorder {
+
+/**
+ * breadth first search from ip_ker. The points are visited in the order of increasing degree.
+ * @param aOrder (out) points in the visiting order
+ * @param aLevel (in&out) level of points. UINT_MAX for unvisited point. The visited points are reset to UINT_MAX if is_reset
+ * @return number of levels
+ */
+DFM2_INLINE unsigned int LevelStructure(
+    std::vector<unsigned int>& aOrder,
+    std::vector<unsigned int>& aLevel,
+    unsigned int ip_ker,
+    const std::vector<unsigned int>& psup_ind,
+    const std::vector<unsigned int>& psup,
+    bool is_reset)
+{
+  aOrder.clear();
+  aOrder.push_back(ip_ker);
+  aLevel[ip_ker] = 0;
+  std::vector<std::pair<unsigned int,unsigned int> > aDegNei;
+  for(unsigned int iip=0;iip<aOrder.size();++iip){
+    const unsigned int ip0 = aOrder[iip];
+    aDegNei.clear();
+    for(unsigned int ipsup=psup_ind[ip0];ipsup<psup_ind[ip0+1];++ipsup){
+      const unsigned int ip1 = psup[ipsup];
+      if( aLevel[ip1] != UINT_MAX ){ continue; }
+      aLevel[ip1] = aLevel[ip0]+1;
+      aDegNei.emplace_back(psup_ind[ip1+1]-psup_ind[ip1],ip1);
+    }
+    std::sort(aDegNei.begin(),aDegNei.end());
+    for(const auto& dn : aDegNei){ aOrder.push_back(dn.second); }
+  }
+  const unsigned int nlevel = aLevel[aOrder.back()]+1;
+  if( is_reset ){
+    for(unsigned int ip : aOrder){ aLevel[ip] = UINT_MAX; }
+  }
+  return nlevel;
+}
+
+/**
+ * find pseudo-peripheral point with the algorithm of Gibbs, Poole & Stockmeyer
+ */
+DFM2_INLINE unsigned int PseudoPeripheralPoint(
+    unsigned int ip_ker,
+    std::vector<unsigned int>& aLevel,
+    const std::vector<unsigned int>& psup_ind,
+    const std::vector<unsigned int>& psup)
+{
+  std::vector<unsigned int> aOrder;
+  unsigned int nlevel = LevelStructure(aOrder,aLevel,ip_ker,psup_ind,psup,false);
+  for(unsigned int itr=0;itr<8;++itr){ // few iterations are enough in practice
+    // pick the point with minimum degree in the last level
+    unsigned int ip_cand = UINT_MAX, ideg_min = UINT_MAX;
+    for(unsigned int ip : aOrder){
+      if( aLevel[ip] != nlevel-1 ){ continue; }
+      const unsigned int ideg = psup_ind[ip+1]-psup_ind[ip];
+      if( ideg < ideg_min ){ ideg_min = ideg; ip_cand = ip; }
+    }
+    for(unsigned int ip : aOrder){ aLevel[ip] = UINT_MAX; }
+    assert( ip_cand != UINT_MAX );
+    const unsigned int nlevel_cand = LevelStructure(aOrder,aLevel,ip_cand,psup_ind,psup,false);
+    if( nlevel_cand <= nlevel ){ break; }
+    ip_ker = ip_cand;
+    nlevel = nlevel_cand;
+  }
+  for(unsigned int ip : aOrder){ aLevel[ip] = UINT_MAX; }
+  return ip_ker;
+}
+
+/**
+ * rotate bits for 3D Hilbert curve (Skilling 2004)
+ * @param X (in&out) coordinates -> transposed Hilbert index
+ */
+DFM2_INLINE void AxesToTranspose3(
+    std::uint32_t X[3],
+    unsigned int nbit)
+{
+  const std::uint32_t M = 1u << (nbit-1);
+  // inverse undo
+  for(std::uint32_t Q=M;Q>1;Q>>=1){
+    const std::uint32_t P = Q-1;
+    for(unsigned int i=0;i<3;++i){
+      if( X[i] & Q ){ X[0] ^= P; }
+      else{
+        const std::uint32_t t = (X[0]^X[i]) & P;
+        X[0] ^= t;
+        X[i] ^= t;
+      }
+    }
+  }
+  // gray encode
+  for(unsigned int i=1;i<3;++i){ X[i] ^= X[i-1]; }
+  std::uint32_t t = 0;
+  for(std::uint32_t Q=M;Q>1;Q>>=1){
+    if( X[2] & Q ){ t ^= Q-1; }
+  }
+  for(unsigned int i=0;i<3;++i){ X[i] ^= t; }
+}
+
+template <typename REAL>
+DFM2_INLINE void BoundingBox3(
+    REAL bbmin[3],
+    REAL bbmax[3],
+    const std::vector<REAL>& aXYZ)
+{
+  const size_t np = aXYZ.size()/3;
+  for(int idim=0;idim<3;++idim){ bbmin[idim] = bbmax[idim] = 0; }
+  if( np == 0 ){ return; }
+  for(int idim=0;idim<3;++idim){ bbmin[idim] = bbmax[idim] = aXYZ[idim]; }
+  for(unsigned int ip=0;ip<np;++ip){
+    for(int idim=0;idim<3;++idim){
+      bbmin[idim] = (aXYZ[ip*3+idim] < bbmin[idim]) ? aXYZ[ip*3+idim] : bbmin[idim];
+      bbmax[idim] = (aXYZ[ip*3+idim] > bbmax[idim]) ? aXYZ[ip*3+idim] : bbmax[idim];
+    }
+  }
+}
+
+}
+}
+
+// ------------------------------------
+
+DFM2_INLINE void delfem2::Permutation_ReverseCuthillMcKee(
+    std::vector<unsigned int>& aOld2New,
+    const std::vector<unsigned int>& psup_ind,
+    const std::vector<unsigned int>& psup)
+{
+  assert( !psup_ind.empty() );
+  const unsigned int np = static_cast<unsigned int>(psup_ind.size()-1);
+  std::vector<unsigned int> aNew2Old;
+  aNew2Old.reserve(np);
+  std::vector<unsigned int> aLevel(np,UINT_MAX);
+  std::vector<unsigned int> aOrder;
+  // visit points with small degree first to find good starting point
+  std::vector<std::pair<unsigned int,unsigned int> > aDegPoint(np);
+  for(unsigned int ip=0;ip<np;++ip){
+    aDegPoint[ip] = std::make_pair(psup_ind[ip+1]-psup_ind[ip],ip);
+  }
+  std::sort(aDegPoint.begin(),aDegPoint.end());
+  for(const auto& dp : aDegPoint){
+    const unsigned int ip0 = dp.second;
+    if( aLevel[ip0] != UINT_MAX ){ continue; } // already in other connected component
+    const unsigned int ip_ker = mshreorder::PseudoPeripheralPoint(ip0,aLevel,psup_ind,psup);
+    mshreorder::LevelStructure(aOrder,aLevel,ip_ker,psup_ind,psup,false);
+    aNew2Old.insert(aNew2Old.end(),aOrder.begin(),aOrder.end());
+  }
+  assert( aNew2Old.size() == np );
+  aOld2New.resize(np);
+  for(unsigned int ip=0;ip<np;++ip){
+    aOld2New[aNew2Old[ip]] = np-1-ip; // reverse
+  }
+}
+
+template <typename REAL>
+DFM2_INLINE void delfem2::Permutation_MortonCode(
+    std::vector<unsigned int>& aOld2New,
+    const std::vector<REAL>& aXYZ)
+{
+  const size_t np = aXYZ.size()/3;
+  if( np == 0 ){ aOld2New.clear(); return; }
+  REAL bbmin[3], bbmax[3];
+  mshreorder::BoundingBox3(bbmin,bbmax,aXYZ);
+  std::vector<unsigned int> aSortedId;
+  std::vector<std::uint32_t> aSortedMc;
+  SortedMortenCode_Points3(aSortedId,aSortedMc,
+      aXYZ,bbmin,bbmax);
+  aOld2New.resize(np);
+  for(unsigned int ip=0;ip<np;++ip){
+    aOld2New[aSortedId[ip]] = ip;
+  }
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::Permutation_MortonCode(
+    std::vector<unsigned int>& aOld2New,
+    const std::vector<float>& aXYZ);
+template void delfem2::Permutation_MortonCode(
+    std::vector<unsigned int>& aOld2New,
+    const std::vector<double>& aXYZ);
+#endif
+
+template <typename REAL>
+DFM2_INLINE std::uint32_t delfem2::HilbertCode(REAL x, REAL y, REAL z)
+{
+  std::uint32_t X[3] = {
+      (std::uint32_t)fmin(fmax(x * 1024.0f, 0.0f), 1023.0f),
+      (std::uint32_t)fmin(fmax(y * 1024.0f, 0.0f), 1023.0f),
+      (std::uint32_t)fmin(fmax(z * 1024.0f, 0.0f), 1023.0f) };
+  mshreorder::AxesToTranspose3(X,10);
+  std::uint32_t ixyz = 0;
+  for(int ibit=9;ibit>=0;--ibit){ // interleave the transposed index
+    for(unsigned int i=0;i<3;++i){
+      ixyz = (ixyz << 1) | ((X[i]>>ibit)&1u);
+    }
+  }
+  return ixyz;
+}
+#ifndef DFM2_HEADER_ONLY
+template std::uint32_t delfem2::HilbertCode(float x, float y, float z);
+template std::uint32_t delfem2::HilbertCode(double x, double y, double z);
+#endif
+
+template <typename REAL>
+DFM2_INLINE void delfem2::Permutation_HilbertCurve(
+    std::vector<unsigned int>& aOld2New,
+    const std::vector<REAL>& aXYZ)
+{
+  const size_t np = aXYZ.size()/3;
+  if( np == 0 ){ aOld2New.clear(); return; }
+  REAL bbmin[3], bbmax[3];
+  mshreorder::BoundingBox3(bbmin,bbmax,aXYZ);
+  REAL invlen[3];
+  for(int idim=0;idim<3;++idim){
+    const REAL len = bbmax[idim]-bbmin[idim];
+    invlen[idim] = ( len > 0 ) ? 1/len : 0;
+  }
+  std::vector<std::pair<std::uint32_t,unsigned int> > aCodeId(np);
+  for(unsigned int ip=0;ip<np;++ip){
+    const REAL x = (aXYZ[ip*3+0]-bbmin[0])*invlen[0];
+    const REAL y = (aXYZ[ip*3+1]-bbmin[1])*invlen[1];
+    const REAL z = (aXYZ[ip*3+2]-bbmin[2])*invlen[2];
+    aCodeId[ip] = std::make_pair(HilbertCode(x,y,z),ip);
+  }
+  std::sort(aCodeId.begin(),aCodeId.end());
+  aOld2New.resize(np);
+  for(unsigned int ip=0;ip<np;++ip){
+    aOld2New[aCodeId[ip].second] = ip;
+  }
+}
+#ifndef DFM2_HEADER_ONLY
+template void delfem2::Permutation_HilbertCurve(
+    std::vector<unsigned int>& aOld2New,
+    const std::vector<float>& aXYZ);
+template void delfem2::Permutation_HilbertCurve(
+    std::vector<unsigned int>& aOld2New,
+    const std::vector<double>& aXYZ);
+#endif
+
+// ------------------------------------
+
+DFM2_INLINE void delfem2::Permutation_Inverse(
+    std::vector<unsigned int>& aNew2Old,
+    const std::vector<unsigned int>& aOld2New)
+{
+  const size_t np = aOld2New.size();
+  aNew2Old.assign(np,UINT_MAX);
+  for(unsigned int ip0=0;ip0<np;++ip0){
+    const unsigned int ip1 = aOld2New[ip0];
+    assert( ip1 < np && aNew2Old[ip1] == UINT_MAX );
+    aNew2Old[ip1] = ip0;
+  }
+}
+
+DFM2_INLINE unsigned int delfem2::Bandwidth_JArray(
+    const std::vector<unsigned int>& psup_ind,
+    const std::vector<unsigned int>& psup)
+{
+  unsigned int nbw = 0;
+  for(unsigned int ip=0;ip+1<psup_ind.size();++ip){
+    for(unsigned int ipsup=psup_ind[ip];ipsup<psup_ind[ip+1];++ipsup){
+      const unsigned int jp = psup[ipsup];
+      const unsigned int ibw = (ip > jp) ? ip-jp : jp-ip;
+      nbw = (ibw > nbw) ? ibw : nbw;
+    }
+  }
+  return nbw;
+}
+
+DFM2_INLINE void delfem2::JArray_Permute(
+    std::vector<unsigned int>& psup_ind,
+    std::vector<unsigned int>& psup,
+    const std::vector<unsigned int>& aOld2New)
+{
+  const size_t np = aOld2New.size();
+  assert( psup_ind.size() == np+1 );
+  const std::vector<unsigned int> psup_ind0 = psup_ind;
+  const std::vector<unsigned int> psup0 = psup;
+  psup_ind.assign(np+1,0);
+  for(unsigned int ip0=0;ip0<np;++ip0){
+    psup_ind[aOld2New[ip0]+1] = psup_ind0[ip0+1]-psup_ind0[ip0];
+  }
+  for(unsigned int ip=0;ip<np;++ip){
+    psup_ind[ip+1] += psup_ind[ip];
+  }
+  for(unsigned int ip0=0;ip0<np;++ip0){
+    const unsigned int ip1 = aOld2New[ip0];
+    unsigned int ipsup1 = psup_ind[ip1];
+    for(unsigned int ipsup0=psup_ind0[ip0];ipsup0<psup_ind0[ip0+1];++ipsup0){
+      psup[ipsup1] = aOld2New[psup0[ipsup0]];
+      ++ipsup1;
+    }
+    std::sort(psup.begin()+psup_ind[ip1],psup.begin()+psup_ind[ip1+1]);
+  }
+}
+
+DFM2_INLINE void delfem2::PermuteElemIndex(
+    std::vector<unsigned int>& aElem,
+    const std::vector<unsigned int>& aOld2New)
+{
+  for(auto& ip : aElem){
+    assert( ip < aOld2New.size() );
+    ip = aOld2New[ip];
+  }
+}
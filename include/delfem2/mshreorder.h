@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file functions to renumber the points of a mesh to improve the memory locality
+ * @details a permutation is stored as "aOld2New" where aOld2New[ip_old] = ip_new.
+ * Apply the same permutation to the coordinates, the element index, the BC flags and the solution vectors.
+ */
+
+#ifndef DFM2_MSHREORDER_H
+#define DFM2_MSHREORDER_H
+
+#include "delfem2/dfm2_inline.h"
+#include <vector>
+#include <cassert>
+#include <cstdint>
+
+namespace delfem2 {
+
+/**
+ * @brief reverse Cuthill-McKee ordering of the graph given as a jagged array
+ * @param aOld2New (out) permutation of points. aOld2New[ip_old] = ip_new
+ * @param psup_ind (in) index of jagged array (size: np+1)
+ * @param psup (in) point surrounding point
+ * @details each connected component is started from a pseudo-peripheral point
+ */
+DFM2_INLINE void Permutation_ReverseCuthillMcKee(
+    std::vector<unsigned int>& aOld2New,
+    const std::vector<unsigned int>& psup_ind,
+    const std::vector<unsigned int>& psup);
+
+/**
+ * @brief ordering of the points along the z-curve using the Morton code
+ * @param aOld2New (out) permutation of points. aOld2New[ip_old] = ip_new
+ * @details defined for "float" and "double"
+ */
+template <typename REAL>
+DFM2_INLINE void Permutation_MortonCode(
+    std::vector<unsigned int>& aOld2New,
+    const std::vector<REAL>& aXYZ);
+
+/**
+ * @brief 30bit code of the point along the 3D Hilbert curve. Each coordinate must be within the range of [0,1]
+ * @details defined for "float" and "double". The algorithm is from
+ * J. Skilling "Programming the Hilbert curve" AIP Conference Proceedings 707, 381 (2004)
+ */
+template <typename REAL>
+DFM2_INLINE std::uint32_t HilbertCode(REAL x, REAL y, REAL z);
+
+/**
+ * @brief ordering of the points along the Hilbert curve
+ * @param aOld2New (out) permutation of points. aOld2New[ip_old] = ip_new
+ * @details defined for "float" and "double".
+ * Unlike the z-curve, the consecutive points along the curve are always adjacent.
+ */
+template <typename REAL>
+DFM2_INLINE void Permutation_HilbertCurve(
+    std::vector<unsigned int>& aOld2New,
+    const std::vector<REAL>& aXYZ);
+
+/**
+ * @brief compute inverse permutation
+ */
+DFM2_INLINE void Permutation_Inverse(
+    std::vector<unsigned int>& aNew2Old,
+    const std::vector<unsigned int>& aOld2New);
+
+/**
+ * @brief maximum of |ip-jp| for all the pairs in the jagged array
+ */
+DFM2_INLINE unsigned int Bandwidth_JArray(
+    const std::vector<unsigned int>& psup_ind,
+    const std::vector<unsigned int>& psup);
+
+/**
+ * @brief renumber the jagged array (e.g., psup) with the permutation
+ * @details the entries in each row are sorted
+ */
+DFM2_INLINE void JArray_Permute(
+    std::vector<unsigned int>& psup_ind,
+    std::vector<unsigned int>& psup,
+    const std::vector<unsigned int>& aOld2New);
+
+/**
+ * @brief renumber the point index in the element array
+ * @param aElem (in&out) element index array (e.g., aTri, aTet, aLine)
+ */
+DFM2_INLINE void PermuteElemIndex(
+    std::vector<unsigned int>& aElem,
+    const std::vector<unsigned int>& aOld2New);
+
+/**
+ * @brief move values on points (e.g., coordinates, BC flags, solution vectors) to the new location
+ * @param aVal (in&out) values on points. The size need to be ndim*np
+ * @param ndim number of values per point (e.g. 3 for 3D coordinates)
+ */
+template <typename T>
+void PermuteValues(
+    std::vector<T>& aVal,
+    unsigned int ndim,
+    const std::vector<unsigned int>& aOld2New)
+{
+  const size_t np = aOld2New.size();
+  assert( aVal.size() == np*ndim );
+  const std::vector<T> aVal0 = aVal;
+  for(unsigned int ip0=0;ip0<np;++ip0){
+    const unsigned int ip1 = aOld2New[ip0];
+    for(unsigned int idim=0;idim<ndim;++idim){
+      aVal[ip1*ndim+idim] = aVal0[ip0*ndim+idim];
+    }
+  }
+}
+
+} // end namespace delfem2
+
+#ifdef DFM2_HEADER_ONLY
+#  include "delfem2/mshreorder.cpp"
+#endif
+
+#endif /* DFM2_MSHREORDER_H */
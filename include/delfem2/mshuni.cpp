@@ -314,6 +314,113 @@ DFM2_INLINE void delfem2::JArray_PSuP_MeshElem(
 	  pElem, elsup_ind,elsup, nPoEl, nPo);
 }
 
+DFM2_INLINE void delfem2::JArray_ColorElem_MeshElem(
+    std::vector<unsigned int>& color_ind,
+    std::vector<unsigned int>& color_elem,
+    //
+    const unsigned int* pElem,
+    size_t nEl,
+    unsigned int nPoEl,
+    size_t nPo)
+{
+  std::vector<unsigned int> elsup_ind, elsup;
+  JArray_ElSuP_MeshElem(
+      elsup_ind, elsup,
+      pElem, nEl, nPoEl, nPo);
+  std::vector<unsigned int> aColor(nEl,UINT_MAX);
+  std::vector<unsigned int> aStamp; // aStamp[icolor]==iel if icolor is used around iel
+  unsigned int ncolor = 0;
+  for(unsigned int iel=0;iel<nEl;++iel){
+    for(unsigned int inoel=0;inoel<nPoEl;++inoel){
+      const unsigned int ip = pElem[iel*nPoEl+inoel];
+      for(unsigned int ielsup=elsup_ind[ip];ielsup<elsup_ind[ip+1];++ielsup){
+        const unsigned int jel = elsup[ielsup];
+        if( aColor[jel] == UINT_MAX ){ continue; }
+        aStamp[aColor[jel]] = iel;
+      }
+    }
+    unsigned int icolor = 0;
+    for(;icolor<ncolor;++icolor){
+      if( aStamp[icolor] != iel ){ break; }
+    }
+    if( icolor == ncolor ){
+      ncolor++;
+      aStamp.push_back(UINT_MAX);
+    }
+    aColor[iel] = icolor;
+  }
+  color_ind.assign(ncolor+1,0);
+  for(unsigned int iel=0;iel<nEl;++iel){ color_ind[aColor[iel]+1]++; }
+  for(unsigned int icolor=0;icolor<ncolor;++icolor){ color_ind[icolor+1] += color_ind[icolor]; }
+  color_elem.resize(nEl);
+  for(unsigned int iel=0;iel<nEl;++iel){
+    const unsigned int icolor = aColor[iel];
+    color_elem[color_ind[icolor]] = iel;
+    color_ind[icolor]++;
+  }
+  for(unsigned int icolor=ncolor;icolor>0;--icolor){ color_ind[icolor] = color_ind[icolor-1]; }
+  color_ind[0] = 0;
+}
+
+DFM2_INLINE void delfem2::JArray_ColorElem_JArrayElem(
+    std::vector<unsigned int>& color_ind,
+    std::vector<unsigned int>& color_elem,
+    //
+    const unsigned int* elem_ind,
+    size_t nEl,
+    const unsigned int* elem,
+    size_t nPo)
+{
+  std::vector<unsigned int> elsup_ind(nPo+1,0), elsup;
+  for(unsigned int iel=0;iel<nEl;++iel){
+    for(unsigned int iip=elem_ind[iel];iip<elem_ind[iel+1];++iip){ elsup_ind[elem[iip]+1]++; }
+  }
+  for(unsigned int ip=0;ip<nPo;++ip){ elsup_ind[ip+1] += elsup_ind[ip]; }
+  elsup.resize(elsup_ind[nPo]);
+  for(unsigned int iel=0;iel<nEl;++iel){
+    for(unsigned int iip=elem_ind[iel];iip<elem_ind[iel+1];++iip){
+      const unsigned int ip = elem[iip];
+      elsup[elsup_ind[ip]] = iel;
+      elsup_ind[ip]++;
+    }
+  }
+  for(unsigned int ip=nPo;ip>0;--ip){ elsup_ind[ip] = elsup_ind[ip-1]; }
+  elsup_ind[0] = 0;
+  std::vector<unsigned int> aColor(nEl,UINT_MAX);
+  std::vector<unsigned int> aStamp; // aStamp[icolor]==iel if icolor is used around iel
+  unsigned int ncolor = 0;
+  for(unsigned int iel=0;iel<nEl;++iel){
+    for(unsigned int iip=elem_ind[iel];iip<elem_ind[iel+1];++iip){
+      const unsigned int ip = elem[iip];
+      for(unsigned int ielsup=elsup_ind[ip];ielsup<elsup_ind[ip+1];++ielsup){
+        const unsigned int jel = elsup[ielsup];
+        if( aColor[jel] == UINT_MAX ){ continue; }
+        aStamp[aColor[jel]] = iel;
+      }
+    }
+    unsigned int icolor = 0;
+    for(;icolor<ncolor;++icolor){
+      if( aStamp[icolor] != iel ){ break; }
+    }
+    if( icolor == ncolor ){
+      ncolor++;
+      aStamp.push_back(UINT_MAX);
+    }
+    aColor[iel] = icolor;
+  }
+  color_ind.assign(ncolor+1,0);
+  for(unsigned int iel=0;iel<nEl;++iel){ color_ind[aColor[iel]+1]++; }
+  for(unsigned int icolor=0;icolor<ncolor;++icolor){ color_ind[icolor+1] += color_ind[icolor]; }
+  color_elem.resize(nEl);
+  for(unsigned int iel=0;iel<nEl;++iel){
+    const unsigned int icolor = aColor[iel];
+    color_elem[color_ind[icolor]] = iel;
+    color_ind[icolor]++;
+  }
+  for(unsigned int icolor=ncolor;icolor>0;--icolor){ color_ind[icolor] = color_ind[icolor-1]; }
+  color_ind[0] = 0;
+}
+
 DFM2_INLINE void delfem2::makeOneRingNeighborhood_TriFan(
     std::vector<int>& psup_ind,
     std::vector<int>& psup,
@@ -159,6 +159,36 @@ DFM2_INLINE void JArray_PSuP_MeshElem(
     unsigned int nPoEl,
     size_t nPo);
 
+/**
+ * @brief greedy coloring of elements such that the elements in the same color do not share a point
+ * @details the elements in the same color can be merged to the matrix or projected in parallel without race
+ * @param color_ind (out) index of jagged array. color_ind.size()-1 is the number of colors
+ * @param color_elem (out) element index sorted by the color. Each color keeps the original order of elements.
+ * @param nPoEl number of nodes in an element
+ */
+DFM2_INLINE void JArray_ColorElem_MeshElem(
+    std::vector<unsigned int>& color_ind,
+    std::vector<unsigned int>& color_elem,
+    //
+    const unsigned int* pElem,
+    size_t nEl,
+    unsigned int nPoEl,
+    size_t nPo);
+
+/**
+ * @brief greedy coloring of the elements with variable number of points (e.g., clusters of points)
+ * @details same as "JArray_ColorElem_MeshElem" but the elements are given as a jagged array
+ * @param elem_ind (in) index of jagged array of the points in the elements
+ */
+DFM2_INLINE void JArray_ColorElem_JArrayElem(
+    std::vector<unsigned int>& color_ind,
+    std::vector<unsigned int>& color_elem,
+    //
+    const unsigned int* elem_ind,
+    size_t nEl,
+    const unsigned int* elem,
+    size_t nPo);
+
 DFM2_INLINE void makeOneRingNeighborhood_TriFan(
     std::vector<int>& psup_ind,
     std::vector<int>& psup,
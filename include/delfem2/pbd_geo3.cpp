@@ -5,6 +5,8 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cmath>
+#include <algorithm>
 #include "delfem2/geo3_v23m34q.h"
 #include "delfem2/pbd_geo3.h"
 
@@ -128,7 +130,7 @@ DFM2_INLINE void delfem2::PBD_ConstProj_Rigid3D
     for (int iip=clstr_ind[iclstr];iip<clstr_ind[iclstr+1]; iip++){
       const int ip = clstr[iip];
       const CVec3d dq = CVec3d(aXYZ0[ip*3+0],aXYZ0[ip*3+1],aXYZ0[ip*3+2])-qc; // undeform
-      const CVec3d dp = CVec3d(aXYZt[ip*3+0],aXYZt[ip*3+1],aXYZ0[ip*3+2])-pc; // deform
+      const CVec3d dp = CVec3d(aXYZt[ip*3+0],aXYZt[ip*3+1],aXYZt[ip*3+2])-pc; // deform
       A[0*3+0] += dp[0]*dq[0];
       A[0*3+1] += dp[0]*dq[1];
       A[0*3+2] += dp[0]*dq[2];
@@ -198,6 +200,168 @@ DFM2_INLINE void delfem2::PBD_ConstProj_Rigid2D(
 }
 
 
+// ----------------------------------------
+
+namespace delfem2 {
+namespace pbd_geo3 {
+
+/**
+ * @brief goal positions of the points in a cluster by matching the rest shape
+ * @param q (in&out) rotation of the cluster as the quaternion. Used only in 3D
+ */
+DFM2_INLINE void GoalPositions_ShapeMatching(
+    double* aGoal,
+    double* q,
+    unsigned int ndim,
+    unsigned int nitr_rot,
+    unsigned int nnode,
+    const unsigned int* aIP,
+    const double* aDq,
+    const double* aXYZt)
+{
+  double pc[3] = {0,0,0};
+  for(unsigned int inode=0;inode<nnode;++inode){
+    for(unsigned int idim=0;idim<ndim;++idim){ pc[idim] += aXYZt[aIP[inode]*ndim+idim]; }
+  }
+  for(unsigned int idim=0;idim<ndim;++idim){ pc[idim] /= nnode; }
+  if( ndim == 2 ){
+    double A[4] = {0,0,0,0};
+    for(unsigned int inode=0;inode<nnode;++inode){
+      const double* dq = aDq+inode*2;
+      const double dp[2] = { aXYZt[aIP[inode]*2+0]-pc[0], aXYZt[aIP[inode]*2+1]-pc[1] };
+      A[0*2+0] += dp[0]*dq[0];
+      A[0*2+1] += dp[0]*dq[1];
+      A[1*2+0] += dp[1]*dq[0];
+      A[1*2+1] += dp[1]*dq[1];
+    }
+    double R[4]; RotationalComponentOfMatrix2(R,A);
+    for(unsigned int inode=0;inode<nnode;++inode){
+      const double* dq = aDq+inode*2;
+      aGoal[inode*2+0] = pc[0] + R[0]*dq[0] + R[1]*dq[1];
+      aGoal[inode*2+1] = pc[1] + R[2]*dq[0] + R[3]*dq[1];
+    }
+    return;
+  }
+  double A[9] = {0,0,0, 0,0,0, 0,0,0};
+  for(unsigned int inode=0;inode<nnode;++inode){
+    const double* dq = aDq+inode*3;
+    const double dp[3] = {
+        aXYZt[aIP[inode]*3+0]-pc[0],
+        aXYZt[aIP[inode]*3+1]-pc[1],
+        aXYZt[aIP[inode]*3+2]-pc[2] };
+    for(int i=0;i<3;++i){
+      for(int j=0;j<3;++j){ A[i*3+j] += dp[i]*dq[j]; }
+    }
+  }
+  Quat_RotationalPart(q, A, nitr_rot);
+  double R[9]; Mat3_Quat(R, q);
+  for(unsigned int inode=0;inode<nnode;++inode){
+    const double* dq = aDq+inode*3;
+    for(int i=0;i<3;++i){
+      aGoal[inode*3+i] = pc[i] + R[i*3+0]*dq[0] + R[i*3+1]*dq[1] + R[i*3+2]*dq[2];
+    }
+  }
+}
+
+}
+}
+
+DFM2_INLINE void delfem2::CPBD_ShapeMatching::Initialize(
+    unsigned int ndim_,
+    const std::vector<unsigned int>& clstr_ind_,
+    const std::vector<unsigned int>& clstr_,
+    const std::vector<double>& aXYZ0)
+{
+  assert( ndim_ == 2 || ndim_ == 3 );
+  assert( !clstr_ind_.empty() && clstr_ind_.back() == clstr_.size() );
+  ndim = ndim_;
+  clstr_ind = clstr_ind_;
+  clstr = clstr_;
+  const unsigned int np = static_cast<unsigned int>(aXYZ0.size()/ndim);
+  const unsigned int nclstr = NumCluster();
+  aDq.resize(clstr.size()*ndim);
+  for(unsigned int iclstr=0;iclstr<nclstr;++iclstr){
+    const unsigned int nnode = clstr_ind[iclstr+1]-clstr_ind[iclstr];
+    double qc[3] = {0,0,0};
+    for(unsigned int iip=clstr_ind[iclstr];iip<clstr_ind[iclstr+1];++iip){
+      const unsigned int ip = clstr[iip]; assert( ip < np );
+      for(unsigned int idim=0;idim<ndim;++idim){ qc[idim] += aXYZ0[ip*ndim+idim]; }
+    }
+    for(unsigned int idim=0;idim<ndim;++idim){ qc[idim] /= nnode; }
+    for(unsigned int iip=clstr_ind[iclstr];iip<clstr_ind[iclstr+1];++iip){
+      for(unsigned int idim=0;idim<ndim;++idim){
+        aDq[iip*ndim+idim] = aXYZ0[clstr[iip]*ndim+idim] - qc[idim];
+      }
+    }
+  }
+  aQuat.resize(nclstr*4);
+  for(unsigned int iclstr=0;iclstr<nclstr;++iclstr){ Quat_Identity(aQuat.data()+iclstr*4); }
+  JArray_ColorElem_JArrayElem(
+      aColorInd, aOrder,
+      clstr_ind.data(), nclstr, clstr.data(), np);
+  psuc_ind.assign(np+1,0);
+  for(unsigned int ip : clstr){ psuc_ind[ip+1]++; }
+  for(unsigned int ip=0;ip<np;++ip){ psuc_ind[ip+1] += psuc_ind[ip]; }
+  psuc.resize(psuc_ind[np]);
+  for(unsigned int iip=0;iip<clstr.size();++iip){ // entries are sorted for each point
+    const unsigned int ip = clstr[iip];
+    psuc[psuc_ind[ip]] = iip;
+    psuc_ind[ip]++;
+  }
+  for(unsigned int ip=np;ip>0;--ip){ psuc_ind[ip] = psuc_ind[ip-1]; }
+  psuc_ind[0] = 0;
+  aGoal.resize(clstr.size()*ndim);
+}
+
+DFM2_INLINE void delfem2::CPBD_ShapeMatching::Project(
+    double* aXYZt,
+    double stiffness,
+    bool is_jacobi,
+    unsigned int nthread)
+{
+  auto goal = [&](unsigned int iclstr){
+    const unsigned int iip0 = clstr_ind[iclstr];
+    pbd_geo3::GoalPositions_ShapeMatching(
+        aGoal.data()+iip0*ndim, aQuat.data()+iclstr*4,
+        ndim, nitr_rot,
+        clstr_ind[iclstr+1]-iip0, clstr.data()+iip0, aDq.data()+iip0*ndim,
+        aXYZt);
+  };
+  if( !is_jacobi ){
+    for(unsigned int icolor=0;icolor<NumColor();++icolor){
+      const unsigned int jc0 = aColorInd[icolor];
+      thread::parallel_for(
+          aColorInd[icolor+1]-jc0,
+          [&](unsigned int jc){
+            const unsigned int iclstr = aOrder[jc0+jc];
+            goal(iclstr);
+            for(unsigned int iip=clstr_ind[iclstr];iip<clstr_ind[iclstr+1];++iip){
+              const unsigned int ip = clstr[iip];
+              for(unsigned int idim=0;idim<ndim;++idim){
+                aXYZt[ip*ndim+idim] = stiffness*aGoal[iip*ndim+idim] + (1-stiffness)*aXYZt[ip*ndim+idim];
+              }
+            }
+          },
+          nthread);
+    }
+    return;
+  }
+  thread::parallel_for(NumCluster(), goal, nthread);
+  thread::parallel_for(
+      static_cast<unsigned int>(psuc_ind.size()-1),
+      [&](unsigned int ip){
+        const unsigned int nc = psuc_ind[ip+1]-psuc_ind[ip];
+        if( nc == 0 ){ return; }
+        for(unsigned int idim=0;idim<ndim;++idim){
+          double g = 0.0;
+          for(unsigned int ipsuc=psuc_ind[ip];ipsuc<psuc_ind[ip+1];++ipsuc){ g += aGoal[psuc[ipsuc]*ndim+idim]; }
+          g /= nc;
+          aXYZt[ip*ndim+idim] = stiffness*g + (1-stiffness)*aXYZt[ip*ndim+idim];
+        }
+      },
+      nthread);
+}
+
 DFM2_INLINE void delfem2::PBD_CdC_TriStrain2D3D(
     double C[3],
     double dCdp[3][9],
@@ -488,6 +652,190 @@ DFM2_INLINE void delfem2::PBD_Seam(
   }
 }
 
+DFM2_INLINE void delfem2::PBD_CdC_Distance(
+    double& C,
+    double dCdp[6],
+    double L0,
+    const double p[2][3])
+{
+  const double v[3] = {p[0][0]-p[1][0], p[0][1]-p[1][1], p[0][2]-p[1][2]};
+  const double l = Length3(v);
+  for(int i=0;i<6;++i){ dCdp[i] = 0.0; }
+  if( l < 1.0e-20 ){ C = 0.0; return; } // direction is not defined
+  C = l-L0;
+  for(int idim=0;idim<3;++idim){
+    dCdp[0*3+idim] = +v[idim]/l;
+    dCdp[1*3+idim] = -v[idim]/l;
+  }
+}
+
+DFM2_INLINE bool delfem2::PBD_DeltaConst_XPBD(
+    double* dp,
+    double* dlambda,
+    unsigned int nnode,
+    unsigned int ncons,
+    const double* C,
+    const double* dCdp,
+    const double* aInvMass,
+    const double* lambda,
+    double alpha_tilde)
+{
+  const unsigned int nconsmax = 8;
+  assert( ncons <= nconsmax );
+  const unsigned int n = nnode*3;
+  // A = dCdp M^-1 dCdp^T + alpha_tilde I,  b = -C - alpha_tilde*lambda
+  double A[nconsmax][nconsmax], b[nconsmax];
+  double amax = 0.0;
+  for(unsigned int i=0;i<ncons;++i){
+    for(unsigned int j=0;j<ncons;++j){
+      double v = (i==j) ? alpha_tilde : 0.0;
+      for(unsigned int k=0;k<n;++k){ v += dCdp[i*n+k]*aInvMass[k/3]*dCdp[j*n+k]; }
+      A[i][j] = v;
+      amax = (fabs(v) > amax) ? fabs(v) : amax;
+    }
+    b[i] = -C[i] - alpha_tilde*lambda[i];
+  }
+  if( amax == 0.0 ){ return false; }
+  // Gaussian elimination with partial pivoting
+  unsigned int aPerm[nconsmax];
+  for(unsigned int i=0;i<ncons;++i){ aPerm[i] = i; }
+  for(unsigned int i=0;i<ncons;++i){
+    unsigned int ipiv = i;
+    for(unsigned int j=i+1;j<ncons;++j){
+      if( fabs(A[aPerm[j]][i]) > fabs(A[aPerm[ipiv]][i]) ){ ipiv = j; }
+    }
+    std::swap(aPerm[i], aPerm[ipiv]);
+    const unsigned int ir = aPerm[i];
+    if( fabs(A[ir][i]) < 1.0e-12*amax ){ return false; }
+    for(unsigned int j=i+1;j<ncons;++j){
+      const unsigned int jr = aPerm[j];
+      const double r = A[jr][i]/A[ir][i];
+      for(unsigned int k=i;k<ncons;++k){ A[jr][k] -= r*A[ir][k]; }
+      b[jr] -= r*b[ir];
+    }
+  }
+  for(unsigned int i=ncons;i-->0;){
+    const unsigned int ir = aPerm[i];
+    double v = b[ir];
+    for(unsigned int k=i+1;k<ncons;++k){ v -= A[ir][k]*dlambda[k]; }
+    dlambda[i] = v/A[ir][i];
+  }
+  for(unsigned int k=0;k<n;++k){
+    double v = 0.0;
+    for(unsigned int i=0;i<ncons;++i){ v += dCdp[i*n+k]*dlambda[i]; }
+    dp[k] = aInvMass[k/3]*v;
+  }
+  return true;
+}
+
+// ----------------------------------------
+
+DFM2_INLINE void delfem2::CXPBD_Cloth::Initialize(
+    const std::vector<double>& aXYZ_,
+    const std::vector<unsigned int>& aTri,
+    const std::vector<double>& aXY0,
+    double density)
+{
+  const size_t np = aXYZ_.size()/3;
+  assert( aXY0.size() == np*2 );
+  const unsigned int ntri = static_cast<unsigned int>(aTri.size()/3);
+  aXYZ = aXYZ_;
+  aXYZt = aXYZ_;
+  aUVW.assign(np*3, 0.0);
+  { // lumped mass
+    std::vector<double> aMass(np, 0.0);
+    for(unsigned int it=0;it<ntri;++it){
+      const unsigned int* aIP = aTri.data()+it*3;
+      const double* p0 = aXY0.data()+aIP[0]*2;
+      const double* p1 = aXY0.data()+aIP[1]*2;
+      const double* p2 = aXY0.data()+aIP[2]*2;
+      const double a = 0.5*fabs((p1[0]-p0[0])*(p2[1]-p0[1])-(p2[0]-p0[0])*(p1[1]-p0[1]));
+      for(unsigned int inode=0;inode<3;++inode){ aMass[aIP[inode]] += density*a/3.0; }
+    }
+    aInvMass.resize(np);
+    for(unsigned int ip=0;ip<np;++ip){ aInvMass[ip] = (aMass[ip] > 0.0) ? 1.0/aMass[ip] : 0.0; }
+  }
+  { // stretch
+    std::vector<double> aRest(ntri*6);
+    for(unsigned int it=0;it<ntri;++it){
+      for(unsigned int inode=0;inode<3;++inode){
+        aRest[it*6+inode*2+0] = aXY0[aTri[it*3+inode]*2+0];
+        aRest[it*6+inode*2+1] = aXY0[aTri[it*3+inode]*2+1];
+      }
+    }
+    batch_stretch.Initialize(aTri.data(), ntri, aRest.data(), 6, np);
+  }
+  { // bend
+    std::vector<unsigned int> aQuad;
+    ElemQuad_DihedralTri(aQuad, aTri.data(), ntri, static_cast<unsigned int>(np));
+    const unsigned int nquad = static_cast<unsigned int>(aQuad.size()/4);
+    std::vector<double> aRest(nquad*12);
+    for(unsigned int iq=0;iq<nquad;++iq){
+      for(unsigned int inode=0;inode<4;++inode){
+        aRest[iq*12+inode*3+0] = aXY0[aQuad[iq*4+inode]*2+0];
+        aRest[iq*12+inode*3+1] = aXY0[aQuad[iq*4+inode]*2+1];
+        aRest[iq*12+inode*3+2] = 0.0;
+      }
+    }
+    batch_bend.Initialize(aQuad.data(), nquad, aRest.data(), 12, np);
+  }
+  batch_seam.Initialize(nullptr, 0, nullptr, 1, np);
+}
+
+DFM2_INLINE void delfem2::CXPBD_Cloth::SetSeam(
+    const std::vector<unsigned int>& aLine)
+{
+  const std::vector<double> aRest(aLine.size()/2, 0.0);
+  batch_seam.Initialize(aLine.data(), aLine.size()/2, aRest.data(), 1, aXYZ.size()/3);
+}
+
+DFM2_INLINE void delfem2::CXPBD_Cloth::Step(
+    double dt,
+    unsigned int nsubstep,
+    unsigned int nthread)
+{
+  const unsigned int np = static_cast<unsigned int>(aXYZ.size()/3);
+  nsubstep = std::max(nsubstep, 1u);
+  const double h = dt/nsubstep;
+  aXYZt.resize(np*3);
+  for(unsigned int isubstep=0;isubstep<nsubstep;++isubstep){
+    thread::parallel_for(
+        np,
+        [&](unsigned int ip){
+          if( aInvMass[ip] == 0.0 ){
+            for(int idim=0;idim<3;++idim){ aXYZt[ip*3+idim] = aXYZ[ip*3+idim]; }
+            return;
+          }
+          for(int idim=0;idim<3;++idim){
+            aXYZt[ip*3+idim] = aXYZ[ip*3+idim] + h*aUVW[ip*3+idim] + h*h*gravity[idim];
+          }
+        },
+        nthread);
+    batch_stretch.ResetMultiplier();
+    batch_bend.ResetMultiplier();
+    batch_seam.ResetMultiplier();
+    batch_stretch.Project(
+        aXYZt.data(), aInvMass.data(), CPBD_CdC_TriStrain2D3D(),
+        compliance_stretch, h, false, 1.0, nthread);
+    batch_bend.Project(
+        aXYZt.data(), aInvMass.data(), CPBD_CdC_QuadBend(),
+        compliance_bend, h, false, 1.0, nthread);
+    batch_seam.Project(
+        aXYZt.data(), aInvMass.data(), CPBD_CdC_Distance(),
+        compliance_seam, h, false, 1.0, nthread);
+    thread::parallel_for(
+        np,
+        [&](unsigned int ip){
+          if( aInvMass[ip] == 0.0 ){ return; }
+          for(int idim=0;idim<3;++idim){
+            aUVW[ip*3+idim] = (aXYZt[ip*3+idim]-aXYZ[ip*3+idim])/h;
+            aXYZ[ip*3+idim] = aXYZt[ip*3+idim];
+          }
+        },
+        nthread);
+  }
+}
+
 template <typename T>
 DFM2_INLINE void delfem2::GetConstConstDiff_Bend(
     double& C, CVec3<T> dC[4],
@@ -13,6 +13,8 @@
 #include <vector>
 #include "delfem2/mat3.h"
 #include "delfem2/vec3.h"
+#include "delfem2/mshuni.h"
+#include "delfem2/thread/th.h"
 
 namespace delfem2 {
 
@@ -62,6 +64,51 @@ DFM2_INLINE void PBD_ConstProj_Rigid3D(
     const int* clstr,     int nclstr0,
     const double* aXYZ0,   int nXYZ0);
 
+/**
+ * @brief shape matching of overlapping rigid clusters with the precomputed rest shapes
+ * @details the rest centroids and the rest offsets of the points are computed in "Initialize".
+ * In 3D, the rotation of each cluster is kept and used as the initial guess of the next polar decomposition ("Quat_RotationalPart").
+ * The clusters are projected in parallel either in the graph-colored order (Gauss-Seidel) or
+ * by averaging the goal positions of the clusters sharing a point (Jacobi).
+ * Both are deterministic regardless of the number of threads.
+ */
+class CPBD_ShapeMatching {
+public:
+  /**
+   * @param ndim_ dimension of the coordinate (2 or 3)
+   * @param clstr_ind_ (in) index of jagged array of the points in the clusters
+   * @param clstr_ (in) points in the clusters
+   * @param aXYZ0 (in) rest positions
+   */
+  void Initialize(
+      unsigned int ndim_,
+      const std::vector<unsigned int>& clstr_ind_,
+      const std::vector<unsigned int>& clstr_,
+      const std::vector<double>& aXYZ0);
+  /**
+   * @param aXYZt (in&out) positions to be projected
+   * @param stiffness ratio of the movement toward the goal positions
+   * @param nthread number of threads. hardware concurrency is used if 0
+   */
+  void Project(
+      double* aXYZt,
+      double stiffness,
+      bool is_jacobi = false,
+      unsigned int nthread = 0);
+  unsigned int NumCluster() const { return clstr_ind.empty() ? 0 : static_cast<unsigned int>(clstr_ind.size()-1); }
+  unsigned int NumColor() const { return aColorInd.empty() ? 0 : static_cast<unsigned int>(aColorInd.size()-1); }
+public:
+  unsigned int ndim = 3;
+  unsigned int nitr_rot = 4; // number of iterations of polar decomposition in 3D
+  std::vector<unsigned int> clstr_ind, clstr;
+  std::vector<double> aDq; // rest offset from the centroid for each point of the clusters (ndim values)
+  std::vector<double> aQuat; // rotation of each cluster (3D only)
+  std::vector<unsigned int> aColorInd, aOrder; // clusters sorted by the color
+  std::vector<unsigned int> psuc_ind, psuc; // index of "clstr" for each point
+private:
+  std::vector<double> aGoal; // goal position for each point of the clusters (ndim values)
+};
+
 /**
  *
  * @param C
@@ -114,6 +161,303 @@ DFM2_INLINE void PBD_Seam(
     const unsigned int* aLine,
     unsigned int nline);
 
+/**
+ * @brief constraint that keeps the distance of two points. rest data is the length
+ * @details "PBD_Seam" is the case the length is zero
+ */
+DFM2_INLINE void PBD_CdC_Distance(
+    double& C,
+    double dCdp[6],
+    double L0,
+    const double p[2][3]);
+
+/**
+ * @brief XPBD update of a constraint with multiple values
+ * @param dp (out) displacement of the points (nnode*3)
+ * @param dlambda (out) increment of the Lagrange multipliers (ncons)
+ * @param C (in) value of the constraints (ncons)
+ * @param dCdp (in) gradient of the constraints (ncons*nnode*3)
+ * @param aInvMass (in) inverse mass of the points (nnode). 0 for fixed point
+ * @param lambda (in) Lagrange multipliers accumulated in the time step (ncons)
+ * @param alpha_tilde (in) compliance divided by the square of time step. 0 for the hard constraint (PBD)
+ * @return false if the constraint is degenerated (e.g., all points are fixed)
+ */
+DFM2_INLINE bool PBD_DeltaConst_XPBD(
+    double* dp,
+    double* dlambda,
+    unsigned int nnode,
+    unsigned int ncons,
+    const double* C,
+    const double* dCdp,
+    const double* aInvMass,
+    const double* lambda,
+    double alpha_tilde);
+
+/**
+ * @brief constraints of the same kind sorted by the graph coloring
+ * @details the constraints of the same color do not share the points, so they are projected in parallel
+ * (Gauss-Seidel between the colors). In the Jacobi mode, all constraints are projected in parallel and
+ * the displacements are averaged at each point. The result does not depend on the number of threads in both modes.
+ * The point indices, the rest data and the Lagrange multipliers are stored in the structure of arrays in the colored order.
+ * @tparam nnode number of points of a constraint
+ * @tparam ncons number of constraint values of a constraint
+ */
+template <unsigned int nnode, unsigned int ncons>
+class CPBD_ConstraintBatch {
+public:
+  /**
+   * @param aElem (in) points of the constraints (nnode for each)
+   * @param aRest (in) rest data of the constraints (nrest for each). e.g., undeformed positions
+   * @param np (in) number of points
+   */
+  void Initialize(
+      const unsigned int* aElem,
+      size_t nelem_,
+      const double* aRest,
+      unsigned int nrest_,
+      size_t np)
+  {
+    nelem = nelem_;
+    nrest = nrest_;
+    JArray_ColorElem_MeshElem(
+        aColorInd, aOrder,
+        aElem, nelem, nnode, np);
+    aElemSoA.resize(nelem*nnode);
+    aRestSoA.resize(nelem*nrest);
+    for(unsigned int je=0;je<nelem;++je){
+      const unsigned int ie = aOrder[je];
+      for(unsigned int inode=0;inode<nnode;++inode){ aElemSoA[inode*nelem+je] = aElem[ie*nnode+inode]; }
+      for(unsigned int irest=0;irest<nrest;++irest){ aRestSoA[irest*nelem+je] = aRest[ie*nrest+irest]; }
+    }
+    { // slots of the displacement around point for the Jacobi mode
+      std::vector<unsigned int> aSlot(nelem*nnode);
+      for(unsigned int je=0;je<nelem;++je){
+        for(unsigned int inode=0;inode<nnode;++inode){ aSlot[je*nnode+inode] = aElemSoA[inode*nelem+je]; }
+      }
+      JArray_ElSuP_MeshElem(
+          slsup_ind, slsup,
+          aSlot.data(), nelem*nnode, 1, np);
+    }
+    aLambda.assign(nelem*ncons, 0.0);
+  }
+  /**
+   * @brief set the Lagrange multipliers zero. Call this at the beginning of the time step
+   */
+  void ResetMultiplier(){ aLambda.assign(nelem*ncons, 0.0); }
+  size_t NumConstraint() const { return nelem; }
+  size_t NumColor() const { return aColorInd.empty() ? 0 : aColorInd.size()-1; }
+  /**
+   * @brief project the constraints once
+   * @param aXYZt (in&out) positions of the points
+   * @param aInvMass (in) inverse mass of the points. 0 for the fixed point
+   * @param cdc function "cdc(C, dCdp, rest, p)" computes the value "C[ncons]" and the gradient "dCdp[ncons*nnode*3]"
+   * of a constraint from its rest data "rest[nrest]" and the positions "p[nnode*3]"
+   * @param compliance inverse of the stiffness. 0 for the hard constraint
+   * @param dt time step (the compliance is divided by dt*dt)
+   * @param is_jacobi project in the Jacobi mode
+   * @param omega relaxation parameter for the Jacobi mode
+   * @param nthread number of threads. hardware concurrency is used if 0
+   */
+  template <class CDC>
+  void Project(
+      double* aXYZt,
+      const double* aInvMass,
+      CDC cdc,
+      double compliance,
+      double dt,
+      bool is_jacobi = false,
+      double omega = 1.0,
+      unsigned int nthread = 0)
+  {
+    const double alpha_tilde = compliance/(dt*dt);
+    auto delta = [&](double dp[nnode*3], unsigned int je){
+      double p[nnode*3], invm[nnode], rest[nrest_max], C[ncons], dCdp[ncons*nnode*3], dlambda[ncons];
+      for(unsigned int inode=0;inode<nnode;++inode){
+        const unsigned int ip = aElemSoA[inode*nelem+je];
+        p[inode*3+0] = aXYZt[ip*3+0];
+        p[inode*3+1] = aXYZt[ip*3+1];
+        p[inode*3+2] = aXYZt[ip*3+2];
+        invm[inode] = aInvMass[ip];
+      }
+      for(unsigned int irest=0;irest<nrest;++irest){ rest[irest] = aRestSoA[irest*nelem+je]; }
+      cdc(C, dCdp, rest, p);
+      double* lambda = aLambda.data()+je*ncons;
+      if( !PBD_DeltaConst_XPBD(dp, dlambda, nnode, ncons, C, dCdp, invm, lambda, alpha_tilde) ){
+        for(unsigned int i=0;i<nnode*3;++i){ dp[i] = 0.0; }
+        return;
+      }
+      for(unsigned int icons=0;icons<ncons;++icons){ lambda[icons] += dlambda[icons]; }
+    };
+    assert( nrest <= nrest_max );
+    if( !is_jacobi ){
+      for(unsigned int icolor=0;icolor<this->NumColor();++icolor){
+        const unsigned int je0 = aColorInd[icolor];
+        thread::parallel_for(
+            aColorInd[icolor+1]-je0,
+            [&](unsigned int i){
+              const unsigned int je = je0+i;
+              double dp[nnode*3];
+              delta(dp, je);
+              for(unsigned int inode=0;inode<nnode;++inode){
+                const unsigned int ip = aElemSoA[inode*nelem+je];
+                aXYZt[ip*3+0] += dp[inode*3+0];
+                aXYZt[ip*3+1] += dp[inode*3+1];
+                aXYZt[ip*3+2] += dp[inode*3+2];
+              }
+            },
+            nthread);
+      }
+      return;
+    }
+    aDelta.resize(nelem*nnode*3);
+    thread::parallel_for(
+        static_cast<unsigned int>(nelem),
+        [&](unsigned int je){ delta(aDelta.data()+je*nnode*3, je); },
+        nthread);
+    thread::parallel_for(
+        static_cast<unsigned int>(slsup_ind.size()-1),
+        [&](unsigned int ip){
+          const unsigned int nslot = slsup_ind[ip+1]-slsup_ind[ip];
+          if( nslot == 0 ){ return; }
+          double d[3] = {0,0,0};
+          for(unsigned int islot=slsup_ind[ip];islot<slsup_ind[ip+1];++islot){
+            const double* dp = aDelta.data()+slsup[islot]*3;
+            d[0] += dp[0];
+            d[1] += dp[1];
+            d[2] += dp[2];
+          }
+          const double r = omega/nslot;
+          aXYZt[ip*3+0] += d[0]*r;
+          aXYZt[ip*3+1] += d[1]*r;
+          aXYZt[ip*3+2] += d[2]*r;
+        },
+        nthread);
+  }
+public:
+  static const unsigned int nrest_max = 16;
+  size_t nelem = 0;
+  unsigned int nrest = 0;
+  std::vector<unsigned int> aColorInd; // index of jagged array of the colors
+  std::vector<unsigned int> aOrder; // original index of the constraints in the colored order
+  std::vector<unsigned int> aElemSoA; // aElemSoA[inode*nelem+je] is the inode-th point of the je-th constraint
+  std::vector<double> aRestSoA; // aRestSoA[irest*nelem+je]
+  std::vector<double> aLambda; // Lagrange multipliers of XPBD
+  std::vector<unsigned int> slsup_ind, slsup; // slots of displacement (je*nnode+inode) around point
+  std::vector<double> aDelta; // displacement of the slots in the Jacobi mode
+};
+
+// functions for "CPBD_ConstraintBatch::Project" to compute the constraint from the rest data and the positions
+
+/**
+ * @brief rest data is the 2D undeformed positions of the triangle (6 values)
+ */
+class CPBD_CdC_DistanceTri2D3D {
+public:
+  void operator()(double* C, double* dCdp, const double* rest, const double* p) const {
+    PBD_ConstraintProjection_DistanceTri2D3D(
+        C, reinterpret_cast<double(*)[9]>(dCdp),
+        reinterpret_cast<const double(*)[2]>(rest), reinterpret_cast<const double(*)[3]>(p));
+  }
+};
+
+/**
+ * @brief rest data is the 2D undeformed positions of the triangle (6 values)
+ */
+class CPBD_CdC_TriStrain2D3D {
+public:
+  void operator()(double* C, double* dCdp, const double* rest, const double* p) const {
+    PBD_CdC_TriStrain2D3D(
+        C, reinterpret_cast<double(*)[9]>(dCdp),
+        reinterpret_cast<const double(*)[2]>(rest), reinterpret_cast<const double(*)[3]>(p));
+  }
+};
+
+/**
+ * @brief rest data is the 2D undeformed positions of the triangle (6 values). The constraint is the StVK energy.
+ */
+class CPBD_CdC_EnergyStVK {
+public:
+  CPBD_CdC_EnergyStVK(double lambda_, double myu_) : lambda(lambda_), myu(myu_) {}
+  void operator()(double* C, double* dCdp, const double* rest, const double* p) const {
+    PBD_ConstraintProjection_EnergyStVK(
+        C[0], dCdp,
+        reinterpret_cast<const double(*)[2]>(rest), reinterpret_cast<const double(*)[3]>(p),
+        lambda, myu);
+  }
+  const double lambda, myu;
+};
+
+/**
+ * @brief rest data is the 3D undeformed positions of the two triangles sharing an edge (12 values)
+ */
+class CPBD_CdC_QuadBend {
+public:
+  void operator()(double* C, double* dCdp, const double* rest, const double* p) const {
+    PBD_CdC_QuadBend(
+        C, reinterpret_cast<double(*)[12]>(dCdp),
+        reinterpret_cast<const double(*)[3]>(rest), reinterpret_cast<const double(*)[3]>(p));
+  }
+};
+
+/**
+ * @brief rest data is the length (1 value)
+ */
+class CPBD_CdC_Distance {
+public:
+  void operator()(double* C, double* dCdp, const double* rest, const double* p) const {
+    PBD_CdC_Distance(
+        C[0], dCdp,
+        rest[0], reinterpret_cast<const double(*)[3]>(p));
+  }
+};
+
+/**
+ * @brief XPBD cloth solver that keeps the constraints, the Lagrange multipliers and the inverse masses
+ * @details the time step is divided into "nsubstep" small steps and the constraints are projected once in each small step.
+ * The constraints are projected in parallel with "CPBD_ConstraintBatch", so the result does not depend on the number of threads.
+ * Set zero to "aInvMass" for the fixed points.
+ */
+class CXPBD_Cloth {
+public:
+  /**
+   * @param aXYZ_ (in) initial 3D positions
+   * @param aTri (in) triangles
+   * @param aXY0 (in) 2D rest positions (pattern) of the points
+   * @param density (in) mass per unit area. The mass is lumped to the points
+   */
+  void Initialize(
+      const std::vector<double>& aXYZ_,
+      const std::vector<unsigned int>& aTri,
+      const std::vector<double>& aXY0,
+      double density = 1.0);
+  /**
+   * @param aLine (in) pairs of points that are sewed together
+   */
+  void SetSeam(
+      const std::vector<unsigned int>& aLine);
+  /**
+   * @param nsubstep number of the small steps. One small step is used if 0
+   * @param nthread number of threads. hardware concurrency is used if 0
+   */
+  void Step(
+      double dt,
+      unsigned int nsubstep = 10,
+      unsigned int nthread = 0);
+public:
+  std::vector<double> aXYZ; // positions
+  std::vector<double> aUVW; // velocities
+  std::vector<double> aInvMass; // inverse mass. 0 for the fixed point
+  double gravity[3] = {0.0, 0.0, -10.0};
+  double compliance_stretch = 0.0;
+  double compliance_bend = 1.0e-2;
+  double compliance_seam = 0.0;
+  CPBD_ConstraintBatch<3,3> batch_stretch;
+  CPBD_ConstraintBatch<4,3> batch_bend;
+  CPBD_ConstraintBatch<2,1> batch_seam;
+private:
+  std::vector<double> aXYZt; // predicted positions
+};
+
 template <typename T>
 DFM2_INLINE void GetConstConstDiff_Bend(
     double& C,
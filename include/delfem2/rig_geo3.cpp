@@ -7,7 +7,9 @@
 
 #include "delfem2/rig_geo3.h"
 #include "delfem2/geo3_v23m34q.h"
+#include "delfem2/thread/th.h"
 #include <map>
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 #include <fstream>
@@ -420,23 +422,201 @@ delfem2::Skinning_LBS_LocalWeight(
   }
 }
 
+// ------------------------------------
+// skinning with fixed number of influences
+
+DFM2_INLINE void delfem2::SkinningMatrix_Bones(
+    std::vector<double>& aMat3x4,
+    const std::vector<CRigBone>& aBone)
+{
+  aMat3x4.resize(aBone.size()*12);
+  for(unsigned int ib=0;ib<aBone.size();++ib){
+    double m[16]; MatMat4(m, aBone[ib].affmat3Global, aBone[ib].invBindMat);
+    for(int i=0;i<12;++i){ aMat3x4[ib*12+i] = m[i]; }
+  }
+}
+
+DFM2_INLINE void delfem2::DualQuaternion_Bones(
+    std::vector<double>& aDualQuat,
+    const std::vector<CRigBone>& aBone)
+{
+  aDualQuat.resize(aBone.size()*8);
+  for(unsigned int ib=0;ib<aBone.size();++ib){
+    double m[16]; MatMat4(m, aBone[ib].affmat3Global, aBone[ib].invBindMat);
+    const CMat3d R(m[0],m[1],m[2], m[4],m[5],m[6], m[8],m[9],m[10]);
+    double* qr = aDualQuat.data()+ib*8;
+    double* qd = aDualQuat.data()+ib*8+4;
+    R.GetQuat_RotMatrix(qr);
+    Normalize_Quat(qr);
+    const double qt[4] = {0, m[3], m[7], m[11]};
+    QuatQuat(qd, qt, qr);
+    for(int i=0;i<4;++i){ qd[i] *= 0.5; }
+  }
+}
+
+DFM2_INLINE void delfem2::CSkinWeightFixedWidth::SetDenseWeight(
+    const std::vector<double>& aW,
+    unsigned int nbone,
+    unsigned int ninfl0)
+{
+  this->ninfl = ninfl0;
+  this->np = static_cast<unsigned int>(aW.size()/nbone);
+  assert( aW.size() == np*nbone );
+  aWeight.assign(ninfl*np,0.0);
+  aIdBone.assign(ninfl*np,0);
+  std::vector<std::pair<double,unsigned int> > aWIb;
+  for(unsigned int ip=0;ip<np;++ip){
+    aWIb.clear();
+    double sum_all = 0.0;
+    for(unsigned int ib=0;ib<nbone;++ib){
+      const double w0 = aW[ip*nbone+ib];
+      if( w0 == 0.0 ){ continue; }
+      sum_all += w0;
+      aWIb.emplace_back(-fabs(w0),ib);
+    }
+    std::sort(aWIb.begin(),aWIb.end());
+    const unsigned int n0 = std::min(ninfl,static_cast<unsigned int>(aWIb.size()));
+    double sum_kept = 0.0;
+    for(unsigned int iinfl=0;iinfl<n0;++iinfl){ sum_kept += aW[ip*nbone+aWIb[iinfl].second]; }
+    const double scale = ( fabs(sum_kept) > 1.0e-30 ) ? sum_all/sum_kept : 1.0;
+    for(unsigned int iinfl=0;iinfl<n0;++iinfl){
+      const unsigned int ib = aWIb[iinfl].second;
+      aWeight[iinfl*np+ip] = aW[ip*nbone+ib]*scale;
+      aIdBone[iinfl*np+ip] = ib;
+    }
+  }
+}
+
+DFM2_INLINE void delfem2::CSkinWeightFixedWidth::SetSparseWeight(
+    const std::vector<double>& aWBoneSparse,
+    const std::vector<unsigned int>& aIdBoneSparse,
+    unsigned int np0,
+    unsigned int ninfl0)
+{
+  this->ninfl = ninfl0;
+  this->np = np0;
+  const size_t nBW = aWBoneSparse.size()/np;
+  assert( aWBoneSparse.size() == nBW*np );
+  assert( aIdBoneSparse.size() == nBW*np );
+  aWeight.assign(ninfl*np,0.0);
+  aIdBone.assign(ninfl*np,0);
+  std::vector<std::pair<double,unsigned int> > aWIb;
+  for(unsigned int ip=0;ip<np;++ip){
+    aWIb.clear();
+    double sum_all = 0.0;
+    for(unsigned int ibw=0;ibw<nBW;++ibw){
+      const double w0 = aWBoneSparse[ip*nBW+ibw];
+      if( w0 == 0.0 ){ continue; }
+      sum_all += w0;
+      aWIb.emplace_back(-fabs(w0),ibw);
+    }
+    std::sort(aWIb.begin(),aWIb.end());
+    const unsigned int n0 = std::min(ninfl,static_cast<unsigned int>(aWIb.size()));
+    double sum_kept = 0.0;
+    for(unsigned int iinfl=0;iinfl<n0;++iinfl){ sum_kept += aWBoneSparse[ip*nBW+aWIb[iinfl].second]; }
+    const double scale = ( fabs(sum_kept) > 1.0e-30 ) ? sum_all/sum_kept : 1.0;
+    for(unsigned int iinfl=0;iinfl<n0;++iinfl){
+      const unsigned int ibw = aWIb[iinfl].second;
+      aWeight[iinfl*np+ip] = aWBoneSparse[ip*nBW+ibw]*scale;
+      aIdBone[iinfl*np+ip] = aIdBoneSparse[ip*nBW+ibw];
+    }
+  }
+}
+
+DFM2_INLINE void delfem2::SkinningFixedWidth_LBS(
+    std::vector<double>& aXYZ1,
+    const std::vector<double>& aXYZ0,
+    const CSkinWeightFixedWidth& sw,
+    const std::vector<double>& aMat3x4,
+    unsigned int nthread)
+{
+  const unsigned int np = sw.np;
+  const unsigned int ninfl = sw.ninfl;
+  assert( aXYZ0.size() == np*3 );
+  aXYZ1.resize(aXYZ0.size());
+  const double* aM = aMat3x4.data();
+  const double* aP0 = aXYZ0.data();
+  double* aP1 = aXYZ1.data();
+  // the block of points fits in L1 cache. the loop over points is innermost for vectorization
+  const unsigned int nblk = 256;
+  auto func = [&](unsigned int, unsigned int ip0, unsigned int ip1){
+    for(unsigned int jp0=ip0;jp0<ip1;jp0+=nblk){
+      const unsigned int jp1 = std::min(jp0+nblk,ip1);
+      for(unsigned int ip=jp0*3;ip<jp1*3;++ip){ aP1[ip] = 0.0; }
+      for(unsigned int iinfl=0;iinfl<ninfl;++iinfl){
+        const double* aW = sw.aWeight.data()+iinfl*np;
+        const unsigned int* aIB = sw.aIdBone.data()+iinfl*np;
+        for(unsigned int ip=jp0;ip<jp1;++ip){
+          const double w = aW[ip];
+          const double* M = aM+aIB[ip]*12;
+          const double x = aP0[ip*3+0], y = aP0[ip*3+1], z = aP0[ip*3+2];
+          aP1[ip*3+0] += w*(M[0]*x+M[1]*y+M[ 2]*z+M[ 3]);
+          aP1[ip*3+1] += w*(M[4]*x+M[5]*y+M[ 6]*z+M[ 7]);
+          aP1[ip*3+2] += w*(M[8]*x+M[9]*y+M[10]*z+M[11]);
+        }
+      }
+    }
+  };
+  thread::parallel_for_range(np, func, thread::num_threads(nthread));
+}
+
+DFM2_INLINE void delfem2::SkinningFixedWidth_DQS(
+    std::vector<double>& aXYZ1,
+    const std::vector<double>& aXYZ0,
+    const CSkinWeightFixedWidth& sw,
+    const std::vector<double>& aDualQuat,
+    unsigned int nthread)
+{
+  const unsigned int np = sw.np;
+  const unsigned int ninfl = sw.ninfl;
+  assert( aXYZ0.size() == np*3 );
+  aXYZ1.resize(aXYZ0.size());
+  const double* aDQ = aDualQuat.data();
+  auto func = [&](unsigned int ip){
+    double b[8] = {0,0,0,0, 0,0,0,0};
+    const double* q0 = aDQ+sw.aIdBone[ip]*8; // pivot to choose the hemisphere
+    for(unsigned int iinfl=0;iinfl<ninfl;++iinfl){
+      const double* q = aDQ+sw.aIdBone[iinfl*np+ip]*8;
+      double w = sw.aWeight[iinfl*np+ip];
+      if( q0[0]*q[0]+q0[1]*q[1]+q0[2]*q[2]+q0[3]*q[3] < 0 ){ w = -w; }
+      for(int i=0;i<8;++i){ b[i] += w*q[i]; }
+    }
+    const double len = sqrt(b[0]*b[0]+b[1]*b[1]+b[2]*b[2]+b[3]*b[3]);
+    const double* p0 = aXYZ0.data()+ip*3;
+    double* p1 = aXYZ1.data()+ip*3;
+    if( len < 1.0e-30 ){ p1[0] = p0[0]; p1[1] = p0[1]; p1[2] = p0[2]; return; }
+    const double invlen = 1.0/len;
+    const double rw = b[0]*invlen, rx = b[1]*invlen, ry = b[2]*invlen, rz = b[3]*invlen;
+    const double dw = b[4]*invlen, dx = b[5]*invlen, dy = b[6]*invlen, dz = b[7]*invlen;
+    // rotation: p + 2 r x (r x p + w p)
+    const double cx = ry*p0[2]-rz*p0[1]+rw*p0[0];
+    const double cy = rz*p0[0]-rx*p0[2]+rw*p0[1];
+    const double cz = rx*p0[1]-ry*p0[0]+rw*p0[2];
+    // translation: 2 (rw d - dw r + r x d)
+    const double tx = 2*(rw*dx-dw*rx+ry*dz-rz*dy);
+    const double ty = 2*(rw*dy-dw*ry+rz*dx-rx*dz);
+    const double tz = 2*(rw*dz-dw*rz+rx*dy-ry*dx);
+    p1[0] = p0[0] + 2*(ry*cz-rz*cy) + tx;
+    p1[1] = p0[1] + 2*(rz*cx-rx*cz) + ty;
+    p1[2] = p0[2] + 2*(rx*cy-ry*cx) + tz;
+  };
+  thread::parallel_for(np, func, nthread);
+}
+
 // ------------------------------------
 // from here BioVisionHierarchy
 
-DFM2_INLINE void
-delfem2::Read_BioVisionHierarchy(
+namespace delfem2 {
+namespace rig_v3q {
+
+/**
+ * parse the "HIERARCHY" section until the "MOTION" keyword
+ */
+DFM2_INLINE void ReadHierarchy_BioVisionHierarchy(
     std::vector<CRigBone>& aBone,
     std::vector<CChannel_BioVisionHierarchy>& aChannelRotTransBone,
-    int& nframe,
-    std::vector<double>& aValueRotTransBone,
-    const std::string& path_bvh)
+    std::ifstream& fin)
 {
-  std::ifstream fin;
-  fin.open(path_bvh.c_str());
-  if( !fin.is_open() ){
-    std::cout << "cannot open file" << std::endl;
-    return;
-  }
   aBone.clear();
   aChannelRotTransBone.clear();
   //
@@ -522,33 +702,57 @@ delfem2::Read_BioVisionHierarchy(
       break;
     }
   }
+}
+
+/**
+ * read "Frames:" and "Frame Time:" lines after the "MOTION" keyword
+ */
+DFM2_INLINE void ReadMotionHeader_BioVisionHierarchy(
+    int& nframe,
+    double& frame_time,
+    std::ifstream& fin)
+{
+  std::string line;
   nframe = 0;
+  frame_time = 0.0;
   {
     std::string stmp0;
-    {
-      std::getline(fin,line);
-      std::stringstream ss(line);
-      ss >> stmp0 >> nframe;
-//      std::cout << "frame: " << nframe << std::endl;
-    }
     std::getline(fin,line);
-//    std::cout << "frametime: " << line << std::endl;
+    std::stringstream ss(line);
+    ss >> stmp0 >> nframe;
   }
-  const size_t nchannel = aChannelRotTransBone.size();
-  aValueRotTransBone.resize(nframe*nchannel);
-  for(int iframe=0;iframe<nframe;++iframe){
+  {
     std::getline(fin,line);
-    line = rig_v3q::MyReplace(line, '\t', ' ');
-    if (line[line.size()-1] == '\n') line.erase(line.size()-1); // remove the newline code
-    if (line[line.size()-1] == '\r') line.erase(line.size()-1); // remove the newline code
-    std::vector<std::string> aToken = rig_v3q::MySplit(line,' ');
-//    std::cout << aToken.size() << " " << aChannelRotTransBone.size() << std::endl;
-    assert(aToken.size()==aChannelRotTransBone.size());
-    for(unsigned int ich=0;ich<nchannel;++ich){
-      aValueRotTransBone[iframe*nchannel+ich] = rig_v3q::myStod(aToken[ich]);
-    }
+    const std::size_t ipos = line.find(':');
+    if( ipos != std::string::npos ){ frame_time = myStod(line.substr(ipos+1)); }
+  }
+}
+
+/**
+ * parse a line of channel values without making tokens
+ * @return number of parsed values
+ */
+DFM2_INLINE unsigned int ParseFrame_BioVisionHierarchy(
+    double* aVal,
+    std::size_t nch,
+    const char* str)
+{
+  unsigned int ich = 0;
+  for(;ich<nch;++ich){
+    char* e;
+    aVal[ich] = std::strtod(str,&e);
+    if( e == str ){ break; }
+    str = e;
   }
-  // ---------------
+  return ich;
+}
+
+/**
+ * set the relative transformation of the bones to the rest pose
+ */
+DFM2_INLINE void InitBones_BioVisionHierarchy(
+    std::vector<CRigBone>& aBone)
+{
   for(unsigned int ibone=0;ibone<aBone.size();++ibone){
     CRigBone& bone = aBone[ibone];
     bone.scale = 1.0;
@@ -572,6 +776,80 @@ delfem2::Read_BioVisionHierarchy(
   }
 }
 
+}
+}
+
+DFM2_INLINE void
+delfem2::Read_BioVisionHierarchy(
+    std::vector<CRigBone>& aBone,
+    std::vector<CChannel_BioVisionHierarchy>& aChannelRotTransBone,
+    int& nframe,
+    std::vector<double>& aValueRotTransBone,
+    const std::string& path_bvh)
+{
+  std::ifstream fin;
+  fin.open(path_bvh.c_str());
+  if( !fin.is_open() ){
+    std::cout << "cannot open file" << std::endl;
+    return;
+  }
+  rig_v3q::ReadHierarchy_BioVisionHierarchy(
+      aBone, aChannelRotTransBone,
+      fin);
+  double frame_time;
+  rig_v3q::ReadMotionHeader_BioVisionHierarchy(
+      nframe, frame_time,
+      fin);
+  const size_t nchannel = aChannelRotTransBone.size();
+  aValueRotTransBone.resize(nframe*nchannel);
+  std::string line;
+  for(int iframe=0;iframe<nframe;++iframe){
+    std::getline(fin,line);
+    const unsigned int nch = rig_v3q::ParseFrame_BioVisionHierarchy(
+        aValueRotTransBone.data()+iframe*nchannel, nchannel,
+        line.c_str());
+    assert( nch == nchannel ); (void)nch;
+  }
+  rig_v3q::InitBones_BioVisionHierarchy(aBone);
+}
+
+DFM2_INLINE bool delfem2::CStreamReader_BioVisionHierarchy::Open(
+    const std::string& path_bvh)
+{
+  fin.close();
+  fin.clear();
+  fin.open(path_bvh.c_str());
+  iframe_next = 0;
+  if( !fin.is_open() ){ return false; }
+  rig_v3q::ReadHierarchy_BioVisionHierarchy(
+      aBone, aChannelInfo,
+      fin);
+  rig_v3q::ReadMotionHeader_BioVisionHierarchy(
+      nframe, frame_time,
+      fin);
+  rig_v3q::InitBones_BioVisionHierarchy(aBone);
+  return true;
+}
+
+DFM2_INLINE unsigned int delfem2::CStreamReader_BioVisionHierarchy::ReadFrames(
+    std::vector<double>& aChannelValue,
+    unsigned int nframe_max)
+{
+  const size_t nch = aChannelInfo.size();
+  aChannelValue.resize(nframe_max*nch);
+  unsigned int iframe = 0;
+  std::string line;
+  for(;iframe<nframe_max && iframe_next<nframe;++iframe){
+    if( !std::getline(fin,line) ){ break; }
+    const unsigned int nch0 = rig_v3q::ParseFrame_BioVisionHierarchy(
+        aChannelValue.data()+iframe*nch, nch,
+        line.c_str());
+    if( nch0 != nch ){ break; } // broken file
+    ++iframe_next;
+  }
+  aChannelValue.resize(iframe*nch);
+  return iframe;
+}
 
 DFM2_INLINE void delfem2::SetPose_BioVisionHierarchy(
     std::vector<CRigBone>& aBone,
@@ -608,6 +886,65 @@ DFM2_INLINE void delfem2::SetPose_BioVisionHierarchy(
   UpdateBoneRotTrans(aBone);
 }
 
+DFM2_INLINE void delfem2::GlobalTransforms_BioVisionHierarchy(
+    std::vector<double>& aMat3x4,
+    const std::vector<CRigBone>& aBone,
+    const std::vector<CChannel_BioVisionHierarchy>& aChannelInfo,
+    const double* aChannelValue,
+    unsigned int nframe,
+    unsigned int nthread)
+{
+  const unsigned int nbone = static_cast<unsigned int>(aBone.size());
+  const size_t nch = aChannelInfo.size();
+  aMat3x4.resize(nframe*nbone*12);
+  // rest pose that does not change over frames
+  std::vector<double> aTrans0(nbone*3);
+  for(unsigned int ib=0;ib<nbone;++ib){
+    for(int i=0;i<3;++i){ aTrans0[ib*3+i] = aBone[ib].transRelative[i]; }
+    assert( aBone[ib].ibone_parent < (int)ib );
+  }
+  auto func = [&](unsigned int, unsigned int iframe0, unsigned int iframe1){
+    std::vector<double> aQuat(nbone*4), aTrans(nbone*3); // thread local
+    for(unsigned int iframe=iframe0;iframe<iframe1;++iframe){
+      const double* aVal = aChannelValue+iframe*nch;
+      for(unsigned int ib=0;ib<nbone;++ib){ Quat_Identity(aQuat.data()+ib*4); }
+      aTrans = aTrans0;
+      for(unsigned int ich=0;ich<nch;++ich){
+        const unsigned int ib = aChannelInfo[ich].ibone;
+        const int iaxis = aChannelInfo[ich].iaxis;
+        if( !aChannelInfo[ich].isrot ){
+          aTrans[ib*3+iaxis] = aVal[ich];
+          continue;
+        }
+        const double ar = aVal[ich]*M_PI/180.0;
+        double dq[4] = { cos(ar*0.5), 0, 0, 0 };
+        dq[iaxis+1] = sin(ar*0.5);
+        double qtmp[4]; QuatQuat(qtmp, aQuat.data()+ib*4, dq);
+        Copy_Quat(aQuat.data()+ib*4, qtmp);
+      }
+      double* aM = aMat3x4.data()+iframe*nbone*12;
+      for(unsigned int ib=0;ib<nbone;++ib){
+        double m01[16];
+        Mat4_ScaleRotTrans(m01, aBone[ib].scale, aQuat.data()+ib*4, aTrans.data()+ib*3);
+        const int ibp = aBone[ib].ibone_parent;
+        double* m = aM+ib*12;
+        if( ibp < 0 || ibp >= (int)nbone ){
+          for(int i=0;i<12;++i){ m[i] = m01[i]; }
+          continue;
+        }
+        const double* mp = aM+ibp*12;
+        for(int i=0;i<3;++i){
+          for(int j=0;j<4;++j){
+            m[i*4+j] = mp[i*4+0]*m01[0*4+j] + mp[i*4+1]*m01[1*4+j] + mp[i*4+2]*m01[2*4+j];
+          }
+          m[i*4+3] += mp[i*4+3];
+        }
+      }
+    }
+  };
+  thread::parallel_for_range(nframe, func, thread::num_threads(nthread));
+}
+
 // ----------------------------------
 
 DFM2_INLINE void
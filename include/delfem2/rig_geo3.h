@@ -15,6 +15,7 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <fstream>
 #include <cassert>
 
 namespace delfem2 {
@@ -198,6 +199,86 @@ DFM2_INLINE void SkinningSparse_LBS(
     const std::vector<double> &aWBoneSparse,
     const std::vector<unsigned> &aIdBoneSparse);
 
+// --------------------------------------
+// skinning with fixed number of influences per point
+
+/**
+ * @brief compute 3x4 affine matrix for each bone which send the rest position to the deformed position
+ * @param[out] aMat3x4 row-major 3x4 matrices (size: 12*nbone). The matrix is "affmat3Global*invBindMat"
+ * @details call this function once per pose after "UpdateBoneRotTrans"
+ */
+DFM2_INLINE void SkinningMatrix_Bones(
+    std::vector<double> &aMat3x4,
+    const std::vector<CRigBone> &aBone);
+
+/**
+ * @brief compute unit dual quaternion for each bone which send the rest position to the deformed position
+ * @param[out] aDualQuat (size: 8*nbone) real part (w,x,y,z) followed by dual part (w,x,y,z)
+ * @details the bone transformation is assumed to be rigid (no scale)
+ */
+DFM2_INLINE void DualQuaternion_Bones(
+    std::vector<double> &aDualQuat,
+    const std::vector<CRigBone> &aBone);
+
+/**
+ * @brief rigging weight where each point has the same number of influences (e.g., 4 or 8).
+ * @details the weights are stored in SoA layout so that the points are processed in the inner loop.
+ * The weight of iinfl-th influence of ip-th point is aWeight[iinfl*np+ip].
+ * Unused influence has zero weight and bone index 0.
+ */
+class CSkinWeightFixedWidth {
+public:
+  /**
+   * @brief set from dense weight
+   * @param aW rigging weight [np, nbone]
+   * @details the largest "ninfl" weights are kept and scaled such that the sum of the weights is unchanged
+   */
+  void SetDenseWeight(
+      const std::vector<double> &aW,
+      unsigned int nbone,
+      unsigned int ninfl);
+
+  /**
+   * @brief set from sparse weights used in "SkinningSparse_LBS"
+   */
+  void SetSparseWeight(
+      const std::vector<double> &aWBoneSparse,
+      const std::vector<unsigned int> &aIdBoneSparse,
+      unsigned int np,
+      unsigned int ninfl);
+public:
+  unsigned int np = 0;
+  unsigned int ninfl = 0;
+  std::vector<double> aWeight;
+  std::vector<unsigned int> aIdBone;
+};
+
+/**
+ * @brief linear blend skinning with the fixed number of influences in parallel
+ * @param[out] aXYZ1 deformed positions
+ * @param[in] aXYZ0 rest positions
+ * @param[in] aMat3x4 bone matrices computed by "SkinningMatrix_Bones"
+ * @param[in] nthread number of threads. hardware concurrency is used if 0
+ */
+DFM2_INLINE void SkinningFixedWidth_LBS(
+    std::vector<double> &aXYZ1,
+    const std::vector<double> &aXYZ0,
+    const CSkinWeightFixedWidth &sw,
+    const std::vector<double> &aMat3x4,
+    unsigned int nthread = 0);
+
+/**
+ * @brief dual quaternion skinning with the fixed number of influences in parallel
+ * @param[in] aDualQuat bone dual quaternions computed by "DualQuaternion_Bones"
+ * @details Ladislav Kavan et al. "Skinning with dual quaternions" I3D 2007
+ */
+DFM2_INLINE void SkinningFixedWidth_DQS(
+    std::vector<double> &aXYZ1,
+    const std::vector<double> &aXYZ0,
+    const CSkinWeightFixedWidth &sw,
+    const std::vector<double> &aDualQuat,
+    unsigned int nthread = 0);
+
 // --------------------------------------
 
 DFM2_INLINE void InitBones_JointPosition(
@@ -246,6 +327,56 @@ DFM2_INLINE void SetPose_BioVisionHierarchy(
     const double *aVal);
 
 
+/**
+ * @brief read the frames of BioVision BVH file chunk by chunk.
+ * @details the channel values of all the frames are not loaded at once. usage:
+ * Open(path) and then call ReadFrames() until it returns 0
+ */
+class CStreamReader_BioVisionHierarchy {
+public:
+  /**
+   * @brief parse the hierarchy and the header of the motion
+   * @return false if the file cannot be opened
+   */
+  bool Open(const std::string &path_bvh);
+
+  /**
+   * @brief read next frames
+   * @param[out] aChannelValue channel values of the frames (size: nframe_read*aChannelInfo.size())
+   * @param[in] nframe_max maximum number of frames to read
+   * @return number of frames read
+   */
+  unsigned int ReadFrames(
+      std::vector<double> &aChannelValue,
+      unsigned int nframe_max);
+public:
+  std::vector<CRigBone> aBone;
+  std::vector<CChannel_BioVisionHierarchy> aChannelInfo;
+  int nframe = 0;
+  double frame_time = 0.0;
+private:
+  std::ifstream fin;
+  int iframe_next = 0;
+};
+
+/**
+ * @brief forward kinematics of many frames in parallel
+ * @param[out] aMat3x4 global affine matrix of the bones for all the frames (size: nframe*nbone*12).
+ * The matrix of ib-th bone at iframe-th frame starts at (iframe*nbone+ib)*12.
+ * It is the same as the top 3 rows of "CRigBone.affmat3Global" computed by "SetPose_BioVisionHierarchy"
+ * @param[in] aBone bones in the rest pose (e.g., loaded by "Read_BioVisionHierarchy")
+ * @param[in] aChannelValue channel values (size: nframe*aChannelInfo.size())
+ * @param[in] nthread number of threads. hardware concurrency is used if 0
+ */
+DFM2_INLINE void GlobalTransforms_BioVisionHierarchy(
+    std::vector<double> &aMat3x4,
+    const std::vector<CRigBone> &aBone,
+    const std::vector<CChannel_BioVisionHierarchy> &aChannelInfo,
+    const double *aChannelValue,
+    unsigned int nframe,
+    unsigned int nthread = 0);
+
+
 } // namespace delfem2
 
 #ifdef DFM2_HEADER_ONLY
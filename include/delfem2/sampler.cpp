@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "delfem2/sampler.h"
+#include "delfem2/thread/th.h"
+
+namespace delfem2 {
+namespace sampler {
+
+/**
+ * move the points to the centroids accumulated for each thread
+ * @param accumulate functor "void(unsigned int irow, double* awpw)" that adds the weighted coordinates
+ * and the weight of the samples in the row "irow" to "awpw" (ndim+1 values per point)
+ */
+template <class ACCUMULATE>
+void MoveToCentroid(
+    std::vector<double>& aXYZ,
+    unsigned int ndim,
+    unsigned int nrow,
+    const ACCUMULATE& accumulate,
+    unsigned int nthread)
+{
+  const unsigned int np = static_cast<unsigned int>(aXYZ.size()/ndim);
+  const unsigned int nthread1 = std::max(1u, std::min(nrow, thread::num_threads(nthread)));
+  std::vector< std::vector<double> > aAWPW(nthread1);
+  thread::parallel_for_range(
+      nrow,
+      [&](unsigned int ithread, unsigned int irow0, unsigned int irow1){
+        std::vector<double>& awpw = aAWPW[ithread];
+        awpw.assign(np*(ndim+1), 0.0);
+        for(unsigned int irow=irow0;irow<irow1;++irow){ accumulate(irow, awpw.data()); }
+      },
+      nthread1);
+  for(unsigned int ip=0;ip<np;++ip){
+    double w = 0.0;
+    for(unsigned int ithread=0;ithread<nthread1;++ithread){
+      if( aAWPW[ithread].empty() ){ continue; }
+      w += aAWPW[ithread][ip*(ndim+1)+ndim];
+    }
+    if( w <= 0.0 ){ continue; }
+    for(unsigned int idim=0;idim<ndim;++idim){
+      double wp = 0.0;
+      for(unsigned int ithread=0;ithread<nthread1;++ithread){
+        if( aAWPW[ithread].empty() ){ continue; }
+        wp += aAWPW[ithread][ip*(ndim+1)+idim];
+      }
+      aXYZ[ip*ndim+idim] = wp/w;
+    }
+  }
+}
+
+}
+}
+
+// ------------------------------------
+
+DFM2_INLINE void delfem2::CBucketGrid_NearestPoint::Initialize(
+    const double* aXYZ_,
+    unsigned int np_,
+    unsigned int ndim_,
+    const double* bbmin_,
+    const double* bbmax_,
+    double npoint_per_cell)
+{
+  assert( ndim_ == 2 || ndim_ == 3 );
+  aXYZ = aXYZ_;
+  np = np_;
+  ndim = ndim_;
+  for(unsigned int idim=0;idim<ndim;++idim){ bbmin[idim] = bbmin_[idim]; }
+  // the dimensions thinner than the bucket are not divided (e.g., points on a slightly noisy plane in 3D).
+  // otherwise the volume per bucket is too small and the other dimensions are divided too finely
+  const double ncell = std::max(1.0, np/npoint_per_cell);
+  bool aIsFlat[3] = {true, true, true};
+  for(unsigned int idim=0;idim<ndim;++idim){ aIsFlat[idim] = !(bbmax_[idim]-bbmin_[idim] > 0.0); }
+  double size = 1.0;
+  for(unsigned int itr=0;itr<3;++itr){ // each iteration makes at least one more dimension flat
+    double vol = 1.0;
+    unsigned int ndim_pos = 0;
+    for(unsigned int idim=0;idim<ndim;++idim){
+      if( aIsFlat[idim] ){ continue; }
+      vol *= bbmax_[idim]-bbmin_[idim];
+      ndim_pos++;
+    }
+    size = (ndim_pos==0) ? 1.0 : pow(vol/ncell, 1.0/ndim_pos);
+    bool is_changed = false;
+    for(unsigned int idim=0;idim<ndim;++idim){
+      if( aIsFlat[idim] || bbmax_[idim]-bbmin_[idim] >= size ){ continue; }
+      aIsFlat[idim] = true;
+      is_changed = true;
+    }
+    if( !is_changed ){ break; }
+  }
+  for(unsigned int idim=0;idim<3;++idim){
+    aNDiv[idim] = 1;
+    aH[idim] = 1.0;
+    if( idim >= ndim ){ continue; }
+    const double ext = bbmax_[idim]-bbmin_[idim];
+    if( aIsFlat[idim] ){ continue; }
+    aNDiv[idim] = static_cast<unsigned int>(std::min(std::ceil(ext/size), 4096.0));
+    aNDiv[idim] = std::max(aNDiv[idim], 1u);
+    aH[idim] = ext/aNDiv[idim];
+  }
+  // counting sort of the points by the bucket
+  const unsigned int nc = aNDiv[0]*aNDiv[1]*aNDiv[2];
+  std::vector<unsigned int> aIC(np);
+  aCellInd.assign(nc+1, 0);
+  for(unsigned int ip=0;ip<np;++ip){
+    unsigned int ic = 0;
+    for(int idim=static_cast<int>(ndim)-1;idim>=0;--idim){
+      const double r = (aXYZ[ip*ndim+idim]-bbmin[idim])/aH[idim];
+      const int i0 = static_cast<int>(std::floor(r));
+      const unsigned int i1 = static_cast<unsigned int>(std::max(0, std::min(i0, static_cast<int>(aNDiv[idim])-1)));
+      ic = ic*aNDiv[idim]+i1;
+    }
+    aIC[ip] = ic;
+    aCellInd[ic+1]++;
+  }
+  for(unsigned int ic=0;ic<nc;++ic){ aCellInd[ic+1] += aCellInd[ic]; }
+  aCellPoint.resize(np);
+  std::vector<unsigned int> aCnt(aCellInd.begin(), aCellInd.end()-1);
+  for(unsigned int ip=0;ip<np;++ip){
+    aCellPoint[aCnt[aIC[ip]]++] = ip;
+  }
+}
+
+DFM2_INLINE unsigned int delfem2::CBucketGrid_NearestPoint::Nearest(
+    const double* p) const
+{
+  int c[3] = {0,0,0};
+  int kmax = 0;
+  double hmin = -1; // lower bound of the distance to the point beyond the ring is (k*hmin)
+  for(unsigned int idim=0;idim<ndim;++idim){
+    const int n = static_cast<int>(aNDiv[idim]);
+    c[idim] = static_cast<int>(std::floor((p[idim]-bbmin[idim])/aH[idim]));
+    c[idim] = std::max(0, std::min(c[idim], n-1));
+    kmax = std::max(kmax, std::max(c[idim], n-1-c[idim]));
+    if( n > 1 && (hmin < 0 || aH[idim] < hmin) ){ hmin = aH[idim]; }
+  }
+  unsigned int ip_min = UINT_MAX;
+  double d2_min = -1;
+  for(int k=0;k<=kmax;++k){
+    const int iz0 = std::max(c[2]-k, 0), iz1 = std::min(c[2]+k, static_cast<int>(aNDiv[2])-1);
+    const int iy0 = std::max(c[1]-k, 0), iy1 = std::min(c[1]+k, static_cast<int>(aNDiv[1])-1);
+    const int ix0 = std::max(c[0]-k, 0), ix1 = std::min(c[0]+k, static_cast<int>(aNDiv[0])-1);
+    for(int iz=iz0;iz<=iz1;++iz){
+      for(int iy=iy0;iy<=iy1;++iy){
+        const bool is_shell_yz = std::abs(iz-c[2]) == k || std::abs(iy-c[1]) == k;
+        for(int ix=ix0;ix<=ix1;++ix){
+          if( !is_shell_yz && std::abs(ix-c[0]) != k ){
+            ix = (ix < c[0]+k) ? c[0]+k-1 : ix; // skip the interior already searched
+            continue;
+          }
+          const unsigned int ic = (iz*aNDiv[1]+iy)*aNDiv[0]+ix;
+          for(unsigned int jcp=aCellInd[ic];jcp<aCellInd[ic+1];++jcp){
+            const unsigned int jp = aCellPoint[jcp];
+            double d2 = 0.0;
+            for(unsigned int idim=0;idim<ndim;++idim){
+              const double d = p[idim]-aXYZ[jp*ndim+idim];
+              d2 += d*d;
+            }
+            if( ip_min == UINT_MAX || d2 < d2_min || (d2 == d2_min && jp > ip_min) ){
+              d2_min = d2;
+              ip_min = jp;
+            }
+          }
+        }
+      }
+    }
+    if( ip_min != UINT_MAX && hmin > 0 && d2_min < (k*hmin)*(k*hmin) ){ break; }
+  }
+  return ip_min;
+}
+
+// ------------------------------------
+
+DFM2_INLINE void delfem2::Step_Lloyd2(
+    std::vector<double> &aXY,
+    //
+    const unsigned int ndiv,
+    const std::vector<double> &aD,
+    const double min_aabb[2],
+    const double max_aabb[2],
+    unsigned int nthread)
+{
+  assert(aD.size() == ndiv * ndiv);
+  const unsigned int np = static_cast<unsigned int>(aXY.size() / 2);
+  const std::vector<double> aXY0 = aXY; // the grid refers to the coordinates before the update
+  CBucketGrid_NearestPoint grid;
+  grid.Initialize(aXY0.data(), np, 2, min_aabb, max_aabb);
+  sampler::MoveToCentroid(
+      aXY, 2, ndiv,
+      [&](unsigned int ih, double* awpw){
+        const double ry0 = 1.0 - (ih + 0.5) / ndiv;
+        const double y0 = min_aabb[1] + (max_aabb[1] - min_aabb[1]) * ry0;
+        for (unsigned int iw = 0; iw < ndiv; ++iw) {
+          const double rx0 = (iw + 0.5) / ndiv;
+          const double x0 = min_aabb[0] + (max_aabb[0] - min_aabb[0]) * rx0;
+          const double p0[2] = {x0, y0};
+          const unsigned int ip0 = grid.Nearest(p0);
+          if( ip0 == UINT_MAX ){ continue; }
+          const double w0 = aD[ih * ndiv + iw];
+          awpw[ip0 * 3 + 0] += w0 * x0;
+          awpw[ip0 * 3 + 1] += w0 * y0;
+          awpw[ip0 * 3 + 2] += w0;
+        }
+      },
+      nthread);
+}
+
+DFM2_INLINE void delfem2::Step_Lloyd3(
+    std::vector<double> &aXYZ,
+    //
+    const std::vector<double> &aXYZ_sample,
+    const std::vector<double> &aW_sample,
+    unsigned int nthread)
+{
+  const unsigned int np = static_cast<unsigned int>(aXYZ.size() / 3);
+  const unsigned int ns = static_cast<unsigned int>(aW_sample.size());
+  assert( aXYZ_sample.size() == ns*3 );
+  if( ns == 0 ){ return; }
+  double bb[6] = {
+      aXYZ_sample[0], aXYZ_sample[1], aXYZ_sample[2],
+      aXYZ_sample[0], aXYZ_sample[1], aXYZ_sample[2] };
+  for(unsigned int is=0;is<ns;++is){
+    for(int idim=0;idim<3;++idim){
+      bb[idim] = std::min(bb[idim], aXYZ_sample[is*3+idim]);
+      bb[idim+3] = std::max(bb[idim+3], aXYZ_sample[is*3+idim]);
+    }
+  }
+  const std::vector<double> aXYZ0 = aXYZ;
+  CBucketGrid_NearestPoint grid;
+  grid.Initialize(aXYZ0.data(), np, 3, bb, bb+3);
+  const unsigned int nrow = (ns + 255) / 256; // blocks of the samples
+  sampler::MoveToCentroid(
+      aXYZ, 3, nrow,
+      [&](unsigned int irow, double* awpw){
+        const unsigned int is1 = std::min(irow*256+256, ns);
+        for(unsigned int is=irow*256;is<is1;++is){
+          const double* p0 = aXYZ_sample.data()+is*3;
+          const unsigned int ip0 = grid.Nearest(p0);
+          if( ip0 == UINT_MAX ){ continue; }
+          const double w0 = aW_sample[is];
+          awpw[ip0 * 4 + 0] += w0 * p0[0];
+          awpw[ip0 * 4 + 1] += w0 * p0[1];
+          awpw[ip0 * 4 + 2] += w0 * p0[2];
+          awpw[ip0 * 4 + 3] += w0;
+        }
+      },
+      nthread);
+}
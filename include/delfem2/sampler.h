@@ -5,9 +5,16 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+/**
+ * @file importance sampling with the Lloyd method
+ * @details the nearest site of each sample is searched with the bucket grid "CBucketGrid_NearestPoint"
+ * and the centroids are accumulated for each thread.
+ */
+
 #ifndef DFM2_SAMPLER_H
 #define DFM2_SAMPLER_H
 
+#include "delfem2/dfm2_inline.h"
 #include <vector>
 #include <climits>
 #include <cassert>
@@ -15,65 +22,80 @@
 namespace delfem2 {
 
 /**
- * @brief one step of importance sampling using the Lloyd method. Brute force approach.
- * @param aXY
+ * @brief uniform grid of buckets to find the nearest point in 2D or 3D
+ * @details the points outside the box are stored in the buckets on the boundary.
+ * The query is the fastest when it is inside the box.
+ */
+class CBucketGrid_NearestPoint {
+public:
+  /**
+   * @param aXYZ coordinates of the points (ndim values per point). The array need to be alive while the search
+   * @param bbmin,bbmax box of the grid (ndim values). Typically the box of the queries
+   * @param npoint_per_cell average number of points in a bucket
+   */
+  void Initialize(
+      const double* aXYZ,
+      unsigned int np,
+      unsigned int ndim,
+      const double* bbmin,
+      const double* bbmax,
+      double npoint_per_cell = 2.0);
+  /**
+   * @return index of the nearest point. The point with the larger index is returned for the tie.
+   * UINT_MAX if there is no point
+   */
+  unsigned int Nearest(const double* p) const;
+public:
+  const double* aXYZ = nullptr;
+  unsigned int np = 0;
+  unsigned int ndim = 0;
+  unsigned int aNDiv[3] = {1,1,1};
+  double bbmin[3] = {0,0,0};
+  double aH[3] = {1,1,1}; // size of the bucket
+  std::vector<unsigned int> aCellInd, aCellPoint; // jagged array of the points in the buckets
+};
+
+/**
+ * @brief one step of importance sampling using the Lloyd method.
+ * @details the pixels are assigned to the nearest point with the bucket grid and
+ * the rows of the pixels are processed in parallel.
+ * The point that has no pixel does not move.
+ * @param aXY (in,out) coordinates of the points moved to the centroids of their Voronoi regions
  * @param ndiv grid resolution
- * @param aD importance defined on the grid
+ * @param aD importance defined on the grid. The row 0 is at the top (max_aabb[1])
  * @param min_aabb
  * @param max_aabb
+ * @param nthread number of threads. 0 for the number of the hardware threads
  */
-void Step_Lloyd2(
+DFM2_INLINE void Step_Lloyd2(
     std::vector<double> &aXY,
     //
     const unsigned int ndiv,
     const std::vector<double> &aD,
     const double min_aabb[2],
-    const double max_aabb[2]) {
-  assert(aD.size() == ndiv * ndiv);
-  const unsigned int np = aXY.size() / 2;
-  std::vector<unsigned int> aV; // Volonoi, index of point, distance for every pixels
-  aV.resize(ndiv * ndiv);
-  for (unsigned int ih = 0; ih < ndiv; ++ih) {
-    for (unsigned int iw = 0; iw < ndiv; ++iw) {
-      const double rx0 = (iw + 0.5) / ndiv;
-      const double ry0 = 1.0 - (ih + 0.5) / ndiv;
-      const double x0 = min_aabb[0] + (max_aabb[0] - min_aabb[0]) * rx0;
-      const double y0 = min_aabb[1] + (max_aabb[1] - min_aabb[1]) * ry0;
-      double min_dist = 4.0;
-      unsigned int min_ip = UINT_MAX;
-      for (unsigned int ip = 0; ip < np; ++ip) {
-        const double x1 = aXY[ip * 2 + 0];
-        const double y1 = aXY[ip * 2 + 1];
-        const double d01 = (x0 - x1) * (x0 - x1) + (y0 - y1) * (y0 - y1);
-        if (d01 > min_dist) { continue; }
-        min_dist = d01;
-        min_ip = ip;
-      }
-      aV[ih * ndiv + iw] = min_ip;
-    }
-  }
+    const double max_aabb[2],
+    unsigned int nthread = 0);
 
-  std::vector<double> awpw(np * 3, 1.0e-10);
-  for (unsigned int ih = 0; ih < ndiv; ++ih) {
-    for (unsigned int iw = 0; iw < ndiv; ++iw) {
-      const double rx0 = (iw + 0.5) / ndiv;
-      const double ry0 = 1.0 - (ih + 0.5) / ndiv;
-      const double x0 = min_aabb[0] + (max_aabb[0] - min_aabb[0]) * rx0;
-      const double y0 = min_aabb[1] + (max_aabb[1] - min_aabb[1]) * ry0;
-      double w0 = aD[ih * ndiv + iw];
-      const unsigned int ip0 = aV[ih * ndiv + iw];
-      awpw[ip0 * 3 + 0] += w0 * x0;
-      awpw[ip0 * 3 + 1] += w0 * y0;
-      awpw[ip0 * 3 + 2] += w0;
-    }
-  }
+/**
+ * @brief one step of the Lloyd method in 3D where the density is given as the weighted samples
+ * @details for the remeshing of the surface, use the points on the surface (e.g., the centers of the triangles
+ * with their areas as the weights) as the samples and project the points back to the surface after this step.
+ * The point that has no sample does not move.
+ * @param aXYZ (in,out) coordinates of the points moved to the centroids of their Voronoi regions
+ * @param aXYZ_sample coordinates of the samples
+ * @param aW_sample weights of the samples
+ */
+DFM2_INLINE void Step_Lloyd3(
+    std::vector<double> &aXYZ,
+    //
+    const std::vector<double> &aXYZ_sample,
+    const std::vector<double> &aW_sample,
+    unsigned int nthread = 0);
 
-  for (unsigned int ip = 0; ip < np; ++ip) {
-    aXY[ip * 2 + 0] = awpw[ip * 3 + 0] / awpw[ip * 3 + 2];
-    aXY[ip * 2 + 1] = awpw[ip * 3 + 1] / awpw[ip * 3 + 2];
-  }
 }
 
-}
+#ifdef DFM2_HEADER_ONLY
+#  include "delfem2/sampler.cpp"
+#endif
 
-#endif // SAMPLER
\ No newline at end of file
+#endif // DFM2_SAMPLER_H
@@ -9,6 +9,7 @@
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <vector>
 
 #ifndef DFM2_TH_H
 #define DFM2_TH_H
@@ -16,14 +17,46 @@
 namespace delfem2 {
 namespace thread {
 
-unsigned int mymin(unsigned int x, unsigned int y) {
+inline unsigned int mymin(unsigned int x, unsigned int y) {
   return (x <= y) ? x : y;
 }
 
-unsigned int mymax(unsigned int x, unsigned int y) {
+inline unsigned int mymax(unsigned int x, unsigned int y) {
   return (x >= y) ? x : y;
 }
 
+/**
+ * @brief number of threads used when the target concurrency is "target_concurrency"
+ * @param target_concurrency if 0, the hardware concurrency is used
+ */
+inline unsigned int num_threads(unsigned int target_concurrency = 0) {
+  unsigned int nthread = (target_concurrency == 0) ? std::thread::hardware_concurrency()
+                                                   : target_concurrency;
+  return (nthread == 0) ? 4 : nthread;
+}
+
+/**
+ * @brief split the tasks into "nthread" contiguous ranges and run them in parallel
+ * @details "function(ithread, itask_start, itask_end)" is called once for each thread.
+ * Use this when a thread needs its own buffer (indexed by ithread).
+ */
+template<typename FUNCTION>
+void parallel_for_range(
+    unsigned int ntask,
+    FUNCTION function,
+    unsigned int nthread) {
+  if( ntask == 0 || nthread == 0 ){ return; }
+  if( nthread == 1 ){ function(0, 0, ntask); return; }
+  const unsigned int ntasks_per_thread = (ntask / nthread) + (ntask % nthread == 0 ? 0 : 1);
+  std::vector<std::thread> aThread;
+  for (unsigned int jthread = 0; jthread < nthread; ++jthread) {
+    const unsigned int itask_start = mymin(ntask, jthread * ntasks_per_thread);
+    const unsigned int itask_end = mymin(ntask, itask_start + ntasks_per_thread);
+    aThread.push_back(std::thread(function, jthread, itask_start, itask_end));
+  }
+  for (auto &t : aThread) { t.join(); }
+}
+
 template<typename FUNCTION>
 void parallel_for(
     unsigned int ntask,
@@ -201,11 +201,7 @@ std::vector<REAL> Solve_BiCGStab(
     unsigned int max_niter,
     const MAT& mat)
 {
-  assert(!mat.valDia.empty());
-  assert(mat.nrowblk == mat.ncolblk);
-  assert(mat.nrowdim == mat.ncoldim);
-  const unsigned int ndof = mat.nrowblk * mat.nrowdim;
-  assert(r_vec.size() == ndof);
+  const unsigned int ndof = static_cast<unsigned int>(r_vec.size()); // "mat" only need "MatVec"
   
   std::vector<double> aConv;
   double sq_inv_norm_res_ini;
@@ -283,12 +279,7 @@ Solve_BiCGSTAB_Complex(
     const MAT& mat)
 {
   using COMPLEX = std::complex<REAL>;
-  //
-  assert(!mat.valDia.empty());
-  assert(mat.nblk_col == mat.nblk_row);
-  assert(mat.nrowdim == mat.len_row);
-  const unsigned int ndof = mat.nblk_col * mat.nrowdim;
-  assert(r_vec.size() == ndof);
+  const unsigned int ndof = static_cast<unsigned int>(r_vec.size()); // "mat" only need "MatVec"
   
   std::vector<double> aConv;
   double sq_inv_norm_res_ini;
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2020 Nobuyuki Umetani
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file benchmark of the mesh readers in "mshiofast.h" against the ones in "mshio.h".
+ * @details usage: "benchMshIO [ndiv]". A closed cylinder with about 2*ndiv*ndiv triangles is written
+ * as OBJ, ascii PLY and binary STL, and loaded with the old and the new readers. The files are removed at the end.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include "delfem2/mshiofast.h"
+#include "delfem2/mshio.h"
+#include "delfem2/mshprimitive.h"
+
+namespace dfm2 = delfem2;
+
+// ---------------------------
+
+double TimeMilliSec(
+    const std::function<void()>& func,
+    unsigned int nrep)
+{
+  double t_min = -1;
+  for(unsigned int irep=0;irep<nrep;++irep){ // the fastest of the repetitions
+    const auto t0 = std::chrono::steady_clock::now();
+    func();
+    const auto t1 = std::chrono::steady_clock::now();
+    const double t = std::chrono::duration<double,std::milli>(t1-t0).count();
+    if( t_min < 0 || t < t_min ){ t_min = t; }
+  }
+  return t_min;
+}
+
+void Report(
+    const char* name,
+    double t_old,
+    double t_new,
+    bool is_same)
+{
+  std::cout << name << "  old: " << t_old << "ms  new: " << t_new << "ms";
+  std::cout << "  speedup: " << t_old/t_new;
+  if( !is_same ){ std::cout << "  (the results are different)"; }
+  std::cout << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  const unsigned int ndiv = (argc > 1) ? std::atoi(argv[1]) : 1024;
+  const unsigned int nrep = 3;
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_CylinderClosed(aXYZ, aTri, 0.3, 1.0, ndiv, ndiv);
+  std::cout << "nvtx: " << aXYZ.size()/3 << "  ntri: " << aTri.size()/3 << std::endl;
+  dfm2::Write_Obj("tmp_bench_mshio.obj",
+                  aXYZ.data(), aXYZ.size()/3,
+                  aTri.data(), aTri.size()/3);
+  dfm2::Write_Ply("tmp_bench_mshio.ply",
+                  aXYZ.size()/3, aXYZ.data(),
+                  aTri.size()/3, aTri.data());
+  dfm2::Write_STL_Binary("tmp_bench_mshio.stl", aXYZ, aTri);
+  std::vector<double> aXYZ0, aXYZ1;
+  std::vector<unsigned int> aTri0, aTri1;
+  {
+    const double t0 = TimeMilliSec([&](){ dfm2::Read_Obj("tmp_bench_mshio.obj", aXYZ0, aTri0); }, nrep);
+    const double t1 = TimeMilliSec([&](){ dfm2::Read_Obj_Fast("tmp_bench_mshio.obj", aXYZ1, aTri1); }, nrep);
+    Report("obj", t0, t1, aXYZ0 == aXYZ1 && aTri0 == aTri1);
+  }
+  {
+    const double t0 = TimeMilliSec([&](){ dfm2::Read_Ply("tmp_bench_mshio.ply", aXYZ0, aTri0); }, nrep);
+    const double t1 = TimeMilliSec([&](){ dfm2::Read_Ply_Fast("tmp_bench_mshio.ply", aXYZ1, aTri1); }, nrep);
+    Report("ply", t0, t1, aXYZ0 == aXYZ1 && aTri0 == aTri1);
+  }
+  { // there is no STL reader in "mshio.h", so the binary STL is compared with the OBJ reader for the same mesh
+    const double t0 = TimeMilliSec([&](){ dfm2::Read_Obj("tmp_bench_mshio.obj", aXYZ0, aTri0); }, nrep);
+    const double t1 = TimeMilliSec([&](){ dfm2::Read_STL("tmp_bench_mshio.stl", aXYZ1, aTri1); }, nrep);
+    Report("stl", t0, t1, aTri0.size() == aTri1.size());
+  }
+  std::remove("tmp_bench_mshio.obj");
+  std::remove("tmp_bench_mshio.ply");
+  std::remove("tmp_bench_mshio.stl");
+  return 0;
+}
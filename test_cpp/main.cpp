@@ -18,6 +18,9 @@
 #include "delfem2/evalmathexp.h"
 #include <cstring>
 #include <random>
+#include <fstream>
+#include <complex>
+#include <cstdio>
 
 #ifndef M_PI
 #  define M_PI 3.14159265359
@@ -83,6 +86,165 @@ TEST(funcs,numpy_load_1df){
   EXPECT_EQ(aData.size(),ndim0);
 }
 
+TEST(funcs,numpy_ndim){
+  std::mt19937 rndeng(0);
+  std::uniform_real_distribution<double> dist(-1,1);
+  const std::vector<size_t> aShape = {3, 4, 5};
+  std::vector<double> aVal(60);
+  for(auto& v : aVal){ v = dist(rndeng); }
+  EXPECT_TRUE(dfm2::SaveNumpy("tmp_ndim.npy", aShape, aVal.data()));
+  { // load with conversion
+    std::vector<size_t> aShape1;
+    std::vector<float> aVal1;
+    EXPECT_TRUE(dfm2::LoadNumpy(aShape1, aVal1, "tmp_ndim.npy"));
+    EXPECT_EQ(aShape1, aShape);
+    ASSERT_EQ(aVal1.size(), aVal.size());
+    for(unsigned int i=0;i<aVal.size();++i){ EXPECT_FLOAT_EQ(aVal1[i], static_cast<float>(aVal[i])); }
+  }
+  { // zero-copy access
+    dfm2::CNumpyMappedArray npy;
+    EXPECT_TRUE(npy.Open("tmp_ndim.npy"));
+    EXPECT_EQ(npy.Header().shape, aShape);
+    EXPECT_EQ(npy.Data<float>(), nullptr);
+    const double* p = npy.Data<double>();
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(std::memcmp(p, aVal.data(), aVal.size()*sizeof(double)), 0);
+  }
+  { // big endian array in the Fortran order
+    dfm2::CNumpyHeader head;
+    head.kind = 'i';
+    head.nbyte_value = 4;
+    head.is_big_endian = true;
+    head.fortran_order = true;
+    head.shape = {2, 3, 4};
+    std::string buff = dfm2::MakeNumpyHeader(head);
+    EXPECT_EQ(buff.size() % 64, 0);
+    for(int k=0;k<4;++k){
+      for(int j=0;j<3;++j){
+        for(int i=0;i<2;++i){
+          const int v = i*100+j*10+k;
+          for(int ib=3;ib>=0;--ib){ buff.push_back(static_cast<char>((v >> (8*ib)) & 0xFF)); }
+        }
+      }
+    }
+    std::ofstream("tmp_fortran.npy", std::ios::binary).write(buff.data(), buff.size());
+    std::vector<size_t> aShape1;
+    std::vector<int> aVal1;
+    EXPECT_TRUE(dfm2::LoadNumpy(aShape1, aVal1, "tmp_fortran.npy"));
+    EXPECT_EQ(aShape1, head.shape);
+    ASSERT_EQ(aVal1.size(), 24);
+    for(int i=0;i<2;++i){
+      for(int j=0;j<3;++j){
+        for(int k=0;k<4;++k){ EXPECT_EQ(aVal1[(i*3+j)*4+k], i*100+j*10+k); }
+      }
+    }
+  }
+  { // malformed shape is rejected without exception
+    dfm2::CNumpyHeader head;
+    head.shape = {2, 3};
+    std::string buff = dfm2::MakeNumpyHeader(head);
+    buff.replace(buff.find("(2, 3)"), 6, "(2, x)");
+    EXPECT_FALSE(dfm2::ParseNumpyHeader(head, buff.data(), buff.size()));
+  }
+  std::remove("tmp_ndim.npy");
+  std::remove("tmp_fortran.npy");
+}
+
+TEST(funcs,numpy_stream){
+  const unsigned int nrow = 1000;
+  { // write rows in small chunks
+    dfm2::CNumpyRowWriter writer;
+    EXPECT_TRUE(writer.Open<float>("tmp_stream.npy", {3}));
+    std::vector<float> aRow(3*7);
+    for(unsigned int irow=0;irow<nrow;irow+=7){
+      const unsigned int n = std::min(7u, nrow-irow);
+      for(unsigned int i=0;i<n*3;++i){ aRow[i] = static_cast<float>(irow*3+i); }
+      EXPECT_TRUE(writer.WriteRows(aRow.data(), n));
+    }
+    EXPECT_FALSE(writer.WriteRows(std::vector<double>(3).data(), 1));
+    EXPECT_EQ(writer.NumRows(), nrow);
+    EXPECT_TRUE(writer.Close());
+  }
+  {
+    std::vector<size_t> aShape;
+    std::vector<double> aVal;
+    EXPECT_TRUE(dfm2::LoadNumpy(aShape, aVal, "tmp_stream.npy"));
+    EXPECT_EQ(aShape, std::vector<size_t>({nrow, 3}));
+  }
+  { // read rows in chunks
+    dfm2::CNumpyRowReader reader;
+    EXPECT_TRUE(reader.Open("tmp_stream.npy"));
+    EXPECT_EQ(reader.NumRows(), nrow);
+    std::vector<unsigned int> aVal;
+    unsigned int irow = 0;
+    for(;;){
+      const size_t n = reader.ReadRows(aVal, 64);
+      if( n == 0 ){ break; }
+      EXPECT_EQ(aVal.size(), n*3);
+      for(unsigned int i=0;i<n*3;++i){ EXPECT_EQ(aVal[i], irow*3+i); }
+      irow += n;
+    }
+    EXPECT_EQ(irow, nrow);
+    EXPECT_EQ(reader.NumRowsRemaining(), 0);
+  }
+  { // version 1 header followed by no data
+    dfm2::CNumpyHeader head;
+    head.shape = {0};
+    const std::string buff = dfm2::MakeNumpyHeader(head);
+    ASSERT_EQ(buff[6], 1);
+    std::ofstream("tmp_empty.npy", std::ios::binary).write(buff.data(), buff.size());
+    dfm2::CNumpyRowReader reader;
+    EXPECT_TRUE(reader.Open("tmp_empty.npy"));
+    EXPECT_EQ(reader.NumRows(), 0);
+  }
+  std::remove("tmp_stream.npy");
+  std::remove("tmp_empty.npy");
+}
+
+TEST(funcs,numpy_npz){
+  const std::vector<double> aXYZ = {0,0,0, 1,0,0, 0,1,0, 0,0,1};
+  const std::vector<unsigned int> aTri = {0,2,1, 0,1,3, 1,2,3, 2,0,3};
+  const std::vector<std::complex<double>> aC = {{1,2}, {3,4}};
+  std::vector<double> aRnd(30000); // incompressible data larger than the output buffer of zlib
+  {
+    std::mt19937 rndeng(0);
+    std::uniform_real_distribution<double> dist(-1,1);
+    for(auto& v : aRnd){ v = dist(rndeng); }
+  }
+  for(bool is_compress : {false, true}) {
+    {
+      dfm2::CNumpyZipWriter writer;
+      EXPECT_TRUE(writer.Open("tmp_arrays.npz", is_compress));
+      EXPECT_TRUE(writer.Add("xyz", {4, 3}, aXYZ.data()));
+      EXPECT_TRUE(writer.Add("tri", {4, 3}, aTri.data()));
+      EXPECT_TRUE(writer.Add("c", {2}, aC.data()));
+      EXPECT_TRUE(writer.Add("rnd", {aRnd.size()}, aRnd.data()));
+      EXPECT_TRUE(writer.Close());
+    }
+    dfm2::CNumpyZipReader reader;
+    EXPECT_TRUE(reader.Open("tmp_arrays.npz"));
+    EXPECT_EQ(reader.Names(), std::vector<std::string>({"c", "rnd", "tri", "xyz"}));
+    std::vector<size_t> aShape;
+    std::vector<double> aXYZ1;
+    EXPECT_TRUE(reader.Get(aShape, aXYZ1, "xyz"));
+    EXPECT_EQ(aShape, std::vector<size_t>({4, 3}));
+    EXPECT_EQ(aXYZ1, aXYZ);
+    std::vector<unsigned int> aTri1;
+    EXPECT_TRUE(reader.Get(aShape, aTri1, "tri"));
+    EXPECT_EQ(aTri1, aTri);
+    std::vector<std::complex<double>> aC1;
+    EXPECT_TRUE(reader.Get(aShape, aC1, "c"));
+    EXPECT_EQ(aC1, aC);
+    std::vector<double> aC2;
+    EXPECT_FALSE(reader.Get(aShape, aC2, "c")); // complex to real
+    EXPECT_FALSE(reader.Get(aShape, aC2, "none"));
+    std::vector<double> aRnd1;
+    EXPECT_TRUE(reader.Get(aShape, aRnd1, "rnd"));
+    EXPECT_EQ(aRnd1, aRnd);
+  }
+  std::remove("tmp_arrays.npz");
+}
+
 TEST(funcs,split_parentheses){
   {
     std::string str = "(a,b),c,(d,e)";
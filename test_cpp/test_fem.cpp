@@ -18,18 +18,28 @@
 
 #include "delfem2/fempoisson.h"
 #include "delfem2/femmitc3.h"
+#include "delfem2/femcloth.h"
+#include "delfem2/defarap.h"
 
 #include "delfem2/vecxitrsol.h"
 #include "delfem2/lsilu_mats.h"
+#include "delfem2/lsldlt_mats.h"
+#include "delfem2/filesnapshot.h"
+#include "delfem2/srch_v3bvhmshtopo.h"
+#include "delfem2/srchbv3aabb.h"
 #include "delfem2/lsitrsol.h"
 #include "delfem2/lsmats.h"
 #include "delfem2/lsvecx.h"
+#include "delfem2/lsmatfree.h"
+#include "delfem2/bem.h"
 
 #include "delfem2/mshuni.h"
 #include "delfem2/mshmisc.h"
 #include "delfem2/points.h"
 #include "delfem2/mshprimitive.h"
 #include <random>
+#include <cstdio>
+#include <limits>
 
 
 namespace dfm2 = delfem2;
@@ -266,6 +276,314 @@ TEST(objfunc_v23, pbd_energy_stvk)
   }
 }
 
+TEST(objfunc_v23, pbd_constraint_batch)
+{
+  const unsigned int n = 20; // cloth of (n+1)x(n+1) grid points
+  std::vector<double> aXY0, aXYZ;
+  for(unsigned int iy=0;iy<=n;++iy){
+    for(unsigned int ix=0;ix<=n;++ix){
+      aXY0.push_back(ix*1.0/n);
+      aXY0.push_back(iy*1.0/n);
+      aXYZ.push_back(ix*1.0/n);
+      aXYZ.push_back(iy*1.0/n);
+      aXYZ.push_back(0.0);
+    }
+  }
+  const unsigned int np = (n+1)*(n+1);
+  std::vector<unsigned int> aTri;
+  for(unsigned int iy=0;iy<n;++iy){
+    for(unsigned int ix=0;ix<n;++ix){
+      const unsigned int i0 = iy*(n+1)+ix;
+      const unsigned int aIP[6] = {i0, i0+1, i0+n+2, i0, i0+n+2, i0+n+1};
+      aTri.insert(aTri.end(), aIP, aIP+6);
+    }
+  }
+  const unsigned int ntri = static_cast<unsigned int>(aTri.size()/3);
+  std::vector<double> aRest(ntri*6);
+  for(unsigned int it=0;it<ntri;++it){
+    for(unsigned int inode=0;inode<3;++inode){
+      aRest[it*6+inode*2+0] = aXY0[aTri[it*3+inode]*2+0];
+      aRest[it*6+inode*2+1] = aXY0[aTri[it*3+inode]*2+1];
+    }
+  }
+  std::vector<double> aInvMass(np, 1.0);
+  aInvMass[n*(n+1)] = 0.0; // fix two corners
+  aInvMass[n*(n+1)+n] = 0.0;
+  for(unsigned int ip=0;ip<np;++ip){ // perturb
+    if( aInvMass[ip] == 0.0 ){ continue; }
+    aXYZ[ip*3+2] -= 0.1*sin(aXYZ[ip*3+0]*3.0)*aXYZ[ip*3+1];
+    aXYZ[ip*3+1] -= 0.05*aXYZ[ip*3+0]*aXYZ[ip*3+0];
+  }
+  dfm2::CPBD_ConstraintBatch<3,3> batch;
+  batch.Initialize(aTri.data(), ntri, aRest.data(), 6, np);
+  EXPECT_EQ(batch.NumConstraint(), ntri);
+  EXPECT_LE(batch.NumColor(), 12);
+  for(unsigned int icolor=0;icolor<batch.NumColor();++icolor){ // points are not shared in a color
+    std::vector<int> aFlg(np, 0);
+    for(unsigned int je=batch.aColorInd[icolor];je<batch.aColorInd[icolor+1];++je){
+      for(unsigned int inode=0;inode<3;++inode){
+        const unsigned int ip = batch.aElemSoA[inode*ntri+je];
+        EXPECT_EQ(aFlg[ip], 0);
+        aFlg[ip] = 1;
+      }
+    }
+  }
+  const dfm2::CPBD_CdC_DistanceTri2D3D cdc;
+  auto violation = [&](const std::vector<double>& aP){
+    double v = 0.0;
+    for(unsigned int it=0;it<ntri;++it){
+      double p[9], C[3], dCdp[27];
+      for(unsigned int inode=0;inode<3;++inode){
+        for(int idim=0;idim<3;++idim){ p[inode*3+idim] = aP[aTri[it*3+inode]*3+idim]; }
+      }
+      cdc(C, dCdp, aRest.data()+it*6, p);
+      v += C[0]*C[0] + C[1]*C[1] + C[2]*C[2];
+    }
+    return sqrt(v);
+  };
+  const double v0 = violation(aXYZ);
+  for(bool is_jacobi : {false, true}){
+    std::vector<double> aP1 = aXYZ, aP4 = aXYZ;
+    batch.ResetMultiplier();
+    for(int itr=0;itr<20;++itr){ batch.Project(aP1.data(), aInvMass.data(), cdc, 0.0, 0.01, is_jacobi, 1.0, 1); }
+    batch.ResetMultiplier();
+    for(int itr=0;itr<20;++itr){ batch.Project(aP4.data(), aInvMass.data(), cdc, 0.0, 0.01, is_jacobi, 1.0, 4); }
+    EXPECT_EQ(aP1, aP4); // deterministic
+    EXPECT_LT(violation(aP1), v0*0.7);
+    for(unsigned int ip=0;ip<np;++ip){
+      if( aInvMass[ip] != 0.0 ){ continue; }
+      EXPECT_EQ(aP1[ip*3+0], aXYZ[ip*3+0]);
+    }
+  }
+  { // same as the serial projection in the colored order
+    std::vector<double> aP0 = aXYZ, aP1 = aXYZ;
+    const std::vector<double> aInvMass1(np, 1.0);
+    batch.Project(aP0.data(), aInvMass1.data(), cdc, 0.0, 0.01);
+    for(unsigned int ie : batch.aOrder){
+      const unsigned int* aIP = aTri.data()+ie*3;
+      double p[3][3], C[3], dCdp[3][9];
+      for(unsigned int inode=0;inode<3;++inode){
+        for(int idim=0;idim<3;++idim){ p[inode][idim] = aP1[aIP[inode]*3+idim]; }
+      }
+      dfm2::PBD_ConstraintProjection_DistanceTri2D3D(C, dCdp, (const double(*)[2])(aRest.data()+ie*6), p);
+      const double mass[3] = {1,1,1};
+      dfm2::PBD_Update_Const3(aP1.data(), 3, 3, mass, C, &dCdp[0][0], aIP, 1.0);
+    }
+    for(unsigned int i=0;i<np*3;++i){ EXPECT_NEAR(aP0[i], aP1[i], 1.0e-10); }
+  }
+  { // XPBD with compliance for a distance constraint: the length 2 becomes 2-2/(2+alpha_tilde)
+    const unsigned int aLine[2] = {0, 1};
+    const double L0 = 1.0;
+    dfm2::CPBD_ConstraintBatch<2,1> batch1;
+    batch1.Initialize(aLine, 1, &L0, 1, 2);
+    for(double alpha_tilde : {0.0, 1.0, 3.0}){
+      std::vector<double> aP = {0,0,0, 2,0,0};
+      const double aInvMass1[2] = {1.0, 1.0};
+      batch1.ResetMultiplier();
+      batch1.Project(aP.data(), aInvMass1, dfm2::CPBD_CdC_Distance(), alpha_tilde*0.01, 0.1);
+      EXPECT_NEAR(aP[3]-aP[0], 2.0-2.0/(2.0+alpha_tilde), 1.0e-10);
+      EXPECT_NEAR(batch1.aLambda[0], -1.0/(2.0+alpha_tilde), 1.0e-10);
+    }
+  }
+}
+
+TEST(objfunc_v23, xpbd_cloth)
+{
+  const unsigned int n = 16; // two panels of (n+1)x(n/2+1) grid points sewed at y=0.5
+  std::vector<double> aXY0, aXYZ;
+  for(unsigned int iy=0;iy<=n;++iy){
+    for(unsigned int ix=0;ix<=n;++ix){
+      aXY0.push_back(ix*1.0/n);
+      aXY0.push_back(iy*1.0/n);
+    }
+  }
+  for(unsigned int ix=0;ix<=n;++ix){ // duplicated points on the seam
+    aXY0.push_back(ix*1.0/n);
+    aXY0.push_back(0.5);
+  }
+  const unsigned int np = static_cast<unsigned int>(aXY0.size()/2);
+  for(unsigned int ip=0;ip<np;++ip){
+    aXYZ.push_back(aXY0[ip*2+0]);
+    aXYZ.push_back(aXY0[ip*2+1]);
+    aXYZ.push_back(0.0);
+  }
+  std::vector<unsigned int> aTri;
+  for(unsigned int iy=0;iy<n;++iy){
+    for(unsigned int ix=0;ix<n;++ix){
+      const unsigned int i0 = iy*(n+1)+ix;
+      unsigned int aIP[6] = {i0, i0+1, i0+n+2, i0, i0+n+2, i0+n+1};
+      for(unsigned int& ip : aIP){ // lower panel uses the duplicated points
+        if( iy < n/2 && ip/(n+1) == n/2 ){ ip = (n+1)*(n+1) + ip%(n+1); }
+      }
+      aTri.insert(aTri.end(), aIP, aIP+6);
+    }
+  }
+  std::vector<unsigned int> aLine;
+  for(unsigned int ix=0;ix<=n;++ix){
+    aLine.push_back((n/2)*(n+1)+ix);
+    aLine.push_back((n+1)*(n+1)+ix);
+  }
+  const unsigned int ip0 = n*(n+1), ip1 = n*(n+1)+n; // fixed corners
+  auto max_strain = [&](const std::vector<double>& aP){
+    double s = 0.0;
+    for(unsigned int it=0;it<aTri.size()/3;++it){
+      for(unsigned int iedge=0;iedge<3;++iedge){
+        const unsigned int i0 = aTri[it*3+iedge], i1 = aTri[it*3+(iedge+1)%3];
+        const double l0 = sqrt(dfm2::SquareDistance2(aXY0.data()+i0*2, aXY0.data()+i1*2));
+        const double l1 = dfm2::Distance3(aP.data()+i0*3, aP.data()+i1*3);
+        s = (fabs(l1/l0-1.0) > s) ? fabs(l1/l0-1.0) : s;
+      }
+    }
+    return s;
+  };
+  dfm2::CXPBD_Cloth aCloth[2];
+  for(unsigned int ic=0;ic<2;++ic){
+    dfm2::CXPBD_Cloth& cloth = aCloth[ic];
+    cloth.Initialize(aXYZ, aTri, aXY0);
+    cloth.aInvMass[ip0] = 0.0;
+    cloth.aInvMass[ip1] = 0.0;
+    cloth.SetSeam(aLine);
+    EXPECT_EQ(cloth.batch_stretch.NumConstraint(), aTri.size()/3);
+    EXPECT_EQ(cloth.batch_seam.NumConstraint(), n+1);
+    double zmin = 0.0;
+    for(int iframe=0;iframe<30;++iframe){
+      cloth.Step(1.0/60.0, 10, (ic==0) ? 1 : 4);
+      EXPECT_LT(max_strain(cloth.aXYZ), 0.25); // largest around the fixed corners
+      for(unsigned int ip=0;ip<np;++ip){
+        ASSERT_TRUE(std::isfinite(cloth.aXYZ[ip*3+2]));
+        zmin = (cloth.aXYZ[ip*3+2] < zmin) ? cloth.aXYZ[ip*3+2] : zmin;
+      }
+    }
+    EXPECT_LT(zmin, -0.5); // falling down
+    EXPECT_GT(zmin, -1.2);
+  }
+  EXPECT_EQ(aCloth[0].aXYZ, aCloth[1].aXYZ); // deterministic
+  const std::vector<double>& aP = aCloth[0].aXYZ;
+  for(unsigned int idim=0;idim<3;++idim){
+    EXPECT_EQ(aP[ip0*3+idim], aXYZ[ip0*3+idim]);
+    EXPECT_EQ(aP[ip1*3+idim], aXYZ[ip1*3+idim]);
+  }
+  for(unsigned int il=0;il<aLine.size()/2;++il){
+    EXPECT_LT(dfm2::Distance3(aP.data()+aLine[il*2+0]*3, aP.data()+aLine[il*2+1]*3), 1.0e-2);
+  }
+}
+
+TEST(objfunc_v23, pbd_shape_matching)
+{
+  { // 2D
+    std::vector<double> aXY0;
+    std::vector<unsigned int> aQuad;
+    dfm2::MeshQuad2D_Grid(aXY0, aQuad, 12, 8);
+    const unsigned int np = static_cast<unsigned int>(aXY0.size()/2);
+    std::vector<unsigned int> clstr_ind, clstr;
+    {
+      std::vector<unsigned int> psup_ind, psup;
+      dfm2::JArray_PSuP_MeshElem(psup_ind, psup, aQuad.data(), aQuad.size()/4, 4, np);
+      dfm2::JArray_AddDiagonal(clstr_ind, clstr,
+                               psup_ind.data(), psup_ind.size(), psup.data(), psup.size());
+    }
+    std::vector<double> aXYt = aXY0;
+    for(unsigned int ip=0;ip<np;++ip){
+      aXYt[ip*2+0] += 0.3*sin(aXY0[ip*2+1]);
+      aXYt[ip*2+1] += 0.1*aXY0[ip*2+0]*cos(aXY0[ip*2+0]);
+    }
+    dfm2::CPBD_ShapeMatching sm;
+    EXPECT_EQ(sm.NumCluster(), 0); // not initialized
+    EXPECT_EQ(sm.NumColor(), 0);
+    sm.Initialize(2, clstr_ind, clstr, aXY0);
+    EXPECT_EQ(sm.NumCluster(), np);
+    for(unsigned int icolor=0;icolor<sm.NumColor();++icolor){ // points are not shared in a color
+      std::vector<int> aFlg(np, 0);
+      for(unsigned int jc=sm.aColorInd[icolor];jc<sm.aColorInd[icolor+1];++jc){
+        const unsigned int iclstr = sm.aOrder[jc];
+        for(unsigned int iip=clstr_ind[iclstr];iip<clstr_ind[iclstr+1];++iip){
+          EXPECT_EQ(aFlg[clstr[iip]], 0);
+          aFlg[clstr[iip]] = 1;
+        }
+      }
+    }
+    { // colored projection is the same as the serial projection in the colored order
+      std::vector<unsigned int> clstr_ind1(1,0), clstr1;
+      for(unsigned int iclstr : sm.aOrder){
+        clstr1.insert(clstr1.end(), clstr.begin()+clstr_ind[iclstr], clstr.begin()+clstr_ind[iclstr+1]);
+        clstr_ind1.push_back(static_cast<unsigned int>(clstr1.size()));
+      }
+      std::vector<double> aP0 = aXYt, aP1 = aXYt;
+      sm.Project(aP0.data(), 0.5, false, 4);
+      dfm2::PBD_ConstProj_Rigid2D(aP1.data(), 0.5,
+                                  clstr_ind1.data(), clstr_ind1.size(),
+                                  clstr1.data(), clstr1.size(),
+                                  aXY0.data(), aXY0.size());
+      for(unsigned int i=0;i<np*2;++i){ EXPECT_NEAR(aP0[i], aP1[i], 1.0e-10); }
+    }
+    { // jacobi
+      std::vector<double> aP1 = aXYt, aP4 = aXYt;
+      for(int itr=0;itr<5;++itr){
+        sm.Project(aP1.data(), 0.5, true, 1);
+        sm.Project(aP4.data(), 0.5, true, 4);
+      }
+      EXPECT_EQ(aP1, aP4);
+    }
+  }
+  { // 3D: clusters of 2x2x2 points. rigid transformation is recovered
+    const unsigned int n = 5;
+    std::vector<double> aXYZ0;
+    for(unsigned int iz=0;iz<n;++iz){
+      for(unsigned int iy=0;iy<n;++iy){
+        for(unsigned int ix=0;ix<n;++ix){
+          aXYZ0.push_back(ix);
+          aXYZ0.push_back(iy);
+          aXYZ0.push_back(iz);
+        }
+      }
+    }
+    const unsigned int np = n*n*n;
+    std::vector<unsigned int> clstr_ind(1,0), clstr;
+    for(unsigned int iz=0;iz<n-1;++iz){
+      for(unsigned int iy=0;iy<n-1;++iy){
+        for(unsigned int ix=0;ix<n-1;++ix){
+          for(unsigned int i=0;i<8;++i){
+            clstr.push_back(((iz+i/4)*n+(iy+(i/2)%2))*n+(ix+i%2));
+          }
+          clstr_ind.push_back(static_cast<unsigned int>(clstr.size()));
+        }
+      }
+    }
+    double R[9];
+    {
+      const double a[3] = {0.3, -0.8, 0.5};
+      double q[4]; dfm2::Quat_CartesianAngle(q, a);
+      dfm2::Mat3_Quat(R, q);
+    }
+    std::vector<double> aXYZ1(np*3); // rigid transformation of rest shape
+    for(unsigned int ip=0;ip<np;++ip){
+      const double* p = aXYZ0.data()+ip*3;
+      for(int i=0;i<3;++i){ aXYZ1[ip*3+i] = R[i*3+0]*p[0]+R[i*3+1]*p[1]+R[i*3+2]*p[2] + 1.0 + i; }
+    }
+    for(bool is_jacobi : {false, true}){
+      dfm2::CPBD_ShapeMatching sm;
+      sm.Initialize(3, clstr_ind, clstr, aXYZ0);
+      std::vector<double> aP1 = aXYZ1, aP4 = aXYZ1;
+      for(unsigned int ip=0;ip<np;++ip){ aP1[ip*3+2] += 0.2*sin(ip*1.0); } // perturb
+      aP4 = aP1;
+      dfm2::CPBD_ShapeMatching sm4 = sm;
+      for(int itr=0;itr<300;++itr){
+        sm.Project(aP1.data(), 1.0, is_jacobi, 1);
+        sm4.Project(aP4.data(), 1.0, is_jacobi, 4);
+      }
+      EXPECT_EQ(aP1, aP4);
+      // the body is rigid after the projection
+      for(unsigned int ip=0;ip<np;++ip){
+        for(unsigned int jp=ip+1;jp<np;++jp){
+          const double d0 = dfm2::Distance3(aXYZ0.data()+ip*3, aXYZ0.data()+jp*3);
+          const double d1 = dfm2::Distance3(aP1.data()+ip*3, aP1.data()+jp*3);
+          EXPECT_NEAR(d0, d1, 1.0e-3);
+        }
+      }
+    }
+  }
+}
+
 TEST(objfunc_v23, dWddW_RodFrameTrans)
 {
   std::random_device randomDevice;
@@ -978,3 +1296,620 @@ TEST(fem,plate_bending_mitc3_cantilever)
     }
   }
 }
+
+TEST(fem,cloth_merge_parallel)
+{
+  std::vector<double> aXYZ0;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Cube(aXYZ0,aTri, 6);
+  const unsigned int np = aXYZ0.size()/3;
+  std::vector<unsigned int> aQuad;
+  dfm2::ElemQuad_DihedralTri(aQuad,aTri.data(),aTri.size()/3,np);
+  std::vector<double> aXYZ = aXYZ0;
+  {
+    std::mt19937 rdeng(0);
+    std::uniform_real_distribution<double> dist(-0.01, 0.01);
+    for(auto& x : aXYZ){ x += dist(rdeng); }
+  }
+  dfm2::CMatrixSparse<double> mat0, mat1;
+  {
+    std::vector<unsigned int> psup_ind, psup;
+    dfm2::JArray_PSuP_MeshElem(psup_ind, psup,
+                               aQuad.data(), aQuad.size()/4, 4, np);
+    dfm2::JArray_Sort(psup_ind, psup);
+    mat0.Initialize(np, 3, true);
+    mat0.SetPattern(psup_ind.data(), psup_ind.size(), psup.data(),psup.size());
+    mat1.Initialize(np, 3, true);
+    mat1.SetPattern(psup_ind.data(), psup_ind.size(), psup.data(),psup.size());
+  }
+  std::vector<unsigned int> aTriColor_ind, aTriColor, aQuadColor_ind, aQuadColor;
+  dfm2::JArray_ColorElem_MeshElem(aTriColor_ind,aTriColor,
+                                  aTri.data(),aTri.size()/3,3,np);
+  dfm2::JArray_ColorElem_MeshElem(aQuadColor_ind,aQuadColor,
+                                  aQuad.data(),aQuad.size()/4,4,np);
+  for(unsigned int icolor=0;icolor+1<aQuadColor_ind.size();++icolor){ // no shared point in a color
+    std::vector<int> aFlg(np,0);
+    for(unsigned int iiq=aQuadColor_ind[icolor];iiq<aQuadColor_ind[icolor+1];++iiq){
+      for(int ino=0;ino<4;++ino){
+        const unsigned int ip = aQuad[aQuadColor[iiq]*4+ino];
+        EXPECT_EQ(aFlg[ip],0);
+        aFlg[ip] = 1;
+      }
+    }
+  }
+  const double lambda = 1.0, myu = 2.0, stiff_bend = 0.1;
+  std::vector<double> dW0(np*3,0.0), dW1(np*3,0.0);
+  mat0.setZero();
+  const double W0 = dfm2::MergeLinSys_Cloth(
+      mat0, dW0.data(),
+      lambda, myu, stiff_bend,
+      aXYZ0.data(), np, 3,
+      aTri.data(), aTri.size()/3,
+      aQuad.data(), aQuad.size()/4,
+      aXYZ.data());
+  for(unsigned int nthread=1;nthread<5;++nthread){
+    mat1.setZero();
+    for(auto& v : dW1){ v = 0.0; }
+    const double W1 = dfm2::MergeLinSys_Cloth_Parallel(
+        mat1, dW1.data(),
+        lambda, myu, stiff_bend,
+        aXYZ0.data(), np, 3,
+        aTri.data(), aTri.size()/3, aTriColor_ind, aTriColor,
+        aQuad.data(), aQuad.size()/4, aQuadColor_ind, aQuadColor,
+        aXYZ.data(), nthread);
+    EXPECT_EQ(W0,W1);
+    for(unsigned int i=0;i<dW0.size();++i){ EXPECT_NEAR(dW0[i],dW1[i],1.0e-10); }
+    for(unsigned int i=0;i<mat0.valCrs.size();++i){ EXPECT_NEAR(mat0.valCrs[i],mat1.valCrs[i],1.0e-10); }
+    for(unsigned int i=0;i<mat0.valDia.size();++i){ EXPECT_NEAR(mat0.valDia[i],mat1.valDia[i],1.0e-10); }
+  }
+}
+
+TEST(fem,sparse_ldlt)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Cube(aXYZ,aTri, 8);
+  const unsigned int np = aXYZ.size()/3;
+  std::vector<unsigned int> psup_ind, psup;
+  dfm2::JArray_PSuP_MeshElem(psup_ind, psup,
+                             aTri.data(), aTri.size()/3, 3, np);
+  dfm2::JArray_Sort(psup_ind, psup);
+  // block Laplacian with the symmetric coupling in the diagonal blocks
+  dfm2::CMatrixSparse<double> mat;
+  mat.Initialize(np, 3, true);
+  mat.SetPattern(psup_ind.data(), psup_ind.size(), psup.data(),psup.size());
+  mat.setZero();
+  for(unsigned int ip=0;ip<np;++ip){
+    const double deg = psup_ind[ip+1]-psup_ind[ip];
+    const double eM[9] = {deg+0.1, 0.3, 0.0,  0.3, deg+0.1, 0.2,  0.0, 0.2, deg+0.1};
+    for(int i=0;i<9;++i){ mat.valDia[ip*9+i] = eM[i]; }
+    for(unsigned int ipsup=psup_ind[ip];ipsup<psup_ind[ip+1];++ipsup){
+      for(int i=0;i<3;++i){ mat.valCrs[ipsup*9+i*3+i] = -1.0; }
+    }
+  }
+  std::vector<int> aBCFlag(np*3,0);
+  for(unsigned int ip=0;ip<np;++ip){
+    if( aXYZ[ip*3+2] < -0.49 ){ aBCFlag[ip*3+0] = aBCFlag[ip*3+2] = 1; }
+  }
+  mat.SetFixedBC(aBCFlag.data());
+  dfm2::CSparseLDLT<double> ldlt;
+  ldlt.Initialize(mat);
+  EXPECT_TRUE(ldlt.Factorize(mat));
+  std::vector<double> b(np*3);
+  {
+    std::mt19937 rdeng(0);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for(unsigned int i=0;i<np*3;++i){ b[i] = (aBCFlag[i]!=0) ? 0.0 : dist(rdeng); }
+  }
+  std::vector<double> x = b;
+  ldlt.Solve(x.data());
+  std::vector<double> r(np*3);
+  mat.MatVec(r.data(), 1.0, x.data(), 0.0);
+  for(unsigned int i=0;i<np*3;++i){ EXPECT_NEAR(r[i], b[i], 1.0e-10); }
+  // compare with the conjugate gradient
+  std::vector<double> x1(np*3, 0.0), r1 = b, tmp0(np*3), tmp1(np*3);
+  dfm2::Solve_CG(dfm2::CVecXd(r1), dfm2::CVecXd(x1), dfm2::CVecXd(tmp0), dfm2::CVecXd(tmp1),
+                 1.0e-12, 1000, mat);
+  for(unsigned int i=0;i<np*3;++i){ EXPECT_NEAR(x[i], x1[i], 1.0e-8); }
+}
+
+TEST(fem,sparse_fixedbc)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Cube(aXYZ,aTri, 6);
+  const unsigned int np = aXYZ.size()/3;
+  std::vector<unsigned int> psup_ind, psup;
+  dfm2::JArray_PSuP_MeshElem(psup_ind, psup,
+                             aTri.data(), aTri.size()/3, 3, np);
+  dfm2::JArray_Sort(psup_ind, psup);
+  dfm2::CMatrixSparse<double> mat;
+  mat.Initialize(np, 3, true);
+  mat.SetPattern(psup_ind.data(), psup_ind.size(), psup.data(),psup.size());
+  std::mt19937 rdeng(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  for(auto& v : mat.valDia){ v = dist(rdeng); }
+  for(auto& v : mat.valCrs){ v = dist(rdeng); }
+  std::vector<int> aBCFlag(np*3,0);
+  for(unsigned int ip=0;ip<np;++ip){
+    if( aXYZ[ip*3+2] < -0.49 ){ aBCFlag[ip*3+0] = aBCFlag[ip*3+2] = 1; }
+  }
+  dfm2::CSparseFixedBC bc;
+  bc.Initialize(mat, aBCFlag.data());
+  EXPECT_EQ(bc.NumFixed()+bc.NumFree(), np*3);
+  EXPECT_LT(bc.aSlotCol.size(), mat.rowPtr.size());
+  dfm2::CMatrixSparse<double> mat0, mat1;
+  mat0 = mat;
+  mat1 = mat;
+  mat0.SetFixedBC(aBCFlag.data());
+  bc.SetFixedBC(mat1);
+  EXPECT_EQ(mat0.valDia, mat1.valDia);
+  EXPECT_EQ(mat0.valCrs, mat1.valCrs);
+  { // reduced matrix is the same as the original matrix on the free degrees of freedom
+    dfm2::CMatrixSparse<double> mat_r;
+    bc.InitializeReducedMatrix(mat_r);
+    bc.SetValueReducedMatrix(mat_r, mat);
+    EXPECT_EQ(mat_r.nrowblk, bc.NumFree());
+    std::vector<double> x_r(bc.NumFree()), y_r(bc.NumFree()), x(np*3), y(np*3), y1(bc.NumFree());
+    for(auto& v : x_r){ v = dist(rdeng); }
+    mat_r.MatVec(y_r.data(), 1.0, x_r.data(), 0.0);
+    bc.ExpandVector(x.data(), x_r.data());
+    mat0.MatVec(y.data(), 1.0, x.data(), 0.0);
+    bc.ReduceVector(y1.data(), y.data());
+    for(unsigned int i=0;i<y_r.size();++i){ EXPECT_NEAR(y_r[i], y1[i], 1.0e-10); }
+    bc.SetZero(y.data());
+    for(unsigned int i=0;i<np*3;++i){
+      if( aBCFlag[i] != 0 ){ EXPECT_EQ(y[i], 0.0); }
+    }
+  }
+}
+
+TEST(fem,matrix_free)
+{
+  std::mt19937 rdeng(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  { // element-by-element operator is the same as the assembled matrix
+    std::vector<double> aXY;
+    std::vector<unsigned int> aQuad;
+    dfm2::MeshQuad2D_Grid(aXY, aQuad, 10, 7);
+    const unsigned int np = aXY.size()/2;
+    std::vector<unsigned int> aTri;
+    for(unsigned int iq=0;iq<aQuad.size()/4;++iq){
+      const unsigned int* q = aQuad.data()+iq*4;
+      const unsigned int aIP[6] = {q[0],q[1],q[2], q[0],q[2],q[3]};
+      aTri.insert(aTri.end(), aIP, aIP+6);
+    }
+    const unsigned int ntri = aTri.size()/3;
+    std::vector<double> aEMat(ntri*9);
+    for(unsigned int it=0;it<ntri;++it){
+      double coords[3][2], eres[3];
+      const double value[3] = {0,0,0};
+      for(int inode=0;inode<3;++inode){
+        coords[inode][0] = aXY[aTri[it*3+inode]*2+0]*(1.0+0.1*dist(rdeng));
+        coords[inode][1] = aXY[aTri[it*3+inode]*2+1];
+      }
+      dfm2::EMat_Poisson_Tri2D(eres, (double(*)[3])(aEMat.data()+it*9), 1.0, 0.0, coords, value);
+    }
+    dfm2::CMatrixSparse<double> mat;
+    {
+      std::vector<unsigned int> psup_ind, psup;
+      dfm2::JArray_PSuP_MeshElem(psup_ind, psup, aTri.data(), ntri, 3, np);
+      mat.Initialize(np, 1, true);
+      mat.SetPattern(psup_ind.data(), psup_ind.size(), psup.data(), psup.size());
+      mat.setZero();
+      std::vector<unsigned int> tmp_buffer;
+      for(unsigned int it=0;it<ntri;++it){
+        dfm2::Merge<3,3,double>(mat, aTri.data()+it*3, aTri.data()+it*3, (const double(*)[3])(aEMat.data()+it*9), tmp_buffer);
+      }
+    }
+    const dfm2::CElemOp_Stored<double> op{aEMat.data(), 3};
+    dfm2::CMatFree_Elem<double,dfm2::CElemOp_Stored<double>> mf1(aTri.data(), ntri, 3, np, 1, op, 1);
+    dfm2::CMatFree_Elem<double,dfm2::CElemOp_Stored<double>> mf4(aTri.data(), ntri, 3, np, 1, op, 4);
+    std::vector<double> x(np), y0(np), y1, y4;
+    for(auto& v : x){ v = dist(rdeng); }
+    for(auto& v : y0){ v = dist(rdeng); }
+    y1 = y0; y4 = y0;
+    mat.MatVec(y0.data(), 0.7, x.data(), -0.3);
+    mf1.MatVec(y1.data(), 0.7, x.data(), -0.3);
+    mf4.MatVec(y4.data(), 0.7, x.data(), -0.3);
+    EXPECT_EQ(y1, y4);
+    for(unsigned int ip=0;ip<np;++ip){ EXPECT_NEAR(y0[ip], y1[ip], 1.0e-12); }
+  }
+  { // dense operator with BiCGStab
+    const unsigned int n = 150;
+    std::vector<double> A(n*n);
+    for(unsigned int i=0;i<n;++i){
+      for(unsigned int j=0;j<n;++j){ A[i*n+j] = (i==j) ? 20.0 : dist(rdeng); }
+    }
+    const dfm2::CMatFree_Dense<double> mf(A.data(), n, n);
+    std::vector<double> b(n), r, x, Ax(n, std::numeric_limits<double>::quiet_NaN()); // "Ax" is not read if beta==0
+    for(auto& v : b){ v = dist(rdeng); }
+    r = b;
+    dfm2::Solve_BiCGStab(r, x, 1.0e-10, 1000, mf);
+    mf.MatVec(Ax.data(), 1.0, x.data(), 0.0);
+    for(unsigned int i=0;i<n;++i){ EXPECT_NEAR(Ax[i], b[i], 1.0e-8); }
+  }
+}
+
+TEST(bem, hmatrix_potential_flow)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Sphere(aXYZ, aTri, 1.0, 32, 48);
+  const unsigned int nt = aTri.size()/3;
+  EXPECT_GT(nt, 2000);
+  const dfm2::CVec3d velo_inf(1.0, 0.2, 0.0);
+  std::vector<double> A0, f0;
+  dfm2::makeLinearSystem_PotentialFlow_Order0th(A0, f0, velo_inf, 1, aXYZ, aTri);
+  dfm2::CHMatrixACA A1;
+  std::vector<double> f1;
+  dfm2::makeHMatrix_PotentialFlow_Order0th(A1, f1, velo_inf, 1, aXYZ, aTri, 1.0e-5);
+  EXPECT_LT(A1.NumStoredValues(), nt*nt/2);
+  const auto rel_err = [](const std::vector<double>& a, const std::vector<double>& b){
+    double sqd = 0, sqn = 0;
+    for(unsigned int i=0;i<a.size();++i){ sqd += (a[i]-b[i])*(a[i]-b[i]); sqn += b[i]*b[i]; }
+    return sqrt(sqd/sqn);
+  };
+  EXPECT_LT(rel_err(f1, f0), 1.0e-4);
+  { // matrix-vector product
+    std::mt19937 rdeng(0);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::vector<double> x(nt), y0(nt), y1(nt);
+    for(auto& v : x){ v = dist(rdeng); }
+    for(auto& v : y0){ v = dist(rdeng); }
+    y1 = y0;
+    dfm2::CMatFree_Dense<double>(A0.data(), nt, nt).MatVec(y0.data(), 0.7, x.data(), -0.3);
+    A1.MatVec(y1.data(), 0.7, x.data(), -0.3);
+    EXPECT_LT(rel_err(y1, y0), 1.0e-4);
+  }
+  { // solution
+    std::vector<double> r0 = f0, r1 = f1, x0, x1;
+    dfm2::Solve_BiCGStab(r0, x0, 1.0e-10, 1000, dfm2::CMatFree_Dense<double>(A0.data(), nt, nt));
+    dfm2::Solve_BiCGStab(r1, x1, 1.0e-10, 1000, A1);
+    EXPECT_LT(rel_err(x1, x0), 1.0e-4);
+  }
+}
+
+TEST(bem, vortex_particle_treecode)
+{
+  std::mt19937 rdeng(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  std::vector<dfm2::CVortexParticle> aVP0(3000);
+  for(auto& vp : aVP0){
+    vp.pos = dfm2::CVec3d(dist(rdeng), dist(rdeng), dist(rdeng));
+    vp.circ = dfm2::CVec3d(dist(rdeng), dist(rdeng), dist(rdeng))*1.0e-3;
+    vp.rad = 0.02;
+    vp.velo = dfm2::CVec3d(0,0,0);
+    vp.gradvelo.SetZero();
+  }
+  std::vector<dfm2::CVortexParticle> aVP1 = aVP0, aVP2 = aVP0, aVP3 = aVP0;
+  dfm2::setGradVeloVortexParticles(aVP0);
+  dfm2::setGradVeloVortexParticles_TreeCode(aVP1, 0.0, 1); // no approximation
+  dfm2::setGradVeloVortexParticles_TreeCode(aVP2, 0.5, 1);
+  dfm2::setGradVeloVortexParticles_TreeCode(aVP3, 0.5, 4);
+  double sqdv1 = 0, sqdv2 = 0, sqv = 0, sqdg2 = 0, sqg = 0;
+  for(unsigned int ivp=0;ivp<aVP0.size();++ivp){
+    sqv += aVP0[ivp].velo.DLength();
+    sqdv1 += (aVP1[ivp].velo-aVP0[ivp].velo).DLength();
+    sqdv2 += (aVP2[ivp].velo-aVP0[ivp].velo).DLength();
+    for(int i=0;i<9;++i){
+      sqg += aVP0[ivp].gradvelo.mat[i]*aVP0[ivp].gradvelo.mat[i];
+      const double dg = aVP2[ivp].gradvelo.mat[i]-aVP0[ivp].gradvelo.mat[i];
+      sqdg2 += dg*dg;
+    }
+    for(int i=0;i<3;++i){ EXPECT_EQ(aVP2[ivp].velo[i], aVP3[ivp].velo[i]); }
+  }
+  EXPECT_LT(sqrt(sqdv1/sqv), 1.0e-12);
+  EXPECT_LT(sqrt(sqdv2/sqv), 1.0e-2);
+  EXPECT_LT(sqrt(sqdg2/sqg), 1.0e-2);
+}
+
+TEST(bem, helmholtz_order1st)
+{
+  using COMPLEX = std::complex<double>;
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Sphere(aXYZ, aTri, 1.0, 12, 16);
+  const unsigned int nno = aXYZ.size()/3;
+  const std::vector<double> aSolidAngle(nno, 2*M_PI); // smooth surface
+  const double k = 3.0, beta = 0.1;
+  const dfm2::CVec3d pos_source(3.0, 0.5, 0.2);
+  dfm2::CBEM_Helmholtz_Order1st bem;
+  bem.Initialize(aXYZ, aTri, 2);
+  std::vector<COMPLEX> A1, A4;
+  bem.MakeMatrix(A1, k, beta, aSolidAngle, 1);
+  bem.MakeMatrix(A4, k, beta, aSolidAngle, 4);
+  EXPECT_EQ(A1, A4);
+  { // compare with the transfer function for a triangle
+    std::vector<COMPLEX> A0(nno*nno, COMPLEX(0,0));
+    for(unsigned int ino=0;ino<nno;++ino){
+      const dfm2::CVec3d p(aXYZ.data()+ino*3);
+      for(unsigned int jtri=0;jtri<aTri.size()/3;++jtri){
+        const unsigned int* jn = aTri.data()+jtri*3;
+        if( jn[0] == ino || jn[1] == ino || jn[2] == ino ){ continue; }
+        COMPLEX aC[3];
+        dfm2::Helmholtz_TransferOrder1st_PntTri(
+            aC, p,
+            dfm2::CVec3d(aXYZ.data()+jn[0]*3), dfm2::CVec3d(aXYZ.data()+jn[1]*3), dfm2::CVec3d(aXYZ.data()+jn[2]*3),
+            k, beta, 2);
+        for(int inoel=0;inoel<3;++inoel){ A0[ino*nno+jn[inoel]] += aC[inoel]; }
+      }
+      A0[ino*nno+ino] += 0.5;
+    }
+    for(unsigned int i=0;i<nno*nno;++i){ EXPECT_LT(std::abs(A0[i]-A1[i]), 1.0e-12); }
+  }
+  std::vector<COMPLEX> f;
+  bem.MakeRhs_PointSource(f, pos_source, k);
+  std::vector<COMPLEX> x0 = f;
+  { // dense LU
+    std::vector<COMPLEX> LU = A1;
+    std::vector<unsigned int> aPiv;
+    EXPECT_TRUE(dfm2::LUDecomp_Dense(LU, aPiv, nno, 4));
+    dfm2::LUSolve_Dense(x0, LU, aPiv, nno);
+    std::vector<COMPLEX> r = f;
+    dfm2::CMatFree_Dense<COMPLEX>(A1.data(), nno, nno).MatVec(r.data(), -1.0, x0.data(), 1.0);
+    for(unsigned int i=0;i<nno;++i){ EXPECT_LT(std::abs(r[i]), 1.0e-10); }
+  }
+  { // iterative solver with the operator
+    std::vector<COMPLEX> r = f, x1;
+    dfm2::Solve_BiCGSTAB_Complex(r, x1, 1.0e-10, 1000, dfm2::CMatFree_Dense<COMPLEX>(A1.data(), nno, nno));
+    for(unsigned int i=0;i<nno;++i){ EXPECT_LT(std::abs(x1[i]-x0[i]), 1.0e-7); }
+  }
+  { // field at the receivers
+    std::vector<double> aXYZ_recv;
+    for(unsigned int i=0;i<20;++i){
+      aXYZ_recv.insert(aXYZ_recv.end(), {-2.0+0.2*i, 1.5, -0.3});
+    }
+    std::vector<COMPLEX> aVal;
+    bem.EvaluateField(aVal, aXYZ_recv, x0, pos_source, k, beta);
+    const std::vector<int> aTri_i(aTri.begin(), aTri.end());
+    for(unsigned int irecv=0;irecv<aXYZ_recv.size()/3;++irecv){
+      const COMPLEX v0 = dfm2::evaluateField_Helmholtz_Order1st(
+          x0, dfm2::CVec3d(aXYZ_recv.data()+irecv*3), pos_source, k, beta, aTri_i, aXYZ, false, 2);
+      EXPECT_LT(std::abs(aVal[irecv]-v0), 1.0e-12);
+    }
+  }
+  { // blocked LU for real matrix
+    std::mt19937 rdeng(0);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    const unsigned int n = 150;
+    std::vector<double> A(n*n), b(n);
+    for(auto& v : A){ v = dist(rdeng); }
+    for(auto& v : b){ v = dist(rdeng); }
+    std::vector<double> LU = A, x = b;
+    std::vector<unsigned int> aPiv;
+    EXPECT_TRUE(dfm2::LUDecomp_Dense(LU, aPiv, n));
+    dfm2::LUSolve_Dense(x, LU, aPiv, n);
+    dfm2::CMatFree_Dense<double>(A.data(), n, n).MatVec(b.data(), -1.0, x.data(), 1.0);
+    for(unsigned int i=0;i<n;++i){ EXPECT_NEAR(b[i], 0.0, 1.0e-10); }
+  }
+}
+
+TEST(objfunc_v23, arap_prefactored)
+{
+  { // polar decomposition
+    std::mt19937 rdeng(0);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for(unsigned int itr=0;itr<10;++itr){
+      double q0[4] = {dist(rdeng), dist(rdeng), dist(rdeng), dist(rdeng)};
+      dfm2::Normalize_Quat(q0);
+      double R0[9]; dfm2::Mat3_Quat(R0, q0);
+      const double S[9] = {1.5, 0.1, 0.0,  0.1, 1.0, 0.2,  0.0, 0.2, 0.8}; // symmetric positive definite
+      double A[9]; dfm2::MatMat3(A, R0, S);
+      double q1[4] = {1,0,0,0};
+      dfm2::Quat_RotationalPart(q1, A, 100);
+      double R1[9]; dfm2::Mat3_Quat(R1, q1);
+      for(int i=0;i<9;++i){ EXPECT_NEAR(R0[i], R1[i], 1.0e-6); }
+    }
+  }
+  std::vector<double> aXYZ0;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_CylinderClosed(aXYZ0, aTri, 0.2, 1.0, 8, 8);
+  const unsigned int np = aXYZ0.size()/3;
+  std::vector<int> aBCFlag(np*3,0);
+  for(unsigned int ip=0;ip<np;++ip){
+    if( aXYZ0[ip*3+1] < -0.4 || aXYZ0[ip*3+1] > +0.4 ){
+      aBCFlag[ip*3+0] = aBCFlag[ip*3+1] = aBCFlag[ip*3+2] = 1;
+    }
+  }
+  dfm2::CDef_Arap def;
+  def.Init(aXYZ0, aTri, false);
+  EXPECT_TRUE(def.Prefactorize(aBCFlag));
+  // rigid transformation of the fixed points. The result should be the rigid transformation of the rest shape
+  double q0[4] = {1, 0.2, 0.3, -0.1};
+  dfm2::Normalize_Quat(q0);
+  double R0[9]; dfm2::Mat3_Quat(R0, q0);
+  std::vector<double> aXYZ2(np*3);
+  for(unsigned int ip=0;ip<np;++ip){
+    dfm2::MatVec3(aXYZ2.data()+ip*3, R0, aXYZ0.data()+ip*3);
+    aXYZ2[ip*3+0] += 0.3;
+  }
+  std::vector<double> aXYZ1 = aXYZ0;
+  for(unsigned int i=0;i<np*3;++i){
+    if( aBCFlag[i] != 0 ){ aXYZ1[i] = aXYZ2[i]; }
+  }
+  std::vector<double> aQuat1(np*4);
+  for(unsigned int ip=0;ip<np;++ip){ dfm2::Quat_Identity(aQuat1.data()+ip*4); }
+  def.DeformPrefactored(aXYZ1, aQuat1, aXYZ0, 200, 2);
+  for(unsigned int i=0;i<np*3;++i){ EXPECT_NEAR(aXYZ1[i], aXYZ2[i], 1.0e-4); }
+}
+
+TEST(fem,rodhair_band_ldlt)
+{
+  std::mt19937 rndeng(0);
+  std::uniform_real_distribution<double> dist01(0,1);
+  std::vector<dfm2::CVec3d> aP0, aS0;
+  std::vector<unsigned int> aIP_HairRoot(1,0);
+  for(unsigned int ihair=0;ihair<16;++ihair){ // spiral hairs
+    const unsigned int np = 20 + ihair;
+    const double rad0 = 0.1 + 0.2*dist01(rndeng);
+    const double dangle = 0.3*dist01(rndeng);
+    const double py = dist01(rndeng), pz = dist01(rndeng);
+    for(unsigned int ip=0;ip<np;++ip){
+      aP0.emplace_back(ip*0.1, py+rad0*cos(dangle*ip), pz+rad0*sin(dangle*ip));
+    }
+    const unsigned int np0 = aIP_HairRoot[ihair];
+    for(unsigned int is=0;is<np-1;++is){
+      const dfm2::CVec3d v = (aP0[np0+is+1] - aP0[np0+is+0]).Normalize();
+      dfm2::CVec3d s(1.3, 1.5, 1.7);
+      aS0.push_back( (s-(s*v)*v).Normalize() );
+    }
+    aS0.emplace_back(1,0,0);
+    aIP_HairRoot.push_back(static_cast<unsigned int>(aP0.size()));
+  }
+  dfm2::ParallelTransport_RodHair(aP0, aS0, aIP_HairRoot);
+  const size_t np = aP0.size();
+  std::vector<int> aBCFlag;
+  dfm2::MakeBCFlag_RodHair(aBCFlag, aIP_HairRoot);
+  const double stiff_stretch = 1.0e+4;
+  const double stiff_bendtwist[3] = {1.0e+3, 1.1e+3, 1.2e+3};
+  const double mdtt = 1.0e+2;
+  std::vector<dfm2::CVec3d> aPt = aP0; // displaced by the gravity
+  for(unsigned int ip=0;ip<np;++ip){
+    if( aBCFlag[ip*4] == 0 ){ aPt[ip] += dfm2::CVec3d(0, -0.01*(ip%7), 0.001*(ip%5)); }
+  }
+  std::vector<dfm2::CVec3d> aS = aS0;
+  dfm2::MakeDirectorOrthogonal_RodHair(aS, aPt);
+  { // parallel merge and direct solve
+    dfm2::CMatrixSparse<double> mats0, mats1;
+    dfm2::MakeSparseMatrix_RodHair(mats0, aIP_HairRoot);
+    dfm2::MakeSparseMatrix_RodHair(mats1, aIP_HairRoot);
+    mats0.setZero();
+    mats1.setZero();
+    std::vector<double> vec_r0(np*4, 0.0), vec_r1(np*4, 0.0);
+    const double W0 = dfm2::MergeLinSys_Hair(vec_r0, mats0, stiff_stretch, stiff_bendtwist,
+                                             aIP_HairRoot, aPt, aS, aP0, aS0, 1);
+    const double W1 = dfm2::MergeLinSys_Hair(vec_r1, mats1, stiff_stretch, stiff_bendtwist,
+                                             aIP_HairRoot, aPt, aS, aP0, aS0, 4);
+    EXPECT_NEAR(W0, W1, 1.0e-10*(1+fabs(W0)));
+    for(unsigned int i=0;i<vec_r0.size();++i){ EXPECT_NEAR(vec_r0[i], vec_r1[i], 1.0e-8); }
+    for(unsigned int i=0;i<mats0.valCrs.size();++i){ EXPECT_NEAR(mats0.valCrs[i], mats1.valCrs[i], 1.0e-6); }
+    for(unsigned int ip=0;ip<np;++ip){
+      for(unsigned int idim=0;idim<3;++idim){ mats1.valDia[ip*16+idim*4+idim] += mdtt; }
+    }
+    mats1.SetFixedBC(aBCFlag.data());
+    dfm2::setRHS_Zero(vec_r1, aBCFlag, 0);
+    dfm2::CRodHairBandLDLT ldlt;
+    ldlt.Initialize(aIP_HairRoot, 4);
+    EXPECT_TRUE(ldlt.SetValueFactorize(mats1));
+    std::vector<double> vec_x = vec_r1;
+    ldlt.Solve(vec_x.data());
+    std::vector<double> vec_ax(np*4);
+    mats1.MatVec(vec_ax.data(), 1.0, vec_x.data(), 0.0);
+    double res = 0, nrm = 0;
+    for(unsigned int i=0;i<np*4;++i){
+      res += (vec_ax[i]-vec_r1[i])*(vec_ax[i]-vec_r1[i]);
+      nrm += vec_r1[i]*vec_r1[i];
+    }
+    EXPECT_LT(sqrt(res/nrm), 1.0e-10);
+  }
+  { // direct solve and preconditioned CG without contact give the same update
+    dfm2::CMatrixSparse<double> mats;
+    dfm2::MakeSparseMatrix_RodHair(mats, aIP_HairRoot);
+    std::vector<dfm2::CVec3d> aP1 = aPt, aS1 = aS;
+    dfm2::Solve_RodHair(aP1, aS1, mats, stiff_stretch, stiff_bendtwist, mdtt,
+                        aP0, aS0, aBCFlag, aIP_HairRoot);
+    std::vector<dfm2::CVec3d> aP2 = aPt, aS2 = aS;
+    dfm2::Solve_RodHairContact(aP2, aS2, mats, stiff_stretch, stiff_bendtwist, mdtt,
+                               aPt, aP0, aS0, aBCFlag, aIP_HairRoot,
+                               0.0, 0.0, std::vector<dfm2::CContactHair>());
+    for(unsigned int ip=0;ip<np;++ip){
+      EXPECT_LT((aP1[ip]-aP2[ip]).Length(), 1.0e-8);
+      EXPECT_LT((aS1[ip]-aS2[ip]).Length(), 1.0e-8);
+    }
+  }
+}
+
+TEST(fem,snapshot)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Cube(aXYZ,aTri, 6);
+  const unsigned int np = aXYZ.size()/3;
+  dfm2::CMatrixSparse<double> mat;
+  {
+    std::vector<unsigned int> psup_ind, psup;
+    dfm2::JArray_PSuP_MeshElem(psup_ind, psup,
+                               aTri.data(), aTri.size()/3, 3, np);
+    dfm2::JArray_Sort(psup_ind, psup);
+    mat.Initialize(np, 3, true);
+    mat.SetPattern(psup_ind.data(), psup_ind.size(), psup.data(),psup.size());
+    std::mt19937 rdeng(0);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for(auto& v : mat.valCrs){ v = dist(rdeng); }
+    for(unsigned int ip=0;ip<np;++ip){
+      for(int i=0;i<9;++i){ mat.valDia[ip*9+i] = (i%4==0) ? 100.0 : dist(rdeng); }
+    }
+  }
+  dfm2::CPreconditionerILU<double> ilu;
+  ilu.Initialize_ILU0(mat);
+  ilu.SetValueILU(mat);
+  ilu.DoILUDecomp();
+  dfm2::CBVH_MeshTri3D<dfm2::CBV3d_AABB,double> bvh;
+  {
+    std::vector<double> aXYZ0;
+    std::vector<unsigned int> aTri0;
+    dfm2::MeshTri3D_Sphere(aXYZ0, aTri0, 1.0, 16, 8);
+    bvh.Init(aXYZ0.data(), aXYZ0.size()/3, aTri0.data(), aTri0.size()/3, 0.0);
+  }
+  {
+    dfm2::CSnapshotWriter writer;
+    writer.Add("xyz", aXYZ);
+    writer.Add("tri", aTri);
+    dfm2::AddToSnapshot(writer, "mat", mat);
+    dfm2::AddToSnapshot(writer, "ilu", ilu);
+    dfm2::AddToSnapshot(writer, "bvh", bvh.aNodeBVH, bvh.aBB_BVH);
+    EXPECT_TRUE(writer.Write("tmp_snapshot.bin"));
+  }
+  { // the file is unmapped at the end of the scope
+    dfm2::CSnapshotReader reader;
+    EXPECT_TRUE(reader.Open("tmp_snapshot.bin"));
+    { // zero-copy access
+      const dfm2::CArrayView<double> vXYZ = reader.View<double>("xyz");
+      ASSERT_EQ(vXYZ.size(), aXYZ.size());
+      EXPECT_EQ(reinterpret_cast<std::uintptr_t>(vXYZ.data()) % 64, 0);
+      EXPECT_TRUE(std::equal(vXYZ.begin(), vXYZ.end(), aXYZ.begin()));
+      EXPECT_TRUE(reader.View<float>("xyz").empty()); // type mismatch
+      EXPECT_TRUE(reader.View<double>("hoge").empty());
+      std::vector<unsigned int> aTri1;
+      EXPECT_TRUE(reader.Get(aTri1, "tri"));
+      EXPECT_EQ(aTri, aTri1);
+    }
+    {
+      dfm2::CMatrixSparse<double> mat1;
+      EXPECT_TRUE(dfm2::GetFromSnapshot(mat1, reader, "mat"));
+      EXPECT_EQ(mat1.nrowblk, mat.nrowblk);
+      EXPECT_EQ(mat1.nrowdim, mat.nrowdim);
+      EXPECT_EQ(mat1.colInd, mat.colInd);
+      EXPECT_EQ(mat1.rowPtr, mat.rowPtr);
+      EXPECT_EQ(mat1.valCrs, mat.valCrs);
+      EXPECT_EQ(mat1.valDia, mat.valDia);
+    }
+    { // the factorization is restored without re-computation
+      dfm2::CPreconditionerILU<double> ilu1;
+      EXPECT_TRUE(dfm2::GetFromSnapshot(ilu1, reader, "ilu"));
+      std::vector<double> v0(np*3), v1;
+      for(unsigned int i=0;i<np*3;++i){ v0[i] = i%7; }
+      v1 = v0;
+      ilu.SolvePrecond(v0.data());
+      ilu1.SolvePrecond(v1.data());
+      EXPECT_EQ(v0, v1);
+    }
+    {
+      std::vector<dfm2::CNodeBVH2> aNode;
+      std::vector<dfm2::CBV3d_AABB> aBB;
+      EXPECT_TRUE(dfm2::GetFromSnapshot(aNode, aBB, reader, "bvh"));
+      ASSERT_EQ(aNode.size(), bvh.aNodeBVH.size());
+      for(unsigned int ino=0;ino<aNode.size();++ino){
+        EXPECT_EQ(aNode[ino].iparent, bvh.aNodeBVH[ino].iparent);
+        EXPECT_EQ(aNode[ino].ichild[0], bvh.aNodeBVH[ino].ichild[0]);
+        EXPECT_EQ(aNode[ino].ichild[1], bvh.aNodeBVH[ino].ichild[1]);
+        for(int i=0;i<3;++i){
+          EXPECT_EQ(aBB[ino].bbmin[i], bvh.aBB_BVH[ino].bbmin[i]);
+          EXPECT_EQ(aBB[ino].bbmax[i], bvh.aBB_BVH[ino].bbmax[i]);
+        }
+      }
+    }
+  }
+  std::remove("tmp_snapshot.bin");
+}
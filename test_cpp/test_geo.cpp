@@ -9,6 +9,9 @@
 #include "delfem2/vec3.h"
 #include "delfem2/mat3.h"
 #include "delfem2/quat.h"
+#include "delfem2/rig_geo3.h"
+#include <random>
+#include <climits>
 
 namespace dfm2 = delfem2;
 
@@ -186,4 +189,110 @@ TEST(mat3, quat)
     }
   }
 
-}
\ No newline at end of file
+}
+TEST(rig, skinning_fixed_width)
+{
+  std::mt19937 rdeng(0);
+  std::uniform_real_distribution<double> dist_m1p1(-1, +1);
+  std::uniform_real_distribution<double> dist_01(0, 1);
+  const unsigned int nb = 5;
+  std::vector<dfm2::CRigBone> aBone;
+  {
+    const unsigned int aIndBoneParent[nb] = {UINT_MAX, 0, 1, 2, 1};
+    double aJntPos0[nb*3];
+    for(double& v : aJntPos0){ v = dist_m1p1(rdeng); }
+    dfm2::InitBones_JointPosition(aBone, nb, aIndBoneParent, aJntPos0);
+  }
+  for(auto& bone : aBone){
+    const double a[3] = {dist_m1p1(rdeng), dist_m1p1(rdeng), dist_m1p1(rdeng)};
+    dfm2::Quat_CartesianAngle(bone.quatRelativeRot, a);
+  }
+  dfm2::UpdateBoneRotTrans(aBone);
+  const unsigned int np = 1000;
+  std::vector<double> aXYZ0(np*3);
+  for(double& v : aXYZ0){ v = dist_m1p1(rdeng); }
+  std::vector<double> aW(np*nb, 0.0);
+  for(unsigned int ip=0;ip<np;++ip){ // at most three influences
+    double sum = 0.0;
+    for(unsigned int iinfl=0;iinfl<3;++iinfl){
+      const unsigned int ib = (ip*7+iinfl*3)%nb;
+      aW[ip*nb+ib] = dist_01(rdeng);
+      sum += aW[ip*nb+ib];
+    }
+    for(unsigned int ib=0;ib<nb;++ib){ aW[ip*nb+ib] /= sum; }
+  }
+  std::vector<double> aXYZ1;
+  dfm2::Skinning_LBS(aXYZ1, aXYZ0, aBone, aW);
+  dfm2::CSkinWeightFixedWidth sw;
+  sw.SetDenseWeight(aW, nb, 4);
+  std::vector<double> aMat3x4;
+  dfm2::SkinningMatrix_Bones(aMat3x4, aBone);
+  for(unsigned int nthread=1;nthread<4;++nthread){
+    std::vector<double> aXYZ2;
+    dfm2::SkinningFixedWidth_LBS(aXYZ2, aXYZ0, sw, aMat3x4, nthread);
+    for(unsigned int i=0;i<np*3;++i){ EXPECT_NEAR(aXYZ1[i], aXYZ2[i], 1.0e-10); }
+  }
+  std::vector<double> aDualQuat;
+  dfm2::DualQuaternion_Bones(aDualQuat, aBone);
+  { // single influence: dual quaternion skinning is the same as the linear blend skinning
+    dfm2::CSkinWeightFixedWidth sw1;
+    sw1.SetDenseWeight(aW, nb, 1);
+    std::vector<double> aXYZ2, aXYZ3;
+    dfm2::SkinningFixedWidth_LBS(aXYZ2, aXYZ0, sw1, aMat3x4);
+    dfm2::SkinningFixedWidth_DQS(aXYZ3, aXYZ0, sw1, aDualQuat);
+    for(unsigned int i=0;i<np*3;++i){ EXPECT_NEAR(aXYZ2[i], aXYZ3[i], 1.0e-10); }
+  }
+  { // all the bones move rigidly together: blended dual quaternion is the same rigid transformation
+    for(unsigned int ib=1;ib<nb;++ib){ dfm2::Quat_Identity(aBone[ib].quatRelativeRot); }
+    dfm2::UpdateBoneRotTrans(aBone);
+    dfm2::SkinningMatrix_Bones(aMat3x4, aBone);
+    dfm2::DualQuaternion_Bones(aDualQuat, aBone);
+    std::vector<double> aXYZ2, aXYZ3;
+    dfm2::SkinningFixedWidth_LBS(aXYZ2, aXYZ0, sw, aMat3x4);
+    dfm2::SkinningFixedWidth_DQS(aXYZ3, aXYZ0, sw, aDualQuat);
+    for(unsigned int i=0;i<np*3;++i){ EXPECT_NEAR(aXYZ2[i], aXYZ3[i], 1.0e-10); }
+  }
+}
+
+TEST(rig, bvh_batch_forward_kinematics)
+{
+  const std::string path = std::string(PATH_INPUT_DIR)+"/walk.bvh";
+  std::vector<dfm2::CRigBone> aBone;
+  std::vector<dfm2::CChannel_BioVisionHierarchy> aChannelInfo;
+  int nframe = 0;
+  std::vector<double> aChannelValue;
+  dfm2::Read_BioVisionHierarchy(aBone, aChannelInfo, nframe, aChannelValue, path);
+  EXPECT_EQ(nframe, 344);
+  const size_t nch = aChannelInfo.size();
+  const size_t nbone = aBone.size();
+  EXPECT_EQ(aChannelValue.size(), nframe*nch);
+  { // streaming reader gives the same values
+    dfm2::CStreamReader_BioVisionHierarchy reader;
+    EXPECT_TRUE(reader.Open(path));
+    EXPECT_EQ(reader.nframe, nframe);
+    EXPECT_EQ(reader.aBone.size(), nbone);
+    EXPECT_NEAR(reader.frame_time, 0.0083333, 1.0e-10);
+    std::vector<double> aVal;
+    unsigned int iframe = 0;
+    for(;;){
+      const unsigned int nread = reader.ReadFrames(aVal, 100);
+      if( nread == 0 ){ break; }
+      EXPECT_EQ(aVal.size(), nread*nch);
+      for(unsigned int i=0;i<nread*nch;++i){ EXPECT_EQ(aVal[i], aChannelValue[iframe*nch+i]); }
+      iframe += nread;
+    }
+    EXPECT_EQ(iframe, nframe);
+  }
+  std::vector<double> aMat3x4;
+  dfm2::GlobalTransforms_BioVisionHierarchy(aMat3x4,
+      aBone, aChannelInfo, aChannelValue.data(), nframe);
+  EXPECT_EQ(aMat3x4.size(), nframe*nbone*12);
+  for(int iframe=0;iframe<nframe;iframe+=17){
+    dfm2::SetPose_BioVisionHierarchy(aBone, aChannelInfo, aChannelValue.data()+iframe*nch);
+    for(unsigned int ib=0;ib<nbone;++ib){
+      for(int i=0;i<12;++i){
+        EXPECT_NEAR(aMat3x4[(iframe*nbone+ib)*12+i], aBone[ib].affmat3Global[i], 1.0e-8);
+      }
+    }
+  }
+}
@@ -10,11 +10,34 @@
 #include "delfem2/mshuni.h"
 #include "delfem2/mshmisc.h"
 #include "delfem2/mshio.h"
+#include "delfem2/mshiofast.h"
+#include "delfem2/mshiovtk.h"
+#include "delfem2/mshreorder.h"
+#include "delfem2/mshprimitive.h"
+#include "delfem2/jagarray.h"
 #include "delfem2/points.h"
+#include "delfem2/sampler.h"
 #include "delfem2/slice.h"
 #include "delfem2/gridvoxel.h"
+#include "delfem2/adf.h"
+#include "delfem2/geodesic.h"
+#include "delfem2/dijkstra.h"
+#include "delfem2/dtri3_qem.h"
+#include "delfem2/lsmatfree.h"
+#include "delfem2/lsitrsol.h"
+#include "delfem2/lsvecx.h"
 #include <cstring>
 #include <random>
+#include <algorithm>
+#include <limits>
+#include <fstream>
+#include <cstdio>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#ifdef USE_ZLIB
+#  include <zlib.h>
+#endif
 
 #ifndef M_PI
 #  define M_PI 3.14159265359
@@ -34,6 +57,264 @@ TEST(mshio,load_obj)
   EXPECT_EQ(aTri.size(),1000*3);
 }
 
+TEST(mshio,read_fast)
+{
+  { // ascii ply
+    std::vector<double> aXYZ0, aXYZ1;
+    std::vector<unsigned int> aTri0, aTri1;
+    const std::string path = std::string(PATH_INPUT_DIR)+"/arm_16k.ply";
+    dfm2::Read_Ply(path, aXYZ0, aTri0);
+    for(unsigned int nthread=1;nthread<5;++nthread){
+      EXPECT_TRUE(dfm2::Read_Ply_Fast(path, aXYZ1, aTri1, nthread));
+      EXPECT_EQ(aXYZ0, aXYZ1);
+      EXPECT_EQ(aTri0, aTri1);
+    }
+  }
+  { // obj
+    std::vector<double> aXYZ0, aXYZ1;
+    std::vector<unsigned int> aTri0, aTri1;
+    const std::string path = std::string(PATH_INPUT_DIR)+"/bunny_1k.obj";
+    dfm2::Read_Obj3(path, aXYZ0, aTri0);
+    for(unsigned int nthread=1;nthread<5;++nthread){
+      EXPECT_TRUE(dfm2::Read_Obj_Fast(path, aXYZ1, aTri1, nthread));
+      EXPECT_EQ(aXYZ0, aXYZ1);
+      EXPECT_EQ(aTri0, aTri1);
+    }
+  }
+  { // obj with polygon, texture/normal index and relative index
+    {
+      std::ofstream fout("tmp_mshiofast.obj");
+      fout << "# comment\nv 0 0 0\nv 1 0 0\r\nv 1 1 0\nvt 0.5 0.5\nv 0 1.5e-1 -2.5E+2\n";
+      fout << "f 1/1/1 2//2 3/1 4\n";
+      fout << "f -4 -3 -2\n";
+    }
+    std::vector<double> aXYZ;
+    std::vector<unsigned int> aTri;
+    EXPECT_TRUE(dfm2::Read_Obj_Fast("tmp_mshiofast.obj", aXYZ, aTri));
+    EXPECT_EQ(aXYZ, std::vector<double>({0,0,0, 1,0,0, 1,1,0, 0,0.15,-250}));
+    EXPECT_EQ(aTri, std::vector<unsigned int>({0,1,2, 0,2,3, 0,1,2}));
+  }
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_CylinderClosed(aXYZ, aTri, 0.3, 1.0, 16, 8);
+  for(auto& v : aXYZ){ v = static_cast<float>(v); } // binary files store float
+  { // binary little endian ply
+    dfm2::Write_Ply_Binary("tmp_mshiofast.ply", aXYZ, aTri);
+    std::vector<double> aXYZ1;
+    std::vector<unsigned int> aTri1;
+    for(unsigned int nthread=1;nthread<5;++nthread){
+      EXPECT_TRUE(dfm2::Read_Ply_Fast("tmp_mshiofast.ply", aXYZ1, aTri1, nthread));
+      EXPECT_EQ(aXYZ, aXYZ1);
+      EXPECT_EQ(aTri, aTri1);
+    }
+  }
+  { // binary big endian ply with a quad and extra properties
+    {
+      std::ofstream fout("tmp_mshiofast_be.ply", std::ios::binary);
+      fout << "ply\nformat binary_big_endian 1.0\ncomment test\n";
+      fout << "element vertex 4\nproperty double x\nproperty double y\nproperty double z\nproperty uchar red\n";
+      fout << "element face 1\nproperty list uchar uint vertex_indices\nproperty float quality\nend_header\n";
+      auto put_be = [&fout](const void* v, unsigned int n){
+        const char* c = static_cast<const char*>(v);
+        std::vector<char> b(c,c+n);
+        const std::uint16_t one = 1;
+        if( *reinterpret_cast<const char*>(&one) == 1 ){ std::reverse(b.begin(),b.end()); }
+        fout.write(b.data(), n);
+      };
+      for(unsigned int ip=0;ip<4;++ip){
+        const double p[3] = {double(ip), double(ip)*0.5, -double(ip)};
+        for(int idim=0;idim<3;++idim){ put_be(p+idim, 8); }
+        fout.put(char(ip));
+      }
+      fout.put(4);
+      for(std::uint32_t ip=0;ip<4;++ip){ put_be(&ip, 4); }
+      const float quality = 1.f;
+      put_be(&quality, 4);
+    }
+    std::vector<double> aXYZ1;
+    std::vector<unsigned int> aTri1;
+    EXPECT_TRUE(dfm2::Read_Ply_Fast("tmp_mshiofast_be.ply", aXYZ1, aTri1));
+    EXPECT_EQ(aXYZ1, std::vector<double>({0,0,0, 1,0.5,-1, 2,1,-2, 3,1.5,-3}));
+    EXPECT_EQ(aTri1, std::vector<unsigned int>({0,1,2, 0,2,3}));
+  }
+  { // binary stl
+    dfm2::Write_STL_Binary("tmp_mshiofast.stl", aXYZ, aTri);
+    std::vector<double> aXYZ1;
+    std::vector<unsigned int> aTri1;
+    EXPECT_TRUE(dfm2::Read_STL("tmp_mshiofast.stl", aXYZ1, aTri1));
+    EXPECT_EQ(aXYZ1.size(), aXYZ.size());
+    EXPECT_EQ(aTri1.size(), aTri.size());
+    for(unsigned int i=0;i<aTri.size();++i){
+      for(int idim=0;idim<3;++idim){
+        EXPECT_EQ(aXYZ[aTri[i]*3+idim], aXYZ1[aTri1[i]*3+idim]);
+      }
+    }
+    EXPECT_TRUE(dfm2::Read_STL("tmp_mshiofast.stl", aXYZ1, aTri1, false));
+    EXPECT_EQ(aXYZ1.size(), aTri.size()*3);
+  }
+  { // ascii stl
+    std::vector<int> aTri0(aTri.begin(),aTri.end());
+    dfm2::Write_STL("tmp_mshiofast_ascii.stl", aXYZ, aTri0);
+    std::vector<double> aXYZ1;
+    std::vector<unsigned int> aTri1;
+    EXPECT_TRUE(dfm2::Read_STL("tmp_mshiofast_ascii.stl", aXYZ1, aTri1));
+    EXPECT_EQ(aTri1.size(), aTri.size());
+    for(unsigned int i=0;i<aTri.size();++i){
+      for(int idim=0;idim<3;++idim){
+        EXPECT_NEAR(aXYZ[aTri[i]*3+idim], aXYZ1[aTri1[i]*3+idim], 1.0e-5);
+      }
+    }
+  }
+  for(const char* path : {
+      "tmp_mshiofast.obj", "tmp_mshiofast.ply", "tmp_mshiofast_be.ply",
+      "tmp_mshiofast.stl", "tmp_mshiofast_ascii.stl"}){
+    std::remove(path);
+  }
+}
+
+TEST(mshio,write_vtk_binary)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Cube(aXYZ, aTri, 4);
+  const size_t np = aXYZ.size()/3;
+  const size_t ntri = aTri.size()/3;
+  dfm2::CVtkUnstructuredGrid grid;
+  grid.SetPoints(aXYZ, 3);
+  grid.AddCells(aTri, 3, 5);
+  {
+    std::vector<double> aDisp(np*3), aPress(np), aArea(ntri);
+    for(unsigned int i=0;i<np*3;++i){ aDisp[i] = aXYZ[i]*0.1; }
+    for(unsigned int ip=0;ip<np;++ip){ aPress[ip] = ip; }
+    for(unsigned int it=0;it<ntri;++it){ aArea[it] = -double(it); }
+    grid.AddPointData("disp", aDisp, 3);
+    grid.AddPointData("press", aPress, 1);
+    grid.AddCellData("area", aArea, 1);
+  }
+  auto load = [](const std::string& path){
+    std::ifstream fin(path, std::ios::binary);
+    std::stringstream ss;
+    ss << fin.rdbuf();
+    return ss.str();
+  };
+  { // legacy binary
+    EXPECT_TRUE(dfm2::WriteVTK_LegacyBinary("tmp_mshiovtk.vtk", grid));
+    const std::string s = load("tmp_mshiovtk.vtk");
+    const std::string key = "POINTS " + std::to_string(np) + " double\n";
+    const size_t ipos = s.find(key);
+    ASSERT_NE(ipos, std::string::npos);
+    const std::uint16_t one = 1;
+    const bool is_little = *reinterpret_cast<const char*>(&one) == 1;
+    for(unsigned int i=0;i<np*3;++i){
+      char b[8];
+      memcpy(b, s.data()+ipos+key.size()+i*8, 8);
+      if( is_little ){ std::reverse(b,b+8); }
+      double v; memcpy(&v,b,8);
+      EXPECT_EQ(v, aXYZ[i]);
+    }
+    EXPECT_NE(s.find("CELL_TYPES " + std::to_string(ntri) + "\n"), std::string::npos);
+    EXPECT_NE(s.find("SCALARS press double 1\n"), std::string::npos);
+    EXPECT_NE(s.find("CELL_DATA " + std::to_string(ntri) + "\n"), std::string::npos);
+  }
+  { // vtu with appended raw data
+    EXPECT_TRUE(dfm2::WriteVTU("tmp_mshiovtk.vtu", grid));
+    const std::string s = load("tmp_mshiovtk.vtu");
+    const size_t ipos = s.find("<AppendedData encoding=\"raw\">");
+    ASSERT_NE(ipos, std::string::npos);
+    const char* p = s.data() + s.find('_', ipos) + 1;
+    std::uint64_t nbyte; memcpy(&nbyte, p, 8);
+    EXPECT_EQ(nbyte, np*3*8);
+    std::vector<double> aXYZ1(np*3);
+    memcpy(aXYZ1.data(), p+8, nbyte);
+    EXPECT_EQ(aXYZ, aXYZ1);
+    // the offset of the connectivity is right after the points
+    EXPECT_NE(s.find("Name=\"connectivity\" NumberOfComponents=\"1\" format=\"appended\" offset=\""
+                     + std::to_string(8+nbyte) + "\""), std::string::npos);
+  }
+  { // time series written in the background thread
+    dfm2::CVtkSeriesWriter writer("tmp_mshiovtk_series", false, true, 1);
+    for(unsigned int iframe=0;iframe<4;++iframe){
+      dfm2::CVtkUnstructuredGrid grid1 = grid;
+      writer.Write(iframe*0.1, std::move(grid1));
+    }
+    writer.Finish();
+    EXPECT_EQ(writer.NumFrames(), 4);
+    const std::string s = load("tmp_mshiovtk_series.pvd");
+    size_t ndataset = 0;
+    for(size_t ipos=s.find("<DataSet");ipos!=std::string::npos;ipos=s.find("<DataSet",ipos+1)){ ndataset++; }
+    EXPECT_EQ(ndataset, 4);
+    EXPECT_NE(s.find("file=\"tmp_mshiovtk_series_00003.vtu\""), std::string::npos);
+    EXPECT_EQ(load("tmp_mshiovtk_series_00003.vtu"), load("tmp_mshiovtk.vtu"));
+  }
+#ifdef USE_ZLIB
+  { // vtu with the data compressed in blocks
+    std::vector<double> aXYZ1;
+    std::vector<unsigned int> aTri1;
+    dfm2::MeshTri3D_Cube(aXYZ1, aTri1, 32); // the points need several blocks
+    dfm2::CVtkUnstructuredGrid grid1;
+    grid1.SetPoints(aXYZ1, 3);
+    grid1.AddCells(aTri1, 3, 5);
+    EXPECT_TRUE(dfm2::WriteVTU("tmp_mshiovtk_zlib.vtu", grid1, true, 2));
+    const std::string s = load("tmp_mshiovtk_zlib.vtu");
+    EXPECT_NE(s.find("compressor=\"vtkZLibDataCompressor\""), std::string::npos);
+    const size_t ipos = s.find("<AppendedData encoding=\"raw\">");
+    ASSERT_NE(ipos, std::string::npos);
+    const char* p = s.data() + s.find('_', ipos) + 1;
+    std::uint64_t aHead[3]; memcpy(aHead, p, 24); // number of blocks, block size, size of the last block
+    ASSERT_GT(aHead[0], 1);
+    std::vector<std::uint64_t> aNComp(aHead[0]);
+    memcpy(aNComp.data(), p+24, aHead[0]*8);
+    std::vector<double> aXYZ2;
+    const char* pc = p + 24 + aHead[0]*8;
+    for(unsigned int iblock=0;iblock<aHead[0];++iblock){
+      uLongf n = static_cast<uLongf>(aHead[1]);
+      std::vector<double> aBlock(aHead[1]/8);
+      EXPECT_EQ(uncompress(reinterpret_cast<Bytef*>(aBlock.data()), &n,
+                           reinterpret_cast<const Bytef*>(pc), static_cast<uLong>(aNComp[iblock])), Z_OK);
+      aXYZ2.insert(aXYZ2.end(), aBlock.begin(), aBlock.begin()+n/8);
+      pc += aNComp[iblock];
+    }
+    EXPECT_EQ(aXYZ2, aXYZ1);
+    EXPECT_EQ(aXYZ1.size()*8 % aHead[1], aHead[2]);
+    // the offset of the connectivity is right after the points
+    EXPECT_NE(s.find("Name=\"connectivity\" NumberOfComponents=\"1\" format=\"appended\" offset=\""
+                     + std::to_string(pc-p) + "\""), std::string::npos);
+  }
+  std::remove("tmp_mshiovtk_zlib.vtu");
+#endif
+  for(const char* path : {
+      "tmp_mshiovtk.vtk", "tmp_mshiovtk.vtu", "tmp_mshiovtk_series.pvd",
+      "tmp_mshiovtk_series_00000.vtu", "tmp_mshiovtk_series_00001.vtu",
+      "tmp_mshiovtk_series_00002.vtu", "tmp_mshiovtk_series_00003.vtu"}){
+    std::remove(path);
+  }
+}
+
+TEST(mshio,read_fast_same_as_read)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_CylinderClosed(aXYZ, aTri, 0.3, 1.0, 32, 32);
+  dfm2::Write_Obj("tmp_mshiofast_cmp.obj",
+                  aXYZ.data(), aXYZ.size()/3,
+                  aTri.data(), aTri.size()/3);
+  dfm2::Write_Ply("tmp_mshiofast_cmp.ply",
+                  aXYZ.size()/3, aXYZ.data(),
+                  aTri.size()/3, aTri.data());
+  std::vector<double> aXYZ0, aXYZ1;
+  std::vector<unsigned int> aTri0, aTri1;
+  dfm2::Read_Obj("tmp_mshiofast_cmp.obj", aXYZ0, aTri0);
+  EXPECT_TRUE(dfm2::Read_Obj_Fast("tmp_mshiofast_cmp.obj", aXYZ1, aTri1));
+  EXPECT_EQ(aXYZ0, aXYZ1);
+  EXPECT_EQ(aTri0, aTri1);
+  dfm2::Read_Ply("tmp_mshiofast_cmp.ply", aXYZ0, aTri0);
+  EXPECT_TRUE(dfm2::Read_Ply_Fast("tmp_mshiofast_cmp.ply", aXYZ1, aTri1));
+  EXPECT_EQ(aXYZ0, aXYZ1);
+  EXPECT_EQ(aTri0, aTri1);
+  std::remove("tmp_mshiofast_cmp.obj");
+  std::remove("tmp_mshiofast_cmp.ply");
+}
+
 TEST(meshtopo,quad_subdiv0)
 {
   dfm2::CGrid3<int> vg;
@@ -126,4 +407,671 @@ TEST(slice,test1){
     }
   }
 
-}
\ No newline at end of file
+}
+TEST(mshreorder,rcm)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Cube(aXYZ,aTri, 10);
+  const unsigned int np = aXYZ.size()/3;
+  { // shuffle the points to destroy the locality
+    std::vector<unsigned int> aOld2New(np);
+    for(unsigned int ip=0;ip<np;++ip){ aOld2New[ip] = ip; }
+    std::mt19937 rdeng(0);
+    std::shuffle(aOld2New.begin(), aOld2New.end(), rdeng);
+    dfm2::PermuteValues(aXYZ,3,aOld2New);
+    dfm2::PermuteElemIndex(aTri,aOld2New);
+  }
+  std::vector<unsigned int> psup_ind, psup;
+  dfm2::JArray_PSuP_MeshElem(psup_ind, psup,
+                             aTri.data(), aTri.size()/3, 3, np);
+  const unsigned int nbw0 = dfm2::Bandwidth_JArray(psup_ind,psup);
+  std::vector<unsigned int> aOld2New;
+  dfm2::Permutation_ReverseCuthillMcKee(aOld2New, psup_ind,psup);
+  { // check it is a permutation
+    std::vector<unsigned int> aNew2Old;
+    dfm2::Permutation_Inverse(aNew2Old,aOld2New);
+    for(unsigned int ip=0;ip<np;++ip){ EXPECT_EQ(aOld2New[aNew2Old[ip]],ip); }
+  }
+  std::vector<unsigned int> psup_ind1 = psup_ind, psup1 = psup;
+  dfm2::JArray_Permute(psup_ind1,psup1,aOld2New);
+  const unsigned int nbw1 = dfm2::Bandwidth_JArray(psup_ind1,psup1);
+  EXPECT_LT(nbw1*4, nbw0);
+  { // permuting the element is consistent with permuting the jagged array
+    std::vector<unsigned int> aTri2 = aTri;
+    dfm2::PermuteElemIndex(aTri2,aOld2New);
+    std::vector<unsigned int> psup_ind2, psup2;
+    dfm2::JArray_PSuP_MeshElem(psup_ind2, psup2,
+                               aTri2.data(), aTri2.size()/3, 3, np);
+    dfm2::JArray_Sort(psup_ind2,psup2);
+    EXPECT_EQ(psup_ind1,psup_ind2);
+    EXPECT_EQ(psup1,psup2);
+  }
+  {
+    std::vector<double> aXYZ2 = aXYZ;
+    dfm2::PermuteValues(aXYZ2,3,aOld2New);
+    for(unsigned int ip=0;ip<np;++ip){
+      EXPECT_EQ(aXYZ[ip*3+1],aXYZ2[aOld2New[ip]*3+1]);
+    }
+  }
+}
+
+TEST(mshreorder,space_filling_curve)
+{
+  const unsigned int n = 8;
+  std::vector<double> aXYZ;
+  for(unsigned int i=0;i<n*n*n;++i){
+    aXYZ.push_back(i%n);
+    aXYZ.push_back((i/n)%n);
+    aXYZ.push_back(i/(n*n));
+  }
+  std::vector<unsigned int> aOld2New;
+  dfm2::Permutation_HilbertCurve(aOld2New,aXYZ);
+  std::vector<unsigned int> aNew2Old;
+  dfm2::Permutation_Inverse(aNew2Old,aOld2New);
+  for(unsigned int ip=0;ip<n*n*n-1;++ip){ // consecutive points are adjacent
+    const unsigned int i0 = aNew2Old[ip];
+    const unsigned int i1 = aNew2Old[ip+1];
+    const double d0 = fabs(aXYZ[i0*3+0]-aXYZ[i1*3+0])
+        + fabs(aXYZ[i0*3+1]-aXYZ[i1*3+1])
+        + fabs(aXYZ[i0*3+2]-aXYZ[i1*3+2]);
+    EXPECT_EQ(d0,1.0);
+  }
+  dfm2::Permutation_MortonCode(aOld2New,aXYZ);
+  dfm2::Permutation_Inverse(aNew2Old,aOld2New);
+  for(unsigned int ip=0;ip<n*n*n;ip+=8){ // z-curve visits 2x2x2 block in a row
+    const unsigned int i0 = aNew2Old[ip];
+    for(unsigned int jp=ip;jp<ip+8;++jp){
+      const unsigned int j0 = aNew2Old[jp];
+      EXPECT_EQ(int(aXYZ[i0*3+0])/2,int(aXYZ[j0*3+0])/2);
+      EXPECT_EQ(int(aXYZ[i0*3+2])/2,int(aXYZ[j0*3+2])/2);
+    }
+  }
+  aXYZ.clear(); // no point
+  dfm2::Permutation_HilbertCurve(aOld2New,aXYZ);
+  EXPECT_TRUE(aOld2New.empty());
+  dfm2::Permutation_MortonCode(aOld2New,aXYZ);
+  EXPECT_TRUE(aOld2New.empty());
+}
+
+TEST(sampler,nearest_point)
+{
+  std::mt19937 rndeng(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  for(unsigned int ndim=2;ndim<=3;++ndim){
+    std::vector<double> aXYZ(1000*ndim);
+    for(auto& v : aXYZ){ v = dist(rndeng); }
+    for(unsigned int i=0;i<ndim;++i){ aXYZ[ndim+i] = aXYZ[i]; } // duplicated point
+    const double bbmin[3] = {-0.8,-0.8,-0.8}, bbmax[3] = {0.8,0.8,0.8};
+    dfm2::CBucketGrid_NearestPoint grid;
+    grid.Initialize(aXYZ.data(), 1000, ndim, bbmin, bbmax);
+    for(unsigned int itr=0;itr<1000;++itr){
+      double p[3];
+      for(unsigned int i=0;i<ndim;++i){ p[i] = dist(rndeng)*1.2; } // some are outside the grid
+      if( itr == 0 ){ for(unsigned int i=0;i<ndim;++i){ p[i] = aXYZ[i]; } }
+      unsigned int ip_min = 0;
+      double d2_min = -1;
+      for(unsigned int ip=0;ip<1000;++ip){
+        double d2 = 0.0;
+        for(unsigned int i=0;i<ndim;++i){ d2 += (p[i]-aXYZ[ip*ndim+i])*(p[i]-aXYZ[ip*ndim+i]); }
+        if( d2_min < 0 || d2 <= d2_min ){ d2_min = d2; ip_min = ip; }
+      }
+      EXPECT_EQ(grid.Nearest(p), ip_min);
+    }
+  }
+  { // points on a slightly noisy plane in 3D
+    const unsigned int np = 10000;
+    std::vector<double> aXYZ(np*3);
+    for(unsigned int ip=0;ip<np;++ip){
+      aXYZ[ip*3+0] = dist(rndeng);
+      aXYZ[ip*3+1] = dist(rndeng);
+      aXYZ[ip*3+2] = dist(rndeng)*1.0e-4;
+    }
+    const double bbmin[3] = {-1,-1,-1.0e-4}, bbmax[3] = {1,1,1.0e-4};
+    dfm2::CBucketGrid_NearestPoint grid;
+    grid.Initialize(aXYZ.data(), np, 3, bbmin, bbmax);
+    EXPECT_EQ(grid.aNDiv[2], 1);
+    EXPECT_LT(grid.aNDiv[0]*grid.aNDiv[1]*grid.aNDiv[2], np); // proportional to the number of points
+    for(unsigned int itr=0;itr<100;++itr){
+      const double p[3] = {dist(rndeng), dist(rndeng), dist(rndeng)*1.0e-4};
+      unsigned int ip_min = 0;
+      double d2_min = -1;
+      for(unsigned int ip=0;ip<np;++ip){
+        double d2 = 0.0;
+        for(unsigned int i=0;i<3;++i){ d2 += (p[i]-aXYZ[ip*3+i])*(p[i]-aXYZ[ip*3+i]); }
+        if( d2_min < 0 || d2 <= d2_min ){ d2_min = d2; ip_min = ip; }
+      }
+      EXPECT_EQ(grid.Nearest(p), ip_min);
+    }
+  }
+}
+
+TEST(sampler,lloyd)
+{
+  std::mt19937 rndeng(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  { // 2D
+    const unsigned int ndiv = 128;
+    const double min_xy[2] = {-1,-1}, max_xy[2] = {1,1};
+    std::vector<double> aD(ndiv*ndiv);
+    for(unsigned int i=0;i<aD.size();++i){ aD[i] = 1.0 + (i%ndiv)*0.01; }
+    std::vector<double> aXY0(500*2);
+    for(auto& v : aXY0){ v = dist(rndeng); }
+    std::vector<double> aXY1 = aXY0, aXY4 = aXY0;
+    dfm2::Step_Lloyd2(aXY1, ndiv, aD, min_xy, max_xy, 1);
+    dfm2::Step_Lloyd2(aXY4, ndiv, aD, min_xy, max_xy, 4);
+    // brute force
+    std::vector<double> awpw(500*3, 0.0);
+    for(unsigned int ih=0;ih<ndiv;++ih){
+      for(unsigned int iw=0;iw<ndiv;++iw){
+        const double x0 = min_xy[0] + (max_xy[0]-min_xy[0])*(iw+0.5)/ndiv;
+        const double y0 = min_xy[1] + (max_xy[1]-min_xy[1])*(1.0-(ih+0.5)/ndiv);
+        unsigned int ip_min = 0;
+        double d2_min = -1;
+        for(unsigned int ip=0;ip<500;++ip){
+          const double d2 = (x0-aXY0[ip*2+0])*(x0-aXY0[ip*2+0]) + (y0-aXY0[ip*2+1])*(y0-aXY0[ip*2+1]);
+          if( d2_min < 0 || d2 <= d2_min ){ d2_min = d2; ip_min = ip; }
+        }
+        const double w0 = aD[ih*ndiv+iw];
+        awpw[ip_min*3+0] += w0*x0;
+        awpw[ip_min*3+1] += w0*y0;
+        awpw[ip_min*3+2] += w0;
+      }
+    }
+    for(unsigned int ip=0;ip<500;++ip){
+      if( awpw[ip*3+2] == 0.0 ){
+        EXPECT_EQ(aXY1[ip*2+0], aXY0[ip*2+0]);
+        continue;
+      }
+      EXPECT_NEAR(aXY1[ip*2+0], awpw[ip*3+0]/awpw[ip*3+2], 1.0e-12);
+      EXPECT_NEAR(aXY1[ip*2+1], awpw[ip*3+1]/awpw[ip*3+2], 1.0e-12);
+      EXPECT_NEAR(aXY4[ip*2+0], aXY1[ip*2+0], 1.0e-10);
+      EXPECT_NEAR(aXY4[ip*2+1], aXY1[ip*2+1], 1.0e-10);
+    }
+  }
+  { // on the surface of the sphere. the samples are the centers of the triangles
+    std::vector<double> aXYZ;
+    std::vector<unsigned int> aTri;
+    dfm2::MeshTri3D_Sphere(aXYZ, aTri, 1.0, 32, 32);
+    std::vector<double> aXYZ_sample, aW_sample;
+    for(unsigned int it=0;it<aTri.size()/3;++it){
+      const dfm2::CVec3d p0(aXYZ.data()+aTri[it*3+0]*3);
+      const dfm2::CVec3d p1(aXYZ.data()+aTri[it*3+1]*3);
+      const dfm2::CVec3d p2(aXYZ.data()+aTri[it*3+2]*3);
+      const dfm2::CVec3d pc = (p0+p1+p2)/3.0;
+      aXYZ_sample.insert(aXYZ_sample.end(), pc.p, pc.p+3);
+      aW_sample.push_back(((p1-p0)^(p2-p0)).Length()*0.5);
+    }
+    std::vector<double> aXYZ_site;
+    for(unsigned int ip=0;ip<aXYZ.size()/3;ip+=7){
+      aXYZ_site.insert(aXYZ_site.end(), aXYZ.data()+ip*3, aXYZ.data()+ip*3+3);
+    }
+    auto energy = [&](const std::vector<double>& aS){
+      double e = 0.0;
+      for(unsigned int is=0;is<aW_sample.size();++is){
+        double d2_min = -1;
+        for(unsigned int ip=0;ip<aS.size()/3;++ip){
+          const double d2 = (dfm2::CVec3d(aXYZ_sample.data()+is*3)-dfm2::CVec3d(aS.data()+ip*3)).DLength();
+          if( d2_min < 0 || d2 < d2_min ){ d2_min = d2; }
+        }
+        e += aW_sample[is]*d2_min;
+      }
+      return e;
+    };
+    double e0 = energy(aXYZ_site);
+    for(unsigned int itr=0;itr<5;++itr){
+      std::vector<double> aXYZ1 = aXYZ_site, aXYZ4 = aXYZ_site;
+      dfm2::Step_Lloyd3(aXYZ1, aXYZ_sample, aW_sample, 1);
+      dfm2::Step_Lloyd3(aXYZ4, aXYZ_sample, aW_sample, 4);
+      for(unsigned int i=0;i<aXYZ1.size();++i){ EXPECT_NEAR(aXYZ1[i], aXYZ4[i], 1.0e-10); }
+      for(unsigned int ip=0;ip<aXYZ1.size()/3;++ip){ // project to the sphere
+        dfm2::CVec3d p(aXYZ1.data()+ip*3);
+        p.SetNormalizedVector();
+        p.CopyTo(aXYZ1.data()+ip*3);
+      }
+      const double e1 = energy(aXYZ1);
+      EXPECT_LT(e1, e0);
+      e0 = e1;
+      aXYZ_site = aXYZ1;
+    }
+  }
+}
+
+TEST(gridvoxel,stencil_matfree)
+{
+  // stencil operator on the grid solved with the Jacobi preconditioned CG
+  std::mt19937 rdeng(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  const unsigned int nx = 9, ny = 8, nz = 7;
+  auto index = [&](unsigned int ix, unsigned int iy, unsigned int iz){ return (iz*ny+iy)*nx+ix; }; // x is the fastest
+  dfm2::CGrid3<int> grid;
+  grid.Initialize(nx, ny, nz, 1);
+  grid.aVal[index(4,4,3)] = 0;
+  grid.aVal[index(5,4,3)] = 0;
+  const dfm2::CMatFree_GridStencil<double> mf(grid, 0.1, 1.0, 0.5);
+  { // the discrete Laplacian of the quadratic function is exact at the cells surrounded by the cells inside
+    const unsigned int n = grid.aVal.size();
+    std::vector<double> x(n), y(n, std::numeric_limits<double>::quiet_NaN()); // "y" is not read if beta==0
+    for(unsigned int iz=0;iz<nz;++iz){
+      for(unsigned int iy=0;iy<ny;++iy){
+        for(unsigned int ix=0;ix<nx;++ix){
+          const double px = ix*0.1, py = iy*0.1, pz = iz*0.1;
+          x[index(ix,iy,iz)] = px*px + 2*py*py + 3*pz*pz;
+        }
+      }
+    }
+    mf.MatVec(y.data(), 1.0, x.data(), 0.0);
+    for(unsigned int iz=1;iz+1<nz;++iz){
+      for(unsigned int iy=1;iy+1<ny;++iy){
+        for(unsigned int ix=1;ix+1<nx;++ix){
+          if( iy == 4 && iz == 3 && ix >= 3 && ix <= 6 ){ continue; } // next to the cells outside
+          if( (iy == 3 || iy == 5 || iz == 2 || iz == 4) && (ix == 4 || ix == 5) ){ continue; }
+          const unsigned int ic = index(ix,iy,iz);
+          EXPECT_NEAR(y[ic], 0.5*x[ic] - 12.0, 1.0e-8);
+        }
+      }
+    }
+  }
+  dfm2::CPreconditionerJacobi<double> prec;
+  prec.SetValue(mf, grid.aVal.size());
+  const unsigned int n = grid.aVal.size();
+  std::vector<double> b(n), r(n), x(n), tmp0(n), tmp1(n), Ax(n);
+  for(auto& v : b){ v = dist(rdeng); }
+  r = b;
+  const std::vector<double> aConv = dfm2::Solve_PCG(
+      dfm2::CVecXd(r), dfm2::CVecXd(x), dfm2::CVecXd(tmp0), dfm2::CVecXd(tmp1),
+      1.0e-10, 1000, mf, prec);
+  EXPECT_LT(aConv.size(), 200);
+  mf.MatVec(Ax.data(), 1.0, x.data(), 0.0);
+  for(unsigned int i=0;i<n;++i){ EXPECT_NEAR(Ax[i], b[i], 1.0e-6); }
+  EXPECT_NEAR(x[index(4,4,3)], b[index(4,4,3)], 1.0e-8); // identity outside
+}
+
+TEST(gridvoxel,voxelize_meshtri3)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Sphere(aXYZ, aTri, 1.0, 32, 32);
+  const unsigned int n = 48;
+  const double el = 2.4/n;
+  dfm2::CGrid3<int> grid1, grid4, grid_srf;
+  for(dfm2::CGrid3<int>* g : {&grid1, &grid4, &grid_srf}){
+    g->Initialize(n, n, n, 0);
+    g->am.SetScale(el, el, el);
+    g->am.mat[3] = g->am.mat[7] = g->am.mat[11] = -1.2;
+  }
+  dfm2::Voxelize_MeshTri3(grid1, aXYZ, aTri, true, 1);
+  dfm2::Voxelize_MeshTri3(grid4, aXYZ, aTri, true, 4);
+  dfm2::Voxelize_MeshTri3(grid_srf, aXYZ, aTri, false);
+  EXPECT_EQ(grid1.aVal, grid4.aVal);
+  for(unsigned int iz=0;iz<n;++iz){
+    for(unsigned int iy=0;iy<n;++iy){
+      for(unsigned int ix=0;ix<n;++ix){
+        const unsigned int ivox = iz*n*n+iy*n+ix;
+        const double r = dfm2::CVec3d((ix+0.5)*el-1.2, (iy+0.5)*el-1.2, (iz+0.5)*el-1.2).Length();
+        if( r < 0.98 ){ EXPECT_EQ(grid1.aVal[ivox], 1); }
+        if( r > 1.0+el ){ EXPECT_EQ(grid1.aVal[ivox], 0); } // the circumsphere of voxel touches the sphere
+        if( fabs(r-1.0) > el ){ EXPECT_EQ(grid_srf.aVal[ivox], 0); }
+        if( grid_srf.aVal[ivox] == 1 ){ EXPECT_EQ(grid1.aVal[ivox], 1); }
+      }
+    }
+  }
+  { // narrow band signed distance
+    dfm2::CGrid3<double> grid_sdf;
+    grid_sdf.Initialize(n, n, n, 0.0);
+    grid_sdf.am = grid1.am;
+    const double band = 3*el;
+    dfm2::SignedDistance_NarrowBand_MeshTri3(grid_sdf, aXYZ, aTri, band);
+    for(unsigned int iz=0;iz<n;++iz){
+      for(unsigned int iy=0;iy<n;++iy){
+        for(unsigned int ix=0;ix<n;++ix){
+          const double r = dfm2::CVec3d((ix+0.5)*el-1.2, (iy+0.5)*el-1.2, (iz+0.5)*el-1.2).Length();
+          const double sd = grid_sdf.aVal[iz*n*n+iy*n+ix];
+          if( fabs(r-1.0) < 2*el ){ EXPECT_NEAR(sd, r-1.0, 0.01); }
+          if( fabs(r-1.0) > 4*el ){ EXPECT_EQ(fabs(sd), band); }
+        }
+      }
+    }
+  }
+}
+
+TEST(gridvoxel,signed_distance_field)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Sphere(aXYZ, aTri, 1.0, 32, 32);
+  const unsigned int n = 40;
+  const double el = 3.0/n;
+  dfm2::CGrid3<float> grid1, grid4;
+  for(dfm2::CGrid3<float>* g : {&grid1, &grid4}){
+    g->Initialize(n, n, n, 0.f);
+    g->am.SetScale(el, el, el);
+    g->am.mat[3] = g->am.mat[7] = g->am.mat[11] = -1.5;
+  }
+  const double band = 1.5*el;
+  dfm2::SignedDistanceField_MeshTri3(grid1, aXYZ, aTri, band, 1);
+  dfm2::SignedDistanceField_MeshTri3(grid4, aXYZ, aTri, band, 4);
+  EXPECT_EQ(grid1.aVal, grid4.aVal);
+  dfm2::CGrid3<double> grid_nb;
+  grid_nb.Initialize(n, n, n, 0.0);
+  grid_nb.am = grid1.am;
+  dfm2::SignedDistance_NarrowBand_MeshTri3(grid_nb, aXYZ, aTri, band);
+  for(unsigned int iz=0;iz<n;++iz){
+    for(unsigned int iy=0;iy<n;++iy){
+      for(unsigned int ix=0;ix<n;++ix){
+        const unsigned int ivox = iz*n*n+iy*n+ix;
+        const double r = dfm2::CVec3d((ix+0.5)*el-1.5, (iy+0.5)*el-1.5, (iz+0.5)*el-1.5).Length();
+        EXPECT_NEAR(grid1.aVal[ivox], r-1.0, 0.01);
+        if( fabs(grid_nb.aVal[ivox]) < band ){ EXPECT_NEAR(grid1.aVal[ivox], grid_nb.aVal[ivox], 1.0e-5); }
+      }
+    }
+  }
+  const dfm2::CMat4d ami = grid1.am.Inverse();
+  std::mt19937 rndeng(0);
+  std::uniform_real_distribution<double> dist(-1.3, 1.3);
+  for(unsigned int itr=0;itr<1000;++itr){
+    const double p[3] = {dist(rndeng), dist(rndeng), dist(rndeng)};
+    const dfm2::CVec3d vp(p);
+    double grad[3];
+    const double sd = dfm2::SignedDistance_Grid3(grad, grid1, ami, p);
+    EXPECT_NEAR(sd, vp.Length()-1.0, 0.02);
+    if( vp.Length() < 0.3 ){ continue; }
+    const dfm2::CVec3d vg(grad);
+    EXPECT_NEAR(vg.Length(), 1.0, 0.1);
+    EXPECT_GT(vg*vp.Normalize(), 0.95*vg.Length());
+  }
+}
+
+TEST(geodesic,fast_marching_meshtri3)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Sphere(aXYZ, aTri, 1.0, 32, 32);
+  const unsigned int np = aXYZ.size()/3;
+  unsigned int ip_top = 0, ip_bottom = 0;
+  for(unsigned int ip=0;ip<np;++ip){
+    if( aXYZ[ip*3+1] > aXYZ[ip_top*3+1] ){ ip_top = ip; }
+    if( aXYZ[ip*3+1] < aXYZ[ip_bottom*3+1] ){ ip_bottom = ip; }
+  }
+  std::vector<double> aDistFM;
+  dfm2::FastMarching_MeshTri3D(aDistFM, {{ip_top,0.0}}, -1.0, aXYZ, aTri);
+  std::vector<double> aDistDijk;
+  {
+    std::vector<unsigned int> psup_ind, psup;
+    dfm2::JArray_PSuP_MeshElem(psup_ind, psup, aTri.data(), aTri.size()/3, 3, np);
+    std::vector<unsigned int> aOrder;
+    dfm2::geodesic::CProc_Nothing proc;
+    dfm2::DijkstraPoint_MeshTri3D(aDistDijk, aOrder, proc, ip_top, aXYZ, psup_ind, psup);
+  }
+  double err_fm = 0.0, err_dijk = 0.0;
+  for(unsigned int ip=0;ip<np;++ip){
+    const double d0 = acos(aXYZ[ip*3+1]);
+    err_fm = std::max(err_fm, fabs(aDistFM[ip]-d0));
+    err_dijk = std::max(err_dijk, fabs(aDistDijk[ip]-d0));
+  }
+  EXPECT_LT(err_fm, 0.05);
+  EXPECT_LT(err_fm, err_dijk*0.5);
+  { // multiple sources
+    std::vector<double> aDist;
+    dfm2::FastMarching_MeshTri3D(aDist, {{ip_top,0.0},{ip_bottom,0.0}}, -1.0, aXYZ, aTri);
+    for(unsigned int ip=0;ip<np;++ip){
+      const double d0 = std::min(acos(aXYZ[ip*3+1]), acos(-aXYZ[ip*3+1]));
+      EXPECT_NEAR(aDist[ip], d0, 0.05);
+    }
+  }
+  { // early termination
+    std::vector<double> aDist;
+    dfm2::FastMarching_MeshTri3D(aDist, {{ip_top,0.0}}, 1.0, aXYZ, aTri);
+    for(unsigned int ip=0;ip<np;++ip){
+      if( aDistFM[ip] <= 1.0 ){ EXPECT_EQ(aDist[ip], aDistFM[ip]); }
+      else{ EXPECT_EQ(aDist[ip], -1.0); }
+    }
+  }
+  { // heat method
+    dfm2::CGeodesic_HeatMethod heat;
+    heat.Initialize(aXYZ, aTri);
+    std::vector<double> aDist;
+    heat.Compute(aDist, {ip_top});
+    for(unsigned int ip=0;ip<np;++ip){
+      EXPECT_NEAR(aDist[ip], acos(aXYZ[ip*3+1]), 0.1);
+    }
+    std::vector<double> aDist2;
+    std::thread th([&](){ heat.Compute(aDist2, {ip_top}); }); // solve is const
+    th.join();
+    EXPECT_EQ(aDist, aDist2);
+    heat.Compute(aDist2, {}); // no source
+    EXPECT_EQ(aDist2, std::vector<double>(np, 0.0));
+  }
+}
+
+TEST(dijkstra,graph)
+{
+  std::vector<double> aXYZ;
+  std::vector<unsigned int> aTri;
+  dfm2::MeshTri3D_Sphere(aXYZ, aTri, 1.0, 32, 32);
+  const unsigned int ntri = aTri.size()/3;
+  std::vector<unsigned int> aTriSuTri;
+  dfm2::ElSuEl_MeshElem(aTriSuTri, aTri.data(), ntri, dfm2::MESHELEM_TRI, aXYZ.size()/3);
+  std::vector<unsigned int> aInd, aAdj;
+  std::vector<double> aWeight;
+  dfm2::ElemGraph_MeshElemGeo3(aInd, aAdj, aWeight, aTri, 3, aXYZ, aTriSuTri);
+  { // same as the distance without the cache
+    class CProc {
+    public:
+      void AddElem(unsigned int, std::vector<unsigned int>&){}
+      bool IsIncludeElem(unsigned int){ return true; }
+    } proc;
+    std::vector<double> aDist0;
+    std::vector<unsigned int> aOrder;
+    dfm2::DijkstraElem_MeshElemGeo3(aDist0, aOrder, proc, 5, aTri, ntri, aXYZ, aTriSuTri);
+    std::vector<double> aDist1;
+    std::vector<unsigned int> aLabel;
+    dfm2::Dijkstra_Graph(aDist1, aLabel, {{5,0.0}}, aInd, aAdj, aWeight);
+    for(unsigned int it=0;it<ntri;++it){
+      EXPECT_NEAR(aDist0[it], aDist1[it], 1.0e-10);
+      EXPECT_EQ(aLabel[it], 0);
+    }
+  }
+  { // multiple sources is the minimum of the single sources
+    const std::vector<unsigned int> aSrc = {0, 100, 1000, 1500};
+    std::vector<double> aDist1, aDist4;
+    dfm2::DijkstraSources_Graph(aDist1, aSrc, aInd, aAdj, aWeight, 1);
+    dfm2::DijkstraSources_Graph(aDist4, aSrc, aInd, aAdj, aWeight, 4);
+    EXPECT_EQ(aDist1, aDist4);
+    std::vector<double> aDist;
+    std::vector<unsigned int> aLabel;
+    dfm2::Dijkstra_Graph(aDist, aLabel, {{0,0.0},{100,0.0},{1000,0.0},{1500,0.0}}, aInd, aAdj, aWeight);
+    for(unsigned int it=0;it<ntri;++it){
+      double dmin = aDist1[it];
+      for(unsigned int isrc=0;isrc<aSrc.size();++isrc){ dmin = std::min(dmin, aDist1[isrc*ntri+it]); }
+      EXPECT_NEAR(aDist[it], dmin, 1.0e-10);
+      EXPECT_NEAR(aDist1[aLabel[it]*ntri+it], dmin, 1.0e-10);
+    }
+  }
+  { // incremental clustering is the same as the farthest point sampling with the full distance field
+    std::vector<unsigned int> aLabel, aSeed;
+    std::vector<double> aDist;
+    dfm2::Clustering_Graph(aLabel, aDist, aSeed, 20, 7, aInd, aAdj, aWeight);
+    EXPECT_EQ(aSeed.size(), 20);
+    std::vector<double> aDist0;
+    std::vector<unsigned int> aLabel0, aSeed0 = {7};
+    dfm2::DijkstraSources_Graph(aDist0, {7}, aInd, aAdj, aWeight);
+    aLabel0.assign(ntri, 0);
+    for(unsigned int icluster=1;icluster<20;++icluster){
+      const unsigned int iseed = std::max_element(aDist0.begin(), aDist0.end()) - aDist0.begin();
+      aSeed0.push_back(iseed);
+      std::vector<double> aDist1;
+      dfm2::DijkstraSources_Graph(aDist1, {iseed}, aInd, aAdj, aWeight);
+      for(unsigned int it=0;it<ntri;++it){
+        if( aDist1[it] >= aDist0[it] ){ continue; }
+        aDist0[it] = aDist1[it];
+        aLabel0[it] = icluster;
+      }
+    }
+    EXPECT_EQ(aSeed, aSeed0);
+    EXPECT_EQ(aLabel, aLabel0);
+    for(unsigned int it=0;it<ntri;++it){ EXPECT_NEAR(aDist[it], aDist0[it], 1.0e-10); }
+  }
+  { // topological clustering
+    std::vector<unsigned int> aFlgElm;
+    dfm2::MeshClustering(aFlgElm, 10, aTriSuTri, ntri);
+    std::vector<unsigned int> aCnt(10, 0);
+    for(unsigned int it=0;it<ntri;++it){ ASSERT_LT(aFlgElm[it], 10); aCnt[aFlgElm[it]]++; }
+    for(unsigned int icluster=0;icluster<10;++icluster){ EXPECT_GT(aCnt[icluster], 0); }
+  }
+  { // the elements not connected to the seeds are in the cluster 0
+    const std::vector<unsigned int> aTriSuTri1(4*3, UINT_MAX);
+    std::vector<unsigned int> aFlgElm;
+    dfm2::MeshClustering(aFlgElm, 2, aTriSuTri1, 4);
+    EXPECT_EQ(std::count(aFlgElm.begin(), aFlgElm.end(), 0u), 3);
+    EXPECT_EQ(std::count(aFlgElm.begin(), aFlgElm.end(), 1u), 1);
+  }
+}
+
+TEST(dtri3,simplify_qem)
+{
+  std::vector<double> aXYZ0;
+  std::vector<unsigned int> aTri0;
+  dfm2::MeshTri3D_Sphere(aXYZ0, aTri0, 1.0, 32, 32);
+  const unsigned int np0 = aXYZ0.size()/3;
+  for(unsigned int nthread : {1u, 4u}){
+    std::vector<dfm2::CDynPntSur> aDP;
+    std::vector<dfm2::CDynTri> aDTri;
+    dfm2::InitializeMesh(aDP, aDTri, aTri0.data(), aTri0.size()/3, np0);
+    std::vector<dfm2::CVec3d> aVec3;
+    for(unsigned int ip=0;ip<np0;++ip){ aVec3.emplace_back(aXYZ0.data()+ip*3); }
+    std::vector<double> aAttr(np0); // attribute is the height of the point
+    for(unsigned int ip=0;ip<np0;++ip){ aAttr[ip] = aXYZ0[ip*3+1]; }
+    const size_t ntri_target = 200;
+    dfm2::Simplify_QEM_MeshDTri3(aDP, aDTri, aVec3, aAttr, 1, ntri_target, nthread);
+    EXPECT_LE(aDTri.size(), ntri_target);
+    EXPECT_GT(aDTri.size(), ntri_target/2);
+    dfm2::AssertDTri(aDTri);
+    dfm2::AssertMeshDTri(aDP, aDTri);
+    unsigned int np = 0;
+    for(unsigned int ip=0;ip<np0;++ip){
+      if( aDP[ip].e == UINT_MAX ){ continue; }
+      np++;
+      EXPECT_NEAR(aVec3[ip].Length(), 1.0, 0.05);
+      EXPECT_NEAR(aAttr[ip], aVec3[ip].y(), 0.1);
+    }
+    EXPECT_EQ(np - aDTri.size()*3/2 + aDTri.size(), 2); // Euler characteristic of the sphere
+    for(const dfm2::CDynTri& tri : aDTri){ // no flipped triangle
+      const dfm2::CVec3d& p0 = aVec3[tri.v[0]];
+      const dfm2::CVec3d& p1 = aVec3[tri.v[1]];
+      const dfm2::CVec3d& p2 = aVec3[tri.v[2]];
+      EXPECT_GT(((p1-p0)^(p2-p0))*(p0+p1+p2), 0.0);
+    }
+  }
+}
+
+TEST(geodesic,fast_marching_voxel)
+{
+  const unsigned int n = 32;
+  const double el = 0.1;
+  dfm2::CGrid3<int> grid;
+  grid.Initialize(n, n, n, 1);
+  const unsigned int ivox0 = (n/2)*n*n+(n/2)*n+(n/2);
+  std::vector<double> aDistFM, aDistDijk;
+  dfm2::VoxelGeodesic_FastMarching(aDistFM, {{ivox0,0.0}}, el, grid);
+  dfm2::VoxelGeodesic(aDistDijk, {{ivox0,0.0}}, el, grid);
+  double err_fm = 0.0, err_dijk = 0.0;
+  for(unsigned int iz=0;iz<n;++iz){
+    for(unsigned int iy=0;iy<n;++iy){
+      for(unsigned int ix=0;ix<n;++ix){
+        const unsigned int ivox = iz*n*n+iy*n+ix;
+        const double d0 = dfm2::CVec3d(ix-n/2.0, iy-n/2.0, iz-n/2.0).Length()*el;
+        if( d0 < 5*el ){ continue; } // error is large near the point source
+        err_fm = std::max(err_fm, fabs(aDistFM[ivox]-d0)/d0);
+        err_dijk = std::max(err_dijk, fabs(aDistDijk[ivox]-d0)/d0);
+      }
+    }
+  }
+  EXPECT_LT(err_fm, 0.2);
+  EXPECT_LT(err_fm, err_dijk*0.5);
+  { // the voxels outside are not reached
+    grid.aVal[ivox0+1] = 0;
+    std::vector<double> aDist;
+    dfm2::VoxelGeodesic_FastMarching(aDist, {{ivox0,0.0}}, el, grid, 0.5);
+    EXPECT_EQ(aDist[ivox0+1], -1.0);
+    for(unsigned int ivox=0;ivox<aDist.size();++ivox){
+      EXPECT_LE(aDist[ivox], 0.5);
+    }
+  }
+}
+
+TEST(adf,setup_parallel)
+{
+  class CInSphere : public dfm2::CInput_ADF3
+  {
+  public:
+    double sdf(double x, double y, double z) const override {
+      ++ncall;
+      return 0.5-sqrt(x*x+y*y+z*z); // inside is positive
+    }
+  public:
+    mutable std::atomic<unsigned int> ncall{0};
+  };
+  double bb[6] = { -1, 1, -1, 1, -1, 1 };
+  CInSphere sphere;
+  unsigned int nnode_legacy = 0, ncall_legacy = 0;
+  { // recursive construction sampling every point
+    dfm2::CADF3::CNode no;
+    no.cent_[0] = no.cent_[1] = no.cent_[2] = 0.0;
+    no.hw_ = 1.1234;
+    no.SetCornerDist(sphere);
+    std::vector<dfm2::CADF3::CNode> aNo(1);
+    no.MakeChildTree(sphere, aNo, no.hw_*(0.99/64.0), no.hw_*(1.01/4.0));
+    nnode_legacy = static_cast<unsigned int>(aNo.size());
+    ncall_legacy = sphere.ncall;
+  }
+  dfm2::CADF3 adf1, adf4;
+  sphere.ncall = 0;
+  adf1.SetUp(sphere, bb);
+  EXPECT_EQ(adf1.aNode.size(), nnode_legacy);
+  EXPECT_LT(sphere.ncall*2, ncall_legacy); // shared samples are evaluated once
+  adf4.SetUp(sphere, bb, 6, 1, -1.0, 4);
+  ASSERT_EQ(adf1.aNode.size(), adf4.aNode.size());
+  EXPECT_EQ(adf1.aIndChild, adf4.aIndChild);
+  EXPECT_EQ(adf1.aDistCorner, adf4.aDistCorner);
+  { // the children are contiguous
+    for(const auto& no : adf1.aNode){
+      if( no.ichilds_[0] == -1 ){ continue; }
+      for(int i=0;i<8;++i){ EXPECT_EQ(no.ichilds_[i], no.ichilds_[0]+i); }
+    }
+  }
+  { // query
+    std::mt19937 rndeng(0);
+    std::uniform_real_distribution<double> dist(-0.9, 0.9);
+    const unsigned int np = 1000;
+    std::vector<double> aXYZ(np*3);
+    for(auto& v : aXYZ){ v = dist(rndeng); }
+    std::vector<double> aDist(np), aNorm(np*3);
+    adf4.Projection_Batch(aDist.data(), aNorm.data(), aXYZ.data(), np);
+    for(unsigned int ip=0;ip<np;++ip){
+      const dfm2::CVec3d p(aXYZ.data()+ip*3);
+      if( fabs(p.Length()-0.5) < 0.02 ){ EXPECT_NEAR(aDist[ip], 0.5-p.Length(), 2.0e-3); } // fine cells near the surface
+      double n0[3];
+      const double d0 = adf4.aNode[0].FindDistNormal(p.x(), p.y(), p.z(), n0, adf4.aNode);
+      EXPECT_NEAR(aDist[ip], d0, 1.0e-10);
+      if( fabs(p.Length()-0.5) < 0.1 ){
+        EXPECT_GT(dfm2::CVec3d(aNorm.data()+ip*3)*p.Normalize(), 0.98);
+      }
+    }
+  }
+  { // error-driven depth
+    dfm2::CADF3 adf_fine;
+    adf_fine.SetUp(sphere, bb, 8, 1, 1.0e-5);
+    EXPECT_GT(adf_fine.aNode.size(), adf1.aNode.size());
+    double err1 = 0.0, err_fine = 0.0;
+    for(unsigned int ip=0;ip<1000;++ip){ // points near the surface
+      const double r = 0.48+0.04*ip/1000.0;
+      const double t = ip*0.37, s = ip*0.11;
+      const double p[3] = {r*cos(t)*cos(s), r*sin(t)*cos(s), r*sin(s)};
+      double n[3];
+      err1 = std::max(err1, fabs(adf1.Projection(p[0], p[1], p[2], n)-(0.5-r)));
+      err_fine = std::max(err_fine, fabs(adf_fine.Projection(p[0], p[1], p[2], n)-(0.5-r)));
+    }
+    EXPECT_LT(err_fine, err1*0.1);
+  }
+}